@@ -0,0 +1,784 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "displaypacer.h"
+#include "framerate.h"
+#include "log.h"
+#include "pacesim.h"
+#include "smoothness.h"
+#include "stats.h"
+#include "vulkan.h"
+
+/**
+ * Benchmark suite
+ *
+ * Exercises the demo's code paths without a window (VK_EXT_headless_surface,
+ * meant to run on lavapipe so results do not depend on the GPU or the
+ * display) and writes the results as JSON. Synthetic inputs come from
+ * rand_r() with a fixed seed so runs are comparable.
+ *
+ * Every metric is "lower is better" except the ones flagged otherwise.
+ * Only the deterministic ones are checked against the baseline, timings
+ * on a shared machine vary by more than any useful tolerance. Progress and
+ * the baseline comparison go to stderr, stdout only carries the JSON when
+ * no output file is given.
+ */
+
+#define BENCH_MAX_RESULTS 32
+
+enum BenchResultKind
+{
+  BENCH_RESULT_MEASURED,       /* Wall clock, reported but not checked */
+  BENCH_RESULT_DETERMINISTIC,  /* Same seed, same value: checked against the baseline */
+  BENCH_RESULT_ESTIMATE,       /* Computed from other results, not checked */
+};
+
+/* Indexed by BenchResultKind */
+static const char *g_resultKindNames[] = { "measured", "deterministic", "estimate" };
+
+struct BenchResult
+{
+  const char *name;
+  const char *unit;
+  double value;
+  bool higherIsBetter;
+  enum BenchResultKind kind;
+};
+
+struct BenchOptions
+{
+  const char *outputPath;
+  const char *baselinePath;
+  double tolerance;
+  unsigned int seed;
+  int frames;
+  int width;
+  int height;
+};
+
+struct Bench
+{
+  struct BenchOptions options;
+  VulkanConfig vulkanConfig;
+
+  struct BenchResult results[BENCH_MAX_RESULTS];
+  int resultCount;
+};
+
+static void addResult(struct Bench *bench, const char *name, const char *unit, double value, bool higherIsBetter,
+                      enum BenchResultKind kind)
+{
+  if (bench->resultCount == BENCH_MAX_RESULTS) {
+    return;
+  }
+
+  struct BenchResult *result = &bench->results[bench->resultCount++];
+  result->name = name;
+  result->unit = unit;
+  result->value = value;
+  result->higherIsBetter = higherIsBetter;
+  result->kind = kind;
+
+  fprintf(stderr, "  %-28s %12.3f %s%s\n", name, value, unit, kind == BENCH_RESULT_ESTIMATE ? " (estimate)" : "");
+}
+
+static const struct BenchResult *findResult(const struct Bench *bench, const char *name)
+{
+  for (int i = 0; i < bench->resultCount; i++) {
+    if (strcmp(bench->results[i].name, name) == 0) {
+      return &bench->results[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Swapchain and pipeline creation
+ */
+
+#define BENCH_INIT_CYCLES 5
+
+static bool benchInitialize(struct Bench *bench)
+{
+  struct SampleSeries initSec;
+  if (!statsSeriesInitialize(&initSec, BENCH_INIT_CYCLES)) {
+    return false;
+  }
+
+  bool success = true;
+
+  for (int i = 0; i < BENCH_INIT_CYCLES && success; i++) {
+    double startSec = clockNowSec();
+    success = InitializeVulkan(NULL, bench->options.width, bench->options.height, &bench->vulkanConfig);
+    statsSeriesAdd(&initSec, clockNowSec() - startSec);
+
+    CleanupVulkan();
+  }
+
+  if (success) {
+    struct SeriesSummary summary;
+    statsSeriesSummarize(&initSec, &summary);
+
+    addResult(bench, "init_ms_p50", "ms", summary.p50 * 1000.0, false, BENCH_RESULT_MEASURED);
+    addResult(bench, "init_ms_max", "ms", summary.max * 1000.0, false, BENCH_RESULT_MEASURED);
+  }
+
+  statsSeriesFinalize(&initSec);
+  return success;
+}
+
+/**
+ * Frame recording and submission
+ */
+
+#define BENCH_WARMUP_FRAMES 30
+
+/* Draw loop with random positions, CPU time of Draw() and of its command preparation and
+ * the rendered share of each frame */
+static bool runDrawLoop(struct Bench *bench, const VulkanConfig *config, struct SampleSeries *drawSec,
+                        struct SampleSeries *recordSec, struct SampleSeries *damage, double *totalSec)
+{
+  if (!InitializeVulkan(NULL, bench->options.width, bench->options.height, config)) {
+    CleanupVulkan();
+    return false;
+  }
+
+  unsigned int seed = bench->options.seed;
+  PresentTiming timing;
+
+  for (int i = 0; i < BENCH_WARMUP_FRAMES; i++) {
+    Update(2.0f * rand_r(&seed) / RAND_MAX);
+    Draw();
+    while (PollPresentTiming(&timing));
+  }
+
+  double startSec = clockNowSec();
+
+  for (int i = 0; i < bench->options.frames; i++) {
+    Update(2.0f * rand_r(&seed) / RAND_MAX);
+
+    double frameStartSec = clockNowSec();
+    Draw();
+    statsSeriesAdd(drawSec, clockNowSec() - frameStartSec);
+    statsSeriesAdd(recordSec, GetRecordingDurationSec());
+    statsSeriesAdd(damage, GetDamageFraction());
+
+    while (PollPresentTiming(&timing));
+  }
+
+  *totalSec = clockNowSec() - startSec;
+  return true;
+}
+
+/* Summaries of one draw loop */
+struct DrawRun
+{
+  struct SeriesSummary drawSec;
+  struct SeriesSummary recordSec;
+  struct SeriesSummary damage;
+  double framesPerSec;
+  double gpuFrameSec;  /* Last completed frame */
+};
+
+/* Draw loop on a Vulkan instance of its own, torn down before returning */
+static bool runDraw(struct Bench *bench, const VulkanConfig *config, struct DrawRun *run)
+{
+  /* Zeroed so finalizing is safe whichever allocation failed */
+  struct SampleSeries drawSec = { 0 }, recordSec = { 0 }, damage = { 0 };
+  double totalSec = 0.0;
+  bool success = statsSeriesInitialize(&drawSec, bench->options.frames)
+    && statsSeriesInitialize(&recordSec, bench->options.frames)
+    && statsSeriesInitialize(&damage, bench->options.frames)
+    && runDrawLoop(bench, config, &drawSec, &recordSec, &damage, &totalSec);
+
+  if (success) {
+    statsSeriesSummarize(&drawSec, &run->drawSec);
+    statsSeriesSummarize(&recordSec, &run->recordSec);
+    statsSeriesSummarize(&damage, &run->damage);
+    run->framesPerSec = bench->options.frames / totalSec;
+    run->gpuFrameSec = GetGpuFrameDurationSec();
+
+    CleanupVulkan();
+  }
+
+  statsSeriesFinalize(&drawSec);
+  statsSeriesFinalize(&recordSec);
+  statsSeriesFinalize(&damage);
+
+  return success;
+}
+
+static bool benchDraw(struct Bench *bench)
+{
+  struct DrawRun run;
+  if (!runDraw(bench, &bench->vulkanConfig, &run)) {
+    return false;
+  }
+
+  addResult(bench, "draw_cpu_us_p50", "us", run.drawSec.p50 * 1000000.0, false, BENCH_RESULT_MEASURED);
+  addResult(bench, "draw_cpu_us_p99", "us", run.drawSec.p99 * 1000000.0, false, BENCH_RESULT_MEASURED);
+  addResult(bench, "draw_frames_per_sec", "fps", run.framesPerSec, true, BENCH_RESULT_MEASURED);
+  addResult(bench, "gpu_frame_us", "us", run.gpuFrameSec * 1000000.0, false, BENCH_RESULT_MEASURED);
+  addResult(bench, "record_us_p50", "us", run.recordSec.p50 * 1000000.0, false, BENCH_RESULT_MEASURED);
+
+  return true;
+}
+
+/* Same loop with command buffers recorded once per swapchain image */
+static bool benchPrerecorded(struct Bench *bench)
+{
+  VulkanConfig config = bench->vulkanConfig;
+  config.prerecordedCommands = SDL_TRUE;
+
+  struct DrawRun run;
+  if (!runDraw(bench, &config, &run)) {
+    return false;
+  }
+
+  addResult(bench, "prerecorded_draw_cpu_us_p50", "us", run.drawSec.p50 * 1000000.0, false, BENCH_RESULT_MEASURED);
+  addResult(bench, "prerecorded_draw_cpu_us_p99", "us", run.drawSec.p99 * 1000000.0, false, BENCH_RESULT_MEASURED);
+  addResult(bench, "prerecorded_record_us_p50", "us", run.recordSec.p50 * 1000000.0, false, BENCH_RESULT_MEASURED);
+
+  const struct BenchResult *perFrame = findResult(bench, "record_us_p50");
+  if (perFrame != NULL) {
+    addResult(bench, "prerecorded_saved_us", "us", perFrame->value - run.recordSec.p50 * 1000000.0, true,
+              BENCH_RESULT_MEASURED);
+  }
+
+  return true;
+}
+
+#define BENCH_RECORD_THREADS 4
+
+/* Same loop with the scene recorded into secondary command buffers on several threads */
+static bool benchParallel(struct Bench *bench)
+{
+  VulkanConfig config = bench->vulkanConfig;
+  config.recordThreads = BENCH_RECORD_THREADS;
+
+  struct DrawRun run;
+  if (!runDraw(bench, &config, &run)) {
+    return false;
+  }
+
+  addResult(bench, "parallel_draw_cpu_us_p50", "us", run.drawSec.p50 * 1000000.0, false, BENCH_RESULT_MEASURED);
+  addResult(bench, "parallel_record_us_p50", "us", run.recordSec.p50 * 1000000.0, false, BENCH_RESULT_MEASURED);
+
+  return true;
+}
+
+/* Same loop rendering only the region the bar moved through */
+static bool benchDamage(struct Bench *bench)
+{
+  VulkanConfig config = bench->vulkanConfig;
+  config.damageTracking = SDL_TRUE;
+
+  struct DrawRun run;
+  if (!runDraw(bench, &config, &run)) {
+    return false;
+  }
+
+  double damageFraction = run.damage.mean;
+  /* Not measured: clear (or load) and store of a 32 bit color attachment
+     scaled by the rendered share */
+  double fullFrameKB = 2.0 * 4.0 * bench->options.width * bench->options.height / 1000.0;
+
+  addResult(bench, "damage_gpu_frame_us", "us", run.gpuFrameSec * 1000000.0, false, BENCH_RESULT_MEASURED);
+  /* The positions come from the seed */
+  addResult(bench, "damage_area_percent", "%", damageFraction * 100.0, false, BENCH_RESULT_DETERMINISTIC);
+  addResult(bench, "damage_traffic_saved_kb_estimated", "KB", (1.0 - damageFraction) * fullFrameKB, true,
+            BENCH_RESULT_ESTIMATE);
+
+  return true;
+}
+
+/**
+ * Multiple outputs
+ */
+
+#define BENCH_DISPLAYS          2
+#define BENCH_DISPLAYS_RUN_SEC  2.0
+#define BENCH_DISPLAY_RATE      60
+/* Second output frames as fast as its thread can submit */
+#define BENCH_DISPLAY_BUSY_RATE 1000
+
+/* Cadence error and wake-up lateness of output 0, paced at a fixed rate, with
+ * the other outputs running their own loops next to it */
+static bool runDisplayPacers(struct Bench *bench, uint32_t count, struct SeriesSummary *cadenceError,
+                             struct SeriesSummary *wakeupLateness)
+{
+  SDL_Window *windows[BENCH_DISPLAYS] = {};
+  int widths[BENCH_DISPLAYS], heights[BENCH_DISPLAYS];
+  for (uint32_t i = 0; i < count; i++) {
+    widths[i] = bench->options.width;
+    heights[i] = bench->options.height;
+  }
+
+  if (!InitializeVulkanOutputs(windows, widths, heights, count, &bench->vulkanConfig)) {
+    CleanupVulkan();
+    return false;
+  }
+
+  struct DisplayPacer pacers[BENCH_DISPLAYS];
+  uint32_t initialized = 0;
+  bool success = true;
+
+  for (uint32_t i = 0; i < count && success; i++) {
+    success = displayPacerInitialize(&pacers[i], i, i, BENCH_DISPLAY_RATE, 5.0);
+    if (success) {
+      int rate = i == 0 ? BENCH_DISPLAY_RATE : BENCH_DISPLAY_BUSY_RATE;
+      pacers[i].frameRateController.frameRateMin = rate;
+      pacers[i].frameRateController.frameRateMax = rate;
+      initialized++;
+    }
+  }
+
+  for (uint32_t i = 0; i < initialized && success; i++) {
+    success = displayPacerStart(&pacers[i]);
+  }
+
+  if (success) {
+    clockSleepSec(BENCH_DISPLAYS_RUN_SEC);
+  }
+
+  for (uint32_t i = 0; i < initialized; i++) {
+    displayPacerStop(&pacers[i]);
+  }
+
+  if (success) {
+    struct SeriesSummary frameInterval;
+    displayPacerSummarize(&pacers[0], &frameInterval, cadenceError, wakeupLateness);
+  }
+
+  for (uint32_t i = 0; i < initialized; i++) {
+    displayPacerFinalize(&pacers[i]);
+  }
+
+  CleanupVulkan();
+  return success;
+}
+
+static bool benchDisplays(struct Bench *bench)
+{
+  struct SeriesSummary aloneCadence, aloneWakeup, sharedCadence, sharedWakeup;
+
+  if (!runDisplayPacers(bench, 1, &aloneCadence, &aloneWakeup)
+      || !runDisplayPacers(bench, BENCH_DISPLAYS, &sharedCadence, &sharedWakeup)) {
+    return false;
+  }
+
+  addResult(bench, "displays_cadence_error_us_p99", "us", sharedCadence.p99 * 1000000.0, false,
+            BENCH_RESULT_MEASURED);
+  addResult(bench, "displays_wakeup_us_p99", "us", sharedWakeup.p99 * 1000000.0, false, BENCH_RESULT_MEASURED);
+  /* Jitter the busy output adds to the paced one, ~1 when the outputs are isolated */
+  if (aloneCadence.p99 > 0.0) {
+    addResult(bench, "displays_jitter_ratio", "x", sharedCadence.p99 / aloneCadence.p99, false,
+              BENCH_RESULT_MEASURED);
+  }
+
+  return true;
+}
+
+/**
+ * Frame limiter accuracy
+ */
+
+#define BENCH_PACING_FRAMES 200
+
+static bool benchPacing(struct Bench *bench)
+{
+  struct SampleSeries errorSec;
+  if (!statsSeriesInitialize(&errorSec, BENCH_PACING_FRAMES)) {
+    return false;
+  }
+
+  struct FrameRateController frameRateController;
+  initializeFrameRateController(&frameRateController, 144);
+
+  /* Random phase of the frame rate sweep, the run covers about 2.5 s of it */
+  unsigned int seed = bench->options.seed;
+  double sweepTimeSec = 6.283 * rand_r(&seed) / RAND_MAX;
+
+  for (int i = 0; i < BENCH_PACING_FRAMES; i++) {
+    computeNextFrameDelayMsec(&frameRateController, sweepTimeSec);
+    double delaySec = frameRateController.nextFrameDelaySec;
+
+    double startSec = clockNowSec();
+    clockSleepSec(delaySec);
+    double sleptSec = clockNowSec() - startSec;
+
+    statsSeriesAdd(&errorSec, sleptSec - delaySec);
+    sweepTimeSec += delaySec;
+  }
+
+  struct SeriesSummary summary;
+  statsSeriesSummarize(&errorSec, &summary);
+
+  addResult(bench, "pacing_error_us_mean", "us", summary.mean * 1000000.0, false, BENCH_RESULT_MEASURED);
+  addResult(bench, "pacing_error_us_p99", "us", summary.p99 * 1000000.0, false, BENCH_RESULT_MEASURED);
+  addResult(bench, "pacing_error_us_max", "us", summary.max * 1000000.0, false, BENCH_RESULT_MEASURED);
+
+  statsSeriesFinalize(&errorSec);
+  return true;
+}
+
+/**
+ * Simulated pacing
+ */
+
+#define BENCH_SIM_DURATION_SEC 600.0
+
+/* The demo's pacing in virtual time, see pacesim.h: the same seed gives the same numbers on any machine */
+static bool benchSimulatedPacing(struct Bench *bench)
+{
+  struct PaceSimConfig config;
+  paceSimDefaults(&config);
+  config.durationSec = BENCH_SIM_DURATION_SEC;
+  config.seed = bench->options.seed;
+
+  struct PaceSimResult sleepResult, lowLatencyResult;
+  if (!paceSimRun(&config, &sleepResult)) {
+    return false;
+  }
+
+  config.lowLatency = true;
+  if (!paceSimRun(&config, &lowLatencyResult)) {
+    return false;
+  }
+
+  addResult(bench, "sim_cadence_error_us_p99", "us", sleepResult.cadenceErrorSec.p99 * 1000000.0, false,
+            BENCH_RESULT_DETERMINISTIC);
+  addResult(bench, "sim_judder_pct", "%", sleepResult.judderScore, false, BENCH_RESULT_DETERMINISTIC);
+  addResult(bench, "sim_ll_cadence_error_us_p99", "us", lowLatencyResult.cadenceErrorSec.p99 * 1000000.0, false,
+            BENCH_RESULT_DETERMINISTIC);
+  addResult(bench, "sim_ll_latency_us_p50", "us", lowLatencyResult.latencySec.p50 * 1000000.0, false,
+            BENCH_RESULT_DETERMINISTIC);
+  uint64_t pacedFrames = lowLatencyResult.pacerHits + lowLatencyResult.pacerMisses;
+  if (pacedFrames > 0) {
+    addResult(bench, "sim_ll_late_pct", "%", 100.0 * lowLatencyResult.pacerMisses / pacedFrames, false,
+              BENCH_RESULT_DETERMINISTIC);
+  }
+
+  return true;
+}
+
+/**
+ * Statistics engine
+ */
+
+#define BENCH_STATS_FRAMES 100000
+
+static bool benchStats(struct Bench *bench)
+{
+  struct SampleSeries frameIntervalSec;
+  struct SmoothnessAnalyzer smoothness;
+
+  if (!statsSeriesInitialize(&frameIntervalSec, 4096)) {
+    return false;
+  }
+  if (!smoothnessInitialize(&smoothness, 2560 / 5.0, 2560)) {
+    statsSeriesFinalize(&frameIntervalSec);
+    return false;
+  }
+
+  unsigned int seed = bench->options.seed;
+  PresentTiming timing = {};
+  double positionPx = 0.0;
+  double lastPresentSec = 0.0;
+
+  double startSec = clockNowSec();
+
+  /* Per frame work of the demo's statistics: interval series and smoothness analysis */
+  for (uint64_t frameId = 1; frameId <= BENCH_STATS_FRAMES; frameId++) {
+    double intervalSec = (7.0 + 26.0 * rand_r(&seed) / RAND_MAX) / 1000.0;
+
+    positionPx += 512.0 * intervalSec;
+    if (positionPx >= 2560.0) {
+      positionPx -= 2560.0;
+    }
+
+    timing.frameId = frameId;
+    timing.submitTimeSec = lastPresentSec + intervalSec;
+    timing.presentTimeSec = timing.submitTimeSec + 0.001 * rand_r(&seed) / RAND_MAX;
+    timing.presentTimeIsDisplayed = SDL_TRUE;
+
+    smoothnessFrameSubmitted(&smoothness, frameId, positionPx);
+
+    struct SmoothnessSample sample;
+    smoothnessFramePresented(&smoothness, &timing, &sample);
+    statsSeriesAdd(&frameIntervalSec, timing.presentTimeSec - lastPresentSec);
+
+    lastPresentSec = timing.presentTimeSec;
+  }
+
+  double frameSec = (clockNowSec() - startSec) / BENCH_STATS_FRAMES;
+
+  /* Report cost: summaries sort the retained samples */
+  struct SeriesSummary summary;
+  startSec = clockNowSec();
+  statsSeriesSummarize(&frameIntervalSec, &summary);
+  double summarySec = clockNowSec() - startSec;
+
+  addResult(bench, "stats_per_frame_ns", "ns", frameSec * 1000000000.0, false, BENCH_RESULT_MEASURED);
+  addResult(bench, "stats_summary_us", "us", summarySec * 1000000.0, false, BENCH_RESULT_MEASURED);
+
+  smoothnessFinalize(&smoothness);
+  statsSeriesFinalize(&frameIntervalSec);
+
+  return true;
+}
+
+/**
+ * Output
+ */
+
+static bool writeJson(struct Bench *bench)
+{
+  FILE *file = stdout;
+  if (bench->options.outputPath != NULL) {
+    file = fopen(bench->options.outputPath, "w");
+    if (file == NULL) {
+      fprintf(stderr, "Cannot open '%s'.\n", bench->options.outputPath);
+      return false;
+    }
+  }
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"suite\": \"%s\",\n", "vk-gsync-bench");
+  fprintf(file, "  \"seed\": %u,\n", bench->options.seed);
+  fprintf(file, "  \"frames\": %d,\n", bench->options.frames);
+  fprintf(file, "  \"results\": {\n");
+
+  for (int i = 0; i < bench->resultCount; i++) {
+    const struct BenchResult *result = &bench->results[i];
+    fprintf(file, "    \"%s\": { \"value\": %.6f, \"unit\": \"%s\", \"higher_is_better\": %s, \"kind\": \"%s\" }%s\n",
+            result->name, result->value, result->unit, result->higherIsBetter ? "true" : "false",
+            g_resultKindNames[result->kind], i + 1 < bench->resultCount ? "," : "");
+  }
+
+  fprintf(file, "  }\n");
+  fprintf(file, "}\n");
+
+  if (file != stdout) {
+    fclose(file);
+  }
+
+  return true;
+}
+
+static char *readFile(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  char *content = malloc(size + 1);
+  if (content != NULL) {
+    size_t length = fread(content, 1, size, file);
+    content[length] = '\0';
+  }
+
+  fclose(file);
+  return content;
+}
+
+/* Finds "name": { "value": X in a file written by writeJson() */
+static bool baselineValue(const char *baseline, const char *name, double *value)
+{
+  char key[64];
+  snprintf(key, sizeof(key), "\"%s\"", name);
+
+  const char *entry = strstr(baseline, key);
+  if (entry == NULL) {
+    return false;
+  }
+
+  const char *field = strstr(entry, "\"value\":");
+  if (field == NULL) {
+    return false;
+  }
+
+  char *end;
+  *value = strtod(field + strlen("\"value\":"), &end);
+  return end != field + strlen("\"value\":");
+}
+
+/* Returns the number of deterministic metrics worse than the baseline by more than
+   the tolerance, the others are only shown */
+static int compareBaseline(struct Bench *bench)
+{
+  char *baseline = readFile(bench->options.baselinePath);
+  if (baseline == NULL) {
+    fprintf(stderr, "Cannot read baseline '%s'.\n", bench->options.baselinePath);
+    return -1;
+  }
+
+  int regressions = 0;
+
+  fprintf(stderr, "Baseline %s (tolerance %.0f%%):\n", bench->options.baselinePath, bench->options.tolerance * 100.0);
+
+  for (int i = 0; i < bench->resultCount; i++) {
+    const struct BenchResult *result = &bench->results[i];
+
+    double previous;
+    if (!baselineValue(baseline, result->name, &previous) || previous == 0.0) {
+      fprintf(stderr, "  %-28s no baseline\n", result->name);
+      continue;
+    }
+
+    double change = (result->value - previous) / previous;
+    bool regressed = result->kind == BENCH_RESULT_DETERMINISTIC
+      && (result->higherIsBetter ? change < -bench->options.tolerance : change > bench->options.tolerance);
+
+    fprintf(stderr, "  %-28s %12.3f -> %12.3f %s (%+.1f%%)%s\n", result->name, previous, result->value,
+           result->unit, change * 100.0,
+           regressed ? "  REGRESSION"
+           : result->kind == BENCH_RESULT_ESTIMATE ? "  estimate, not checked"
+           : result->kind == BENCH_RESULT_MEASURED ? "  measured, not checked" : "");
+
+    if (regressed) {
+      regressions++;
+    }
+  }
+
+  free(baseline);
+  return regressions;
+}
+
+/**
+ * Command line
+ */
+
+static void printUsage(const char *programName)
+{
+  printf("Usage: %s [options]\n"
+         "  --output=FILE       write the JSON results to FILE instead of stdout\n"
+         "  --baseline=FILE     compare with a previous JSON result, exit with 1 on regressions\n"
+         "  --tolerance=PCT     allowed regression in percent (default 10)\n"
+         "  --seed=N            random seed (default 1)\n"
+         "  --frames=N          frames drawn by the draw benchmark (default 2000)\n"
+         "  --size=WxH          headless swapchain size (default 1920x1080)\n"
+         "  --help              show this message\n",
+         programName);
+}
+
+static bool parseOptions(struct BenchOptions *options, int argc, char **argv)
+{
+  enum {
+    OPTION_OUTPUT = 256,
+    OPTION_BASELINE,
+    OPTION_TOLERANCE,
+    OPTION_SEED,
+    OPTION_FRAMES,
+    OPTION_SIZE,
+    OPTION_HELP,
+  };
+
+  static const struct option longOptions[] = {
+    { "output",    required_argument, NULL, OPTION_OUTPUT },
+    { "baseline",  required_argument, NULL, OPTION_BASELINE },
+    { "tolerance", required_argument, NULL, OPTION_TOLERANCE },
+    { "seed",      required_argument, NULL, OPTION_SEED },
+    { "frames",    required_argument, NULL, OPTION_FRAMES },
+    { "size",      required_argument, NULL, OPTION_SIZE },
+    { "help",      no_argument,       NULL, OPTION_HELP },
+    { NULL, 0, NULL, 0 }
+  };
+
+  memset(options, 0, sizeof(*options));
+  options->tolerance = 0.10;
+  options->seed = 1;
+  options->frames = 2000;
+  options->width = 1920;
+  options->height = 1080;
+
+  int option;
+  while ((option = getopt_long(argc, argv, "", longOptions, NULL)) != -1) {
+    switch (option) {
+    case OPTION_OUTPUT:    options->outputPath = optarg; break;
+    case OPTION_BASELINE:  options->baselinePath = optarg; break;
+    case OPTION_TOLERANCE: options->tolerance = atof(optarg) / 100.0; break;
+    case OPTION_SEED:      options->seed = strtoul(optarg, NULL, 0); break;
+    case OPTION_FRAMES:    options->frames = atoi(optarg); break;
+    case OPTION_SIZE:
+      if (sscanf(optarg, "%dx%d", &options->width, &options->height) != 2) {
+        fprintf(stderr, "Invalid size '%s', expected WxH\n", optarg);
+        return false;
+      }
+      break;
+    case OPTION_HELP:
+    default:
+      printUsage(argv[0]);
+      return false;
+    }
+  }
+
+  if (options->frames <= 0 || options->width <= 0 || options->height <= 0) {
+    fprintf(stderr, "Frame count and size must be positive\n");
+    return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  struct Bench bench = {};
+
+  if (!parseOptions(&bench.options, argc, argv)) {
+    return 1;
+  }
+
+  bench.vulkanConfig.headless = SDL_TRUE;
+
+  /* Keep Vulkan chatter out of the results */
+  logSetLevel(LOG_LEVEL_WARNING);
+
+  fprintf(stderr, "Running benchmarks (seed %u, %d frames, %dx%d):\n",
+         bench.options.seed, bench.options.frames, bench.options.width, bench.options.height);
+
+  bool success = benchInitialize(&bench)
+    && benchDraw(&bench)
+    && benchPrerecorded(&bench)
+    && benchParallel(&bench)
+    && benchDamage(&bench)
+    && benchDisplays(&bench)
+    && benchPacing(&bench)
+    && benchSimulatedPacing(&bench)
+    && benchStats(&bench);
+
+  if (!success) {
+    fprintf(stderr, "Benchmark failed, is a Vulkan driver with VK_EXT_headless_surface (lavapipe) available?\n");
+    return 1;
+  }
+
+  if (!writeJson(&bench)) {
+    return 1;
+  }
+
+  if (bench.options.baselinePath != NULL) {
+    int regressions = compareBaseline(&bench);
+    if (regressions != 0) {
+      if (regressions > 0) {
+        fprintf(stderr, "%d regressions\n", regressions);
+      }
+      return 1;
+    }
+  }
+
+  return 0;
+}
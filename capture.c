@@ -0,0 +1,273 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "capture.h"
+#include "log.h"
+
+/* Indexed by CaptureFormat */
+static const char *g_formatNames[] = { "ppm", "png" };
+
+static bool reserve(uint8_t **buffer, size_t *size, size_t needed)
+{
+  if (*size >= needed) {
+    return true;
+  }
+
+  uint8_t *grown = realloc(*buffer, needed);
+  if (grown == NULL) {
+    return false;
+  }
+
+  *buffer = grown;
+  *size = needed;
+  return true;
+}
+
+/* RGB scanlines, each preceded by a PNG filter type byte when filterBytes is 1 */
+static void convertRows(uint8_t *destination, const struct CaptureJob *job, int filterBytes)
+{
+  for (uint32_t y = 0; y < job->height; y++) {
+    const uint8_t *source = job->pixels + (size_t)y * job->rowPitch;
+
+    if (filterBytes) {
+      *destination++ = 0;
+    }
+    for (uint32_t x = 0; x < job->width; x++, source += 4) {
+      *destination++ = source[2];
+      *destination++ = source[1];
+      *destination++ = source[0];
+    }
+  }
+}
+
+static bool writePpm(struct CaptureWriter *writer, FILE *file, const struct CaptureJob *job)
+{
+  size_t size = (size_t)job->width * job->height * 3;
+  if (!reserve(&writer->scratch, &writer->scratchSize, size)) {
+    return false;
+  }
+
+  convertRows(writer->scratch, job, 0);
+
+  return fprintf(file, "P6\n%u %u\n255\n", job->width, job->height) > 0
+    && fwrite(writer->scratch, 1, size, file) == size;
+}
+
+static bool writeChunk(FILE *file, const char *type, const uint8_t *data, uint32_t length)
+{
+  uint8_t header[8] = {
+    length >> 24, length >> 16, length >> 8, length,
+    type[0], type[1], type[2], type[3],
+  };
+
+  /* crc32() restarts on a NULL buffer, IEND has no data */
+  uint32_t crc = crc32(0, header + 4, 4);
+  if (length > 0) {
+    crc = crc32(crc, data, length);
+  }
+  uint8_t trailer[4] = { crc >> 24, crc >> 16, crc >> 8, crc };
+
+  return fwrite(header, 1, sizeof(header), file) == sizeof(header)
+    && (length == 0 || fwrite(data, 1, length, file) == length)
+    && fwrite(trailer, 1, sizeof(trailer), file) == sizeof(trailer);
+}
+
+static bool writePng(struct CaptureWriter *writer, FILE *file, const struct CaptureJob *job)
+{
+  static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+  size_t size = (size_t)job->height * (1 + (size_t)job->width * 3);
+  uLongf compressedLength = compressBound(size);
+  if (!reserve(&writer->scratch, &writer->scratchSize, size)
+      || !reserve(&writer->compressed, &writer->compressedSize, compressedLength)) {
+    return false;
+  }
+
+  convertRows(writer->scratch, job, 1);
+
+  /* Speed over size, the disk only has to keep up */
+  if (compress2(writer->compressed, &compressedLength, writer->scratch, size, 1) != Z_OK) {
+    return false;
+  }
+
+  /* 8 bit RGB, no interlacing */
+  uint8_t header[13] = {
+    job->width >> 24, job->width >> 16, job->width >> 8, job->width,
+    job->height >> 24, job->height >> 16, job->height >> 8, job->height,
+    8, 2, 0, 0, 0,
+  };
+
+  return fwrite(signature, 1, sizeof(signature), file) == sizeof(signature)
+    && writeChunk(file, "IHDR", header, sizeof(header))
+    && writeChunk(file, "IDAT", writer->compressed, compressedLength)
+    && writeChunk(file, "IEND", NULL, 0);
+}
+
+static void writeFrame(struct CaptureWriter *writer, const struct CaptureJob *job)
+{
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/frame-%u-%08llu.%s", writer->directory, job->output,
+           (unsigned long long)job->frameId, g_formatNames[writer->format]);
+
+  /* Of the first failure, later calls may change errno */
+  int error = 0;
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    error = errno;
+  } else {
+    errno = 0;
+    bool written = writer->format == CAPTURE_FORMAT_PNG ? writePng(writer, file, job) : writePpm(writer, file, job);
+    if (!written) {
+      /* Allocation and compression failures do not set errno */
+      error = errno != 0 ? errno : EIO;
+    }
+
+    long size = ftell(file);
+    if (fclose(file) != 0 && error == 0) {
+      error = errno;
+    }
+
+    if (error == 0) {
+      atomic_fetch_add(&writer->bytes, size);
+    }
+  }
+
+  if (error == 0) {
+    atomic_fetch_add(&writer->written, 1);
+  } else if (atomic_fetch_add(&writer->failed, 1) == 0) {
+    logError("Cannot write captured frame '%s': %s", path, strerror(error));
+  }
+}
+
+static void *writerThread(void *arg)
+{
+  struct CaptureWriter *writer = arg;
+
+  pthread_mutex_lock(&writer->lock);
+  for (;;) {
+    while (writer->running && writer->count == 0) {
+      pthread_cond_wait(&writer->wakeup, &writer->lock);
+    }
+    /* Stopping, but only once the queue is empty */
+    if (writer->count == 0) {
+      break;
+    }
+
+    struct CaptureJob job = writer->queue[writer->head];
+    writer->head = (writer->head + 1) % CAPTURE_QUEUE_SIZE;
+    writer->count--;
+    pthread_mutex_unlock(&writer->lock);
+
+    writeFrame(writer, &job);
+    atomic_store(job.busy, false);
+
+    pthread_mutex_lock(&writer->lock);
+  }
+  pthread_mutex_unlock(&writer->lock);
+
+  return NULL;
+}
+
+int captureWriterInitialize(struct CaptureWriter *writer, const char *directory, enum CaptureFormat format)
+{
+  memset(writer, 0, sizeof(*writer));
+
+  if (directory == NULL) {
+    return 1;
+  }
+
+  if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+    logError("Cannot create capture directory '%s': %s", directory, strerror(errno));
+    return 0;
+  }
+
+  writer->format = format;
+  writer->running = true;
+  pthread_mutex_init(&writer->lock, NULL);
+  pthread_cond_init(&writer->wakeup, NULL);
+
+  if (pthread_create(&writer->thread, NULL, writerThread, writer) != 0) {
+    logError("Cannot start the capture writer thread");
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->wakeup);
+    return 0;
+  }
+  writer->directory = directory;
+
+  logInfo("Capturing frames to %s as %s", directory, g_formatNames[format]);
+
+  return 1;
+}
+
+void captureWriterFinalize(struct CaptureWriter *writer)
+{
+  if (writer->directory == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&writer->lock);
+  writer->running = false;
+  pthread_cond_signal(&writer->wakeup);
+  pthread_mutex_unlock(&writer->lock);
+
+  pthread_join(writer->thread, NULL);
+  pthread_mutex_destroy(&writer->lock);
+  pthread_cond_destroy(&writer->wakeup);
+
+  logInfo("Frame capture: %llu frames written to %s (%.1f MB), %llu dropped, %llu failed",
+          (unsigned long long)atomic_load(&writer->written), writer->directory, atomic_load(&writer->bytes) / 1e6,
+          (unsigned long long)atomic_load(&writer->dropped), (unsigned long long)atomic_load(&writer->failed));
+
+  free(writer->scratch);
+  free(writer->compressed);
+  writer->scratch = NULL;
+  writer->compressed = NULL;
+  writer->directory = NULL;
+}
+
+bool captureWriterQueue(struct CaptureWriter *writer, const struct CaptureJob *job)
+{
+  bool queued = false;
+
+  pthread_mutex_lock(&writer->lock);
+  if (writer->count < CAPTURE_QUEUE_SIZE) {
+    writer->queue[(writer->head + writer->count) % CAPTURE_QUEUE_SIZE] = *job;
+    writer->count++;
+    queued = true;
+    pthread_cond_signal(&writer->wakeup);
+  }
+  pthread_mutex_unlock(&writer->lock);
+
+  return queued;
+}
+
+void captureWriterDropped(struct CaptureWriter *writer)
+{
+  atomic_fetch_add_explicit(&writer->dropped, 1, memory_order_relaxed);
+}
+
+bool captureParseFormat(const char *value, enum CaptureFormat *format)
+{
+  for (int i = 0; i < (int)(sizeof(g_formatNames) / sizeof(*g_formatNames)); i++) {
+    if (strcmp(value, g_formatNames[i]) == 0) {
+      *format = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char *captureFormatName(enum CaptureFormat format)
+{
+  return g_formatNames[format];
+}
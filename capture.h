@@ -0,0 +1,75 @@
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAPTURE_QUEUE_SIZE 32
+
+enum CaptureFormat
+{
+  CAPTURE_FORMAT_PPM,          /* Binary PPM, uncompressed */
+  CAPTURE_FORMAT_PNG,          /* zlib level 1, for disks that cannot keep up with raw frames */
+};
+
+/* A copied frame in a staging buffer, 32 bit BGRA pixels */
+struct CaptureJob
+{
+  const uint8_t *pixels;
+  uint32_t width;
+  uint32_t height;
+  uint32_t rowPitch;           /* Bytes */
+  uint32_t output;
+  uint64_t frameId;
+  atomic_bool *busy;           /* Cleared once written, the staging buffer can then be reused */
+};
+
+/*
+ * Writes captured frames to disk on its own thread, one file per frame
+ * (DIRECTORY/frame-OUTPUT-FRAMEID.ppm or .png). Queuing a frame only takes
+ * the queue lock, which the writer never holds while converting or writing,
+ * so the frame loop never waits for the disk. Frames the loop could not
+ * capture because every staging buffer was still waiting to be written are
+ * counted as dropped.
+ */
+struct CaptureWriter
+{
+  const char *directory;
+  enum CaptureFormat format;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+  bool running;
+  struct CaptureJob queue[CAPTURE_QUEUE_SIZE];
+  uint32_t head;
+  uint32_t count;
+
+  /* Writer thread only, grown to the biggest frame */
+  uint8_t *scratch;
+  size_t scratchSize;
+  uint8_t *compressed;
+  size_t compressedSize;
+
+  atomic_uint_fast64_t written;
+  atomic_uint_fast64_t dropped;
+  atomic_uint_fast64_t failed;
+  atomic_uint_fast64_t bytes;
+};
+
+/* A NULL directory disables the capture, the directory is created when missing */
+int captureWriterInitialize(struct CaptureWriter *writer, const char *directory, enum CaptureFormat format);
+/* Writes the frames still queued, then stops the thread */
+void captureWriterFinalize(struct CaptureWriter *writer);
+
+/* False when the queue is full, the job's busy flag is then left as is */
+bool captureWriterQueue(struct CaptureWriter *writer, const struct CaptureJob *job);
+void captureWriterDropped(struct CaptureWriter *writer);
+
+bool captureParseFormat(const char *value, enum CaptureFormat *format);
+const char *captureFormatName(enum CaptureFormat format);
+
+#endif /* __CAPTURE_H__ */
@@ -0,0 +1,52 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "clock.h"
+
+static const struct ClockSource *g_source;
+
+void clockSetSource(const struct ClockSource *source)
+{
+  g_source = source;
+}
+
+double clockNowSec(void)
+{
+  if (g_source != NULL) {
+    return g_source->now(g_source->userData);
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double)ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+void clockSleepSec(double durationSec)
+{
+  if (durationSec <= 0.0) {
+    return;
+  }
+
+  clockSleepUntilSec(clockNowSec() + durationSec);
+}
+
+void clockSleepUntilSec(double deadlineSec)
+{
+  if (g_source != NULL) {
+    g_source->sleepUntil(g_source->userData, deadlineSec);
+    return;
+  }
+
+  struct timespec ts;
+  ts.tv_sec = (time_t)deadlineSec;
+  ts.tv_nsec = (long)((deadlineSec - ts.tv_sec) * 1000000000.0);
+
+  /* Absolute deadline: signals do not stretch the sleep */
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
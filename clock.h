@@ -0,0 +1,25 @@
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+/*
+ * Where time and sleeps come from. The default source is CLOCK_MONOTONIC and
+ * clock_nanosleep(), a simulated one (see simclock.h) lets the pacing code run
+ * in virtual time: sleeps return at once and only advance the clock.
+ */
+struct ClockSource
+{
+  double (*now)(void *userData);
+  void (*sleepUntil)(void *userData, double deadlineSec);
+  void *userData;
+};
+
+/* Process wide, set it before any thread uses the clock. NULL restores the real clock. */
+void clockSetSource(const struct ClockSource *source);
+
+/* Monotonic time in seconds, CLOCK_MONOTONIC unless another source is set */
+double clockNowSec(void);
+
+void clockSleepSec(double durationSec);
+void clockSleepUntilSec(double deadlineSec);
+
+#endif /* __CLOCK_H__ */
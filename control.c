@@ -0,0 +1,257 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "log.h"
+
+/* Reserved epoll data value of the listening socket, clients use their slot index */
+#define CONTROL_LISTEN_EVENT -1
+
+int controlInitialize(struct ControlServer *server, const char *path)
+{
+  memset(server, 0, sizeof(*server));
+  server->listenFd = -1;
+  server->epollFd = -1;
+  for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+    server->clients[i].fd = -1;
+  }
+
+  if (path == NULL) {
+    return 1;
+  }
+
+  struct sockaddr_un address = { .sun_family = AF_UNIX };
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    logError("Control socket path '%s' is too long.", path);
+    return 0;
+  }
+  strcpy(address.sun_path, path);
+
+  server->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (server->listenFd < 0) {
+    logError("Cannot create control socket: %s", strerror(errno));
+    return 0;
+  }
+
+  /* Left over by a previous run that did not exit cleanly, but never
+     anything else a mistyped path names */
+  struct stat status;
+  if (lstat(path, &status) == 0) {
+    if (!S_ISSOCK(status.st_mode)) {
+      logError("Control socket path '%s' exists and is not a socket", path);
+      controlFinalize(server);
+      return 0;
+    }
+    unlink(path);
+  }
+
+  if (bind(server->listenFd, (struct sockaddr *)&address, sizeof(address)) != 0
+      || listen(server->listenFd, CONTROL_MAX_CLIENTS) != 0) {
+    logError("Cannot listen on control socket '%s': %s", path, strerror(errno));
+    controlFinalize(server);
+    return 0;
+  }
+  server->path = path;
+
+  server->epollFd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event event = { .events = EPOLLIN, .data.u32 = (uint32_t)CONTROL_LISTEN_EVENT };
+  if (server->epollFd < 0 || epoll_ctl(server->epollFd, EPOLL_CTL_ADD, server->listenFd, &event) != 0) {
+    logError("Cannot poll control socket: %s", strerror(errno));
+    controlFinalize(server);
+    return 0;
+  }
+
+  logInfo("Control socket listening on %s", path);
+
+  return 1;
+}
+
+static void closeClient(struct ControlServer *server, int index)
+{
+  struct ControlClient *client = &server->clients[index];
+
+  /* Closing the descriptor also removes it from the epoll set */
+  close(client->fd);
+  client->fd = -1;
+  client->length = 0;
+}
+
+void controlFinalize(struct ControlServer *server)
+{
+  for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+    if (server->clients[i].fd >= 0) {
+      closeClient(server, i);
+    }
+  }
+
+  if (server->epollFd >= 0) {
+    close(server->epollFd);
+    server->epollFd = -1;
+  }
+
+  if (server->listenFd >= 0) {
+    close(server->listenFd);
+    server->listenFd = -1;
+  }
+
+  if (server->path != NULL) {
+    unlink(server->path);
+    server->path = NULL;
+  }
+}
+
+static void acceptClients(struct ControlServer *server)
+{
+  int fd;
+  while ((fd = accept4(server->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    int index = 0;
+    while (index < CONTROL_MAX_CLIENTS && server->clients[index].fd >= 0) {
+      index++;
+    }
+
+    if (index == CONTROL_MAX_CLIENTS) {
+      logWarning("Control client rejected, %d already connected", CONTROL_MAX_CLIENTS);
+      close(fd);
+      continue;
+    }
+
+    struct epoll_event event = { .events = EPOLLIN, .data.u32 = (uint32_t)index };
+    if (epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      logWarning("Control client rejected, cannot poll it: %s", strerror(errno));
+      close(fd);
+      continue;
+    }
+
+    server->clients[index].fd = fd;
+    server->clients[index].length = 0;
+  }
+}
+
+static void readClient(struct ControlServer *server, int index)
+{
+  struct ControlClient *client = &server->clients[index];
+
+  for (;;) {
+    /* A line longer than the buffer is dropped with the client */
+    if (client->length == CONTROL_LINE_SIZE) {
+      logWarning("Control command longer than %d bytes, closing client", CONTROL_LINE_SIZE);
+      closeClient(server, index);
+      return;
+    }
+
+    ssize_t received = read(client->fd, client->buffer + client->length, CONTROL_LINE_SIZE - client->length);
+    if (received > 0) {
+      client->length += received;
+      if (memchr(client->buffer, '\n', client->length) != NULL) {
+        return;
+      }
+    } else if (received < 0 && (errno == EAGAIN || errno == EINTR)) {
+      return;
+    } else {
+      closeClient(server, index);
+      return;
+    }
+  }
+}
+
+/* Moves the first complete line of a client into the request */
+static bool takeLine(struct ControlServer *server, struct ControlRequest *request)
+{
+  for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+    struct ControlClient *client = &server->clients[i];
+    if (client->fd < 0) {
+      continue;
+    }
+
+    char *newline = memchr(client->buffer, '\n', client->length);
+    if (newline == NULL) {
+      continue;
+    }
+
+    int lineLength = newline - client->buffer;
+    memcpy(request->line, client->buffer, lineLength);
+    request->line[lineLength] = '\0';
+    client->length -= lineLength + 1;
+    memmove(client->buffer, newline + 1, client->length);
+
+    request->client = i;
+    request->argc = 0;
+    char *save = NULL;
+    for (char *token = strtok_r(request->line, " \t\r", &save);
+         token != NULL && request->argc < CONTROL_MAX_ARGS;
+         token = strtok_r(NULL, " \t\r", &save)) {
+      request->argv[request->argc++] = token;
+    }
+
+    /* Blank lines get no reply */
+    if (request->argc > 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool controlReceive(struct ControlServer *server, struct ControlRequest *request)
+{
+  if (server->epollFd < 0) {
+    return false;
+  }
+
+  if (takeLine(server, request)) {
+    return true;
+  }
+
+  struct epoll_event events[CONTROL_MAX_CLIENTS + 1];
+  int count = epoll_wait(server->epollFd, events, CONTROL_MAX_CLIENTS + 1, 0);
+
+  for (int i = 0; i < count; i++) {
+    int index = (int)events[i].data.u32;
+    if (index == CONTROL_LISTEN_EVENT) {
+      acceptClients(server);
+    } else if (server->clients[index].fd >= 0) {
+      readClient(server, index);
+    }
+  }
+
+  return count > 0 && takeLine(server, request);
+}
+
+void controlReply(struct ControlServer *server, const struct ControlRequest *request, const char *format, ...)
+{
+  struct ControlClient *client = &server->clients[request->client];
+  if (client->fd < 0) {
+    return;
+  }
+
+  char reply[1024];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(reply, sizeof(reply) - 1, format, args);
+  va_end(args);
+
+  if (length < 0) {
+    return;
+  }
+  if (length > (int)sizeof(reply) - 2) {
+    length = sizeof(reply) - 2;
+  }
+  reply[length++] = '\n';
+
+  /* Replies fit in the socket buffer, a client that does not read them is dropped */
+  if (send(client->fd, reply, length, MSG_NOSIGNAL) != length) {
+    logWarning("Control client not reading its replies, closing it");
+    closeClient(server, request->client);
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef __CONTROL_H__
+#define __CONTROL_H__
+
+#include <stdbool.h>
+
+#define CONTROL_MAX_CLIENTS 8
+#define CONTROL_LINE_SIZE   256
+#define CONTROL_MAX_ARGS    8
+
+struct ControlClient
+{
+  int fd;                        /* -1 when the slot is free */
+  char buffer[CONTROL_LINE_SIZE];
+  int length;
+};
+
+/* One command line, split on blanks */
+struct ControlRequest
+{
+  int client;
+  char line[CONTROL_LINE_SIZE];
+  char *argv[CONTROL_MAX_ARGS];
+  int argc;
+};
+
+/*
+ * Line based command interface on a UNIX domain stream socket, for test
+ * harnesses to drive the demo. Everything is non-blocking and polled from
+ * the event loop: when nothing happened a poll is a single epoll_wait()
+ * with a zero timeout. Each command gets a one line reply starting with
+ * "ok" or "error".
+ */
+struct ControlServer
+{
+  const char *path;
+  int listenFd;
+  int epollFd;
+  struct ControlClient clients[CONTROL_MAX_CLIENTS];
+};
+
+/* A NULL path disables the interface, controlReceive() then never returns a request */
+int controlInitialize(struct ControlServer *server, const char *path);
+/* Closes the clients and removes the socket */
+void controlFinalize(struct ControlServer *server);
+
+/* Next pending command, false when there is none */
+bool controlReceive(struct ControlServer *server, struct ControlRequest *request);
+void controlReply(struct ControlServer *server, const struct ControlRequest *request, const char *format, ...)
+  __attribute__((format(printf, 3, 4)));
+
+#endif /* __CONTROL_H__ */
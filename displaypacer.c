@@ -0,0 +1,193 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "clock.h"
+#include "displaypacer.h"
+#include "log.h"
+
+#define DISPLAY_PACER_STATS_SIZE 4096
+
+static void collectPresentTimings(struct DisplayPacer *pacer)
+{
+  PresentTiming timing;
+  while (PollPresentTiming(&timing)) {
+    struct DisplayPacerFrame *frame = &pacer->frames[timing.frameId % DISPLAY_PACER_HISTORY_SIZE];
+    double startTimeSec = frame->frameId == timing.frameId ? frame->startTimeSec : 0.0;
+
+    if (pacer->lastPresentTimeSec > 0.0) {
+      double intervalSec = timing.presentTimeSec - pacer->lastPresentTimeSec;
+
+      pthread_mutex_lock(&pacer->lock);
+      pacer->lastFrameIntervalSec = intervalSec;
+      statsSeriesAdd(&pacer->frameIntervalSec, intervalSec);
+      if (startTimeSec > 0.0 && pacer->lastPresentStartTimeSec > 0.0) {
+        statsSeriesAdd(&pacer->cadenceErrorSec, fabs(intervalSec - (startTimeSec - pacer->lastPresentStartTimeSec)));
+      }
+      pthread_mutex_unlock(&pacer->lock);
+    }
+
+    pacer->lastPresentTimeSec = timing.presentTimeSec;
+    pacer->lastPresentStartTimeSec = startTimeSec;
+  }
+}
+
+static void *displayPacerThread(void *arg)
+{
+  struct DisplayPacer *pacer = arg;
+
+  BindOutput(pacer->output);
+
+  double deadlineSec = 0.0;
+  double lastStartTimeSec = clockNowSec();
+
+  while (atomic_load(&pacer->running)) {
+    double startTimeSec = clockNowSec();
+
+    pthread_mutex_lock(&pacer->lock);
+    /* No lateness when the previous frame itself overran the deadline */
+    if (deadlineSec > 0.0) {
+      statsSeriesAdd(&pacer->wakeupLatenessSec, startTimeSec - deadlineSec);
+    }
+    computeNextFrameDelayMsec(&pacer->frameRateController, startTimeSec);
+    double frameDelaySec = pacer->frameRateController.nextFrameDelaySec;
+    pthread_mutex_unlock(&pacer->lock);
+
+    /* NDC space, the bar wraps around after crossing the width of 2 keeping
+       the overshoot, the motion stays continuous across the wrap */
+    pacer->positionNdc += pacer->speedNdcPerSec * (startTimeSec - lastStartTimeSec);
+    if (pacer->positionNdc >= 2.0f) {
+      pacer->positionNdc = fmodf(pacer->positionNdc, 2.0f);
+    }
+    lastStartTimeSec = startTimeSec;
+
+    Update(pacer->positionNdc);
+    uint64_t frameId = Draw();
+
+    pthread_mutex_lock(&pacer->lock);
+    pacer->lastFrameId = frameId;
+    pthread_mutex_unlock(&pacer->lock);
+
+    struct DisplayPacerFrame *frame = &pacer->frames[frameId % DISPLAY_PACER_HISTORY_SIZE];
+    frame->frameId = frameId;
+    frame->startTimeSec = startTimeSec;
+
+    collectPresentTimings(pacer);
+
+    deadlineSec = startTimeSec + frameDelaySec;
+    if (clockNowSec() >= deadlineSec) {
+      deadlineSec = 0.0;
+    } else {
+      clockSleepUntilSec(deadlineSec);
+    }
+  }
+
+  return NULL;
+}
+
+int displayPacerInitialize(struct DisplayPacer *pacer, uint32_t output, int displayIndex, double refreshRateHz,
+                           double animationDurationSec)
+{
+  memset(pacer, 0, sizeof(*pacer));
+  pthread_mutex_init(&pacer->lock, NULL);
+
+  if (!statsSeriesInitialize(&pacer->frameIntervalSec, DISPLAY_PACER_STATS_SIZE)
+      || !statsSeriesInitialize(&pacer->cadenceErrorSec, DISPLAY_PACER_STATS_SIZE)
+      || !statsSeriesInitialize(&pacer->wakeupLatenessSec, DISPLAY_PACER_STATS_SIZE)) {
+    displayPacerFinalize(pacer);
+    return 0;
+  }
+
+  pacer->output = output;
+  pacer->displayIndex = displayIndex;
+  pacer->speedNdcPerSec = 2.0 / animationDurationSec;
+
+  initializeFrameRateController(&pacer->frameRateController, refreshRateHz);
+
+  return 1;
+}
+
+void displayPacerFinalize(struct DisplayPacer *pacer)
+{
+  displayPacerStop(pacer);
+
+  statsSeriesFinalize(&pacer->frameIntervalSec);
+  statsSeriesFinalize(&pacer->cadenceErrorSec);
+  statsSeriesFinalize(&pacer->wakeupLatenessSec);
+  pthread_mutex_destroy(&pacer->lock);
+}
+
+int displayPacerStart(struct DisplayPacer *pacer)
+{
+  atomic_store(&pacer->running, true);
+
+  if (pthread_create(&pacer->thread, NULL, displayPacerThread, pacer) != 0) {
+    logError("Failed to start the frame loop of display %d", pacer->displayIndex);
+    atomic_store(&pacer->running, false);
+    return 0;
+  }
+
+  return 1;
+}
+
+void displayPacerStop(struct DisplayPacer *pacer)
+{
+  if (atomic_exchange(&pacer->running, false)) {
+    pthread_join(pacer->thread, NULL);
+  }
+}
+
+void displayPacerLock(struct DisplayPacer *pacer)
+{
+  pthread_mutex_lock(&pacer->lock);
+}
+
+void displayPacerUnlock(struct DisplayPacer *pacer)
+{
+  pthread_mutex_unlock(&pacer->lock);
+}
+
+void displayPacerSummarize(struct DisplayPacer *pacer, struct SeriesSummary *frameInterval,
+                           struct SeriesSummary *cadenceError, struct SeriesSummary *wakeupLateness)
+{
+  pthread_mutex_lock(&pacer->lock);
+  statsSeriesSummarize(&pacer->frameIntervalSec, frameInterval);
+  statsSeriesSummarize(&pacer->cadenceErrorSec, cadenceError);
+  statsSeriesSummarize(&pacer->wakeupLatenessSec, wakeupLateness);
+  pthread_mutex_unlock(&pacer->lock);
+}
+
+void displayPacerReset(struct DisplayPacer *pacer)
+{
+  pthread_mutex_lock(&pacer->lock);
+  statsSeriesReset(&pacer->frameIntervalSec);
+  statsSeriesReset(&pacer->cadenceErrorSec);
+  statsSeriesReset(&pacer->wakeupLatenessSec);
+  pthread_mutex_unlock(&pacer->lock);
+}
+
+void displayPacerPrintReport(struct DisplayPacer *pacer)
+{
+  struct SeriesSummary frameInterval, cadenceError, wakeupLateness;
+  displayPacerSummarize(pacer, &frameInterval, &cadenceError, &wakeupLateness);
+
+  pthread_mutex_lock(&pacer->lock);
+  int frameRateMin = pacer->frameRateController.frameRateMin;
+  int frameRateMax = pacer->frameRateController.frameRateMax;
+  pthread_mutex_unlock(&pacer->lock);
+
+  if (frameInterval.count == 0) {
+    logInfo("Display %d (%d-%d fps): no frame presented", pacer->displayIndex, frameRateMin, frameRateMax);
+    return;
+  }
+
+  logInfo("Display %d (%d-%d fps): n=%llu interval mean %.2f  p99 %.2f ms, cadence error p50 %.3f  p99 %.3f ms, "
+          "wake-up lateness p50 %.3f  p99 %.3f ms",
+          pacer->displayIndex, frameRateMin, frameRateMax, (unsigned long long)frameInterval.count,
+          frameInterval.mean * 1000.0, frameInterval.p99 * 1000.0,
+          cadenceError.p50 * 1000.0, cadenceError.p99 * 1000.0,
+          wakeupLateness.p50 * 1000.0, wakeupLateness.p99 * 1000.0);
+}
@@ -0,0 +1,74 @@
+#ifndef __DISPLAYPACER_H__
+#define __DISPLAYPACER_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "framerate.h"
+#include "stats.h"
+#include "vulkan.h"
+
+#define DISPLAY_PACER_HISTORY_SIZE 64
+
+struct DisplayPacerFrame
+{
+  uint64_t frameId;
+  double startTimeSec;
+};
+
+/*
+ * Frame loop of one Vulkan output on its own thread, for the multi display
+ * mode. Each display has its own frame rate profile; frames start on absolute
+ * deadlines so the statistics show how much of the cadence survives up to
+ * the present:
+ *
+ *   wake-up lateness  frame start - deadline (thread scheduling)
+ *   cadence error     |present interval - frame start interval|
+ *
+ * Comparing a display's figures with and without the other displays running
+ * shows whether their pacing leaks into it.
+ */
+struct DisplayPacer
+{
+  uint32_t output;
+  int displayIndex;
+  double speedNdcPerSec;
+
+  pthread_t thread;
+  atomic_bool running;
+
+  /* Guards the frame rate controller, the last frame and the statistics */
+  pthread_mutex_t lock;
+  struct FrameRateController frameRateController;
+  uint64_t lastFrameId;
+  double lastFrameIntervalSec;
+
+  float positionNdc;
+  double lastPresentTimeSec;
+  double lastPresentStartTimeSec;
+  struct DisplayPacerFrame frames[DISPLAY_PACER_HISTORY_SIZE];
+
+  struct SampleSeries frameIntervalSec;
+  struct SampleSeries cadenceErrorSec;
+  struct SampleSeries wakeupLatenessSec;
+};
+
+int displayPacerInitialize(struct DisplayPacer *pacer, uint32_t output, int displayIndex, double refreshRateHz,
+                           double animationDurationSec);
+void displayPacerFinalize(struct DisplayPacer *pacer);
+
+int displayPacerStart(struct DisplayPacer *pacer);
+void displayPacerStop(struct DisplayPacer *pacer);
+
+/* Frame rate controller access from other threads */
+void displayPacerLock(struct DisplayPacer *pacer);
+void displayPacerUnlock(struct DisplayPacer *pacer);
+
+void displayPacerSummarize(struct DisplayPacer *pacer, struct SeriesSummary *frameInterval,
+                           struct SeriesSummary *cadenceError, struct SeriesSummary *wakeupLateness);
+void displayPacerReset(struct DisplayPacer *pacer);
+void displayPacerPrintReport(struct DisplayPacer *pacer);
+
+#endif /* __DISPLAYPACER_H__ */
@@ -0,0 +1,61 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "clock.h"
+#include "frameloop.h"
+
+void frameLoopInitialize(struct FrameLoop *loop, struct FrameRateController *frameRateController,
+                         struct FramePacer *pacer, double barWidth, double animationDurationSec)
+{
+  memset(loop, 0, sizeof(*loop));
+
+  loop->frameRateController = frameRateController;
+  loop->pacer = pacer;
+  loop->barWidth = barWidth;
+  loop->barSpeedPerSec = barWidth / animationDurationSec;
+}
+
+void frameLoopBegin(struct FrameLoop *loop)
+{
+  struct FrameRateController *frameRateController = loop->frameRateController;
+
+  /* Sleeping after each frame, the previous frame's delay separates it from this one */
+  loop->intervalSec = loop->frameDelaySec;
+
+  if (loop->pacer != NULL) {
+    /* Cadence of the frame about to start, input is sampled after the sleep */
+    computeNextFrameDelayMsec(frameRateController, clockNowSec());
+    pacerWaitForFrameStart(loop->pacer, frameRateController->nextFrameDelaySec);
+    loop->intervalSec = frameRateController->nextFrameDelaySec;
+  }
+
+  double lastStartTimeSec = loop->startTimeSec;
+  loop->startTimeSec = clockNowSec();
+  loop->deltaSec = lastStartTimeSec > 0.0 ? loop->startTimeSec - lastStartTimeSec : 0.0;
+
+  computeNextFrameDelayMsec(frameRateController, loop->startTimeSec);
+  loop->frameDelaySec = frameRateController->nextFrameDelaySec;
+
+  loop->barPosition += loop->barSpeedPerSec * loop->deltaSec;
+  if (loop->barPosition >= loop->barWidth) {
+    loop->barPosition = fmod(loop->barPosition, loop->barWidth);
+  }
+}
+
+bool frameLoopEnd(struct FrameLoop *loop, double *wakeupLatenessSec)
+{
+  /* With a pacer the wait happens before the frame, see frameLoopBegin() */
+  if (loop->pacer != NULL || loop->frameDelaySec <= 0.0) {
+    return false;
+  }
+
+  double deadlineSec = clockNowSec() + loop->frameDelaySec;
+  clockSleepUntilSec(deadlineSec);
+  *wakeupLatenessSec = clockNowSec() - deadlineSec;
+
+  return true;
+}
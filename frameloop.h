@@ -0,0 +1,43 @@
+#ifndef __FRAMELOOP_H__
+#define __FRAMELOOP_H__
+
+#include <stdbool.h>
+
+#include "framerate.h"
+#include "pacer.h"
+
+/*
+ * Timing of the single display frame loop, shared by the demo and the pacing
+ * simulator so both run the same code:
+ *
+ *   frameLoopBegin()  with a pacer, sleeps until the pacer's start of the
+ *                     frame; then stamps the frame start, moves the bar by the
+ *                     start to start time and takes the delay to the next frame
+ *   frameLoopEnd()    without a pacer, sleeps that delay after the frame
+ *
+ * The bar position wraps keeping the overshoot, so the motion stays
+ * continuous across the edge.
+ */
+struct FrameLoop
+{
+  struct FrameRateController *frameRateController;
+  struct FramePacer *pacer;    /* NULL sleeps after each frame */
+
+  double barSpeedPerSec;       /* Bar units, NDC or pixels */
+  double barWidth;
+  double barPosition;          /* 0 to barWidth */
+
+  double startTimeSec;         /* Of the current frame */
+  double deltaSec;             /* Since the previous frame's start, 0 on the first frame */
+  double intervalSec;          /* Requested time since the previous frame's start */
+  double frameDelaySec;        /* Requested time to the next frame's start */
+};
+
+void frameLoopInitialize(struct FrameLoop *loop, struct FrameRateController *frameRateController,
+                         struct FramePacer *pacer, double barWidth, double animationDurationSec);
+
+void frameLoopBegin(struct FrameLoop *loop);
+/* True when it slept after the frame, wakeupLatenessSec is then the wake-up past the deadline */
+bool frameLoopEnd(struct FrameLoop *loop, double *wakeupLatenessSec);
+
+#endif /* __FRAMELOOP_H__ */
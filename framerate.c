@@ -0,0 +1,83 @@
+#include <math.h>
+
+#include "framerate.h"
+
+/* Period of the ramp, the same as the sine's (2 pi) */
+#define FRAME_RATE_RAMP_PERIOD_SEC 6.283185307179586
+
+static inline double max(double a, double b)
+{
+  return (a > b) ? a : b;
+}
+
+static inline double min(double a, double b)
+{
+  return (a < b) ? a : b;
+}
+
+void initializeFrameRateController(struct FrameRateController *frameRateController, double refreshRateHz)
+{
+  frameRateController->frameRateFloor = 10;
+  frameRateController->frameRateMin = 30;
+  frameRateController->frameRateMax = max(60, lround(refreshRateHz));
+  frameRateController->profile = FRAME_RATE_PROFILE_SINE;
+  frameRateController->refreshRateHz = refreshRateHz;
+}
+
+static double exactFrameRate(struct FrameRateController *frameRateController, int frameRate)
+{
+  if (frameRate == lround(frameRateController->refreshRateHz)) {
+    return frameRateController->refreshRateHz;
+  }
+
+  return frameRate;
+}
+
+void increaseMinFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames)
+{
+  frameRateController->frameRateMin =
+    min(frameRateController->frameRateMin + byNrOfFrames, frameRateController->frameRateMax);
+}
+
+void increaseMaxFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames)
+{
+  frameRateController->frameRateMax += byNrOfFrames;
+}
+
+void decreaseMinFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames)
+{
+  frameRateController->frameRateMin =
+    max(frameRateController->frameRateMin - byNrOfFrames, frameRateController->frameRateFloor);
+}
+
+void decreaseMaxFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames)
+{
+  frameRateController->frameRateMax =
+    max(frameRateController->frameRateMax - byNrOfFrames, frameRateController->frameRateMin);
+}
+
+void computeNextFrameDelayMsec(struct FrameRateController *frameRateController, double currentTimeSec)
+{
+  const double frameRateMin =
+    exactFrameRate(frameRateController, max(frameRateController->frameRateFloor, frameRateController->frameRateMin));
+  const double frameRateMax = exactFrameRate(frameRateController, frameRateController->frameRateMax);
+  const double frameRateRange = (frameRateMax - frameRateMin);
+  const double frameRateRangeMean = (frameRateMin + frameRateMax) / 2.0;
+  const double frameRateAmplitude = frameRateRange / 2.0;
+
+  switch (frameRateController->profile) {
+  case FRAME_RATE_PROFILE_SINE:
+    frameRateController->currentSimulatedFrameRate =
+      frameRateRangeMean + frameRateAmplitude * sin(currentTimeSec);
+    break;
+  case FRAME_RATE_PROFILE_RAMP:
+    frameRateController->currentSimulatedFrameRate =
+      frameRateMin + frameRateRange * fmod(currentTimeSec, FRAME_RATE_RAMP_PERIOD_SEC) / FRAME_RATE_RAMP_PERIOD_SEC;
+    break;
+  case FRAME_RATE_PROFILE_CONSTANT:
+    frameRateController->currentSimulatedFrameRate = frameRateMax;
+    break;
+  }
+
+  frameRateController->nextFrameDelaySec = 1.0 / frameRateController->currentSimulatedFrameRate;
+}
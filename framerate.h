@@ -0,0 +1,38 @@
+#ifndef __FRAMERATE_H__
+#define __FRAMERATE_H__
+
+/* Shape of the simulated frame rate over time */
+enum FrameRateProfile
+{
+  FRAME_RATE_PROFILE_SINE,     /* Sinusoidal sweep between min and max, the default */
+  FRAME_RATE_PROFILE_RAMP,     /* Sawtooth from min up to max */
+  FRAME_RATE_PROFILE_CONSTANT, /* Steady max frame rate */
+};
+
+/*
+ * Simulated frame rate, sweeping between the min and max frame rates so the
+ * VRR range gets exercised. A min or max equal to the display's rounded
+ * refresh rate stands for its exact rate (143.856 Hz rather than 144).
+ */
+struct FrameRateController
+{
+  int frameRateFloor;
+  int frameRateMin;
+  int frameRateMax;
+  enum FrameRateProfile profile;
+  double refreshRateHz;
+
+  double currentSimulatedFrameRate;
+  double nextFrameDelaySec;
+};
+
+void initializeFrameRateController(struct FrameRateController *frameRateController, double refreshRateHz);
+
+void increaseMinFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames);
+void increaseMaxFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames);
+void decreaseMinFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames);
+void decreaseMaxFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames);
+
+void computeNextFrameDelayMsec(struct FrameRateController *frameRateController, double currentTimeSec);
+
+#endif /* __FRAMERATE_H__ */
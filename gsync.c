@@ -1,15 +1,89 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 // #include <GL/glxew.h>
 #include <NVCtrl/NVCtrl.h>
 #include <NVCtrl/NVCtrlLib.h>
 
 #include "gsync.h"
+#include "log.h"
 
-int gsyncInitialize(struct GSyncController *controller)
+/**
+ * Backend
+ *
+ * Attribute access used by the worker thread. Only gsyncInitialize*()
+ * (before the worker starts) and the worker itself talk to the backend.
+ */
+
+struct GSyncBackend
 {
-  int event_base, error_base, value;
+  const char *name;
 
-  controller->isAvailable = false;
+  int  (*open)(struct GSyncController *controller);
+  void (*close)(struct GSyncController *controller);
+
+  bool (*query)(struct GSyncController *controller, int attribute, int *value);
+  void (*set)(struct GSyncController *controller, int attribute, int value);
+
+  /* File descriptor becoming readable when attribute change events are pending */
+  int  (*eventFd)(struct GSyncController *controller);
+  void (*processEvents)(struct GSyncController *controller);
+};
+
+static const int g_trackedAttributes[] = {
+  NV_CTRL_GSYNC_ALLOWED,
+  NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR,
+  NV_CTRL_SHOW_GRAPHICS_VISUAL_INDICATOR,
+};
+
+static int attributeSlot(int attribute)
+{
+  for (int i = 0; i < sizeof(g_trackedAttributes) / sizeof(*g_trackedAttributes); i++) {
+    if (g_trackedAttributes[i] == attribute) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static void updateCachedAttribute(struct GSyncController *controller, int attribute, int value)
+{
+  switch (attribute) {
+  case NV_CTRL_GSYNC_ALLOWED:
+    atomic_store(&controller->allowed, value == NV_CTRL_GSYNC_ALLOWED_TRUE);
+    break;
+  case NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR:
+    atomic_store(&controller->visualIndicatorShown, value == NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR_TRUE);
+    break;
+  default:
+    break;
+  }
+}
+
+static void refreshCachedAttribute(struct GSyncController *controller, int attribute)
+{
+  int value;
+
+  if (controller->backend->query(controller, attribute, &value)) {
+    updateCachedAttribute(controller, attribute, value);
+  }
+}
+
+/*
+ * NV-CONTROL backend
+ */
+
+static int nvctrlOpen(struct GSyncController *controller)
+{
+  int error_base, value;
 
   /*
    * Open a connection to the X server indicated by the DISPLAY
@@ -18,7 +92,7 @@ int gsyncInitialize(struct GSyncController *controller)
 
   controller->dpy = XOpenDisplay(NULL);
   if (!controller->dpy) {
-    fprintf(stderr, "Cannot open display '%s'.\n", XDisplayName(NULL));
+    logError("Cannot open display '%s'.", XDisplayName(NULL));
     return 0;
   }
 
@@ -26,8 +100,8 @@ int gsyncInitialize(struct GSyncController *controller)
    * Check if the NV-CONTROL X extension is present on this X server
    */
 
-  if (!XNVCTRLQueryExtension(controller->dpy, &event_base, &error_base)) {
-    fprintf(stderr, "The NV-CONTROL X extension does not exist on '%s'.\n", XDisplayName(NULL));
+  if (!XNVCTRLQueryExtension(controller->dpy, &controller->eventBase, &error_base)) {
+    logError("The NV-CONTROL X extension does not exist on '%s'.", XDisplayName(NULL));
     return 0;
   }
 
@@ -36,18 +110,307 @@ int gsyncInitialize(struct GSyncController *controller)
    */
 
   if (!XNVCTRLQueryAttribute(controller->dpy, 0, 0, NV_CTRL_GSYNC_ALLOWED, &value)) {
-    fprintf(stderr, "The NV-CONTROL GSYNC attribute is not available on '%s'.\n", XDisplayName(NULL));
+    logError("The NV-CONTROL GSYNC attribute is not available on '%s'.", XDisplayName(NULL));
     return 0;
   }
 
-  controller->isAvailable = true;
+  /*
+   * Get notified when any client changes an attribute
+   */
+
+  if (!XNVCtrlSelectNotify(controller->dpy, 0, ATTRIBUTE_CHANGED_EVENT, True)) {
+    logError("Cannot select NV-CONTROL attribute change events on '%s'.", XDisplayName(NULL));
+    return 0;
+  }
+
+  XFlush(controller->dpy);
+
+  return 1;
+}
+
+static void nvctrlClose(struct GSyncController *controller)
+{
+  if (controller->dpy != NULL) {
+    XCloseDisplay(controller->dpy);
+    controller->dpy = NULL;
+  }
+}
+
+static bool nvctrlQuery(struct GSyncController *controller, int attribute, int *value)
+{
+  return controller->dpy != NULL
+    && XNVCTRLQueryAttribute(controller->dpy, 0, 0, attribute, value);
+}
+
+static void nvctrlSet(struct GSyncController *controller, int attribute, int value)
+{
+  XNVCTRLSetAttribute(controller->dpy, 0, 0, attribute, value);
+  XFlush(controller->dpy);
+}
+
+static int nvctrlEventFd(struct GSyncController *controller)
+{
+  return ConnectionNumber(controller->dpy);
+}
+
+static void nvctrlProcessEvents(struct GSyncController *controller)
+{
+  XEvent event;
+
+  while (XPending(controller->dpy)) {
+    XNextEvent(controller->dpy, &event);
+
+    if (event.type == controller->eventBase + ATTRIBUTE_CHANGED_EVENT) {
+      XNVCtrlAttributeChangedEvent *changed = (XNVCtrlAttributeChangedEvent *)&event;
+      updateCachedAttribute(controller, changed->attribute, changed->value);
+    }
+  }
+}
+
+static const struct GSyncBackend g_nvctrlBackend = {
+  .name          = "NV-CONTROL",
+  .open          = nvctrlOpen,
+  .close         = nvctrlClose,
+  .query         = nvctrlQuery,
+  .set           = nvctrlSet,
+  .eventFd       = nvctrlEventFd,
+  .processEvents = nvctrlProcessEvents,
+};
+
+/*
+ * Mock backend
+ *
+ * In-process attribute table. Every write is echoed back as a change event
+ * through a pipe, the same way the X server notifies NV-CONTROL clients.
+ */
+
+static int mockOpen(struct GSyncController *controller)
+{
+  controller->mockEventPipe[0] = controller->mockEventPipe[1] = -1;
+
+  if (pipe2(controller->mockEventPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+    logError("Cannot create the mock G-SYNC event pipe: %s", strerror(errno));
+    return 0;
+  }
+
+  atomic_store(&controller->mockAttributes[attributeSlot(NV_CTRL_GSYNC_ALLOWED)], NV_CTRL_GSYNC_ALLOWED_TRUE);
+  atomic_store(&controller->mockAttributes[attributeSlot(NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR)], NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR_FALSE);
+  atomic_store(&controller->mockAttributes[attributeSlot(NV_CTRL_SHOW_GRAPHICS_VISUAL_INDICATOR)], 0);
+
+  return 1;
+}
+
+static void mockClose(struct GSyncController *controller)
+{
+  if (controller->mockEventPipe[0] >= 0) {
+    close(controller->mockEventPipe[0]);
+    close(controller->mockEventPipe[1]);
+  }
+}
+
+static bool mockQuery(struct GSyncController *controller, int attribute, int *value)
+{
+  int slot = attributeSlot(attribute);
+  if (slot < 0) {
+    return false;
+  }
+
+  *value = atomic_load(&controller->mockAttributes[slot]);
+  return true;
+}
+
+static void mockSet(struct GSyncController *controller, int attribute, int value)
+{
+  int slot = attributeSlot(attribute);
+  if (slot < 0) {
+    return;
+  }
+
+  atomic_store(&controller->mockAttributes[slot], value);
+
+  struct GSyncAttributeWrite event = { attribute, value };
+  if (write(controller->mockEventPipe[1], &event, sizeof(event)) != sizeof(event)) {
+    logWarning("Mock G-SYNC event dropped.");
+  }
+}
+
+static int mockEventFd(struct GSyncController *controller)
+{
+  return controller->mockEventPipe[0];
+}
+
+static void mockProcessEvents(struct GSyncController *controller)
+{
+  struct GSyncAttributeWrite event;
+
+  while (read(controller->mockEventPipe[0], &event, sizeof(event)) == sizeof(event)) {
+    updateCachedAttribute(controller, event.attribute, event.value);
+  }
+}
+
+static const struct GSyncBackend g_mockBackend = {
+  .name          = "mock",
+  .open          = mockOpen,
+  .close         = mockClose,
+  .query         = mockQuery,
+  .set           = mockSet,
+  .eventFd       = mockEventFd,
+  .processEvents = mockProcessEvents,
+};
+
+/**
+ * Worker
+ */
+
+static void wakeWorker(struct GSyncController *controller)
+{
+  const char token = 0;
+  if (write(controller->wakeupPipe[1], &token, 1) < 0) {
+    /* Pipe full, the worker is already due to wake up */
+  }
+}
+
+static void applyPendingWrites(struct GSyncController *controller)
+{
+  struct GSyncAttributeWrite writes[GSYNC_WRITE_QUEUE_SIZE];
+  int count;
+
+  pthread_mutex_lock(&controller->writeLock);
+  count = controller->pendingWriteCount;
+  memcpy(writes, controller->pendingWrites, count * sizeof(*writes));
+  controller->pendingWriteCount = 0;
+  pthread_mutex_unlock(&controller->writeLock);
+
+  for (int i = 0; i < count; i++) {
+    controller->backend->set(controller, writes[i].attribute, writes[i].value);
+
+    /* The writing client is not guaranteed to be notified about its own change */
+    refreshCachedAttribute(controller, writes[i].attribute);
+  }
+}
+
+static void *gsyncWorker(void *arg)
+{
+  struct GSyncController *controller = arg;
+  bool quit = false;
+
+  while (!quit) {
+    struct pollfd fds[2] = {
+      { .fd = controller->wakeupPipe[0], .events = POLLIN },
+      { .fd = controller->backend->eventFd(controller), .events = POLLIN },
+    };
+
+    /* Xlib may already hold buffered events that poll() cannot see */
+    controller->backend->processEvents(controller);
+
+    if (poll(fds, 2, -1) < 0) {
+      continue;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      char tokens[64];
+      while (read(controller->wakeupPipe[0], tokens, sizeof(tokens)) > 0);
+    }
+
+    applyPendingWrites(controller);
+    controller->backend->processEvents(controller);
+
+    pthread_mutex_lock(&controller->writeLock);
+    quit = controller->quit && controller->pendingWriteCount == 0;
+    pthread_mutex_unlock(&controller->writeLock);
+  }
+
+  return NULL;
+}
+
+/*
+ * The requested value is cached right away, so reads made before the worker
+ * applied the write already see it. The worker's read back after the write,
+ * or a change event, corrects it when the write did not take.
+ */
+static bool queueWrite(struct GSyncController *controller, int attribute, int value)
+{
+  if (!controller->workerStarted) {
+    return false;
+  }
+
+  bool queued = false;
+
+  pthread_mutex_lock(&controller->writeLock);
+
+  if (controller->pendingWriteCount < GSYNC_WRITE_QUEUE_SIZE) {
+    controller->pendingWrites[controller->pendingWriteCount].attribute = attribute;
+    controller->pendingWrites[controller->pendingWriteCount].value = value;
+    controller->pendingWriteCount++;
+    updateCachedAttribute(controller, attribute, value);
+    queued = true;
+  } else {
+    logWarning("G-SYNC write queue full, attribute %d dropped.", attribute);
+  }
+
+  pthread_mutex_unlock(&controller->writeLock);
+
+  wakeWorker(controller);
+
+  return queued;
+}
+
+/**
+ * Public API
+ */
+
+int gsyncInitialize(struct GSyncController *controller)
+{
+  return gsyncInitializeWithBackend(controller, GSYNC_BACKEND_NVCTRL);
+}
+
+int gsyncInitializeWithBackend(struct GSyncController *controller, enum GSyncBackendType type)
+{
+  memset(controller, 0, sizeof(*controller));
+
+  controller->isAvailable = false;
+  controller->backend = (type == GSYNC_BACKEND_MOCK) ? &g_mockBackend : &g_nvctrlBackend;
+  atomic_init(&controller->allowed, false);
+  atomic_init(&controller->visualIndicatorShown, false);
+
+  if (!controller->backend->open(controller)) {
+    controller->backend->close(controller);
+    return 0;
+  }
 
   /*
    * Save current attributes
    */
 
-  controller->initialGSYNCValue = gsyncIsAllowed(controller);
-  controller->initialGSYNCVisualIndicatorValue = gsyncIsVisualIndicatorShown(controller);
+  refreshCachedAttribute(controller, NV_CTRL_GSYNC_ALLOWED);
+  refreshCachedAttribute(controller, NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR);
+
+  controller->initialGSYNCValue = atomic_load(&controller->allowed);
+  controller->initialGSYNCVisualIndicatorValue = atomic_load(&controller->visualIndicatorShown);
+
+  /*
+   * From now on the backend belongs to the worker thread
+   */
+
+  if (pipe2(controller->wakeupPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+    logError("Cannot create the G-SYNC worker pipe: %s", strerror(errno));
+    controller->backend->close(controller);
+    return 0;
+  }
+
+  pthread_mutex_init(&controller->writeLock, NULL);
+
+  if (pthread_create(&controller->worker, NULL, gsyncWorker, controller) != 0) {
+    logError("Cannot start the %s G-SYNC worker.", controller->backend->name);
+    pthread_mutex_destroy(&controller->writeLock);
+    close(controller->wakeupPipe[0]);
+    close(controller->wakeupPipe[1]);
+    controller->backend->close(controller);
+    return 0;
+  }
+
+  controller->workerStarted = true;
+  controller->isAvailable = true;
 
   return 1;
 }
@@ -60,9 +423,24 @@ void gsyncFinalize(struct GSyncController *controller)
     gsyncShowVisualIndicator(controller, controller->initialGSYNCVisualIndicatorValue);
   }
 
-  if (controller->dpy != NULL) {
-    XCloseDisplay(controller->dpy);
+  if (controller->workerStarted) {
+    /* The worker flushes the pending writes before leaving */
+    pthread_mutex_lock(&controller->writeLock);
+    controller->quit = true;
+    pthread_mutex_unlock(&controller->writeLock);
+
+    wakeWorker(controller);
+    pthread_join(controller->worker, NULL);
+
+    pthread_mutex_destroy(&controller->writeLock);
+    close(controller->wakeupPipe[0]);
+    close(controller->wakeupPipe[1]);
+
+    controller->backend->close(controller);
+    controller->workerStarted = false;
   }
+
+  controller->isAvailable = false;
 }
 
 bool gsyncIsAvailable(struct GSyncController *controller)
@@ -72,19 +450,7 @@ bool gsyncIsAvailable(struct GSyncController *controller)
 
 bool gsyncIsAllowed(struct GSyncController *controller)
 {
-  int value;
-
-  if (controller->dpy != NULL) {
-    if (XNVCTRLQueryAttribute(controller->dpy, 0, 0, NV_CTRL_GSYNC_ALLOWED, &value)) {
-      switch(value) {
-      case NV_CTRL_GSYNC_ALLOWED_FALSE: return false;
-      case NV_CTRL_GSYNC_ALLOWED_TRUE:  return true;
-      default:                          return false;
-      }
-    }
-  }
-
-  return false;
+  return atomic_load(&controller->allowed);
 }
 
 void gsyncSetAllowed(struct GSyncController *controller, bool enable)
@@ -96,28 +462,30 @@ void gsyncSetAllowed(struct GSyncController *controller, bool enable)
   case true:  value = NV_CTRL_GSYNC_ALLOWED_TRUE;  break;
   }
 
-  XNVCTRLSetAttribute(controller->dpy, 0, 0, NV_CTRL_GSYNC_ALLOWED, value);
+  queueWrite(controller, NV_CTRL_GSYNC_ALLOWED, value);
 }
 
 bool gsyncIsVisualIndicatorShown(struct GSyncController *controller)
 {
-  int value;
+  return atomic_load(&controller->visualIndicatorShown);
+}
 
-  if (controller->dpy != NULL) {
-    if (XNVCTRLQueryAttribute(controller->dpy, 0, 0, NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR, &value)) {
-      switch(value) {
-      case NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR_FALSE: return false;
-      case NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR_TRUE:  return true;
-      default:                                        return false;
-      }
-    }
-  }
+void gsyncShowVisualIndicator(struct GSyncController *controller, bool enable)
+{
+  queueWrite(controller, NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR, enable);
+  queueWrite(controller, NV_CTRL_SHOW_GRAPHICS_VISUAL_INDICATOR, enable);
+}
 
-  return false;
+void gsyncMockExternalChange(struct GSyncController *controller, int attribute, int value)
+{
+  if (controller->isAvailable && controller->backend == &g_mockBackend) {
+    /* Runs on the caller thread, like a change made by another X client */
+    mockSet(controller, attribute, value);
+  }
 }
 
-void gsyncShowVisualIndicator(struct GSyncController *controller, bool enable)
+bool gsyncMockQuery(struct GSyncController *controller, int attribute, int *value)
 {
-  XNVCTRLSetAttribute(controller->dpy, 0, 0, NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR, enable);
-  XNVCTRLSetAttribute(controller->dpy, 0, 0, NV_CTRL_SHOW_GRAPHICS_VISUAL_INDICATOR, enable);
+  return controller->isAvailable && controller->backend == &g_mockBackend
+    && mockQuery(controller, attribute, value);
 }
@@ -2,26 +2,79 @@
 #define __GSYNC_H__
 
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include <X11/Xlib.h>
 
+#define GSYNC_MAX_ATTRIBUTES 4
+#define GSYNC_WRITE_QUEUE_SIZE 16
+
+enum GSyncBackendType
+{
+  GSYNC_BACKEND_NVCTRL,
+  GSYNC_BACKEND_MOCK,
+};
+
+struct GSyncBackend;
+
+struct GSyncAttributeWrite
+{
+  int attribute;
+  int value;
+};
+
 struct GSyncController
 {
   bool isAvailable;
   Display *dpy;
+  int eventBase;
+
+  const struct GSyncBackend *backend;
 
   bool initialGSYNCValue;
   bool initialGSYNCVisualIndicatorValue;
+
+  /*
+   * Cached attribute state. Written by the worker thread from attribute
+   * change events, read lock-free by anyone (e.g. the HUD every frame).
+   */
+  atomic_bool allowed;
+  atomic_bool visualIndicatorShown;
+
+  /*
+   * Worker thread owning the backend connection. Attribute writes are
+   * queued in order and applied by the worker.
+   */
+  pthread_t worker;
+  bool workerStarted;
+  int wakeupPipe[2];
+
+  pthread_mutex_t writeLock;
+  struct GSyncAttributeWrite pendingWrites[GSYNC_WRITE_QUEUE_SIZE];
+  int pendingWriteCount;
+  bool quit;
+
+  /* Mock backend state */
+  atomic_int mockAttributes[GSYNC_MAX_ATTRIBUTES];
+  int mockEventPipe[2];
 };
 
 int gsyncInitialize(struct GSyncController *controller);
+int gsyncInitializeWithBackend(struct GSyncController *controller, enum GSyncBackendType type);
 void gsyncFinalize(struct GSyncController *controller);
 
 bool gsyncIsAvailable(struct GSyncController *controller);
 
+/* Cached, a set is visible at once and applied later by the worker */
 bool gsyncIsAllowed(struct GSyncController *controller);
 void gsyncSetAllowed(struct GSyncController *controller, bool enable);
 
 bool gsyncIsVisualIndicatorShown(struct GSyncController *controller);
 void gsyncShowVisualIndicator(struct GSyncController *controller, bool enable);
 
+/* Simulate another client (e.g. nvidia-settings) changing an attribute, mock backend only */
+void gsyncMockExternalChange(struct GSyncController *controller, int attribute, int value);
+/* Attribute value as the backend holds it, not the cache, mock backend only */
+bool gsyncMockQuery(struct GSyncController *controller, int attribute, int *value);
+
 #endif /* __GSYNC_H__ */
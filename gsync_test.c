@@ -0,0 +1,99 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <NVCtrl/NVCtrl.h>
+
+#include "clock.h"
+#include "gsync.h"
+#include "log.h"
+
+/**
+ * G-SYNC controller test
+ *
+ * Runs the attribute cache and the worker's write queue against the mock
+ * backend, no X server needed. Exits with 1 on the first failed check.
+ */
+
+/* The worker applies writes and events asynchronously */
+#define WAIT_TIMEOUT_SEC 1.0
+
+#define CHECK(condition)                                               \
+  do {                                                                 \
+    if (!(condition)) {                                                \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      exit(1);                                                         \
+    }                                                                  \
+  } while (0)
+
+static bool waitForBackend(struct GSyncController *controller, int attribute, int expected)
+{
+  double deadlineSec = clockNowSec() + WAIT_TIMEOUT_SEC;
+  int value;
+
+  while (clockNowSec() < deadlineSec) {
+    if (gsyncMockQuery(controller, attribute, &value) && value == expected) {
+      return true;
+    }
+    clockSleepSec(0.001);
+  }
+
+  return false;
+}
+
+static bool waitForAllowed(struct GSyncController *controller, bool expected)
+{
+  double deadlineSec = clockNowSec() + WAIT_TIMEOUT_SEC;
+
+  while (clockNowSec() < deadlineSec) {
+    if (gsyncIsAllowed(controller) == expected) {
+      return true;
+    }
+    clockSleepSec(0.001);
+  }
+
+  return false;
+}
+
+int main(int argc, char **argv)
+{
+  struct GSyncController controller;
+
+  CHECK(gsyncInitializeWithBackend(&controller, GSYNC_BACKEND_MOCK));
+  CHECK(gsyncIsAvailable(&controller));
+
+  /* Cached reads: the initial state, read back before the worker started */
+  CHECK(gsyncIsAllowed(&controller));
+  CHECK(!gsyncIsVisualIndicatorShown(&controller));
+
+  /* A queued write is visible at once and applied by the worker */
+  gsyncSetAllowed(&controller, false);
+  CHECK(!gsyncIsAllowed(&controller));
+  CHECK(waitForBackend(&controller, NV_CTRL_GSYNC_ALLOWED, NV_CTRL_GSYNC_ALLOWED_FALSE));
+  CHECK(!gsyncIsAllowed(&controller));
+
+  /* Two quick toggles end up where the second one asked */
+  gsyncSetAllowed(&controller, !gsyncIsAllowed(&controller));
+  gsyncSetAllowed(&controller, !gsyncIsAllowed(&controller));
+  CHECK(!gsyncIsAllowed(&controller));
+  CHECK(waitForBackend(&controller, NV_CTRL_GSYNC_ALLOWED, NV_CTRL_GSYNC_ALLOWED_FALSE));
+
+  gsyncShowVisualIndicator(&controller, true);
+  CHECK(gsyncIsVisualIndicatorShown(&controller));
+  CHECK(waitForBackend(&controller, NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR, NV_CTRL_SHOW_GSYNC_VISUAL_INDICATOR_TRUE));
+
+  /* A change made by another client reaches the cache through its event */
+  gsyncMockExternalChange(&controller, NV_CTRL_GSYNC_ALLOWED, NV_CTRL_GSYNC_ALLOWED_TRUE);
+  CHECK(waitForAllowed(&controller, true));
+
+  /* Finalizing restores the initial state */
+  gsyncSetAllowed(&controller, false);
+  gsyncFinalize(&controller);
+  CHECK(!gsyncIsAvailable(&controller));
+
+  printf("gsync: ok\n");
+  return 0;
+}
@@ -0,0 +1,328 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hostalloc.h"
+#include "log.h"
+
+/* In front of every block, the user pointer is aligned to at least its size */
+struct BlockHeader
+{
+  size_t size;
+  uint32_t offset;     /* From the malloc() pointer to the block */
+  uint8_t scope;
+  uint8_t type;
+  uint8_t inArena;
+  uint8_t reserved;
+};
+
+#define BLOCK_HEADER_SIZE sizeof(struct BlockHeader)
+
+/* Per thread: the driver calls the callbacks on the thread making the Vulkan call */
+static _Thread_local int g_framePathDepth;
+
+/* Indexed by VkSystemAllocationScope */
+static const char *g_scopeNames[] = { "command", "object", "cache", "device", "instance" };
+
+/* Indexed by HostObjectType */
+static const char *g_objectTypeNames[] = {
+  "instance",
+  "device",
+  "swapchain",
+  "image view",
+  "render pass",
+  "framebuffer",
+  "command pool",
+  "semaphore",
+  "fence",
+  "query pool",
+  "descriptor set layout",
+  "descriptor pool",
+  "buffer",
+  "device memory",
+  "shader module",
+  "pipeline cache",
+  "pipeline layout",
+  "pipeline",
+};
+
+static void countBlock(struct HostAllocationCounters *counters, int64_t size)
+{
+  if (size > 0) {
+    atomic_fetch_add_explicit(&counters->allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->bytes, size, memory_order_relaxed);
+  }
+  atomic_fetch_add_explicit(&counters->live, size > 0 ? 1 : -1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&counters->liveBytes, size, memory_order_relaxed);
+}
+
+/* size is negative for a free */
+static void count(struct HostAllocator *allocator, const struct BlockHeader *header, int64_t size)
+{
+  countBlock(&allocator->scopes[header->scope], size);
+  countBlock(&allocator->types[header->type], size);
+
+  int64_t liveBytes = atomic_fetch_add_explicit(&allocator->liveBytes, size, memory_order_relaxed) + size;
+  int64_t peakLiveBytes = atomic_load_explicit(&allocator->peakLiveBytes, memory_order_relaxed);
+  while (liveBytes > peakLiveBytes
+         && !atomic_compare_exchange_weak_explicit(&allocator->peakLiveBytes, &peakLiveBytes, liveBytes,
+                                                   memory_order_relaxed, memory_order_relaxed)) {
+  }
+
+  if (size > 0 && g_framePathDepth > 0) {
+    uint64_t index = atomic_fetch_add_explicit(&allocator->framePathAllocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&allocator->framePathBytes, size, memory_order_relaxed);
+
+    if (index < HOST_FRAME_PATH_LOG_LIMIT) {
+      logWarning("Host allocation in the frame path: %lld bytes, %s scope, %s",
+                 (long long)size, g_scopeNames[header->scope], g_objectTypeNames[header->type]);
+    }
+  }
+}
+
+static char *alignUp(char *pointer, size_t alignment)
+{
+  return (char *)(((uintptr_t)pointer + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+static char *arenaAllocate(struct HostAllocator *allocator, size_t size, size_t alignment)
+{
+  char *block = NULL;
+
+  pthread_mutex_lock(&allocator->arenaLock);
+  char *start = alignUp(allocator->arena + allocator->arenaUsed + BLOCK_HEADER_SIZE, alignment);
+  if (start + size <= allocator->arena + HOST_ARENA_SIZE) {
+    allocator->arenaUsed = start + size - allocator->arena;
+    block = start;
+  } else if (allocator->arenaFallbacks++ == 0) {
+    logWarning("Host allocation arena full (%d KB), falling back to malloc", HOST_ARENA_SIZE >> 10);
+  }
+  pthread_mutex_unlock(&allocator->arenaLock);
+
+  return block;
+}
+
+static void *VKAPI_PTR allocate(void *userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+  struct HostCallbackSlot *slot = userData;
+  struct HostAllocator *allocator = slot->allocator;
+
+  if (size == 0) {
+    return NULL;
+  }
+  if (alignment < BLOCK_HEADER_SIZE) {
+    alignment = BLOCK_HEADER_SIZE;
+  }
+
+  char *block = NULL;
+  uint32_t offset = 0;
+
+  if (allocator->arena != NULL && scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT) {
+    block = arenaAllocate(allocator, size, alignment);
+  }
+  bool inArena = block != NULL;
+
+  if (!inArena) {
+    char *base = malloc(size + alignment + BLOCK_HEADER_SIZE);
+    if (base == NULL) {
+      return NULL;
+    }
+    block = alignUp(base + BLOCK_HEADER_SIZE, alignment);
+    offset = block - base;
+  }
+
+  struct BlockHeader *header = (struct BlockHeader *)(block - BLOCK_HEADER_SIZE);
+  header->size = size;
+  header->offset = offset;
+  header->scope = scope;
+  header->type = slot->type;
+  header->inArena = inArena;
+
+  count(allocator, header, size);
+
+  return block;
+}
+
+static void VKAPI_PTR freeBlock(void *userData, void *memory)
+{
+  struct HostCallbackSlot *slot = userData;
+
+  if (memory == NULL) {
+    return;
+  }
+
+  struct BlockHeader *header = (struct BlockHeader *)((char *)memory - BLOCK_HEADER_SIZE);
+  count(slot->allocator, header, -(int64_t)header->size);
+
+  /* Arena blocks are only reclaimed with the whole arena */
+  if (!header->inArena) {
+    free((char *)memory - header->offset);
+  }
+}
+
+static void *VKAPI_PTR reallocate(void *userData, void *original, size_t size, size_t alignment,
+                                  VkSystemAllocationScope scope)
+{
+  if (original == NULL) {
+    return allocate(userData, size, alignment, scope);
+  }
+  if (size == 0) {
+    freeBlock(userData, original);
+    return NULL;
+  }
+
+  void *memory = allocate(userData, size, alignment, scope);
+  if (memory == NULL) {
+    return NULL;
+  }
+
+  const struct BlockHeader *header = (const struct BlockHeader *)((char *)original - BLOCK_HEADER_SIZE);
+  memcpy(memory, original, header->size < size ? header->size : size);
+  freeBlock(userData, original);
+
+  return memory;
+}
+
+static void VKAPI_PTR internalAllocation(void *userData, size_t size, VkInternalAllocationType type,
+                                         VkSystemAllocationScope scope)
+{
+  struct HostCallbackSlot *slot = userData;
+  (void)type;
+
+  countBlock(&slot->allocator->internal[scope], size);
+}
+
+static void VKAPI_PTR internalFree(void *userData, size_t size, VkInternalAllocationType type,
+                                   VkSystemAllocationScope scope)
+{
+  struct HostCallbackSlot *slot = userData;
+  (void)type;
+
+  countBlock(&slot->allocator->internal[scope], -(int64_t)size);
+}
+
+int hostAllocatorInitialize(struct HostAllocator *allocator, bool track, bool arena)
+{
+  memset(allocator, 0, sizeof(*allocator));
+
+  if (!track) {
+    return 1;
+  }
+
+  if (arena) {
+    allocator->arena = malloc(HOST_ARENA_SIZE);
+    if (allocator->arena == NULL) {
+      logError("Cannot allocate the %d KB host allocation arena", HOST_ARENA_SIZE >> 10);
+      return 0;
+    }
+    /* Touched now, not while the driver creates objects */
+    memset(allocator->arena, 0, HOST_ARENA_SIZE);
+    pthread_mutex_init(&allocator->arenaLock, NULL);
+  }
+
+  for (int i = 0; i < HOST_OBJECT_TYPE_COUNT; i++) {
+    allocator->slots[i].allocator = allocator;
+    allocator->slots[i].type = i;
+
+    VkAllocationCallbacks *callbacks = &allocator->callbacks[i];
+    callbacks->pUserData = &allocator->slots[i];
+    callbacks->pfnAllocation = allocate;
+    callbacks->pfnReallocation = reallocate;
+    callbacks->pfnFree = freeBlock;
+    callbacks->pfnInternalAllocation = internalAllocation;
+    callbacks->pfnInternalFree = internalFree;
+  }
+
+  allocator->enabled = true;
+
+  logInfo("Tracking Vulkan host allocations%s", arena ? ", object scope ones from an arena" : "");
+
+  return 1;
+}
+
+void hostAllocatorFinalize(struct HostAllocator *allocator)
+{
+  if (allocator->arena != NULL) {
+    free(allocator->arena);
+    allocator->arena = NULL;
+    pthread_mutex_destroy(&allocator->arenaLock);
+  }
+
+  allocator->enabled = false;
+}
+
+const VkAllocationCallbacks *hostAllocatorCallbacks(struct HostAllocator *allocator, enum HostObjectType type)
+{
+  return allocator->enabled ? &allocator->callbacks[type] : NULL;
+}
+
+const char *hostObjectTypeName(enum HostObjectType type)
+{
+  return g_objectTypeNames[type];
+}
+
+void hostAllocatorEnterFrame(struct HostAllocator *allocator)
+{
+  g_framePathDepth++;
+}
+
+void hostAllocatorLeaveFrame(struct HostAllocator *allocator)
+{
+  g_framePathDepth--;
+}
+
+uint64_t hostAllocatorFramePathAllocations(struct HostAllocator *allocator)
+{
+  return atomic_load_explicit(&allocator->framePathAllocations, memory_order_relaxed);
+}
+
+static void printCounters(const char *name, const char *kind, struct HostAllocationCounters *counters)
+{
+  uint64_t allocations = atomic_load(&counters->allocations);
+  int64_t live = atomic_load(&counters->live);
+  int64_t liveBytes = atomic_load(&counters->liveBytes);
+
+  if (allocations == 0 && live == 0) {
+    return;
+  }
+
+  logInfo("  %-21s %s: %6llu allocations, %8.1f KB", name, kind,
+          (unsigned long long)allocations, atomic_load(&counters->bytes) / 1024.0);
+  if (live != 0) {
+    logWarning("  %-21s %s: %lld still live, %.1f KB", name, kind, (long long)live, liveBytes / 1024.0);
+  }
+}
+
+void hostAllocatorPrintReport(struct HostAllocator *allocator)
+{
+  if (!allocator->enabled) {
+    return;
+  }
+
+  logInfo("Vulkan host allocations: peak %.1f KB live", atomic_load(&allocator->peakLiveBytes) / 1024.0);
+  for (int i = 0; i < HOST_SCOPE_COUNT; i++) {
+    printCounters(g_scopeNames[i], "scope", &allocator->scopes[i]);
+  }
+  for (int i = 0; i < HOST_OBJECT_TYPE_COUNT; i++) {
+    printCounters(g_objectTypeNames[i], "objects", &allocator->types[i]);
+  }
+  for (int i = 0; i < HOST_SCOPE_COUNT; i++) {
+    printCounters(g_scopeNames[i], "internal", &allocator->internal[i]);
+  }
+
+  if (allocator->arena != NULL) {
+    logInfo("  arena: %.1f of %d KB used, %llu allocations did not fit",
+            allocator->arenaUsed / 1024.0, HOST_ARENA_SIZE >> 10, (unsigned long long)allocator->arenaFallbacks);
+  }
+
+  uint64_t framePathAllocations = hostAllocatorFramePathAllocations(allocator);
+  if (framePathAllocations > 0) {
+    logWarning("  %llu allocations (%.1f KB) in the frame path after warm-up",
+               (unsigned long long)framePathAllocations, atomic_load(&allocator->framePathBytes) / 1024.0);
+  } else {
+    logInfo("  no allocation in the frame path after warm-up");
+  }
+}
@@ -0,0 +1,107 @@
+#ifndef __HOSTALLOC_H__
+#define __HOSTALLOC_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/* Object scope allocations served from the arena until it is full */
+#define HOST_ARENA_SIZE           (8 << 20)
+/* Frame path allocations logged one by one, the others are only counted */
+#define HOST_FRAME_PATH_LOG_LIMIT 8
+
+/*
+ * Vulkan only tells the allocation callbacks the scope of an allocation, the
+ * object type comes from the callbacks passed: there is one set per type.
+ */
+enum HostObjectType
+{
+  HOST_OBJECT_INSTANCE,
+  HOST_OBJECT_DEVICE,
+  HOST_OBJECT_SWAPCHAIN,
+  HOST_OBJECT_IMAGE_VIEW,
+  HOST_OBJECT_RENDER_PASS,
+  HOST_OBJECT_FRAMEBUFFER,
+  HOST_OBJECT_COMMAND_POOL,
+  HOST_OBJECT_SEMAPHORE,
+  HOST_OBJECT_FENCE,
+  HOST_OBJECT_QUERY_POOL,
+  HOST_OBJECT_DESCRIPTOR_SET_LAYOUT,
+  HOST_OBJECT_DESCRIPTOR_POOL,
+  HOST_OBJECT_BUFFER,
+  HOST_OBJECT_DEVICE_MEMORY,
+  HOST_OBJECT_SHADER_MODULE,
+  HOST_OBJECT_PIPELINE_CACHE,
+  HOST_OBJECT_PIPELINE_LAYOUT,
+  HOST_OBJECT_PIPELINE,
+  HOST_OBJECT_TYPE_COUNT
+};
+
+#define HOST_SCOPE_COUNT (VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1)
+
+struct HostAllocationCounters
+{
+  atomic_uint_fast64_t allocations;
+  atomic_uint_fast64_t bytes;
+  atomic_int_fast64_t live;
+  atomic_int_fast64_t liveBytes;
+};
+
+struct HostCallbackSlot
+{
+  struct HostAllocator *allocator;
+  enum HostObjectType type;
+};
+
+/*
+ * VkAllocationCallbacks counting the driver's host allocations by scope and
+ * object type. Allocations made by a thread while it is in the frame path
+ * (see hostAllocatorEnterFrame()) are counted apart and the first ones logged:
+ * once warmed up a frame should not allocate at all. Optionally object scope
+ * allocations, the driver's per-object metadata, come from a preallocated
+ * arena so they stay contiguous; freeing them does not reclaim anything.
+ */
+struct HostAllocator
+{
+  bool enabled;
+  VkAllocationCallbacks callbacks[HOST_OBJECT_TYPE_COUNT];
+  struct HostCallbackSlot slots[HOST_OBJECT_TYPE_COUNT];
+
+  struct HostAllocationCounters scopes[HOST_SCOPE_COUNT];
+  struct HostAllocationCounters types[HOST_OBJECT_TYPE_COUNT];
+  /* vkInternalAllocationNotification, memory the driver got on its own */
+  struct HostAllocationCounters internal[HOST_SCOPE_COUNT];
+  atomic_int_fast64_t liveBytes;
+  atomic_int_fast64_t peakLiveBytes;
+
+  atomic_uint_fast64_t framePathAllocations;
+  atomic_uint_fast64_t framePathBytes;
+
+  /* Bump allocated, NULL without arena */
+  char *arena;
+  size_t arenaUsed;
+  uint64_t arenaFallbacks;
+  pthread_mutex_t arenaLock;
+};
+
+/* Without tracking the callbacks are NULL and nothing is counted */
+int hostAllocatorInitialize(struct HostAllocator *allocator, bool track, bool arena);
+void hostAllocatorFinalize(struct HostAllocator *allocator);
+
+/* Callbacks for objects of the type, NULL when tracking is disabled */
+const VkAllocationCallbacks *hostAllocatorCallbacks(struct HostAllocator *allocator, enum HostObjectType type);
+const char *hostObjectTypeName(enum HostObjectType type);
+
+/* Brackets the calling thread's part of the frame's work, its allocations in
+   between are flagged. Other threads, like a present waiter or another output
+   still warming up, are not. */
+void hostAllocatorEnterFrame(struct HostAllocator *allocator);
+void hostAllocatorLeaveFrame(struct HostAllocator *allocator);
+uint64_t hostAllocatorFramePathAllocations(struct HostAllocator *allocator);
+
+/* Totals by scope and object type, live ones are leaks when printed after cleanup */
+void hostAllocatorPrintReport(struct HostAllocator *allocator);
+
+#endif /* __HOSTALLOC_H__ */
@@ -0,0 +1,221 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "latency.h"
+#include "log.h"
+
+/* SDL ticks are truncated milliseconds, the event happened within the following millisecond */
+#define SDL_TICK_MIDPOINT_SEC 0.0005
+
+int latencyInitialize(struct LatencyTracker *tracker)
+{
+  memset(tracker, 0, sizeof(*tracker));
+
+  if (!statsSeriesInitialize(&tracker->eventToSubmitSec, LATENCY_HISTORY_SIZE)
+      || !statsSeriesInitialize(&tracker->eventToPresentSec, LATENCY_HISTORY_SIZE)) {
+    latencyFinalize(tracker);
+    return 0;
+  }
+
+  latencyCalibrate(tracker);
+  return 1;
+}
+
+void latencyFinalize(struct LatencyTracker *tracker)
+{
+  latencyStopInjector(tracker);
+
+  statsSeriesFinalize(&tracker->eventToSubmitSec);
+  statsSeriesFinalize(&tracker->eventToPresentSec);
+}
+
+void latencyCalibrate(struct LatencyTracker *tracker)
+{
+  /* Both clocks are read back to back: the smallest difference is the closest
+     to the moment the SDL tick changed */
+  Uint32 ticks = SDL_GetTicks();
+  double nowSec = clockNowSec();
+  double offsetSec = nowSec - ticks / 1000.0;
+
+  if (!tracker->offsetValid) {
+    tracker->sdlClockOffsetSec = offsetSec;
+    tracker->windowOffsetSec = offsetSec;
+    tracker->windowStartSec = nowSec;
+    tracker->offsetValid = true;
+    return;
+  }
+
+  if (offsetSec < tracker->windowOffsetSec) {
+    tracker->windowOffsetSec = offsetSec;
+  }
+
+  /* A smaller offset applies at once, a larger one (the SDL clock drifting
+     ahead) once a whole window did not see the old one anymore */
+  if (offsetSec < tracker->sdlClockOffsetSec) {
+    tracker->sdlClockOffsetSec = offsetSec;
+  }
+
+  if (nowSec - tracker->windowStartSec >= LATENCY_CALIBRATION_WINDOW_SEC) {
+    tracker->sdlClockOffsetSec = tracker->windowOffsetSec;
+    tracker->windowOffsetSec = offsetSec;
+    tracker->windowStartSec = nowSec;
+  }
+}
+
+void latencyAddEvent(struct LatencyTracker *tracker, Uint32 sdlTimestampMs)
+{
+  if (tracker->pendingCount == LATENCY_PENDING_EVENTS) {
+    tracker->droppedEvents++;
+    return;
+  }
+
+  struct LatencyEvent *event = &tracker->pending[tracker->pendingCount++];
+  event->frameId = 0;
+  event->eventTimeSec = sdlTimestampMs / 1000.0 + tracker->sdlClockOffsetSec + SDL_TICK_MIDPOINT_SEC;
+}
+
+void latencyFrameSubmitted(struct LatencyTracker *tracker, uint64_t frameId)
+{
+  for (uint32_t i = 0; i < tracker->pendingCount; i++) {
+    if (tracker->inflightCount == LATENCY_INFLIGHT_EVENTS) {
+      tracker->droppedEvents += tracker->pendingCount - i;
+      break;
+    }
+
+    uint32_t slot = (tracker->inflightHead + tracker->inflightCount) % LATENCY_INFLIGHT_EVENTS;
+    tracker->inflight[slot] = tracker->pending[i];
+    tracker->inflight[slot].frameId = frameId;
+    tracker->inflightCount++;
+  }
+
+  tracker->pendingCount = 0;
+}
+
+void latencyFramePresented(struct LatencyTracker *tracker, const PresentTiming *timing)
+{
+  if (!timing->presentTimeIsDisplayed) {
+    tracker->undisplayedPresents++;
+  }
+
+  /* Timings arrive in submission order, events of older frames have no timing anymore */
+  while (tracker->inflightCount > 0) {
+    struct LatencyEvent *event = &tracker->inflight[tracker->inflightHead];
+    if (event->frameId > timing->frameId) {
+      break;
+    }
+
+    if (event->frameId == timing->frameId) {
+      statsSeriesAdd(&tracker->eventToSubmitSec, timing->submitTimeSec - event->eventTimeSec);
+      statsSeriesAdd(&tracker->eventToPresentSec, timing->presentTimeSec - event->eventTimeSec);
+    } else {
+      tracker->droppedEvents++;
+    }
+
+    tracker->inflightHead = (tracker->inflightHead + 1) % LATENCY_INFLIGHT_EVENTS;
+    tracker->inflightCount--;
+  }
+}
+
+/**
+ * Synthetic input
+ */
+
+static void *injectorThread(void *arg)
+{
+  struct LatencyInjector *injector = arg;
+
+  while (atomic_load(&injector->running)) {
+    /* Uniform in [0.5, 1.5] x mean, so events land at random phases of the frame */
+    double factor = 0.5 + rand_r(&injector->seed) / (double)RAND_MAX;
+    clockSleepSec(injector->meanIntervalSec * factor);
+
+    if (!atomic_load(&injector->running)) {
+      break;
+    }
+
+    /* SDL_PushEvent is thread safe and stamps the event with the current tick */
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = injector->eventType;
+    SDL_PushEvent(&event);
+  }
+
+  return NULL;
+}
+
+int latencyStartInjector(struct LatencyTracker *tracker, double meanIntervalSec, unsigned int seed)
+{
+  struct LatencyInjector *injector = &tracker->injector;
+
+  injector->eventType = SDL_RegisterEvents(1);
+  if (injector->eventType == (Uint32)-1) {
+    logError("Cannot register synthetic input event type.");
+    return 0;
+  }
+
+  injector->meanIntervalSec = meanIntervalSec;
+  injector->seed = seed;
+  atomic_store(&injector->running, true);
+
+  if (pthread_create(&injector->thread, NULL, injectorThread, injector) != 0) {
+    logError("Cannot start synthetic input thread.");
+    atomic_store(&injector->running, false);
+    return 0;
+  }
+
+  logInfo("Injecting synthetic input every %.1f ms on average (seed %u)", meanIntervalSec * 1000.0, seed);
+  return 1;
+}
+
+void latencyStopInjector(struct LatencyTracker *tracker)
+{
+  if (atomic_exchange(&tracker->injector.running, false)) {
+    pthread_join(tracker->injector.thread, NULL);
+  }
+}
+
+bool latencyIsInjectedEvent(struct LatencyTracker *tracker, const SDL_Event *event)
+{
+  return tracker->injector.eventType != 0 && event->type == tracker->injector.eventType;
+}
+
+/**
+ * Report
+ */
+
+static void printSeries(const char *label, struct SampleSeries *series)
+{
+  struct SeriesSummary summary;
+  statsSeriesSummarize(series, &summary);
+
+  if (summary.count == 0) {
+    logInfo("  %-18s no samples", label);
+    return;
+  }
+
+  logInfo("  %-18s n=%-6llu min %6.2f  mean %6.2f  p50 %6.2f  p90 %6.2f  p99 %6.2f  max %6.2f ms",
+         label, (unsigned long long)summary.count,
+         summary.min * 1000.0, summary.mean * 1000.0, summary.p50 * 1000.0,
+         summary.p90 * 1000.0, summary.p99 * 1000.0, summary.max * 1000.0);
+}
+
+void latencyPrintReport(struct LatencyTracker *tracker)
+{
+  logInfo("Input latency:");
+  printSeries("event to submit", &tracker->eventToSubmitSec);
+  printSeries("event to present", &tracker->eventToPresentSec);
+
+  if (tracker->undisplayedPresents > 0) {
+    logInfo("  present times of %llu frames are queue present times (no VK_KHR_present_wait)",
+           (unsigned long long)tracker->undisplayedPresents);
+  }
+  if (tracker->droppedEvents > 0) {
+    logInfo("  %llu events dropped", (unsigned long long)tracker->droppedEvents);
+  }
+}
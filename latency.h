@@ -0,0 +1,85 @@
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SDL2/SDL.h>
+
+#include "stats.h"
+#include "vulkan.h"
+
+#define LATENCY_PENDING_EVENTS  64
+#define LATENCY_INFLIGHT_EVENTS 256
+#define LATENCY_HISTORY_SIZE    4096
+
+/* The SDL tick to monotonic clock offset is the minimum over this window */
+#define LATENCY_CALIBRATION_WINDOW_SEC 2.0
+
+struct LatencyEvent
+{
+  uint64_t frameId;   /* First frame reflecting the event, 0 while not yet submitted */
+  double eventTimeSec;
+};
+
+/* Synthetic input generator pushing SDL user events at random intervals */
+struct LatencyInjector
+{
+  pthread_t thread;
+  atomic_bool running;
+  Uint32 eventType;
+  double meanIntervalSec;
+  unsigned int seed;
+};
+
+/*
+ * Input-to-present latency of input events. Event times are SDL event
+ * timestamps mapped onto clockNowSec(); SDL stamps events when it pumps
+ * them from the window system, not when the kernel received them, so the
+ * figures exclude the time spent in the X server. The two clocks drift
+ * apart, so the mapping is the smallest offset seen over the last
+ * calibration window, not over the whole run.
+ */
+struct LatencyTracker
+{
+  double sdlClockOffsetSec;
+  bool offsetValid;
+  double windowOffsetSec;     /* Smallest offset of the current window */
+  double windowStartSec;
+
+  struct LatencyEvent pending[LATENCY_PENDING_EVENTS];
+  uint32_t pendingCount;
+
+  struct LatencyEvent inflight[LATENCY_INFLIGHT_EVENTS];
+  uint32_t inflightHead;
+  uint32_t inflightCount;
+  uint64_t droppedEvents;
+
+  struct SampleSeries eventToSubmitSec;
+  struct SampleSeries eventToPresentSec;
+  uint64_t undisplayedPresents;
+
+  struct LatencyInjector injector;
+};
+
+int latencyInitialize(struct LatencyTracker *tracker);
+void latencyFinalize(struct LatencyTracker *tracker);
+
+/* Call before polling SDL events, keeps the SDL tick to monotonic clock mapping fresh */
+void latencyCalibrate(struct LatencyTracker *tracker);
+
+/* Registers an input event, it is attributed to the next submitted frame */
+void latencyAddEvent(struct LatencyTracker *tracker, Uint32 sdlTimestampMs);
+void latencyFrameSubmitted(struct LatencyTracker *tracker, uint64_t frameId);
+void latencyFramePresented(struct LatencyTracker *tracker, const PresentTiming *timing);
+
+/* Starts the synthetic input generator, meanIntervalSec apart on average (0.5x - 1.5x) */
+int latencyStartInjector(struct LatencyTracker *tracker, double meanIntervalSec, unsigned int seed);
+void latencyStopInjector(struct LatencyTracker *tracker);
+bool latencyIsInjectedEvent(struct LatencyTracker *tracker, const SDL_Event *event);
+
+void latencyPrintReport(struct LatencyTracker *tracker);
+
+#endif /* __LATENCY_H__ */
@@ -0,0 +1,236 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "log.h"
+
+/**
+ * Ring
+ *
+ * Bounded multi-producer single-consumer queue (D. Vyukov's sequence
+ * numbered slots). A producer claims a slot with a single CAS on the enqueue
+ * position, formats into it and publishes it by bumping the slot sequence.
+ */
+
+struct LogSlot
+{
+  atomic_size_t sequence;
+  int level;
+  int length;
+  char message[LOG_MESSAGE_SIZE];
+};
+
+struct Logger
+{
+  struct LogSlot ring[LOG_RING_SIZE];
+  atomic_size_t enqueuePosition;
+  size_t dequeuePosition;
+
+  atomic_int level;
+  atomic_uint_fast64_t dropped;
+  uint64_t droppedReported;
+
+  atomic_bool running;
+  atomic_int producers;      /* logWrite() calls that saw the writer running */
+  pthread_t writer;
+  sem_t wakeup;
+};
+
+static struct Logger g_logger = {
+  .level = LOG_LEVEL_DEBUG,
+};
+
+static int formatMessage(char *buffer, const char *format, va_list args)
+{
+  int length = vsnprintf(buffer, LOG_MESSAGE_SIZE - 1, format, args);
+  if (length < 0) {
+    length = 0;
+  } else if (length > LOG_MESSAGE_SIZE - 2) {
+    length = LOG_MESSAGE_SIZE - 2;
+  }
+
+  buffer[length++] = '\n';
+  return length;
+}
+
+static void writeAll(int level, const char *buffer, size_t length)
+{
+  int fd = level >= LOG_LEVEL_WARNING ? STDERR_FILENO : STDOUT_FILENO;
+
+  while (length > 0) {
+    ssize_t written = write(fd, buffer, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+
+    buffer += written;
+    length -= written;
+  }
+}
+
+static bool enqueue(int level, const char *format, va_list args)
+{
+  size_t position = atomic_load_explicit(&g_logger.enqueuePosition, memory_order_relaxed);
+  struct LogSlot *slot;
+
+  for (;;) {
+    slot = &g_logger.ring[position & (LOG_RING_SIZE - 1)];
+    size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+    if (difference == 0) {
+      if (atomic_compare_exchange_weak_explicit(&g_logger.enqueuePosition, &position, position + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      /* Writer is a whole ring behind */
+      return false;
+    } else {
+      position = atomic_load_explicit(&g_logger.enqueuePosition, memory_order_relaxed);
+    }
+  }
+
+  slot->level = level;
+  slot->length = formatMessage(slot->message, format, args);
+  atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+
+  return true;
+}
+
+/* Writes out every published message, returns false when the ring was empty */
+static bool drain(void)
+{
+  bool drained = false;
+
+  for (;;) {
+    struct LogSlot *slot = &g_logger.ring[g_logger.dequeuePosition & (LOG_RING_SIZE - 1)];
+    size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+    if (sequence != g_logger.dequeuePosition + 1) {
+      break;
+    }
+
+    writeAll(slot->level, slot->message, slot->length);
+
+    atomic_store_explicit(&slot->sequence, g_logger.dequeuePosition + LOG_RING_SIZE, memory_order_release);
+    g_logger.dequeuePosition++;
+    drained = true;
+  }
+
+  uint64_t dropped = atomic_load(&g_logger.dropped);
+  if (dropped != g_logger.droppedReported) {
+    char buffer[64];
+    int length = snprintf(buffer, sizeof(buffer), "%llu log messages dropped\n",
+                          (unsigned long long)(dropped - g_logger.droppedReported));
+    writeAll(LOG_LEVEL_WARNING, buffer, length);
+    g_logger.droppedReported = dropped;
+  }
+
+  return drained;
+}
+
+static void *writerThread(void *arg)
+{
+  while (atomic_load(&g_logger.running)) {
+    while (sem_wait(&g_logger.wakeup) != 0 && errno == EINTR);
+    drain();
+  }
+
+  /* Producers may still have been publishing while stopping */
+  drain();
+  return NULL;
+}
+
+/**
+ * API
+ */
+
+int logInitialize(void)
+{
+  for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+    atomic_store(&g_logger.ring[i].sequence, i);
+  }
+  atomic_store(&g_logger.enqueuePosition, 0);
+  g_logger.dequeuePosition = 0;
+
+  if (sem_init(&g_logger.wakeup, 0, 0) != 0) {
+    return 0;
+  }
+
+  atomic_store(&g_logger.running, true);
+  if (pthread_create(&g_logger.writer, NULL, writerThread, NULL) != 0) {
+    atomic_store(&g_logger.running, false);
+    sem_destroy(&g_logger.wakeup);
+    return 0;
+  }
+
+  return 1;
+}
+
+void logFinalize(void)
+{
+  if (!atomic_exchange(&g_logger.running, false)) {
+    return;
+  }
+
+  /* Producers that still saw the writer running publish before its last
+     drain, later ones write synchronously */
+  while (atomic_load(&g_logger.producers) > 0) {
+    sched_yield();
+  }
+
+  sem_post(&g_logger.wakeup);
+  pthread_join(g_logger.writer, NULL);
+  sem_destroy(&g_logger.wakeup);
+}
+
+void logSetLevel(int level)
+{
+  atomic_store(&g_logger.level, level);
+}
+
+uint64_t logDroppedCount(void)
+{
+  return atomic_load(&g_logger.dropped);
+}
+
+void logWrite(int level, const char *format, ...)
+{
+  if (level < atomic_load_explicit(&g_logger.level, memory_order_relaxed)) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, format);
+
+  atomic_fetch_add(&g_logger.producers, 1);
+
+  if (!atomic_load(&g_logger.running)) {
+    char buffer[LOG_MESSAGE_SIZE];
+    int length = formatMessage(buffer, format, args);
+    writeAll(level, buffer, length);
+  } else if (enqueue(level, format, args)) {
+    /* Only a syscall when the writer is actually waiting */
+    sem_post(&g_logger.wakeup);
+  } else {
+    atomic_fetch_add(&g_logger.dropped, 1);
+  }
+
+  atomic_fetch_sub(&g_logger.producers, 1);
+
+  va_end(args);
+}
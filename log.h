@@ -0,0 +1,53 @@
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <stdint.h>
+
+#define LOG_LEVEL_DEBUG   0
+#define LOG_LEVEL_INFO    1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR   3
+
+/* Calls below this level are compiled out, build with LOG_COMPILE_LEVEL=0 to keep debug messages */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SIZE    1024 /* Power of two */
+#define LOG_MESSAGE_SIZE 256
+
+/*
+ * Asynchronous logging. Messages are formatted on the calling thread into a
+ * preallocated ring and written out by a background thread, so a slow
+ * terminal or pipe never blocks the frame loop. When the ring is full the
+ * message is dropped and counted. Before logInitialize() and after
+ * logFinalize() messages are written synchronously.
+ *
+ * A new line is appended to every message. Warnings and errors go to
+ * stderr, the rest to stdout.
+ */
+int logInitialize(void);
+void logFinalize(void);
+
+/* Runtime filter on top of LOG_COMPILE_LEVEL */
+void logSetLevel(int level);
+uint64_t logDroppedCount(void);
+
+void logWrite(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define logDebug(...) logWrite(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define logDebug(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define logInfo(...) logWrite(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define logInfo(...) ((void)0)
+#endif
+
+#define logWarning(...) logWrite(LOG_LEVEL_WARNING, __VA_ARGS__)
+#define logError(...)   logWrite(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif /* __LOG_H__ */
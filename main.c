@@ -7,133 +7,591 @@
 #include <SDL2/SDL.h>
 #include "vulkan.h"
 
+#include "clock.h"
+#include "control.h"
+#include "displaypacer.h"
+#include "frameloop.h"
+#include "framerate.h"
 #include "gsync.h"
+#include "latency.h"
+#include "log.h"
+#include "metrics.h"
+#include "pacer.h"
+#include "realtime.h"
+#include "refresh.h"
+#include "scenario.h"
+#include "smoothness.h"
+#include "stats.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "vrr.h"
+#include "vrrprobe.h"
 #include "vsync.h"
 
-#include <time.h>
-#include "sys/time.h"
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
 
 /**
- * Clock
+ * Command line options
  */
 
-struct Clock
+/* Display of the multi display mode, 0 min/max keep the display's default profile */
+struct DisplaySelection
 {
-  double currentTimeSec;
-  double lastTimeSec;
-  double deltaSec; /* Delta Time */
+  int index;
+  int frameRateMin;
+  int frameRateMax;
 };
 
-void initializeClock(struct Clock *clock)
+struct Options
 {
-  clock->currentTimeSec = 0;
-  clock->lastTimeSec = 0;
-  clock->deltaSec = 0;
-}
+  SDL_bool listDisplays;
+  struct DisplaySelection displays[VULKAN_MAX_OUTPUTS];
+  uint32_t displayCount;
+  enum GSyncBackendType gsyncBackend;
+  enum VrrBackendType vrrBackend;
+  VulkanConfig vulkanConfig;
+
+  /* Synthetic input injection, 0 when disabled */
+  double latencyTestIntervalSec;
+  unsigned int latencyTestSeed;
+  double statsIntervalSec;
+
+  int logLevel;
+
+  SDL_bool lowLatency;
+  struct Realtime realtime;
+
+  const char *tracePath;
+  /* Shared memory segment of the live metrics, NULL when disabled */
+  const char *metricsName;
+  /* Command socket, NULL when disabled */
+  const char *controlPath;
+
+  /* GPU telemetry sampling rate, 0 when disabled */
+  double telemetryRateHz;
+  enum TelemetrySourceType telemetrySource;
+
+  /* Unattended sweep, NULL when disabled */
+  const char *scenarioPath;
+  const char *resultsPath;
+
+  /* VRR range probe step in fps, 0 when disabled */
+  int vrrProbeStepHz;
+  SDL_bool vrrProbeSeed;
+};
 
-void updateClock(struct Clock *clock)
+static void printUsage(const char *programName)
 {
-  struct timeval currentTime;
-  gettimeofday(&currentTime, 0);
-
-  clock->lastTimeSec = clock->currentTimeSec;
-  clock->currentTimeSec = (double)currentTime.tv_sec + currentTime.tv_usec / 1000000.0;
-  clock->deltaSec = clock->currentTimeSec - clock->lastTimeSec;
+  printf("Usage: %s [options]\n"
+         "  --direct-display[=N]         render directly to display N (default 0) through VK_KHR_display\n"
+         "  --display-mode=WxH[@HZ]      direct display mode, highest refresh rate is used when HZ is omitted\n"
+         "  --list-displays              list displays, modes and planes and exit\n"
+         "  --displays=N[:MIN-MAX],...   one window per listed display, each paced by its own thread, optionally\n"
+         "                               with its own frame rate range\n"
+         "  --vrr-backend=auto|nvctrl|drm|mock\n"
+         "                               VRR control backend (default auto: NV-CONTROL, then DRM/KMS)\n"
+         "  --gsync-backend=nvctrl|mock  NV-CONTROL attribute backend (default nvctrl)\n"
+         "  --latency-test[=MS]          inject synthetic input every MS milliseconds on average (default 100)\n"
+         "  --seed=N                     random seed of the synthetic input (default 1)\n"
+         "  --stats-interval=SEC         print frame and latency statistics every SEC seconds (default 5, 0 disables)\n"
+         "  --low-latency                start frames just in time for their deadline instead of sleeping after them\n"
+         "  --sched=fifo|rr[:PRIO]       real-time scheduling of the frame loop (default priority 50)\n"
+         "  --cpu=N|auto                 pin the frame loop to CPU N, auto prefers an isolated CPU\n"
+         "  --mlock                      lock the process memory with mlockall\n"
+         "  --prefault                   prefault the stack and a heap reserve before the frame loop\n"
+         "  --prerecorded                record one command buffer per swapchain image at startup, per-frame data\n"
+         "                               goes through a mapped uniform buffer\n"
+         "  --record-threads=N           record the scene on N threads into secondary command buffers (default 0, inline)\n"
+         "  --no-timeline-semaphore      synchronize frames with a fence even when timeline semaphores are supported\n"
+         "  --dynamic-rendering          render with VK_KHR_dynamic_rendering instead of a render pass when supported\n"
+         "  --damage-tracking            render only the region the bar moved through and pass it as present region\n"
+         "  --host-allocations[=track|arena]\n"
+         "                               count the Vulkan driver's host allocations and flag those made per frame,\n"
+         "                               arena also serves object scope ones from a preallocated block (default track)\n"
+         "  --capture=DIR                write frames to DIR from a separate thread, dropped when it falls behind\n"
+         "  --capture-every=N            capture every Nth frame (default 1)\n"
+         "  --capture-format=ppm|png     captured frame files, png is zlib compressed (default ppm)\n"
+         "  --pattern=default|thin|wide|red|gpu-load\n"
+         "                               test pattern to start with, P cycles through them (default default)\n"
+         "  --present-mode=fifo|fifo-relaxed|mailbox|immediate\n"
+         "                               swapchain present mode (default fifo)\n"
+         "  --scenario=FILE              run the phases of FILE unattended and exit, see README\n"
+         "  --results=FILE               per-phase JSON results of the scenario (default results.json)\n"
+         "  --probe-vrr[=STEP]           sweep constant frame rates STEP fps apart (default 5), report the VRR\n"
+         "                               window, LFC and fixed refresh onsets and exit\n"
+         "  --probe-vrr-seed             keep running after the probe with the detected window as frame rate range\n"
+         "  --trace=FILE                 write a per-frame CSV trace to FILE on exit\n"
+         "  --metrics[=NAME]             publish live metrics in shared memory segment NAME\n"
+         "                               (default " METRICS_DEFAULT_NAME "), read them with vk-gsync-monitor\n"
+         "  --control=PATH               accept commands on the UNIX domain socket PATH, see README\n"
+         "  --telemetry[=HZ]             sample GPU clocks, utilization and temperature HZ times per second\n"
+         "                               (default 10) into the trace\n"
+         "  --telemetry-source=nvctrl|mock\n"
+         "                               GPU telemetry source (default nvctrl)\n"
+         "  --log-level=debug|info|warning|error\n"
+         "                               lowest level printed (default info, debug needs a LOG_COMPILE_LEVEL=0 build)\n"
+         "  --help                       show this message\n",
+         programName);
 }
 
-/**
- * FrameRateController
- */
-
-struct FrameRateController
+static SDL_bool parseDisplayMode(const char *value, VulkanConfig *config)
 {
-  int frameRateFloor;
-  int frameRateMin;
-  int frameRateMax;
+  unsigned int width = 0, height = 0;
+  double refreshRate = 0.0;
+  int sizeLength = 0, modeLength = 0;
+
+  /* The whole value, "1920x1080@144junk" is not a mode */
+  int matched = sscanf(value, "%ux%u%n@%lf%n", &width, &height, &sizeLength, &refreshRate, &modeLength);
+  SDL_bool complete = matched == 2 ? value[sizeLength] == '\0' : matched == 3 && value[modeLength] == '\0';
+  if (!complete || (matched == 3 && refreshRate <= 0.0)) {
+    return SDL_FALSE;
+  }
 
-  double currentSimulatedFrameRate;
-  double nextFrameDelaySec;
-};
+  config->modeWidth = width;
+  config->modeHeight = height;
+  config->modeRefreshRateMilliHz = (uint32_t)(refreshRate * 1000.0 + 0.5);
 
-inline double max(double a, double b)
-{
-  return (a > b) ? a : b;
+  return SDL_TRUE;
 }
 
-inline double min(double a, double b)
+static SDL_bool parseDisplayList(const char *value, struct Options *options)
 {
-  return (a < b) ? a : b;
-}
+  options->displayCount = 0;
 
-void initializeFrameRateController(struct FrameRateController *frameRateController, int refreshRate)
-{
-  frameRateController->frameRateFloor = 10;
-  frameRateController->frameRateMin = 30;
-  frameRateController->frameRateMax = max(60, refreshRate);
-}
+  while (*value != '\0') {
+    if (options->displayCount == VULKAN_MAX_OUTPUTS) {
+      return SDL_FALSE;
+    }
 
-void increaseMinFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames)
-{
-  frameRateController->frameRateMin =
-    min(frameRateController->frameRateMin + byNrOfFrames, frameRateController->frameRateMax);
-}
+    struct DisplaySelection *display = &options->displays[options->displayCount++];
+    int consumed = 0;
 
-void increaseMaxFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames)
-{
-  frameRateController->frameRateMax += byNrOfFrames;
-}
+    display->frameRateMin = 0;
+    display->frameRateMax = 0;
+    if (sscanf(value, "%d%n", &display->index, &consumed) != 1 || display->index < 0) {
+      return SDL_FALSE;
+    }
+    value += consumed;
+
+    if (*value == ':') {
+      if (sscanf(value, ":%d-%d%n", &display->frameRateMin, &display->frameRateMax, &consumed) != 2
+          || display->frameRateMin <= 0 || display->frameRateMax < display->frameRateMin) {
+        return SDL_FALSE;
+      }
+      value += consumed;
+    }
 
-void decreaseMinFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames)
-{
-  frameRateController->frameRateMin =
-    max(frameRateController->frameRateMin - byNrOfFrames, frameRateController->frameRateFloor);
-}
+    if (*value == ',') {
+      value++;
+    } else if (*value != '\0') {
+      return SDL_FALSE;
+    }
+  }
 
-void decreaseMaxFrameRate(struct FrameRateController *frameRateController, int byNrOfFrames)
-{
-  frameRateController->frameRateMax =
-    max(frameRateController->frameRateMax - byNrOfFrames, frameRateController->frameRateMin);
+  return options->displayCount > 0;
 }
 
-void computeNextFrameDelayMsec(struct FrameRateController *frameRateController, double currentTimeSec)
+static SDL_bool parseOptions(struct Options *options, int argc, char **argv)
 {
-  const double frameRateMin = max(frameRateController->frameRateFloor, frameRateController->frameRateMin);
-  const double frameRateRange = (frameRateController->frameRateMax - frameRateMin);
-  const double frameRateRangeMean = (frameRateMin + frameRateController->frameRateMax) / 2.0;
-  const double frameRateAmplitude = frameRateRange / 2.0;
+  enum {
+    OPTION_DIRECT_DISPLAY = 256,
+    OPTION_DISPLAY_MODE,
+    OPTION_LIST_DISPLAYS,
+    OPTION_DISPLAYS,
+    OPTION_GSYNC_BACKEND,
+    OPTION_VRR_BACKEND,
+    OPTION_LATENCY_TEST,
+    OPTION_SEED,
+    OPTION_STATS_INTERVAL,
+    OPTION_LOG_LEVEL,
+    OPTION_LOW_LATENCY,
+    OPTION_SCHED,
+    OPTION_CPU,
+    OPTION_MLOCK,
+    OPTION_PREFAULT,
+    OPTION_PRERECORDED,
+    OPTION_RECORD_THREADS,
+    OPTION_NO_TIMELINE_SEMAPHORE,
+    OPTION_DYNAMIC_RENDERING,
+    OPTION_DAMAGE_TRACKING,
+    OPTION_HOST_ALLOCATIONS,
+    OPTION_CAPTURE,
+    OPTION_CAPTURE_EVERY,
+    OPTION_CAPTURE_FORMAT,
+    OPTION_PATTERN,
+    OPTION_PRESENT_MODE,
+    OPTION_SCENARIO,
+    OPTION_RESULTS,
+    OPTION_PROBE_VRR,
+    OPTION_PROBE_VRR_SEED,
+    OPTION_TRACE,
+    OPTION_METRICS,
+    OPTION_CONTROL,
+    OPTION_TELEMETRY,
+    OPTION_TELEMETRY_SOURCE,
+    OPTION_HELP,
+  };
+
+  static const struct option longOptions[] = {
+    { "direct-display", optional_argument, NULL, OPTION_DIRECT_DISPLAY },
+    { "display-mode",   required_argument, NULL, OPTION_DISPLAY_MODE },
+    { "list-displays",  no_argument,       NULL, OPTION_LIST_DISPLAYS },
+    { "displays",       required_argument, NULL, OPTION_DISPLAYS },
+    { "gsync-backend",  required_argument, NULL, OPTION_GSYNC_BACKEND },
+    { "vrr-backend",    required_argument, NULL, OPTION_VRR_BACKEND },
+    { "latency-test",   optional_argument, NULL, OPTION_LATENCY_TEST },
+    { "seed",           required_argument, NULL, OPTION_SEED },
+    { "stats-interval", required_argument, NULL, OPTION_STATS_INTERVAL },
+    { "log-level",      required_argument, NULL, OPTION_LOG_LEVEL },
+    { "low-latency",    no_argument,       NULL, OPTION_LOW_LATENCY },
+    { "sched",          required_argument, NULL, OPTION_SCHED },
+    { "cpu",            required_argument, NULL, OPTION_CPU },
+    { "mlock",          no_argument,       NULL, OPTION_MLOCK },
+    { "prefault",       no_argument,       NULL, OPTION_PREFAULT },
+    { "prerecorded",    no_argument,       NULL, OPTION_PRERECORDED },
+    { "record-threads", required_argument, NULL, OPTION_RECORD_THREADS },
+    { "no-timeline-semaphore", no_argument, NULL, OPTION_NO_TIMELINE_SEMAPHORE },
+    { "dynamic-rendering", no_argument,  NULL, OPTION_DYNAMIC_RENDERING },
+    { "damage-tracking", no_argument,    NULL, OPTION_DAMAGE_TRACKING },
+    { "host-allocations", optional_argument, NULL, OPTION_HOST_ALLOCATIONS },
+    { "capture",        required_argument, NULL, OPTION_CAPTURE },
+    { "capture-every",  required_argument, NULL, OPTION_CAPTURE_EVERY },
+    { "capture-format", required_argument, NULL, OPTION_CAPTURE_FORMAT },
+    { "pattern",        required_argument, NULL, OPTION_PATTERN },
+    { "present-mode",   required_argument, NULL, OPTION_PRESENT_MODE },
+    { "scenario",       required_argument, NULL, OPTION_SCENARIO },
+    { "results",        required_argument, NULL, OPTION_RESULTS },
+    { "probe-vrr",      optional_argument, NULL, OPTION_PROBE_VRR },
+    { "probe-vrr-seed", no_argument,       NULL, OPTION_PROBE_VRR_SEED },
+    { "trace",          required_argument, NULL, OPTION_TRACE },
+    { "metrics",        optional_argument, NULL, OPTION_METRICS },
+    { "control",        required_argument, NULL, OPTION_CONTROL },
+    { "telemetry",      optional_argument, NULL, OPTION_TELEMETRY },
+    { "telemetry-source", required_argument, NULL, OPTION_TELEMETRY_SOURCE },
+    { "help",           no_argument,       NULL, OPTION_HELP },
+    { NULL, 0, NULL, 0 }
+  };
+
+  memset(options, 0, sizeof(*options));
+  options->latencyTestSeed = 1;
+  options->statsIntervalSec = 5.0;
+  options->logLevel = LOG_LEVEL_INFO;
+  options->resultsPath = "results.json";
+  realtimeInitialize(&options->realtime);
+
+  int option;
+  while ((option = getopt_long(argc, argv, "", longOptions, NULL)) != -1) {
+    switch (option) {
+    case OPTION_DIRECT_DISPLAY:
+      options->vulkanConfig.directDisplay = SDL_TRUE;
+      options->vulkanConfig.displayIndex = 0;
+      if (optarg != NULL) {
+        char *end;
+        errno = 0;
+        long index = strtol(optarg, &end, 10);
+        if (end == optarg || *end != '\0' || errno != 0 || index < 0 || index > INT_MAX) {
+          fprintf(stderr, "Invalid display index '%s'\n", optarg);
+          return SDL_FALSE;
+        }
+        options->vulkanConfig.displayIndex = (int)index;
+      }
+      break;
+    case OPTION_DISPLAY_MODE:
+      if (!parseDisplayMode(optarg, &options->vulkanConfig)) {
+        fprintf(stderr, "Invalid display mode '%s', expected WxH or WxH@HZ\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_LIST_DISPLAYS:
+      options->listDisplays = SDL_TRUE;
+      break;
+    case OPTION_DISPLAYS:
+      if (!parseDisplayList(optarg, options)) {
+        fprintf(stderr, "Invalid display list '%s', expected up to %d of N or N:MIN-MAX separated by commas\n",
+                optarg, VULKAN_MAX_OUTPUTS);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_GSYNC_BACKEND:
+      if (strcmp(optarg, "nvctrl") == 0) {
+        options->gsyncBackend = GSYNC_BACKEND_NVCTRL;
+      } else if (strcmp(optarg, "mock") == 0) {
+        options->gsyncBackend = GSYNC_BACKEND_MOCK;
+      } else {
+        fprintf(stderr, "Unknown G-SYNC backend '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_VRR_BACKEND:
+      if (strcmp(optarg, "auto") == 0) {
+        options->vrrBackend = VRR_BACKEND_AUTO;
+      } else if (strcmp(optarg, "nvctrl") == 0) {
+        options->vrrBackend = VRR_BACKEND_NVCTRL;
+      } else if (strcmp(optarg, "drm") == 0) {
+        options->vrrBackend = VRR_BACKEND_DRM;
+      } else if (strcmp(optarg, "mock") == 0) {
+        options->vrrBackend = VRR_BACKEND_MOCK;
+      } else {
+        fprintf(stderr, "Unknown VRR backend '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_LATENCY_TEST:
+      options->latencyTestIntervalSec = (optarg ? atof(optarg) : 100.0) / 1000.0;
+      if (options->latencyTestIntervalSec <= 0.0) {
+        fprintf(stderr, "Invalid synthetic input interval '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_SEED:
+      options->latencyTestSeed = strtoul(optarg, NULL, 0);
+      break;
+    case OPTION_STATS_INTERVAL:
+      options->statsIntervalSec = atof(optarg);
+      break;
+    case OPTION_LOG_LEVEL:
+      if (strcmp(optarg, "debug") == 0) {
+        options->logLevel = LOG_LEVEL_DEBUG;
+      } else if (strcmp(optarg, "info") == 0) {
+        options->logLevel = LOG_LEVEL_INFO;
+      } else if (strcmp(optarg, "warning") == 0) {
+        options->logLevel = LOG_LEVEL_WARNING;
+      } else if (strcmp(optarg, "error") == 0) {
+        options->logLevel = LOG_LEVEL_ERROR;
+      } else {
+        fprintf(stderr, "Unknown log level '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_LOW_LATENCY:
+      options->lowLatency = SDL_TRUE;
+      break;
+    case OPTION_SCHED:
+      if (!realtimeParsePolicy(&options->realtime, optarg)) {
+        fprintf(stderr, "Invalid scheduling '%s', expected fifo or rr, optionally with :PRIO (1-99)\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_CPU:
+      if (!realtimeParseCpu(&options->realtime, optarg)) {
+        fprintf(stderr, "Invalid CPU '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_MLOCK:
+      options->realtime.lockMemory = true;
+      break;
+    case OPTION_PREFAULT:
+      options->realtime.prefault = true;
+      break;
+    case OPTION_PRERECORDED:
+      options->vulkanConfig.prerecordedCommands = SDL_TRUE;
+      break;
+    case OPTION_RECORD_THREADS:
+      options->vulkanConfig.recordThreads = strtoul(optarg, NULL, 0);
+      if (options->vulkanConfig.recordThreads > VULKAN_MAX_RECORD_THREADS) {
+        fprintf(stderr, "At most %d recording threads are supported\n", VULKAN_MAX_RECORD_THREADS);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_NO_TIMELINE_SEMAPHORE:
+      options->vulkanConfig.disableTimelineSemaphore = SDL_TRUE;
+      break;
+    case OPTION_DYNAMIC_RENDERING:
+      options->vulkanConfig.dynamicRendering = SDL_TRUE;
+      break;
+    case OPTION_DAMAGE_TRACKING:
+      options->vulkanConfig.damageTracking = SDL_TRUE;
+      break;
+    case OPTION_HOST_ALLOCATIONS:
+      if (optarg == NULL || strcmp(optarg, "track") == 0) {
+        options->vulkanConfig.trackHostAllocations = SDL_TRUE;
+      } else if (strcmp(optarg, "arena") == 0) {
+        options->vulkanConfig.trackHostAllocations = SDL_TRUE;
+        options->vulkanConfig.hostAllocationArena = SDL_TRUE;
+      } else {
+        fprintf(stderr, "Unknown host allocation mode '%s', expected track or arena\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_CAPTURE:
+      options->vulkanConfig.captureDirectory = optarg;
+      break;
+    case OPTION_CAPTURE_EVERY:
+      options->vulkanConfig.captureInterval = strtoul(optarg, NULL, 0);
+      if (options->vulkanConfig.captureInterval == 0) {
+        fprintf(stderr, "Invalid capture interval '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_CAPTURE_FORMAT:
+      if (strcmp(optarg, "ppm") == 0) {
+        options->vulkanConfig.captureCompressed = SDL_FALSE;
+      } else if (strcmp(optarg, "png") == 0) {
+        options->vulkanConfig.captureCompressed = SDL_TRUE;
+      } else {
+        fprintf(stderr, "Unknown capture format '%s', expected ppm or png\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_PATTERN:
+      if (!scenarioParsePattern(optarg, &options->vulkanConfig.pattern)) {
+        fprintf(stderr, "Unknown pattern '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_PRESENT_MODE:
+      if (!scenarioParsePresentMode(optarg, &options->vulkanConfig.presentMode)) {
+        fprintf(stderr, "Unknown present mode '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_SCENARIO:
+      options->scenarioPath = optarg;
+      break;
+    case OPTION_RESULTS:
+      options->resultsPath = optarg;
+      break;
+    case OPTION_PROBE_VRR:
+      options->vrrProbeStepHz = optarg ? atoi(optarg) : 5;
+      if (options->vrrProbeStepHz <= 0) {
+        fprintf(stderr, "Invalid VRR probe step '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_PROBE_VRR_SEED:
+      options->vrrProbeSeed = SDL_TRUE;
+      break;
+    case OPTION_TRACE:
+      options->tracePath = optarg;
+      break;
+    case OPTION_METRICS:
+      options->metricsName = optarg ? optarg : METRICS_DEFAULT_NAME;
+      break;
+    case OPTION_CONTROL:
+      options->controlPath = optarg;
+      break;
+    case OPTION_TELEMETRY:
+      options->telemetryRateHz = optarg ? atof(optarg) : 10.0;
+      if (options->telemetryRateHz <= 0.0) {
+        fprintf(stderr, "Invalid telemetry rate '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_TELEMETRY_SOURCE:
+      if (strcmp(optarg, "nvctrl") == 0) {
+        options->telemetrySource = TELEMETRY_SOURCE_NVCTRL;
+      } else if (strcmp(optarg, "mock") == 0) {
+        options->telemetrySource = TELEMETRY_SOURCE_MOCK;
+      } else {
+        fprintf(stderr, "Unknown telemetry source '%s'\n", optarg);
+        return SDL_FALSE;
+      }
+      break;
+    case OPTION_HELP:
+    default:
+      printUsage(argv[0]);
+      return SDL_FALSE;
+    }
+  }
 
-  frameRateController->currentSimulatedFrameRate =
-    frameRateRangeMean + frameRateAmplitude * sin(currentTimeSec);
+  if (options->scenarioPath != NULL && options->displayCount > 1) {
+    fprintf(stderr, "Scenarios run on a single display\n");
+    return SDL_FALSE;
+  }
 
-  frameRateController->nextFrameDelaySec = 1.0 / frameRateController->currentSimulatedFrameRate;
+  if (options->vrrProbeSeed && options->vrrProbeStepHz == 0) {
+    options->vrrProbeStepHz = 5;
+  }
+
+  if (options->vrrProbeStepHz > 0 && (options->scenarioPath != NULL || options->displayCount > 1)) {
+    fprintf(stderr, "The VRR probe runs on a single display, without scenario\n");
+    return SDL_FALSE;
+  }
+
+  return SDL_TRUE;
 }
 
 /**
  * Application
  */
 
+/* About an hour at 30 fps, ~12 MB */
+#define TRACE_MAX_FRAMES 100000
+
+/* Percentiles sort the frame interval series, the rest is published every frame */
+#define METRICS_SUMMARY_INTERVAL_SEC 0.25
+
 typedef struct Application_t
 {
-  struct Clock clock;
   struct FrameRateController frameRateController;
+  struct FrameLoop frameLoop;
 
-  struct GSyncController gsyncController;
+  struct VrrController vrrController;
   struct VSyncController vsyncController;
 
+  struct Options options;
+
+  struct LatencyTracker latencyTracker;
+  struct FramePacer framePacer;
+  struct SmoothnessAnalyzer smoothness;
+  struct Trace trace;
+  struct TelemetrySampler telemetry;
+  struct RefreshEstimator refreshEstimator;
+  struct MetricsPublisher metrics;
+  struct ControlServer control;
+  char controlTracePath[CONTROL_LINE_SIZE]; /* Of a trace started from the control socket */
+  struct SeriesSummary metricsIntervalSec; /* Refreshed every METRICS_SUMMARY_INTERVAL_SEC */
+  double metricsSummaryTimeSec;
+  uint64_t lastFrameId;
+  double lastFrameIntervalSec;
+  /* Cached for the frame loop, vrrIsEnabled() is an ioctl with DRM/KMS */
+  bool vrrEnabled;
+  struct SampleSeries frameIntervalSec;
+  struct SampleSeries recordingSec;
+  struct SampleSeries threadRecordingSec[VULKAN_MAX_RECORD_THREADS];
+  struct SampleSeries gpuFrameSec;
+  struct SampleSeries damageFraction;
+  struct SampleSeries wakeupLatenessSec; /* endFrame() sleep */
+  double lastStatsTimeSec;
+  double lastPresentTimeSec;
+
+  /* Scenario mode, phaseCount is 0 when disabled */
+  struct Scenario scenario;
+  int phaseIndex;
+  double phaseStartTimeSec;
+  uint64_t phaseFirstFrameId;    /* Earlier frames still in flight are not part of the phase */
+  uint64_t phaseFrames;
+  int defaultFrameRateMin;
+  int defaultFrameRateMax;
+  double loadSec;
+  double loadJitterSec;
+  unsigned int loadSeed;
+
+  /* VRR range probe, before the normal frame loop */
+  struct VrrProbe vrrProbe;
+  bool probingVrr;
+
+  /* Multi display mode, every display is paced by its own thread */
+  struct DisplayPacer displays[VULKAN_MAX_OUTPUTS];
+  uint32_t displayCount;
+
   int       animationDurationSec;
+  int       windowWidth;
+  int       windowHeight;
   SDL_bool  running;
 
   SDL_Window* pWindowHandle;
+  SDL_Window* windows[VULKAN_MAX_OUTPUTS];
+  uint32_t windowCount;
 } Application;
 
-typedef struct FrameContext_t {
-  double frameDelay;
-  int animationDurationSec;
-} FrameContext;
-
 static void toggleGSync(Application *app)
 {
-  gsyncSetAllowed(&app->gsyncController, !gsyncIsAllowed(&app->gsyncController));
+  vrrSetEnabled(&app->vrrController, !vrrIsEnabled(&app->vrrController));
+  app->vrrEnabled = vrrIsEnabled(&app->vrrController);
 }
 
 static void toggleVSync(Application *app)
@@ -141,6 +599,18 @@ static void toggleVSync(Application *app)
   vsyncSetEnabled(&app->vsyncController, !vsyncIsEnabled(&app->vsyncController));
 }
 
+/* Exact period of the mode the display scans out, SDL only knows the rate in whole Hz */
+static void queryRefreshPeriod(int displayIndex, int refreshRate, struct RefreshPeriod *period)
+{
+  SDL_Rect bounds;
+  if (SDL_GetDisplayBounds(displayIndex, &bounds) == 0 && refreshQueryXRandR(period, bounds.x, bounds.y)) {
+    return;
+  }
+
+  logWarning("No XRandR mode timing for display %d, using its %d Hz refresh rate", displayIndex, refreshRate);
+  refreshPeriodFromRate(period, refreshRate > 0 ? refreshRate : 60, 1, REFRESH_SOURCE_SDL);
+}
+
 static void initializeApplication(Application *app)
 {
   /* Application initialization */
@@ -151,41 +621,125 @@ static void initializeApplication(Application *app)
   app->animationDurationSec = 5;
   app->running = false;
 
-  SDL_DisplayMode displayMode;
-  SDL_GetCurrentDisplayMode(0, &displayMode);
+  /* One fullscreen window per selected display, display 0 by default */
+  static const struct DisplaySelection defaultDisplay = { 0, 0, 0 };
+  const struct DisplaySelection *displays = &defaultDisplay;
+  uint32_t displayCount = 1;
+  if (app->options.displayCount > 0) {
+    displays = app->options.displays;
+    displayCount = app->options.displayCount;
+  }
 
+  int widths[VULKAN_MAX_OUTPUTS], heights[VULKAN_MAX_OUTPUTS];
+  struct RefreshPeriod refreshPeriods[VULKAN_MAX_OUTPUTS];
   uint32_t windowFlags = SDL_WINDOW_VULKAN | SDL_WINDOW_SHOWN | SDL_WINDOW_FULLSCREEN;
-  app->pWindowHandle = SDL_CreateWindow(APP_NAME, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                                                      displayMode.w, displayMode.h, windowFlags);
-  if (app->pWindowHandle == NULL) {
-    printf("Failed to create SDL_Window. Exiting app.\n");
-    return;
+
+  for (uint32_t i = 0; i < displayCount; i++) {
+    SDL_DisplayMode displayMode;
+    if (SDL_GetCurrentDisplayMode(displays[i].index, &displayMode) != 0) {
+      logError("Display %d is not available: %s. Exiting app.", displays[i].index, SDL_GetError());
+      return;
+    }
+    widths[i] = displayMode.w;
+    heights[i] = displayMode.h;
+
+    int position = SDL_WINDOWPOS_UNDEFINED_DISPLAY(displays[i].index);
+    app->windows[i] = SDL_CreateWindow(APP_NAME, position, position, displayMode.w, displayMode.h, windowFlags);
+    if (app->windows[i] == NULL) {
+      logError("Failed to create SDL_Window. Exiting app.");
+      return;
+    }
+    app->windowCount++;
+
+    queryRefreshPeriod(displays[i].index, displayMode.refresh_rate, &refreshPeriods[i]);
   }
 
-  if (!InitializeVulkan(app->pWindowHandle, displayMode.w, displayMode.h)) {
-    printf("Failed to initialize Vulkan. Exiting app.\n");
+  app->pWindowHandle = app->windows[0];
+  app->windowWidth = widths[0];
+  app->windowHeight = heights[0];
+
+  if (!InitializeVulkanOutputs(app->windows, widths, heights, displayCount, &app->options.vulkanConfig)) {
+    logError("Failed to initialize Vulkan. Exiting app.");
+    return;
   };
 
-  initializeClock(&app->clock);
-  initializeFrameRateController(&app->frameRateController, displayMode.refresh_rate);
+  /* Direct display mode may differ from the desktop one */
+  if (GetDisplayRefreshRateMilliHz() != 0) {
+    refreshPeriodFromRate(&refreshPeriods[0], GetDisplayRefreshRateMilliHz(), 1000, REFRESH_SOURCE_DISPLAY_MODE);
+  }
+
+  initializeFrameRateController(&app->frameRateController, refreshRateHz(&refreshPeriods[0]));
+  // We are in NDC space total width is 2 (-1 to 1)
+  frameLoopInitialize(&app->frameLoop, &app->frameRateController, app->options.lowLatency ? &app->framePacer : NULL,
+                      2.0, app->animationDurationSec);
+  refreshEstimatorInitialize(&app->refreshEstimator, &refreshPeriods[0]);
+  if (displays[0].frameRateMax > 0) {
+    app->frameRateController.frameRateMin = displays[0].frameRateMin;
+    app->frameRateController.frameRateMax = displays[0].frameRateMax;
+  }
 
-  vsyncInitialize(&app->vsyncController);
+  for (uint32_t i = 0; i < displayCount && displayCount > 1; i++) {
+    struct DisplayPacer *display = &app->displays[i];
 
-  app->running = true;
-}
+    if (!displayPacerInitialize(display, i, displays[i].index, refreshRateHz(&refreshPeriods[i]),
+                                app->animationDurationSec)) {
+      logError("Failed to allocate statistics. Exiting app.");
+      return;
+    }
+    app->displayCount++;
 
-float computeVerticalBarXPosition(Application* app, FrameContext* frameContext)
-{
-  static float translation = 0.0;
+    if (displays[i].frameRateMax > 0) {
+      display->frameRateController.frameRateMin = displays[i].frameRateMin;
+      display->frameRateController.frameRateMax = displays[i].frameRateMax;
+    }
+  }
 
-  // We are in NDC space total width is 2 (-1 to 1)
-  const float speedPixelPerSec = 2.0f/frameContext->animationDurationSec;
-  translation += speedPixelPerSec * app->clock.deltaSec;
+  vsyncInitialize(&app->vsyncController);
 
-  if (translation >= 2.0f)
-    translation = 0.0f;
+  if (!latencyInitialize(&app->latencyTracker) || !statsSeriesInitialize(&app->frameIntervalSec, 4096)
+      || !statsSeriesInitialize(&app->recordingSec, 4096)
+      || !statsSeriesInitialize(&app->gpuFrameSec, 4096)
+      || !statsSeriesInitialize(&app->damageFraction, 4096)
+      || !statsSeriesInitialize(&app->wakeupLatenessSec, 4096)
+      || !pacerInitialize(&app->framePacer)
+      || !smoothnessInitialize(&app->smoothness, app->windowWidth / (double)app->animationDurationSec, app->windowWidth)
+      || !traceInitialize(&app->trace, app->options.tracePath, TRACE_MAX_FRAMES, 1)
+      || !metricsInitialize(&app->metrics, app->options.metricsName)) {
+    logError("Failed to allocate statistics. Exiting app.");
+    return;
+  }
+
+  if (!controlInitialize(&app->control, app->options.controlPath)) {
+    logError("Failed to open the control socket. Exiting app.");
+    return;
+  }
+  for (uint32_t i = 0; i < GetRecordThreadCount(); i++) {
+    if (!statsSeriesInitialize(&app->threadRecordingSec[i], 4096)) {
+      logError("Failed to allocate statistics. Exiting app.");
+      return;
+    }
+  }
+  pacerSetRefreshPeriod(&app->framePacer, refreshPeriodSec(&refreshPeriods[0]));
+  app->lastStatsTimeSec = clockNowSec();
+  app->vrrEnabled = vrrIsEnabled(&app->vrrController);
+  app->defaultFrameRateMin = app->frameRateController.frameRateMin;
+  app->defaultFrameRateMax = app->frameRateController.frameRateMax;
+  app->loadSeed = app->options.latencyTestSeed;
+
+  /* Started before realtimeApply(), the sampler thread keeps the default scheduling */
+  if (app->options.telemetryRateHz > 0.0) {
+    if (telemetryInitialize(&app->telemetry, app->options.telemetrySource, app->options.telemetryRateHz)) {
+      traceAttachTelemetry(&app->trace, &app->telemetry);
+    } else {
+      logWarning("GPU telemetry unavailable, continuing without it");
+    }
+  }
 
-  return translation;
+  if (app->options.latencyTestIntervalSec > 0.0) {
+    latencyStartInjector(&app->latencyTracker, app->options.latencyTestIntervalSec, app->options.latencyTestSeed);
+  }
+
+  app->running = true;
 }
 
 #ifdef USE_OPENGL
@@ -337,7 +891,7 @@ void drawHUD()
 
   glRasterPos2i(0, 120);
   printStatus("[V] V-SYNC: ", vsyncIsAvailable(&app.vsyncController), vsyncIsEnabled(&app.vsyncController));
-  printStatus("[G] G-SYNC: ", gsyncIsAvailable(&app.gsyncController), gsyncIsAllowed(&app.gsyncController));
+  printStatus("[G] G-SYNC: ", vrrIsAvailable(&app.vrrController), vrrIsEnabled(&app.vrrController));
   printText("\n");
   printText("[UP] / [DOWN] Max frame rate: %i\n", app.frameRateController.frameRateMax);
   printText("[PGUP] / [PGDOWN] Min frame rate: %i\n", app.frameRateController.frameRateMin);
@@ -439,86 +993,880 @@ void specialKeyPress(int key, int x, int y)
 
 #endif
 
-static void beginFrame(Application *app, FrameContext *frameContext)
+static void beginFrame(Application *app)
+{
+  frameLoopBegin(&app->frameLoop);
+}
+
+/* Frame rate keys apply to the display of the window they were pressed in */
+static void changeFrameRate(Application *app, Uint32 windowId, SDL_Scancode scancode)
+{
+  struct FrameRateController *frameRateController = &app->frameRateController;
+  struct DisplayPacer *display = NULL;
+
+  for (uint32_t i = 0; i < app->displayCount; i++) {
+    if (SDL_GetWindowID(app->windows[i]) == windowId) {
+      display = &app->displays[i];
+      frameRateController = &display->frameRateController;
+    }
+  }
+
+  if (app->displayCount > 0 && display == NULL) {
+    return;
+  }
+
+  if (display != NULL) {
+    displayPacerLock(display);
+  }
+
+  switch (scancode) {
+  case SDL_SCANCODE_UP:       increaseMaxFrameRate(frameRateController, 10); break;
+  case SDL_SCANCODE_DOWN:     decreaseMaxFrameRate(frameRateController, 10); break;
+  case SDL_SCANCODE_PAGEUP:   increaseMinFrameRate(frameRateController, 10); break;
+  case SDL_SCANCODE_PAGEDOWN: decreaseMinFrameRate(frameRateController, 10); break;
+  default: break;
+  }
+
+  if (display != NULL) {
+    displayPacerUnlock(display);
+  }
+}
+
+/**
+ * Control socket
+ */
+
+/* Every display's controller in multi display mode, locked until unlockFrameRateControllers() */
+static uint32_t lockFrameRateControllers(Application *app, struct FrameRateController **controllers)
+{
+  if (app->displayCount == 0) {
+    controllers[0] = &app->frameRateController;
+    return 1;
+  }
+
+  for (uint32_t i = 0; i < app->displayCount; i++) {
+    displayPacerLock(&app->displays[i]);
+    controllers[i] = &app->displays[i].frameRateController;
+  }
+  return app->displayCount;
+}
+
+static void unlockFrameRateControllers(Application *app)
+{
+  for (uint32_t i = 0; i < app->displayCount; i++) {
+    displayPacerUnlock(&app->displays[i]);
+  }
+}
+
+/* "min RATE" and "max RATE" */
+/* Far above any panel, keeps the rate within the controller's int */
+#define CONTROL_MAX_FRAME_RATE 1000
+
+static void setFrameRateLimit(Application *app, const struct ControlRequest *request, bool max)
+{
+  char *end = NULL;
+  errno = 0;
+  long rate = request->argc == 2 ? strtol(request->argv[1], &end, 10) : 0;
+  if (end == NULL || end == request->argv[1] || *end != '\0') {
+    controlReply(&app->control, request, "error expected %s RATE", request->argv[0]);
+    return;
+  }
+  if (errno == ERANGE || rate > CONTROL_MAX_FRAME_RATE) {
+    controlReply(&app->control, request, "error %s fps rejected, the limit is %d fps", request->argv[1],
+                 CONTROL_MAX_FRAME_RATE);
+    return;
+  }
+
+  struct FrameRateController *controllers[VULKAN_MAX_OUTPUTS];
+  uint32_t count = lockFrameRateControllers(app, controllers);
+
+  bool valid = true;
+  for (uint32_t i = 0; i < count; i++) {
+    valid = valid && rate >= controllers[i]->frameRateFloor
+            && (max ? rate >= controllers[i]->frameRateMin : rate <= controllers[i]->frameRateMax);
+  }
+  for (uint32_t i = 0; i < count && valid; i++) {
+    if (max) {
+      controllers[i]->frameRateMax = rate;
+    } else {
+      controllers[i]->frameRateMin = rate;
+    }
+  }
+
+  int frameRateMin = controllers[0]->frameRateMin;
+  int frameRateMax = controllers[0]->frameRateMax;
+  unlockFrameRateControllers(app);
+
+  if (valid) {
+    controlReply(&app->control, request, "ok %d-%d fps", frameRateMin, frameRateMax);
+  } else {
+    controlReply(&app->control, request, "error %ld fps rejected, the range is %d-%d fps", rate,
+                 frameRateMin, frameRateMax);
+  }
+}
+
+static void setProfile(Application *app, const struct ControlRequest *request)
+{
+  enum FrameRateProfile profile;
+  if (request->argc != 2 || !scenarioParseProfile(request->argv[1], &profile)) {
+    controlReply(&app->control, request, "error expected profile sine|ramp|constant");
+    return;
+  }
+
+  struct FrameRateController *controllers[VULKAN_MAX_OUTPUTS];
+  uint32_t count = lockFrameRateControllers(app, controllers);
+  for (uint32_t i = 0; i < count; i++) {
+    controllers[i]->profile = profile;
+  }
+  unlockFrameRateControllers(app);
+
+  controlReply(&app->control, request, "ok %s", scenarioProfileName(profile));
+}
+
+static void replyStats(Application *app, const struct ControlRequest *request)
+{
+  char reply[768];
+  int length = 0;
+  struct SeriesSummary summary;
+
+  if (app->displayCount > 0) {
+    for (uint32_t i = 0; i < app->displayCount; i++) {
+      struct SeriesSummary cadenceError, wakeupLateness;
+      displayPacerSummarize(&app->displays[i], &summary, &cadenceError, &wakeupLateness);
+      length += snprintf(reply + length, sizeof(reply) - length,
+                         "%sdisplay%d_frames=%llu display%d_interval_mean_ms=%.3f display%d_interval_p99_ms=%.3f",
+                         i == 0 ? "" : " ", app->displays[i].displayIndex, (unsigned long long)summary.count,
+                         app->displays[i].displayIndex, summary.mean * 1000.0,
+                         app->displays[i].displayIndex, summary.p99 * 1000.0);
+      if (length >= (int)sizeof(reply)) {
+        break;
+      }
+    }
+    controlReply(&app->control, request, "ok %s", reply);
+    return;
+  }
+
+  struct SeriesSummary gpu;
+  statsSeriesSummarize(&app->frameIntervalSec, &summary);
+  statsSeriesSummarize(&app->gpuFrameSec, &gpu);
+
+  controlReply(&app->control, request,
+               "ok frame=%llu target_fps=%.2f min_fps=%d max_fps=%d present_mode=%s gsync=%s "
+               "interval_n=%llu interval_mean_ms=%.3f interval_p50_ms=%.3f interval_p99_ms=%.3f "
+               "interval_max_ms=%.3f gpu_p50_ms=%.3f judder_percent=%.2f",
+               (unsigned long long)app->lastFrameId, app->frameRateController.currentSimulatedFrameRate,
+               app->frameRateController.frameRateMin, app->frameRateController.frameRateMax,
+               GetPresentModeName(GetPresentMode()), app->vrrEnabled ? "on" : "off",
+               (unsigned long long)summary.count, summary.mean * 1000.0, summary.p50 * 1000.0,
+               summary.p99 * 1000.0, summary.max * 1000.0, gpu.p50 * 1000.0,
+               smoothnessJudderScore(&app->smoothness));
+}
+
+static void controlTrace(Application *app, const struct ControlRequest *request)
+{
+  if (app->displayCount > 0) {
+    controlReply(&app->control, request, "error the trace follows the single display frame loop");
+    return;
+  }
+
+  if (request->argc == 3 && strcmp(request->argv[1], "start") == 0) {
+    if (traceIsEnabled(&app->trace)) {
+      controlReply(&app->control, request, "error trace to %s already running", app->trace.path);
+      return;
+    }
+
+    snprintf(app->controlTracePath, sizeof(app->controlTracePath), "%s", request->argv[2]);
+    if (!traceInitialize(&app->trace, app->controlTracePath, TRACE_MAX_FRAMES, app->lastFrameId + 1)) {
+      controlReply(&app->control, request, "error cannot allocate the trace");
+      return;
+    }
+    if (telemetryIsRunning(&app->telemetry)) {
+      traceAttachTelemetry(&app->trace, &app->telemetry);
+    }
+    controlReply(&app->control, request, "ok tracing from frame %llu", (unsigned long long)app->lastFrameId + 1);
+  } else if (request->argc == 2 && strcmp(request->argv[1], "stop") == 0) {
+    if (!traceIsEnabled(&app->trace)) {
+      controlReply(&app->control, request, "error no trace running");
+      return;
+    }
+
+    uint64_t frames = app->trace.count;
+    bool written = traceWrite(&app->trace);
+    traceFinalize(&app->trace);
+    if (written) {
+      controlReply(&app->control, request, "ok %llu frames", (unsigned long long)frames);
+    } else {
+      controlReply(&app->control, request, "error cannot write the trace");
+    }
+  } else {
+    controlReply(&app->control, request, "error expected trace start FILE or trace stop");
+  }
+}
+
+static void executeControlCommand(Application *app, const struct ControlRequest *request)
 {
-  updateClock(&app->clock);
-  computeNextFrameDelayMsec(&app->frameRateController, app->clock.currentTimeSec);
+  const char *command = request->argv[0];
+  const char *argument = request->argc > 1 ? request->argv[1] : "";
+
+  if (strcmp(command, "min") == 0 || strcmp(command, "max") == 0) {
+    setFrameRateLimit(app, request, strcmp(command, "max") == 0);
+  } else if (strcmp(command, "profile") == 0) {
+    setProfile(app, request);
+  } else if ((strcmp(command, "present-mode") == 0 || strcmp(command, "pattern") == 0) && app->displayCount > 0) {
+    /* The display threads render concurrently in multi display mode */
+    controlReply(&app->control, request, "error %s is single display only", command);
+  } else if (strcmp(command, "present-mode") == 0) {
+    VulkanPresentMode presentMode;
+    if (!scenarioParsePresentMode(argument, &presentMode)) {
+      controlReply(&app->control, request, "error unknown present mode '%s'", argument);
+    } else if (!SetPresentMode(presentMode)) {
+      controlReply(&app->control, request, "error cannot switch to %s", argument);
+    } else {
+      controlReply(&app->control, request, "ok %s", GetPresentModeName(GetPresentMode()));
+    }
+  } else if (strcmp(command, "pattern") == 0) {
+    VulkanPattern pattern;
+    if (!scenarioParsePattern(argument, &pattern)) {
+      controlReply(&app->control, request, "error unknown pattern '%s'", argument);
+    } else {
+      SetPattern(pattern);
+      controlReply(&app->control, request, "ok %s", GetPatternName(GetPattern()));
+    }
+  } else if (strcmp(command, "gsync") == 0) {
+    bool enable = strcmp(argument, "on") == 0;
+    if (!enable && strcmp(argument, "off") != 0) {
+      controlReply(&app->control, request, "error expected gsync on|off");
+    } else if (!vrrSetEnabled(&app->vrrController, enable)) {
+      controlReply(&app->control, request, "error the %s backend cannot change the VRR state",
+                   vrrBackendName(&app->vrrController));
+    } else {
+      app->vrrEnabled = vrrIsEnabled(&app->vrrController);
+      controlReply(&app->control, request, "ok %s", app->vrrEnabled ? "on" : "off");
+    }
+  } else if (strcmp(command, "stats") == 0) {
+    replyStats(app, request);
+  } else if (strcmp(command, "trace") == 0) {
+    controlTrace(app, request);
+  } else if (strcmp(command, "quit") == 0) {
+    controlReply(&app->control, request, "ok");
+    app->running = false;
+  } else if (strcmp(command, "help") == 0) {
+    controlReply(&app->control, request, "ok min RATE | max RATE | profile sine|ramp|constant | present-mode MODE | "
+                 "pattern PATTERN | gsync on|off | stats | trace start FILE | trace stop | quit");
+  } else {
+    controlReply(&app->control, request, "error unknown command '%s', try help", command);
+  }
+}
 
-  frameContext->frameDelay = app->frameRateController.nextFrameDelaySec;
-  frameContext->animationDurationSec = app->animationDurationSec;
+static void processControlCommands(Application *app)
+{
+  struct ControlRequest request;
+  while (controlReceive(&app->control, &request)) {
+    executeControlCommand(app, &request);
+  }
 }
 
 static void processEvents(Application* app)
 {
+  processControlCommands(app);
+
+  latencyCalibrate(&app->latencyTracker);
+
   SDL_Event event;
   while(SDL_PollEvent(&event))
     switch (event.type) {
       case SDL_QUIT:
         app->running = false;
       break;
+      case SDL_KEYDOWN:
+      case SDL_MOUSEBUTTONDOWN:
+        latencyAddEvent(&app->latencyTracker, event.common.timestamp);
+      break;
       case SDL_KEYUP:
-        printf("dupa\n");
-        if (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE
-            || event.key.keysym.scancode == SDL_SCANCODE_Q) {
+        switch (event.key.keysym.scancode) {
+        case SDL_SCANCODE_ESCAPE:
+        case SDL_SCANCODE_Q:
           app->running = false;
-          printf("Exit app!\n");
-        }
-        if (event.key.keysym.scancode == SDL_SCANCODE_PAGEUP) {
-
-        }
-        if (event.key.keysym.scancode == SDL_SCANCODE_PAGEDOWN) {
-
+          logInfo("Exit app!");
+          break;
+        case SDL_SCANCODE_P:
+          /* The display threads render concurrently in multi display mode */
+          if (app->displayCount == 0) {
+            SetPattern((GetPattern() + 1) % VULKAN_PATTERN_COUNT);
+          }
+          break;
+        default:
+          changeFrameRate(app, event.key.windowID, event.key.keysym.scancode);
+          break;
         }
       break;
       default:
+        if (latencyIsInjectedEvent(&app->latencyTracker, &event)) {
+          latencyAddEvent(&app->latencyTracker, event.common.timestamp);
+        }
         break;
     }
 }
 
-static void endFrame(Application *app, FrameContext *frameContext)
+static void collectPresentTimings(Application *app)
+{
+  /* Only fixed refresh presents land on vblanks */
+  bool fixedRefresh = GetPresentMode() == VULKAN_PRESENT_MODE_FIFO && !app->vrrEnabled;
+
+  PresentTiming timing;
+  while (PollPresentTiming(&timing)) {
+    /* Submitted before the scenario phase started, with its other settings */
+    bool previousPhase = timing.frameId < app->phaseFirstFrameId;
+
+    if (fixedRefresh && timing.presentTimeIsDisplayed && !previousPhase) {
+      refreshEstimatorPresented(&app->refreshEstimator, timing.presentTimeSec);
+    }
+
+    if (app->lastPresentTimeSec > 0.0 && !previousPhase) {
+      app->lastFrameIntervalSec = timing.presentTimeSec - app->lastPresentTimeSec;
+      statsSeriesAdd(&app->frameIntervalSec, app->lastFrameIntervalSec);
+    }
+    if (!previousPhase) {
+      app->lastPresentTimeSec = timing.presentTimeSec;
+    }
+
+    if (app->probingVrr) {
+      vrrProbePresented(&app->vrrProbe, &timing);
+    }
+
+    latencyFramePresented(&app->latencyTracker, &timing);
+    pacerFramePresented(&app->framePacer, &timing);
+    traceFramePresented(&app->trace, &timing);
+
+    struct SmoothnessSample sample;
+    if (!previousPhase && smoothnessFramePresented(&app->smoothness, &timing, &sample)) {
+      traceFrameSmoothness(&app->trace, timing.frameId, &sample);
+    }
+  }
+}
+
+static void printFrameStats(Application *app)
+{
+  if (app->displayCount > 0) {
+    for (uint32_t i = 0; i < app->displayCount; i++) {
+      displayPacerPrintReport(&app->displays[i]);
+    }
+    return;
+  }
+
+  struct SeriesSummary summary;
+  statsSeriesSummarize(&app->frameIntervalSec, &summary);
+
+  if (summary.count > 0) {
+    logInfo("Frame interval: n=%llu mean %.2f  p50 %.2f  p99 %.2f  max %.2f ms",
+           (unsigned long long)summary.count, summary.mean * 1000.0, summary.p50 * 1000.0,
+           summary.p99 * 1000.0, summary.max * 1000.0);
+  }
+  refreshEstimatorPrintReport(&app->refreshEstimator);
+
+  statsSeriesSummarize(&app->recordingSec, &summary);
+  if (summary.count > 0) {
+    logInfo("Command recording (%s): mean %.1f  p50 %.1f  p99 %.1f us",
+           app->options.vulkanConfig.prerecordedCommands ? "pre-recorded" : "per frame",
+           summary.mean * 1e6, summary.p50 * 1e6, summary.p99 * 1e6);
+  }
+
+  for (uint32_t i = 0; i < GetRecordThreadCount(); i++) {
+    statsSeriesSummarize(&app->threadRecordingSec[i], &summary);
+    if (summary.count > 0) {
+      logInfo("  thread %u: mean %.1f  p50 %.1f  p99 %.1f us",
+             i, summary.mean * 1e6, summary.p50 * 1e6, summary.p99 * 1e6);
+    }
+  }
+
+  statsSeriesSummarize(&app->gpuFrameSec, &summary);
+  if (summary.count > 0) {
+    logInfo("GPU frame: mean %.1f  p50 %.1f  p99 %.1f us", summary.mean * 1e6, summary.p50 * 1e6, summary.p99 * 1e6);
+  }
+
+  statsSeriesSummarize(&app->damageFraction, &summary);
+  if (summary.count > 0 && app->options.vulkanConfig.damageTracking) {
+    /* Clear (or load) and store of a 32 bit color attachment */
+    double fullFrameMB = 2.0 * 4.0 * app->windowWidth * app->windowHeight / 1e6;
+    logInfo("Damage: mean %.1f%% of the frame rendered, estimated %.1f of %.1f MB color traffic per frame saved",
+           summary.mean * 100.0, (1.0 - summary.mean) * fullFrameMB, fullFrameMB);
+  }
+
+  if (app->options.vulkanConfig.trackHostAllocations) {
+    logInfo("Vulkan host allocations in the frame path: %llu", (unsigned long long)GetFramePathHostAllocations());
+  }
+
+  if (app->options.vulkanConfig.captureDirectory != NULL) {
+    uint64_t written, dropped;
+    GetCaptureCounts(&written, &dropped);
+    logInfo("Frame capture: %llu written, %llu dropped", (unsigned long long)written, (unsigned long long)dropped);
+  }
+
+  statsSeriesSummarize(&app->wakeupLatenessSec, &summary);
+  if (summary.count > 0) {
+    char realtime[128];
+    realtimeDescribe(&app->options.realtime, realtime, sizeof(realtime));
+    logInfo("Wake-up lateness (%s): p50 %.1f  p99 %.1f  max %.1f us",
+           realtime, summary.p50 * 1e6, summary.p99 * 1e6, summary.max * 1e6);
+  }
+
+  struct TelemetrySample telemetry;
+  if (telemetryLatest(&app->telemetry, &telemetry)) {
+    logInfo("GPU (%s): %d MHz, memory %d MHz, %d%% busy, %d C", telemetrySourceName(&app->telemetry),
+            telemetry.graphicsClockMHz, telemetry.memoryClockMHz, telemetry.graphicsUtilization,
+            telemetry.temperatureC);
+  }
+
+  smoothnessPrintReport(&app->smoothness);
+  latencyPrintReport(&app->latencyTracker);
+
+  if (app->options.lowLatency) {
+    pacerPrintReport(&app->framePacer);
+  }
+}
+
+/* Busy CPU work standing for the game logic of a scenario phase */
+static void simulateLoad(Application *app)
+{
+  double loadSec = app->loadSec + app->loadJitterSec * rand_r(&app->loadSeed) / (double)RAND_MAX;
+  if (loadSec <= 0.0) {
+    return;
+  }
+
+  double endSec = clockNowSec() + loadSec;
+  while (clockNowSec() < endSec) {
+  }
+}
+
+static void renderFrame(Application *app)
+{
+  simulateLoad(app);
+
+  float position = (float)app->frameLoop.barPosition;
+
+  Update(position);
+  uint64_t frameId = Draw();
+  double submitTimeSec = clockNowSec();
+  app->lastFrameId = frameId;
+  app->phaseFrames++;
+  statsSeriesAdd(&app->recordingSec, GetRecordingDurationSec());
+  statsSeriesAdd(&app->damageFraction, GetDamageFraction());
+  for (uint32_t i = 0; i < GetRecordThreadCount(); i++) {
+    statsSeriesAdd(&app->threadRecordingSec[i], GetThreadRecordingDurationSec(i));
+  }
+
+  // NDC to pixels
+  double positionPx = position * app->windowWidth / 2.0;
+
+  latencyFrameSubmitted(&app->latencyTracker, frameId);
+  if (app->options.lowLatency) {
+    pacerFrameSubmitted(&app->framePacer, frameId, GetGpuFrameDurationSec());
+  }
+  smoothnessFrameSubmitted(&app->smoothness, frameId, positionPx);
+
+  traceFrameSubmitted(&app->trace, frameId, app->frameLoop.startTimeSec, app->frameLoop.frameDelaySec,
+                      submitTimeSec, positionPx);
+  /* The GPU time read back by Draw() is the one of the previous frame */
+  traceFrameGpu(&app->trace, frameId - 1, GetGpuFrameDurationSec());
+  if (GetGpuFrameDurationSec() > 0.0) {
+    statsSeriesAdd(&app->gpuFrameSec, GetGpuFrameDurationSec());
+  }
+}
+
+static void resetFrameStats(Application *app)
+{
+  statsSeriesReset(&app->frameIntervalSec);
+  statsSeriesReset(&app->recordingSec);
+  statsSeriesReset(&app->gpuFrameSec);
+  statsSeriesReset(&app->damageFraction);
+  statsSeriesReset(&app->wakeupLatenessSec);
+  for (uint32_t i = 0; i < GetRecordThreadCount(); i++) {
+    statsSeriesReset(&app->threadRecordingSec[i]);
+  }
+  smoothnessReset(&app->smoothness);
+  refreshEstimatorReset(&app->refreshEstimator);
+}
+
+/* Switches the display state in place, statistics restart with the phase */
+static void startPhase(Application *app, int phaseIndex)
+{
+  const struct ScenarioPhase *phase = &app->scenario.phases[phaseIndex];
+  struct FrameRateController *frameRateController = &app->frameRateController;
+
+  logInfo("Scenario phase %d/%d '%s': %.1f s", phaseIndex + 1, app->scenario.phaseCount, phase->name,
+          phase->durationSec);
+
+  frameRateController->frameRateMin = phase->frameRateMin > 0 ? phase->frameRateMin : app->defaultFrameRateMin;
+  frameRateController->frameRateMax = phase->frameRateMax > 0 ? phase->frameRateMax : app->defaultFrameRateMax;
+  frameRateController->profile = phase->profile;
+
+  SetPattern(phase->pattern);
+
+  /* Unchanged from the previous phase: the swapchain is kept */
+  if (phase->presentMode != GetPresentMode() && !SetPresentMode(phase->presentMode)) {
+    logError("Failed to switch to the %s present mode. Exiting app.", GetPresentModeName(phase->presentMode));
+    app->running = false;
+    return;
+  }
+
+  if (phase->gsync != SCENARIO_GSYNC_KEEP) {
+    vrrSetEnabled(&app->vrrController, phase->gsync == SCENARIO_GSYNC_ON);
+    app->vrrEnabled = vrrIsEnabled(&app->vrrController);
+  }
+
+  app->loadSec = phase->loadSec;
+  app->loadJitterSec = phase->loadJitterSec;
+
+  /* Frames of the previous phase still in flight are not part of this one:
+     what completed goes to the previous phase's statistics before they are
+     reset, timings arriving later are recognized by their frame id */
+  collectPresentTimings(app);
+  resetFrameStats(app);
+  app->lastPresentTimeSec = 0.0;
+  app->phaseFirstFrameId = app->lastFrameId + 1;
+
+  app->phaseIndex = phaseIndex;
+  app->phaseFrames = 0;
+  app->phaseStartTimeSec = clockNowSec();
+}
+
+static void finishPhase(Application *app)
+{
+  struct ScenarioPhaseResult *result = &app->scenario.results[app->phaseIndex];
+
+  result->frameRateMin = app->frameRateController.frameRateMin;
+  result->frameRateMax = app->frameRateController.frameRateMax;
+  result->presentMode = GetPresentMode();
+  result->gsyncEnabled = vrrIsEnabled(&app->vrrController);
+  result->frames = app->phaseFrames;
+  statsSeriesSummarize(&app->frameIntervalSec, &result->frameIntervalSec);
+  statsSeriesSummarize(&app->gpuFrameSec, &result->gpuFrameSec);
+  result->judderPercent = smoothnessJudderScore(&app->smoothness);
+  result->duplicated = app->smoothness.duplicated;
+  result->skipped = app->smoothness.skipped;
+  app->scenario.completedPhases = app->phaseIndex + 1;
+
+  printFrameStats(app);
+
+  if (app->phaseIndex + 1 < app->scenario.phaseCount) {
+    startPhase(app, app->phaseIndex + 1);
+  } else {
+    logInfo("Scenario completed");
+    app->running = false;
+  }
+}
+
+static void setConstantFrameRate(Application *app, int frameRate)
+{
+  app->frameRateController.frameRateMin = frameRate;
+  app->frameRateController.frameRateMax = frameRate;
+  app->frameRateController.profile = FRAME_RATE_PROFILE_CONSTANT;
+}
+
+/* The probe needs absolute frame deadlines: it runs in low latency mode, whose
+   targets do not drift by the frame's own duration */
+static void startVrrProbe(Application *app)
+{
+  struct VrrRange range = { 0.0, 0.0 };
+  vrrGetRange(&app->vrrController, &range);
+
+  if (!vrrProbeInitialize(&app->vrrProbe, app->options.vrrProbeStepHz,
+                          refreshRateHz(&app->refreshEstimator.nominal), &range)) {
+    logError("Failed to allocate the VRR probe. Exiting app.");
+    app->running = false;
+    return;
+  }
+
+  if (!vrrIsEnabled(&app->vrrController) && !vrrSetEnabled(&app->vrrController, true)) {
+    logWarning("Cannot enable VRR, probing the current state");
+  }
+  app->vrrEnabled = vrrIsEnabled(&app->vrrController);
+  app->options.lowLatency = SDL_TRUE;
+  app->frameLoop.pacer = &app->framePacer;
+
+  app->probingVrr = true;
+  setConstantFrameRate(app, vrrProbeFrameRate(&app->vrrProbe));
+  vrrProbeStart(&app->vrrProbe, clockNowSec());
+}
+
+static void finishVrrProbe(Application *app)
+{
+  const struct VrrProbeResult *result = &app->vrrProbe.result;
+
+  vrrProbePrintReport(&app->vrrProbe);
+  app->probingVrr = false;
+
+  if (!app->options.vrrProbeSeed) {
+    app->running = false;
+    return;
+  }
+
+  app->frameRateController.frameRateMin = app->defaultFrameRateMin;
+  app->frameRateController.frameRateMax = app->defaultFrameRateMax;
+  app->frameRateController.profile = FRAME_RATE_PROFILE_SINE;
+  if (result->windowMax > 0) {
+    app->frameRateController.frameRateMin = result->windowMin;
+    app->frameRateController.frameRateMax = result->windowMax;
+  }
+  logInfo("Frame rate range: %d-%d fps", app->frameRateController.frameRateMin,
+          app->frameRateController.frameRateMax);
+
+  resetFrameStats(app);
+  app->lastPresentTimeSec = 0.0;
+  app->lastStatsTimeSec = clockNowSec();
+}
+
+/* Adds the values common to both modes and publishes them */
+static void publishMetricsValues(Application *app, struct MetricsValues *values,
+                                 const struct FrameRateController *frameRateController)
+{
+  values->targetFrameRate = frameRateController->currentSimulatedFrameRate;
+  values->frameRateMin = frameRateController->frameRateMin;
+  values->frameRateMax = frameRateController->frameRateMax;
+  values->presentMode = GetPresentMode();
+  values->gsyncEnabled = app->vrrEnabled;
+  snprintf(values->presentModeName, sizeof(values->presentModeName), "%s", GetPresentModeName(GetPresentMode()));
+
+  const struct SeriesSummary *summary = &app->metricsIntervalSec;
+  values->intervalCount = summary->count;
+  values->intervalMeanSec = summary->mean;
+  values->intervalP50Sec = summary->p50;
+  values->intervalP90Sec = summary->p90;
+  values->intervalP99Sec = summary->p99;
+  values->intervalMaxSec = summary->max;
+
+  metricsPublish(&app->metrics, values);
+}
+
+/* Plain stores into the mapped segment, no system call */
+static void publishMetrics(Application *app)
+{
+  if (app->metrics.segment == NULL) {
+    return;
+  }
+
+  double nowSec = app->frameLoop.startTimeSec;
+  if (nowSec - app->metricsSummaryTimeSec >= METRICS_SUMMARY_INTERVAL_SEC) {
+    statsSeriesSummarize(&app->frameIntervalSec, &app->metricsIntervalSec);
+    app->metricsSummaryTimeSec = nowSec;
+  }
+
+  struct MetricsValues values = {};
+  values.frameId = app->lastFrameId;
+  values.timeSec = nowSec;
+  values.frameIntervalSec = app->lastFrameIntervalSec;
+
+  publishMetricsValues(app, &values, &app->frameRateController);
+}
+
+/* Multi display mode: the primary display's figures, from the main thread */
+static void publishDisplayMetrics(Application *app)
+{
+  if (app->metrics.segment == NULL) {
+    return;
+  }
+
+  struct DisplayPacer *display = &app->displays[0];
+  struct FrameRateController frameRateController;
+  struct MetricsValues values = {};
+  values.timeSec = clockNowSec();
+
+  displayPacerLock(display);
+  if (values.timeSec - app->metricsSummaryTimeSec >= METRICS_SUMMARY_INTERVAL_SEC) {
+    statsSeriesSummarize(&display->frameIntervalSec, &app->metricsIntervalSec);
+    app->metricsSummaryTimeSec = values.timeSec;
+  }
+  values.frameId = display->lastFrameId;
+  values.frameIntervalSec = display->lastFrameIntervalSec;
+  frameRateController = display->frameRateController;
+  displayPacerUnlock(display);
+
+  publishMetricsValues(app, &values, &frameRateController);
+}
+
+static void endFrame(Application *app)
+{
+  collectPresentTimings(app);
+  publishMetrics(app);
+
+  if (app->probingVrr) {
+    if (vrrProbeUpdate(&app->vrrProbe, clockNowSec())) {
+      if (vrrProbeIsDone(&app->vrrProbe)) {
+        finishVrrProbe(app);
+      } else {
+        setConstantFrameRate(app, vrrProbeFrameRate(&app->vrrProbe));
+      }
+    }
+  } else if (app->scenario.phaseCount > 0) {
+    if (app->frameLoop.startTimeSec - app->phaseStartTimeSec >= app->scenario.phases[app->phaseIndex].durationSec) {
+      finishPhase(app);
+    }
+  } else if (app->options.statsIntervalSec > 0.0
+             && app->frameLoop.startTimeSec - app->lastStatsTimeSec >= app->options.statsIntervalSec) {
+    printFrameStats(app);
+    resetFrameStats(app);
+    app->lastStatsTimeSec = app->frameLoop.startTimeSec;
+    /* Picks up changes made outside the demo */
+    app->vrrEnabled = vrrIsEnabled(&app->vrrController);
+  }
+
+  double wakeupLatenessSec;
+  if (frameLoopEnd(&app->frameLoop, &wakeupLatenessSec)) {
+    statsSeriesAdd(&app->wakeupLatenessSec, wakeupLatenessSec);
+  }
+}
+
+/* Multi display mode: the displays render on their own threads, the main
+   thread only handles events and statistics */
+#define DISPLAY_EVENT_POLL_SEC 0.005
+
+static void runDisplays(Application *app)
 {
-  struct timespec ts;
-  ts.tv_sec = 0;
-  ts.tv_nsec = frameContext->frameDelay * 1000000000L;
+  for (uint32_t i = 0; i < app->displayCount && app->running; i++) {
+    app->running = displayPacerStart(&app->displays[i]);
+  }
+
+  while (app->running) {
+    processEvents(app);
+    publishDisplayMetrics(app);
+
+    double nowSec = clockNowSec();
+    if (app->options.statsIntervalSec > 0.0 && nowSec - app->lastStatsTimeSec >= app->options.statsIntervalSec) {
+      printFrameStats(app);
+      for (uint32_t i = 0; i < app->displayCount; i++) {
+        displayPacerReset(&app->displays[i]);
+      }
+      app->lastStatsTimeSec = nowSec;
+    }
 
-  nanosleep(&ts, NULL);
+    clockSleepSec(DISPLAY_EVENT_POLL_SEC);
+  }
+
+  for (uint32_t i = 0; i < app->displayCount; i++) {
+    displayPacerStop(&app->displays[i]);
+  }
 }
 
 static void cleanupApplication(Application *app)
 {
+  latencyStopInjector(&app->latencyTracker);
+  for (uint32_t i = 0; i < app->displayCount; i++) {
+    displayPacerStop(&app->displays[i]);
+  }
+
+  /* The last presents, before the outputs and their timing queues are gone */
+  FinishPresentTimings();
+  collectPresentTimings(app);
   CleanupVulkan();
 
-  SDL_DestroyWindow(app->pWindowHandle);
+  if (app->scenario.phaseCount > 0) {
+    /* Phases cut short by a quit are left out */
+    scenarioWriteResults(&app->scenario, app->options.resultsPath);
+  } else {
+    printFrameStats(app);
+  }
+
+  latencyFinalize(&app->latencyTracker);
+  statsSeriesFinalize(&app->frameIntervalSec);
+  statsSeriesFinalize(&app->recordingSec);
+  statsSeriesFinalize(&app->gpuFrameSec);
+  statsSeriesFinalize(&app->damageFraction);
+  statsSeriesFinalize(&app->wakeupLatenessSec);
+  for (uint32_t i = 0; i < VULKAN_MAX_RECORD_THREADS; i++) {
+    statsSeriesFinalize(&app->threadRecordingSec[i]);
+  }
+  pacerFinalize(&app->framePacer);
+  smoothnessFinalize(&app->smoothness);
+  vrrProbeFinalize(&app->vrrProbe);
+  for (uint32_t i = 0; i < app->displayCount; i++) {
+    displayPacerFinalize(&app->displays[i]);
+  }
+
+  traceWrite(&app->trace);
+  traceFinalize(&app->trace);
+  telemetryFinalize(&app->telemetry);
+  metricsFinalize(&app->metrics);
+  controlFinalize(&app->control);
+
+  for (uint32_t i = 0; i < app->windowCount; i++) {
+    SDL_DestroyWindow(app->windows[i]);
+  }
   SDL_Quit();
 }
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
-  Application app;
-  FrameContext frameCtx;
+  Application app = {};
 
-  gsyncInitialize(&app.gsyncController);
+  if (!parseOptions(&app.options, argc, argv)) {
+    return 1;
+  }
+
+  if (app.options.listDisplays) {
+    return ListDisplays() ? 0 : 1;
+  }
+
+  logSetLevel(app.options.logLevel);
+  logInitialize();
+
+  if (app.options.scenarioPath != NULL) {
+    /* Unless a phase changes them, the command line settings stay in effect */
+    struct ScenarioPhase defaults = {
+      .profile = FRAME_RATE_PROFILE_SINE,
+      .presentMode = app.options.vulkanConfig.presentMode,
+      .gsync = SCENARIO_GSYNC_KEEP,
+      .pattern = app.options.vulkanConfig.pattern,
+    };
+    if (!scenarioLoad(&app.scenario, app.options.scenarioPath, &defaults)) {
+      logFinalize();
+      return 1;
+    }
+  }
+
+  vrrInitialize(&app.vrrController, app.options.vrrBackend, app.options.gsyncBackend);
 
   /* Force G-SYNC Visual Indicator
      For an unknown reason, we must do it twice to make it work...
      (the second call enables the first value) */
-  gsyncShowVisualIndicator(&app.gsyncController, true);
-  gsyncShowVisualIndicator(&app.gsyncController, true);
+  vrrShowIndicator(&app.vrrController, true);
+  vrrShowIndicator(&app.vrrController, true);
 
   initializeApplication(&app);
 
+  if (app.running) {
+    /* After initialization: only the frame loop (and the display threads) run with it */
+    if (app.displayCount > 0 && app.options.realtime.cpu != REALTIME_CPU_NONE) {
+      logWarning("The display threads would share the pinned CPU, ignoring --cpu");
+      app.options.realtime.cpu = REALTIME_CPU_NONE;
+    }
+    realtimeApply(&app.options.realtime);
+  }
+
+  if (app.displayCount > 0) {
+    runDisplays(&app);
+  }
+
+  if (app.running && app.scenario.phaseCount > 0) {
+    startPhase(&app, 0);
+  }
+
+  if (app.running && app.options.vrrProbeStepHz > 0) {
+    startVrrProbe(&app);
+  }
+
   while(app.running) {
-    beginFrame(&app, &frameCtx);
+    beginFrame(&app);
     processEvents(&app);
 
-    Update(computeVerticalBarXPosition(&app, &frameCtx));
-    Draw();
-    endFrame(&app, &frameCtx);
+    renderFrame(&app);
+    endFrame(&app);
   }
 
-  gsyncFinalize(&app.gsyncController);
+  vrrFinalize(&app.vrrController);
 
   cleanupApplication(&app);
 
+  logFinalize();
+
   return 0;
 }
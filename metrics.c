@@ -0,0 +1,155 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "clock.h"
+#include "log.h"
+#include "metrics.h"
+
+int metricsInitialize(struct MetricsPublisher *publisher, const char *name)
+{
+  memset(publisher, 0, sizeof(*publisher));
+
+  if (name == NULL) {
+    return 1;
+  }
+
+  /* Exclusive: two demos sharing a segment would interleave their values */
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0 && errno == EEXIST) {
+    logError("Shared memory segment '%s' already exists: another demo publishes there, "
+             "or a crashed one left it (remove /dev/shm%s)", name, name);
+    return 0;
+  }
+  if (fd < 0) {
+    logError("Cannot create shared memory segment '%s': %s", name, strerror(errno));
+    return 0;
+  }
+
+  if (ftruncate(fd, sizeof(struct MetricsSegment)) != 0) {
+    logError("Cannot size shared memory segment '%s': %s", name, strerror(errno));
+    close(fd);
+    shm_unlink(name);
+    return 0;
+  }
+
+  void *segment = mmap(NULL, sizeof(struct MetricsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED) {
+    logError("Cannot map shared memory segment '%s': %s", name, strerror(errno));
+    shm_unlink(name);
+    return 0;
+  }
+
+  publisher->name = name;
+  publisher->segment = segment;
+
+  /* Touched now, so the first publish does not page fault */
+  memset(segment, 0, sizeof(struct MetricsSegment));
+  publisher->segment->version = METRICS_VERSION;
+  atomic_store(&publisher->segment->sequence, 0);
+  /* Last, readers check it before anything else */
+  atomic_thread_fence(memory_order_release);
+  publisher->segment->magic = METRICS_MAGIC;
+
+  logInfo("Live metrics published in shared memory segment %s", name);
+
+  return 1;
+}
+
+void metricsFinalize(struct MetricsPublisher *publisher)
+{
+  if (publisher->segment == NULL) {
+    return;
+  }
+
+  munmap(publisher->segment, sizeof(struct MetricsSegment));
+  shm_unlink(publisher->name);
+  publisher->segment = NULL;
+}
+
+void metricsPublish(struct MetricsPublisher *publisher, const struct MetricsValues *values)
+{
+  struct MetricsSegment *segment = publisher->segment;
+  if (segment == NULL) {
+    return;
+  }
+
+  uint32_t sequence = atomic_load_explicit(&segment->sequence, memory_order_relaxed);
+
+  /* Odd while the values are written */
+  atomic_store_explicit(&segment->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  segment->values = *values;
+
+  atomic_store_explicit(&segment->sequence, sequence + 2, memory_order_release);
+}
+
+struct MetricsSegment *metricsOpen(const char *name)
+{
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(struct MetricsSegment)) {
+    close(fd);
+    return NULL;
+  }
+
+  struct MetricsSegment *segment = mmap(NULL, sizeof(struct MetricsSegment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED) {
+    return NULL;
+  }
+
+  if (segment->magic != METRICS_MAGIC || segment->version != METRICS_VERSION) {
+    munmap(segment, sizeof(struct MetricsSegment));
+    return NULL;
+  }
+
+  return segment;
+}
+
+void metricsClose(struct MetricsSegment *segment)
+{
+  munmap(segment, sizeof(struct MetricsSegment));
+}
+
+bool metricsRead(struct MetricsSegment *segment, struct MetricsValues *values, uint32_t *sequence)
+{
+  double deadlineSec = 0.0;
+
+  for (;;) {
+    uint32_t before = atomic_load_explicit(&segment->sequence, memory_order_acquire);
+    if (!(before & 1)) {
+      memcpy(values, (const void *)&segment->values, sizeof(*values));
+
+      atomic_thread_fence(memory_order_acquire);
+      uint32_t after = atomic_load_explicit(&segment->sequence, memory_order_relaxed);
+      if (before == after) {
+        *sequence = before;
+        return true;
+      }
+    }
+
+    /* The writer may be preempted in the middle of an update, let it run */
+    double nowSec = clockNowSec();
+    if (deadlineSec == 0.0) {
+      deadlineSec = nowSec + METRICS_READ_TIMEOUT_SEC;
+    } else if (nowSec >= deadlineSec) {
+      return false;
+    }
+    sched_yield();
+  }
+}
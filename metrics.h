@@ -0,0 +1,77 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define METRICS_DEFAULT_NAME "/vk-gsync-demo"
+#define METRICS_MAGIC        0x314d4756 /* "VGM1" */
+#define METRICS_VERSION      1
+
+/* A write takes well under a microsecond, a sequence odd for this long even
+   with the writer preempted in the middle means a dead writer */
+#define METRICS_READ_TIMEOUT_SEC 0.1
+
+/* Fixed size types only, the layout is shared with the reader process */
+struct MetricsValues
+{
+  uint64_t frameId;
+  double timeSec;              /* clockNowSec() of the update */
+
+  double frameIntervalSec;     /* Last present to present interval */
+  double targetFrameRate;      /* Simulated by the FrameRateController */
+  int32_t frameRateMin;
+  int32_t frameRateMax;
+  int32_t presentMode;         /* VulkanPresentMode */
+  int32_t gsyncEnabled;
+  char presentModeName[16];
+
+  /* Present intervals of the current statistics window, refreshed a few times per second */
+  uint64_t intervalCount;
+  double intervalMeanSec;
+  double intervalP50Sec;
+  double intervalP90Sec;
+  double intervalP99Sec;
+  double intervalMaxSec;
+};
+
+/*
+ * Live metrics segment, written by the frame loop and read by other
+ * processes (vk-gsync-monitor). Guarded by a seqlock: the writer makes the
+ * sequence odd, stores the values and makes it even again, readers retry
+ * until they copied the values between two reads of the same even sequence.
+ * The writer never waits and, once the segment is mapped, makes no system
+ * call.
+ */
+struct MetricsSegment
+{
+  uint32_t magic;
+  uint32_t version;
+  _Atomic uint32_t sequence;
+  uint32_t reserved;
+  struct MetricsValues values;
+};
+
+struct MetricsPublisher
+{
+  const char *name;
+  struct MetricsSegment *segment;
+};
+
+/* A NULL name disables publishing, metricsPublish() is then a no-op. Fails
+   when the segment exists: another demo publishes there, or a crashed one left it. */
+int metricsInitialize(struct MetricsPublisher *publisher, const char *name);
+/* Unmaps and unlinks the segment */
+void metricsFinalize(struct MetricsPublisher *publisher);
+void metricsPublish(struct MetricsPublisher *publisher, const struct MetricsValues *values);
+
+/* Reader side, NULL when the segment does not exist or has another layout */
+struct MetricsSegment *metricsOpen(const char *name);
+void metricsClose(struct MetricsSegment *segment);
+/* Consistent copy of the values and the sequence they were read at. False
+   when none was found within METRICS_READ_TIMEOUT_SEC: the writer died in the
+   middle of an update, the segment is torn and will stay so. */
+bool metricsRead(struct MetricsSegment *segment, struct MetricsValues *values, uint32_t *sequence);
+
+#endif /* __METRICS_H__ */
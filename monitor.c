@@ -0,0 +1,131 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "metrics.h"
+
+/**
+ * Live metrics reader
+ *
+ * Prints the values the demo publishes with --metrics, once or every
+ * interval with --follow. Reading never blocks the demo: the segment is
+ * mapped read-only and copied under its seqlock.
+ */
+
+struct MonitorOptions
+{
+  const char *name;
+  double followIntervalSec;    /* 0 prints once */
+};
+
+static void printUsage(const char *programName)
+{
+  printf("Usage: %s [options]\n"
+         "  --name=NAME         shared memory segment (default " METRICS_DEFAULT_NAME ")\n"
+         "  --follow[=MS]       print a line every MS milliseconds (default 500) until interrupted\n"
+         "  --help              show this message\n",
+         programName);
+}
+
+static bool parseOptions(struct MonitorOptions *options, int argc, char **argv)
+{
+  enum {
+    OPTION_NAME = 256,
+    OPTION_FOLLOW,
+    OPTION_HELP,
+  };
+
+  static const struct option longOptions[] = {
+    { "name",   required_argument, NULL, OPTION_NAME },
+    { "follow", optional_argument, NULL, OPTION_FOLLOW },
+    { "help",   no_argument,       NULL, OPTION_HELP },
+    { NULL, 0, NULL, 0 }
+  };
+
+  memset(options, 0, sizeof(*options));
+  options->name = METRICS_DEFAULT_NAME;
+
+  int option;
+  while ((option = getopt_long(argc, argv, "", longOptions, NULL)) != -1) {
+    switch (option) {
+    case OPTION_NAME: options->name = optarg; break;
+    case OPTION_FOLLOW:
+      options->followIntervalSec = (optarg ? atof(optarg) : 500.0) / 1000.0;
+      if (options->followIntervalSec <= 0.0) {
+        fprintf(stderr, "Invalid interval '%s'\n", optarg);
+        return false;
+      }
+      break;
+    case OPTION_HELP:
+    default:
+      printUsage(argv[0]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void printValues(const struct MetricsValues *values)
+{
+  printf("frame %llu  interval %.2f ms  target %.1f fps (%d-%d)  %s  G-SYNC %s  "
+         "n=%llu mean %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n",
+         (unsigned long long)values->frameId, values->frameIntervalSec * 1000.0, values->targetFrameRate,
+         values->frameRateMin, values->frameRateMax, values->presentModeName,
+         values->gsyncEnabled ? "on" : "off", (unsigned long long)values->intervalCount,
+         values->intervalMeanSec * 1000.0, values->intervalP50Sec * 1000.0, values->intervalP90Sec * 1000.0,
+         values->intervalP99Sec * 1000.0, values->intervalMaxSec * 1000.0);
+  fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+  struct MonitorOptions options;
+
+  if (!parseOptions(&options, argc, argv)) {
+    return 1;
+  }
+
+  struct MetricsSegment *segment = metricsOpen(options.name);
+  if (segment == NULL) {
+    fprintf(stderr, "No metrics segment '%s', is the demo running with --metrics?\n", options.name);
+    return 1;
+  }
+
+  struct MetricsValues values;
+  uint32_t lastSequence;
+  if (!metricsRead(segment, &values, &lastSequence)) {
+    fprintf(stderr, "Metrics segment '%s' is torn, the demo stopped in the middle of an update\n", options.name);
+    metricsClose(segment);
+    return 1;
+  }
+  printValues(&values);
+
+  while (options.followIntervalSec > 0.0) {
+    clockSleepSec(options.followIntervalSec);
+
+    uint32_t sequence;
+    if (!metricsRead(segment, &values, &sequence)) {
+      fprintf(stderr, "Metrics segment '%s' is torn, the demo stopped in the middle of an update\n", options.name);
+      metricsClose(segment);
+      return 1;
+    }
+
+    /* Same sequence: the demo did not render a frame since */
+    if (sequence != lastSequence) {
+      printValues(&values);
+      lastSequence = sequence;
+    }
+  }
+
+  metricsClose(segment);
+
+  return 0;
+}
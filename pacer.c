@@ -0,0 +1,136 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "clock.h"
+#include "log.h"
+#include "pacer.h"
+
+#define PACER_MIN_MARGIN_SEC     0.0005
+#define PACER_MAX_MARGIN_SEC     0.008
+#define PACER_MARGIN_DECAY       0.98
+/* Presents within this distance of the target still count as on time */
+#define PACER_MISS_TOLERANCE_SEC 0.0002
+/* Fraction of a refresh period within which an interval is snapped to the vblank grid */
+#define PACER_REFRESH_SNAP       0.02
+
+static double predictedPercentile(struct SampleSeries *series)
+{
+  struct SeriesSummary summary;
+  statsSeriesSummarize(series, &summary);
+
+  return summary.p90;
+}
+
+static double predictedFrameDuration(struct FramePacer *pacer)
+{
+  double cpuSec = predictedPercentile(&pacer->cpuSec);
+  double gpuSec = predictedPercentile(&pacer->gpuSec);
+  double submitToPresentSec = predictedPercentile(&pacer->submitToPresentSec);
+
+  /* Submit to present includes the GPU work when measured with present wait,
+     the GPU time covers the case where present returns before the GPU is done */
+  return cpuSec + (submitToPresentSec > gpuSec ? submitToPresentSec : gpuSec);
+}
+
+int pacerInitialize(struct FramePacer *pacer)
+{
+  memset(pacer, 0, sizeof(*pacer));
+
+  if (!statsSeriesInitialize(&pacer->cpuSec, PACER_HISTORY_SIZE)
+      || !statsSeriesInitialize(&pacer->gpuSec, PACER_HISTORY_SIZE)
+      || !statsSeriesInitialize(&pacer->submitToPresentSec, PACER_HISTORY_SIZE)) {
+    pacerFinalize(pacer);
+    return 0;
+  }
+
+  pacer->marginSec = PACER_MIN_MARGIN_SEC;
+  return 1;
+}
+
+void pacerFinalize(struct FramePacer *pacer)
+{
+  statsSeriesFinalize(&pacer->cpuSec);
+  statsSeriesFinalize(&pacer->gpuSec);
+  statsSeriesFinalize(&pacer->submitToPresentSec);
+}
+
+void pacerSetRefreshPeriod(struct FramePacer *pacer, double refreshPeriodSec)
+{
+  pacer->refreshPeriodSec = refreshPeriodSec;
+}
+
+void pacerWaitForFrameStart(struct FramePacer *pacer, double frameIntervalSec)
+{
+  if (pacer->refreshPeriodSec > 0.0) {
+    double vblanks = round(frameIntervalSec / pacer->refreshPeriodSec);
+    if (vblanks >= 1.0 && fabs(frameIntervalSec - vblanks * pacer->refreshPeriodSec)
+                          < PACER_REFRESH_SNAP * pacer->refreshPeriodSec) {
+      frameIntervalSec = vblanks * pacer->refreshPeriodSec;
+    }
+  }
+
+  double nowSec = clockNowSec();
+  double durationSec = predictedFrameDuration(pacer) + pacer->marginSec;
+
+  double targetSec = pacer->nextTargetTimeSec + frameIntervalSec;
+
+  /* First frame or fell behind: restart the cadence from the earliest reachable target */
+  if (pacer->nextTargetTimeSec == 0.0 || targetSec - durationSec < nowSec) {
+    targetSec = nowSec + durationSec;
+  }
+
+  clockSleepUntilSec(targetSec - durationSec);
+
+  pacer->nextTargetTimeSec = targetSec;
+  pacer->frameStartTimeSec = clockNowSec();
+}
+
+void pacerFrameSubmitted(struct FramePacer *pacer, uint64_t frameId, double gpuDurationSec)
+{
+  struct PacerFrame *frame = &pacer->frames[frameId % PACER_HISTORY_SIZE];
+
+  frame->frameId = frameId;
+  frame->startTimeSec = pacer->frameStartTimeSec;
+  frame->targetTimeSec = pacer->nextTargetTimeSec;
+
+  statsSeriesAdd(&pacer->cpuSec, clockNowSec() - pacer->frameStartTimeSec);
+  if (gpuDurationSec > 0.0) {
+    statsSeriesAdd(&pacer->gpuSec, gpuDurationSec);
+  }
+}
+
+void pacerFramePresented(struct FramePacer *pacer, const PresentTiming *timing)
+{
+  struct PacerFrame *frame = &pacer->frames[timing->frameId % PACER_HISTORY_SIZE];
+  if (frame->frameId != timing->frameId) {
+    return;
+  }
+
+  statsSeriesAdd(&pacer->submitToPresentSec, timing->presentTimeSec - timing->submitTimeSec);
+
+  if (timing->presentTimeSec > frame->targetTimeSec + PACER_MISS_TOLERANCE_SEC) {
+    pacer->misses++;
+    pacer->marginSec *= 2.0;
+    if (pacer->marginSec > PACER_MAX_MARGIN_SEC) {
+      pacer->marginSec = PACER_MAX_MARGIN_SEC;
+    }
+  } else {
+    pacer->hits++;
+    pacer->marginSec *= PACER_MARGIN_DECAY;
+    if (pacer->marginSec < PACER_MIN_MARGIN_SEC) {
+      pacer->marginSec = PACER_MIN_MARGIN_SEC;
+    }
+  }
+}
+
+void pacerPrintReport(struct FramePacer *pacer)
+{
+  logInfo("Frame pacing: %llu on time, %llu late, margin %.2f ms, predicted cpu %.2f gpu %.2f submit to present %.2f ms",
+          (unsigned long long)pacer->hits, (unsigned long long)pacer->misses, pacer->marginSec * 1000.0,
+          predictedPercentile(&pacer->cpuSec) * 1000.0, predictedPercentile(&pacer->gpuSec) * 1000.0,
+          predictedPercentile(&pacer->submitToPresentSec) * 1000.0);
+}
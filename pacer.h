@@ -0,0 +1,61 @@
+#ifndef __PACER_H__
+#define __PACER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stats.h"
+#include "vulkan.h"
+
+#define PACER_HISTORY_SIZE 64
+
+struct PacerFrame
+{
+  uint64_t frameId;
+  double startTimeSec;
+  double targetTimeSec;
+};
+
+/*
+ * Just-in-time frame start. Instead of rendering right away and sleeping
+ * afterwards (the frame then waits in the queue for the whole sleep), the
+ * pacer sleeps until the latest time the frame can start and still reach the
+ * display by its target time:
+ *
+ *   start = target - (predicted CPU + predicted submit to present) - margin
+ *
+ * Predictions are the 90th percentiles of the recent frames. The safety
+ * margin doubles on every missed target and decays slowly on hits.
+ */
+struct FramePacer
+{
+  double marginSec;
+  double nextTargetTimeSec;
+  double frameStartTimeSec;
+
+  struct SampleSeries cpuSec;            /* Frame start to submit */
+  struct SampleSeries gpuSec;            /* Timestamp queries */
+  struct SampleSeries submitToPresentSec;
+
+  struct PacerFrame frames[PACER_HISTORY_SIZE];
+
+  /* Intervals within a few percent of a whole number of refresh periods are
+     snapped to it, so the targets stay on the vblank grid. 0 disables. */
+  double refreshPeriodSec;
+
+  uint64_t hits;
+  uint64_t misses;
+};
+
+int pacerInitialize(struct FramePacer *pacer);
+void pacerFinalize(struct FramePacer *pacer);
+void pacerSetRefreshPeriod(struct FramePacer *pacer, double refreshPeriodSec);
+
+/* Sleeps until the latest safe start of the frame due frameIntervalSec after the previous one */
+void pacerWaitForFrameStart(struct FramePacer *pacer, double frameIntervalSec);
+void pacerFrameSubmitted(struct FramePacer *pacer, uint64_t frameId, double gpuDurationSec);
+void pacerFramePresented(struct FramePacer *pacer, const PresentTiming *timing);
+
+void pacerPrintReport(struct FramePacer *pacer);
+
+#endif /* __PACER_H__ */
@@ -0,0 +1,305 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "frameloop.h"
+#include "pacer.h"
+#include "pacesim.h"
+#include "smoothness.h"
+
+/* Not 0, the pacer takes a zero target time for "no previous frame" */
+#define PACE_SIM_START_SEC        1.0
+#define PACE_SIM_WIDTH_PX         2560.0
+#define PACE_SIM_ANIMATION_SEC    5.0
+#define PACE_SIM_HISTORY_SIZE     64
+#define PACE_SIM_MAX_IMAGES       8
+
+/* Indexed by PaceSimDisplayType */
+static const char *g_displayNames[] = { "fixed", "vrr", "immediate" };
+
+struct SimFrame
+{
+  uint64_t frameId;
+  double startSec;
+  double intervalSec;          /* Requested time since the previous frame */
+};
+
+struct SimDisplay
+{
+  enum PaceSimDisplayType type;
+  double refreshPeriodSec;
+  double minPeriodSec;         /* At the max refresh rate */
+  double maxPeriodSec;         /* At the min refresh rate, the panel repeats the frame after it */
+  double lastScanoutSec;
+};
+
+struct Simulation
+{
+  const struct PaceSimConfig *config;
+  struct SimulatedClock clock;
+  unsigned int seed;
+
+  struct FrameRateController frameRateController;
+  struct FramePacer pacer;
+  struct FrameLoop loop;
+  struct SmoothnessAnalyzer smoothness;
+  struct SimDisplay display;
+
+  struct SimFrame frames[PACE_SIM_HISTORY_SIZE];
+  /* Presents not seen yet by the loop, in frame order */
+  PresentTiming pending[PACE_SIM_HISTORY_SIZE];
+  uint64_t pendingHead;
+  uint64_t pendingTail;
+  double lastPresentSec;
+
+  double gpuDoneSec;
+  double gpuDurationSec;
+  double presentSec[PACE_SIM_MAX_IMAGES];
+
+  struct SampleSeries cadenceErrorSec;
+  struct SampleSeries latencySec;
+  struct SampleSeries wakeupLatenessSec;
+};
+
+/* Start of the scanout of a frame ready to flip at readySec */
+static double scanout(struct SimDisplay *display, double readySec)
+{
+  double lastSec = display->lastScanoutSec;
+  double scanoutSec = readySec;
+
+  switch (display->type) {
+  case PACE_SIM_DISPLAY_FIXED:
+    scanoutSec = ceil(readySec / display->refreshPeriodSec) * display->refreshPeriodSec;
+    /* One frame per vblank, the queued ones take the following ones */
+    if (lastSec > 0.0 && scanoutSec < lastSec + 0.5 * display->refreshPeriodSec) {
+      scanoutSec = lastSec + display->refreshPeriodSec;
+    }
+    break;
+  case PACE_SIM_DISPLAY_VRR:
+    if (lastSec == 0.0) {
+      break;
+    }
+    if (readySec < lastSec + display->minPeriodSec) {
+      scanoutSec = lastSec + display->minPeriodSec;
+    } else if (readySec > lastSec + display->maxPeriodSec) {
+      /* Low framerate compensation: the panel rescanned the last frame every max period,
+         a frame ready during a rescan waits for its end */
+      double repeatSec = lastSec + floor((readySec - lastSec) / display->maxPeriodSec) * display->maxPeriodSec;
+      if (readySec < repeatSec + display->minPeriodSec) {
+        scanoutSec = repeatSec + display->minPeriodSec;
+      }
+    }
+    break;
+  case PACE_SIM_DISPLAY_IMMEDIATE:
+    break;
+  }
+
+  display->lastScanoutSec = scanoutSec;
+  return scanoutSec;
+}
+
+/* The frame loop's present timing collection: presents on screen by now, in order */
+static void collectPresents(struct Simulation *sim)
+{
+  double nowSec = clockNowSec();
+
+  while (sim->pendingTail < sim->pendingHead
+         && sim->pending[sim->pendingTail % PACE_SIM_HISTORY_SIZE].presentTimeSec <= nowSec) {
+    const PresentTiming *timing = &sim->pending[sim->pendingTail % PACE_SIM_HISTORY_SIZE];
+    const struct SimFrame *frame = &sim->frames[timing->frameId % PACE_SIM_HISTORY_SIZE];
+    sim->pendingTail++;
+
+    if (sim->config->lowLatency) {
+      pacerFramePresented(&sim->pacer, timing);
+    }
+
+    struct SmoothnessSample sample;
+    smoothnessFramePresented(&sim->smoothness, timing, &sample);
+
+    if (sim->lastPresentSec > 0.0) {
+      statsSeriesAdd(&sim->cadenceErrorSec, fabs(timing->presentTimeSec - sim->lastPresentSec - frame->intervalSec));
+    }
+    statsSeriesAdd(&sim->latencySec, timing->presentTimeSec - frame->startSec);
+    sim->lastPresentSec = timing->presentTimeSec;
+  }
+}
+
+/* Draw(): waits for the previous frame and a swapchain image, submits, presents */
+static uint64_t draw(struct Simulation *sim, uint64_t frameId)
+{
+  const struct PaceSimConfig *config = sim->config;
+
+  /* The image of frame N - images is released once frame N - images + 1 is on screen */
+  double imageFreeSec = sim->presentSec[(frameId + 1) % config->swapchainImages];
+  double waitSec = sim->gpuDoneSec > imageFreeSec ? sim->gpuDoneSec : imageFreeSec;
+  simClockAdvance(&sim->clock, waitSec - clockNowSec());
+
+  /* The GPU time Draw() reads back is the previous frame's */
+  double previousGpuDurationSec = sim->gpuDurationSec;
+  double submitSec = clockNowSec();
+
+  sim->gpuDurationSec = simDistributionSample(&config->gpuTime, &sim->seed);
+  sim->gpuDoneSec = submitSec + sim->gpuDurationSec;
+  double readySec = sim->gpuDoneSec + simDistributionSample(&config->presentLatency, &sim->seed);
+
+  PresentTiming *timing = &sim->pending[sim->pendingHead++ % PACE_SIM_HISTORY_SIZE];
+  timing->frameId = frameId;
+  timing->submitTimeSec = submitSec;
+  timing->presentTimeSec = scanout(&sim->display, readySec);
+  timing->presentTimeIsDisplayed = SDL_TRUE;
+  sim->presentSec[frameId % config->swapchainImages] = timing->presentTimeSec;
+
+  if (config->lowLatency) {
+    pacerFrameSubmitted(&sim->pacer, frameId, previousGpuDurationSec);
+  }
+
+  return frameId;
+}
+
+static void runFrames(struct Simulation *sim)
+{
+  const struct PaceSimConfig *config = sim->config;
+  struct FrameLoop *loop = &sim->loop;
+
+  double endSec = PACE_SIM_START_SEC + config->durationSec;
+
+  for (uint64_t frameId = 1; clockNowSec() < endSec; frameId++) {
+    /* beginFrame() */
+    frameLoopBegin(loop);
+
+    struct SimFrame *frame = &sim->frames[frameId % PACE_SIM_HISTORY_SIZE];
+    frame->frameId = frameId;
+    frame->startSec = loop->startTimeSec;
+    frame->intervalSec = loop->intervalSec;
+
+    /* renderFrame() */
+    simClockAdvance(&sim->clock, simDistributionSample(&config->cpuTime, &sim->seed));
+
+    draw(sim, frameId);
+    smoothnessFrameSubmitted(&sim->smoothness, frameId, loop->barPosition);
+
+    /* endFrame() */
+    collectPresents(sim);
+
+    double wakeupLatenessSec;
+    if (frameLoopEnd(loop, &wakeupLatenessSec)) {
+      statsSeriesAdd(&sim->wakeupLatenessSec, wakeupLatenessSec);
+    }
+  }
+}
+
+static bool initializeSimulation(struct Simulation *sim, const struct PaceSimConfig *config)
+{
+  memset(sim, 0, sizeof(*sim));
+  sim->config = config;
+  sim->seed = config->seed;
+
+  /* Own stream for the wake-ups, so changing the render times does not shift them */
+  simClockInitialize(&sim->clock, PACE_SIM_START_SEC, &config->wakeupLatency, config->seed * 2654435761u);
+
+  initializeFrameRateController(&sim->frameRateController, config->refreshRateHz);
+  sim->frameRateController.profile = config->profile;
+  if (config->frameRateMin > 0) {
+    sim->frameRateController.frameRateMin = config->frameRateMin;
+  }
+  if (config->frameRateMax > 0) {
+    sim->frameRateController.frameRateMax = config->frameRateMax;
+  }
+
+  sim->display.type = config->display;
+  sim->display.refreshPeriodSec = 1.0 / config->refreshRateHz;
+  sim->display.minPeriodSec = 1.0 / (config->vrrMaxHz > 0.0 ? config->vrrMaxHz : config->refreshRateHz);
+  sim->display.maxPeriodSec = 1.0 / config->vrrMinHz;
+
+  if (!pacerInitialize(&sim->pacer)) {
+    return false;
+  }
+  if (config->display != PACE_SIM_DISPLAY_IMMEDIATE) {
+    pacerSetRefreshPeriod(&sim->pacer, sim->display.refreshPeriodSec);
+  }
+  frameLoopInitialize(&sim->loop, &sim->frameRateController, config->lowLatency ? &sim->pacer : NULL,
+                      PACE_SIM_WIDTH_PX, PACE_SIM_ANIMATION_SEC);
+
+  return smoothnessInitialize(&sim->smoothness, PACE_SIM_WIDTH_PX / PACE_SIM_ANIMATION_SEC, PACE_SIM_WIDTH_PX)
+    && statsSeriesInitialize(&sim->cadenceErrorSec, PACE_SIM_SERIES_SIZE)
+    && statsSeriesInitialize(&sim->latencySec, PACE_SIM_SERIES_SIZE)
+    && statsSeriesInitialize(&sim->wakeupLatenessSec, PACE_SIM_SERIES_SIZE);
+}
+
+static void finalizeSimulation(struct Simulation *sim)
+{
+  pacerFinalize(&sim->pacer);
+  smoothnessFinalize(&sim->smoothness);
+  statsSeriesFinalize(&sim->cadenceErrorSec);
+  statsSeriesFinalize(&sim->latencySec);
+  statsSeriesFinalize(&sim->wakeupLatenessSec);
+}
+
+void paceSimDefaults(struct PaceSimConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+
+  config->durationSec = 3600.0;
+  config->seed = 1;
+  config->profile = FRAME_RATE_PROFILE_SINE;
+  config->display = PACE_SIM_DISPLAY_VRR;
+  config->refreshRateHz = 144.0;
+  config->vrrMinHz = 48.0;
+  config->swapchainImages = 3;
+
+  config->cpuTime = (struct SimDistribution){ SIM_DISTRIBUTION_NORMAL, 0.002, 0.0005 };
+  config->gpuTime = (struct SimDistribution){ SIM_DISTRIBUTION_NORMAL, 0.003, 0.001 };
+  config->presentLatency = (struct SimDistribution){ SIM_DISTRIBUTION_EXPONENTIAL, 0.0002, 0.0003 };
+  config->wakeupLatency = (struct SimDistribution){ SIM_DISTRIBUTION_EXPONENTIAL, 0.00005, 0.00005 };
+}
+
+bool paceSimRun(const struct PaceSimConfig *config, struct PaceSimResult *result)
+{
+  /* Zeroed, finalizing it is safe whatever initialization did */
+  struct Simulation *sim = calloc(1, sizeof(*sim));
+  if (sim == NULL) {
+    return false;
+  }
+
+  memset(result, 0, sizeof(*result));
+
+  bool success = config->swapchainImages >= 2 && config->swapchainImages <= PACE_SIM_MAX_IMAGES
+    && initializeSimulation(sim, config);
+
+  if (success) {
+    double wallStartSec = clockNowSec();
+
+    clockSetSource(&sim->clock.source);
+    runFrames(sim);
+    clockSetSource(NULL);
+
+    result->wallSec = clockNowSec() - wallStartSec;
+    result->simulatedSec = sim->clock.nowSec - PACE_SIM_START_SEC;
+    result->frames = sim->pendingHead;
+
+    statsSeriesSummarize(&sim->cadenceErrorSec, &result->cadenceErrorSec);
+    statsSeriesSummarize(&sim->latencySec, &result->latencySec);
+    statsSeriesSummarize(&sim->wakeupLatenessSec, &result->wakeupLatenessSec);
+
+    result->pacerHits = sim->pacer.hits;
+    result->pacerMisses = sim->pacer.misses;
+    result->judderScore = smoothnessJudderScore(&sim->smoothness);
+    result->duplicated = sim->smoothness.duplicated;
+    result->skipped = sim->smoothness.skipped;
+  }
+
+  finalizeSimulation(sim);
+  free(sim);
+
+  return success;
+}
+
+const char *paceSimDisplayName(enum PaceSimDisplayType display)
+{
+  return g_displayNames[display];
+}
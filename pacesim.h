@@ -0,0 +1,72 @@
+#ifndef __PACESIM_H__
+#define __PACESIM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "framerate.h"
+#include "simclock.h"
+#include "stats.h"
+
+/* Percentiles cover the last frames, about half an hour at 144 fps */
+#define PACE_SIM_SERIES_SIZE 262144
+
+enum PaceSimDisplayType
+{
+  PACE_SIM_DISPLAY_FIXED,     /* FIFO on a fixed refresh grid */
+  PACE_SIM_DISPLAY_VRR,       /* Scanout when the frame is ready, within the VRR range, LFC below it */
+  PACE_SIM_DISPLAY_IMMEDIATE, /* Scanout as soon as the frame is ready */
+};
+
+struct PaceSimConfig
+{
+  double durationSec;                    /* Simulated time */
+  unsigned int seed;
+  bool lowLatency;                       /* FramePacer like --low-latency, else sleep after each frame */
+
+  /* 0 keeps the FrameRateController's default */
+  int frameRateMin;
+  int frameRateMax;
+  enum FrameRateProfile profile;
+
+  enum PaceSimDisplayType display;
+  double refreshRateHz;
+  double vrrMinHz;
+  double vrrMaxHz;                       /* 0 is the refresh rate */
+  int swapchainImages;
+
+  struct SimDistribution cpuTime;        /* Frame start to submit */
+  struct SimDistribution gpuTime;
+  struct SimDistribution presentLatency; /* GPU done to flip queued: driver, compositor */
+  struct SimDistribution wakeupLatency;  /* Added to every sleep */
+};
+
+struct PaceSimResult
+{
+  uint64_t frames;
+  double simulatedSec;
+  double wallSec;
+
+  struct SeriesSummary cadenceErrorSec;   /* |present interval - requested frame interval| */
+  struct SeriesSummary latencySec;        /* Frame start to present */
+  struct SeriesSummary wakeupLatenessSec; /* Sleep after the frame, not with the pacer */
+
+  uint64_t pacerHits;
+  uint64_t pacerMisses;
+  double judderScore;
+  uint64_t duplicated;
+  uint64_t skipped;
+};
+
+/*
+ * Runs the demo's frame loop in virtual time: the real FrameLoop,
+ * FrameRateController, FramePacer and SmoothnessAnalyzer, with the clock,
+ * the rendering and the display simulated. Draw() waits for the previous
+ * frame's GPU work and for a free swapchain image, like the Vulkan path. The
+ * result only depends on the config, seed included.
+ */
+void paceSimDefaults(struct PaceSimConfig *config);
+bool paceSimRun(const struct PaceSimConfig *config, struct PaceSimResult *result);
+const char *paceSimDisplayName(enum PaceSimDisplayType display);
+
+#endif /* __PACESIM_H__ */
@@ -0,0 +1,259 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "realtime.h"
+
+#define REALTIME_ISOLATED_CPUS_PATH "/sys/devices/system/cpu/isolated"
+
+/* Deeper than the frame loop ever goes, well below the default 8 MB stack */
+#define REALTIME_PREFAULT_STACK_SIZE (512 * 1024)
+/* Heap kept by malloc for the allocations made while running */
+#define REALTIME_PREFAULT_HEAP_SIZE  (16 * 1024 * 1024)
+
+void realtimeInitialize(struct Realtime *realtime)
+{
+  memset(realtime, 0, sizeof(*realtime));
+  realtime->policy = REALTIME_POLICY_OTHER;
+  realtime->priority = REALTIME_DEFAULT_PRIORITY;
+  realtime->cpu = REALTIME_CPU_NONE;
+  realtime->pinnedCpu = REALTIME_CPU_NONE;
+}
+
+bool realtimeParsePolicy(struct Realtime *realtime, const char *value)
+{
+  const char *separator = strchr(value, ':');
+  size_t length = separator != NULL ? (size_t)(separator - value) : strlen(value);
+
+  if (length == 4 && strncmp(value, "fifo", length) == 0) {
+    realtime->policy = REALTIME_POLICY_FIFO;
+  } else if (length == 2 && strncmp(value, "rr", length) == 0) {
+    realtime->policy = REALTIME_POLICY_RR;
+  } else {
+    return false;
+  }
+
+  if (separator != NULL) {
+    char *end;
+    realtime->priority = strtol(separator + 1, &end, 10);
+    if (*end != '\0' || realtime->priority < sched_get_priority_min(SCHED_FIFO)
+        || realtime->priority > sched_get_priority_max(SCHED_FIFO)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool realtimeParseCpu(struct Realtime *realtime, const char *value)
+{
+  if (strcmp(value, "auto") == 0) {
+    realtime->cpu = REALTIME_CPU_AUTO;
+    return true;
+  }
+
+  char *end;
+  realtime->cpu = strtol(value, &end, 10);
+  return *end == '\0' && realtime->cpu >= 0 && realtime->cpu < CPU_SETSIZE;
+}
+
+/* CPU list such as "2-3,6", empty without isolcpus= */
+static void readIsolatedCpus(cpu_set_t *cpus)
+{
+  CPU_ZERO(cpus);
+
+  FILE *file = fopen(REALTIME_ISOLATED_CPUS_PATH, "r");
+  if (file == NULL) {
+    return;
+  }
+
+  char list[256];
+  if (fgets(list, sizeof(list), file) != NULL) {
+    const char *cursor = list;
+    int first, last, consumed;
+
+    while (sscanf(cursor, "%d%n", &first, &consumed) == 1) {
+      cursor += consumed;
+      last = first;
+      if (*cursor == '-') {
+        if (sscanf(cursor + 1, "%d%n", &last, &consumed) != 1) {
+          break;
+        }
+        cursor += 1 + consumed;
+      }
+
+      for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+        CPU_SET(cpu, cpus);
+      }
+
+      if (*cursor != ',') {
+        break;
+      }
+      cursor++;
+    }
+  }
+
+  fclose(file);
+}
+
+/* Isolated CPUs are usually left out of the default affinity, they are tried first */
+static int selectCpu(const cpu_set_t *isolated)
+{
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, isolated)) {
+      return cpu;
+    }
+  }
+
+  /* Otherwise the last allowed CPU, away from the housekeeping on CPU 0 */
+  cpu_set_t allowed;
+  if (pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed) != 0) {
+    return REALTIME_CPU_NONE;
+  }
+
+  for (int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      return cpu;
+    }
+  }
+
+  return REALTIME_CPU_NONE;
+}
+
+static void pinCpu(struct Realtime *realtime)
+{
+  cpu_set_t isolated;
+  readIsolatedCpus(&isolated);
+
+  int cpu = realtime->cpu == REALTIME_CPU_AUTO ? selectCpu(&isolated) : realtime->cpu;
+  if (cpu == REALTIME_CPU_NONE) {
+    logWarning("No CPU to pin the frame loop to");
+    return;
+  }
+
+  if (CPU_COUNT(&isolated) > 0 && !CPU_ISSET(cpu, &isolated)) {
+    logWarning("CPU %d is not isolated, other tasks are scheduled on it", cpu);
+  }
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+
+  int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (error != 0) {
+    logWarning("Failed to pin the frame loop to CPU %d: %s", cpu, strerror(error));
+    return;
+  }
+
+  realtime->pinnedCpu = cpu;
+  realtime->pinnedCpuIsolated = CPU_ISSET(cpu, &isolated);
+}
+
+static void setPolicy(struct Realtime *realtime)
+{
+  int policy = realtime->policy == REALTIME_POLICY_RR ? SCHED_RR : SCHED_FIFO;
+  struct sched_param param = { .sched_priority = realtime->priority };
+
+  int error = pthread_setschedparam(pthread_self(), policy, &param);
+  if (error != 0) {
+    logWarning("Failed to set %s priority %d: %s (needs CAP_SYS_NICE or RLIMIT_RTPRIO)",
+               policy == SCHED_RR ? "SCHED_RR" : "SCHED_FIFO", realtime->priority, strerror(error));
+    return;
+  }
+
+  realtime->policyApplied = true;
+}
+
+static void prefaultStack(void)
+{
+  volatile unsigned char stack[REALTIME_PREFAULT_STACK_SIZE];
+  long pageSize = sysconf(_SC_PAGESIZE);
+
+  for (size_t i = 0; i < sizeof(stack); i += pageSize) {
+    stack[i] = 0;
+  }
+}
+
+static void prefaultHeap(void)
+{
+  /* Freed memory stays in the heap instead of going back to the kernel */
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+
+  unsigned char *reserve = malloc(REALTIME_PREFAULT_HEAP_SIZE);
+  if (reserve == NULL) {
+    logWarning("Failed to prefault the heap");
+    return;
+  }
+
+  long pageSize = sysconf(_SC_PAGESIZE);
+  for (size_t i = 0; i < REALTIME_PREFAULT_HEAP_SIZE; i += pageSize) {
+    reserve[i] = 0;
+  }
+  free(reserve);
+}
+
+void realtimeApply(struct Realtime *realtime)
+{
+  /* Locked first, so that the prefaulted pages stay resident */
+  if (realtime->lockMemory) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+      realtime->memoryLocked = true;
+    } else {
+      logWarning("mlockall failed: %s (see RLIMIT_MEMLOCK)", strerror(errno));
+    }
+  }
+
+  if (realtime->prefault) {
+    prefaultHeap();
+    prefaultStack();
+    realtime->prefaulted = true;
+  }
+
+  if (realtime->cpu != REALTIME_CPU_NONE) {
+    pinCpu(realtime);
+  }
+
+  if (realtime->policy != REALTIME_POLICY_OTHER) {
+    setPolicy(realtime);
+  }
+}
+
+void realtimeDescribe(const struct Realtime *realtime, char *buffer, size_t size)
+{
+  size_t length = 0;
+  buffer[0] = '\0';
+
+  if (realtime->policyApplied) {
+    length += snprintf(buffer + length, size - length, "%s %d, ",
+                       realtime->policy == REALTIME_POLICY_RR ? "SCHED_RR" : "SCHED_FIFO", realtime->priority);
+  }
+  if (realtime->pinnedCpu != REALTIME_CPU_NONE && length < size) {
+    length += snprintf(buffer + length, size - length, "CPU %d%s, ", realtime->pinnedCpu,
+                       realtime->pinnedCpuIsolated ? " (isolated)" : "");
+  }
+  if (realtime->memoryLocked && length < size) {
+    length += snprintf(buffer + length, size - length, "mlockall, ");
+  }
+  if (realtime->prefaulted && length < size) {
+    length += snprintf(buffer + length, size - length, "prefault, ");
+  }
+
+  if (length == 0) {
+    snprintf(buffer, size, "default scheduling");
+  } else if (length < size) {
+    /* Trailing separator */
+    buffer[length - 2] = '\0';
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef __REALTIME_H__
+#define __REALTIME_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define REALTIME_CPU_NONE -1
+#define REALTIME_CPU_AUTO -2
+
+#define REALTIME_DEFAULT_PRIORITY 50
+
+enum RealtimePolicy
+{
+  REALTIME_POLICY_OTHER,
+  REALTIME_POLICY_FIFO,
+  REALTIME_POLICY_RR,
+};
+
+/*
+ * Scheduling of the frame loop thread, to take the OS scheduler out of the
+ * frame pacing jitter:
+ *
+ *   policy      SCHED_FIFO or SCHED_RR at the given priority (needs
+ *               CAP_SYS_NICE or an RLIMIT_RTPRIO)
+ *   cpu         pinning to one CPU; "auto" picks an isolated one
+ *               (isolcpus=, /sys/devices/system/cpu/isolated) when there is
+ *               one, the last allowed CPU otherwise
+ *   lockMemory  mlockall() of the current and future mappings
+ *   prefault    touches the stack and a heap reserve kept by malloc, so the
+ *               frame loop does not page fault
+ *
+ * Each setting is optional and a failure only disables it, the applied ones
+ * are reported by realtimeDescribe().
+ */
+struct Realtime
+{
+  /* Requested */
+  enum RealtimePolicy policy;
+  int priority;
+  int cpu;
+  bool lockMemory;
+  bool prefault;
+
+  /* Applied by realtimeApply() */
+  bool policyApplied;
+  int pinnedCpu;
+  bool pinnedCpuIsolated;
+  bool memoryLocked;
+  bool prefaulted;
+};
+
+void realtimeInitialize(struct Realtime *realtime);
+
+/* "fifo[:PRIO]" or "rr[:PRIO]" */
+bool realtimeParsePolicy(struct Realtime *realtime, const char *value);
+/* CPU index or "auto" */
+bool realtimeParseCpu(struct Realtime *realtime, const char *value);
+
+/* Applies the settings to the calling thread, threads it starts afterwards inherit them */
+void realtimeApply(struct Realtime *realtime);
+void realtimeDescribe(const struct Realtime *realtime, char *buffer, size_t size);
+
+#endif /* __REALTIME_H__ */
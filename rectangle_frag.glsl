@@ -4,7 +4,16 @@ layout (location = 0) in vec3 outColor;
 
 layout (location = 0) out vec4 fragColor;
 
+// GPU load of the pattern: dependent math per fragment
+layout (constant_id = 4) const int LOAD_ITERATIONS = 0;
+
 void main()
 {
-    fragColor = vec4(outColor, 1.0f);
+    float load = 0.0;
+    for (int i = 0; i < LOAD_ITERATIONS; i++) {
+        load = sin(load + float(i));
+    }
+
+    // Far below a color step, but keeps the loop from being optimized out
+    fragColor = vec4(outColor + load * 1e-6, 1.0f);
 }
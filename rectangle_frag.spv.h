@@ -2,18 +2,29 @@
 #define RECTANGLE_FRAG_SPV_H
 
 static const unsigned int rectangle_frag_spv[] = {
-	0x07230203, 0x00010000, 0x000d000b, 0x00000013, 0x00000000, 0x00020011, 0x00000001, 0x0006000b, 0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e,
-	0x00000000, 0x0003000e, 0x00000000, 0x00000001, 0x0007000f, 0x00000004, 0x00000004, 0x6e69616d, 0x00000000, 0x00000009, 0x0000000c, 0x00030010,
-	0x00000004, 0x00000007, 0x00030003, 0x00000002, 0x000001c2, 0x000a0004, 0x475f4c47, 0x4c474f4f, 0x70635f45, 0x74735f70, 0x5f656c79, 0x656e696c,
-	0x7269645f, 0x69746365, 0x00006576, 0x00080004, 0x475f4c47, 0x4c474f4f, 0x6e695f45, 0x64756c63, 0x69645f65, 0x74636572, 0x00657669, 0x00040005,
-	0x00000004, 0x6e69616d, 0x00000000, 0x00050005, 0x00000009, 0x67617266, 0x6f6c6f43, 0x00000072, 0x00050005, 0x0000000c, 0x4374756f, 0x726f6c6f,
-	0x00000000, 0x00040047, 0x00000009, 0x0000001e, 0x00000000, 0x00040047, 0x0000000c, 0x0000001e, 0x00000000, 0x00020013, 0x00000002, 0x00030021,
-	0x00000003, 0x00000002, 0x00030016, 0x00000006, 0x00000020, 0x00040017, 0x00000007, 0x00000006, 0x00000004, 0x00040020, 0x00000008, 0x00000003,
-	0x00000007, 0x0004003b, 0x00000008, 0x00000009, 0x00000003, 0x00040017, 0x0000000a, 0x00000006, 0x00000003, 0x00040020, 0x0000000b, 0x00000001,
-	0x0000000a, 0x0004003b, 0x0000000b, 0x0000000c, 0x00000001, 0x0004002b, 0x00000006, 0x0000000e, 0x3f800000, 0x00050036, 0x00000002, 0x00000004,
-	0x00000000, 0x00000003, 0x000200f8, 0x00000005, 0x0004003d, 0x0000000a, 0x0000000d, 0x0000000c, 0x00050051, 0x00000006, 0x0000000f, 0x0000000d,
-	0x00000000, 0x00050051, 0x00000006, 0x00000010, 0x0000000d, 0x00000001, 0x00050051, 0x00000006, 0x00000011, 0x0000000d, 0x00000002, 0x00070050,
-	0x00000007, 0x00000012, 0x0000000f, 0x00000010, 0x00000011, 0x0000000e, 0x0003003e, 0x00000009, 0x00000012, 0x000100fd, 0x00010038
+	0x07230203, 0x00010000, 0x000d000b, 0x0000002d, 0x00000000, 0x00020011, 0x00000001, 0x0006000b, 0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e,
+	0x00000000, 0x0003000e, 0x00000000, 0x00000001, 0x0007000f, 0x00000004, 0x00000002, 0x6e69616d, 0x00000000, 0x00000003, 0x00000004, 0x00030010,
+	0x00000002, 0x00000007, 0x00030003, 0x00000002, 0x000001c2, 0x00040005, 0x00000002, 0x6e69616d, 0x00000000, 0x00040005, 0x00000005, 0x64616f6c,
+	0x00000000, 0x00030005, 0x00000006, 0x00000069, 0x00060005, 0x00000007, 0x44414f4c, 0x4554495f, 0x49544152, 0x00534e4f, 0x00050005, 0x00000003,
+	0x67617266, 0x6f6c6f43, 0x00000072, 0x00050005, 0x00000004, 0x4374756f, 0x726f6c6f, 0x00000000, 0x00040047, 0x00000007, 0x00000001, 0x00000004,
+	0x00040047, 0x00000003, 0x0000001e, 0x00000000, 0x00040047, 0x00000004, 0x0000001e, 0x00000000, 0x00020013, 0x00000008, 0x00030021, 0x00000009,
+	0x00000008, 0x00030016, 0x0000000a, 0x00000020, 0x00040020, 0x0000000b, 0x00000007, 0x0000000a, 0x0004002b, 0x0000000a, 0x0000000c, 0x00000000,
+	0x00040015, 0x0000000d, 0x00000020, 0x00000001, 0x00040020, 0x0000000e, 0x00000007, 0x0000000d, 0x0004002b, 0x0000000d, 0x0000000f, 0x00000000,
+	0x00040032, 0x0000000d, 0x00000007, 0x00000000, 0x00020014, 0x00000010, 0x0004002b, 0x0000000d, 0x00000011, 0x00000001, 0x00040017, 0x00000012,
+	0x0000000a, 0x00000004, 0x00040020, 0x00000013, 0x00000003, 0x00000012, 0x0004003b, 0x00000013, 0x00000003, 0x00000003, 0x00040017, 0x00000014,
+	0x0000000a, 0x00000003, 0x00040020, 0x00000015, 0x00000001, 0x00000014, 0x0004003b, 0x00000015, 0x00000004, 0x00000001, 0x0004002b, 0x0000000a,
+	0x00000016, 0x358637bd, 0x0004002b, 0x0000000a, 0x00000017, 0x3f800000, 0x00050036, 0x00000008, 0x00000002, 0x00000000, 0x00000009, 0x000200f8,
+	0x00000018, 0x0004003b, 0x0000000b, 0x00000005, 0x00000007, 0x0004003b, 0x0000000e, 0x00000006, 0x00000007, 0x0003003e, 0x00000005, 0x0000000c,
+	0x0003003e, 0x00000006, 0x0000000f, 0x000200f9, 0x00000019, 0x000200f8, 0x00000019, 0x000400f6, 0x0000001a, 0x0000001b, 0x00000000, 0x000200f9,
+	0x0000001c, 0x000200f8, 0x0000001c, 0x0004003d, 0x0000000d, 0x0000001d, 0x00000006, 0x000500b1, 0x00000010, 0x0000001e, 0x0000001d, 0x00000007,
+	0x000400fa, 0x0000001e, 0x0000001f, 0x0000001a, 0x000200f8, 0x0000001f, 0x0004003d, 0x0000000a, 0x00000020, 0x00000005, 0x0004003d, 0x0000000d,
+	0x00000021, 0x00000006, 0x0004006f, 0x0000000a, 0x00000022, 0x00000021, 0x00050081, 0x0000000a, 0x00000023, 0x00000020, 0x00000022, 0x0006000c,
+	0x0000000a, 0x00000024, 0x00000001, 0x0000000d, 0x00000023, 0x0003003e, 0x00000005, 0x00000024, 0x000200f9, 0x0000001b, 0x000200f8, 0x0000001b,
+	0x0004003d, 0x0000000d, 0x00000025, 0x00000006, 0x00050080, 0x0000000d, 0x00000026, 0x00000025, 0x00000011, 0x0003003e, 0x00000006, 0x00000026,
+	0x000200f9, 0x00000019, 0x000200f8, 0x0000001a, 0x0004003d, 0x00000014, 0x00000027, 0x00000004, 0x0004003d, 0x0000000a, 0x00000028, 0x00000005,
+	0x00050085, 0x0000000a, 0x00000029, 0x00000028, 0x00000016, 0x00060050, 0x00000014, 0x0000002a, 0x00000029, 0x00000029, 0x00000029, 0x00050081,
+	0x00000014, 0x0000002b, 0x00000027, 0x0000002a, 0x00050050, 0x00000012, 0x0000002c, 0x0000002b, 0x00000017, 0x0003003e, 0x00000003, 0x0000002c,
+	0x000100fd, 0x00010038
 };
 
 #endif /* RECTANGLE_FRAG_SPV_H */
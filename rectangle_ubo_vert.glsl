@@ -0,0 +1,31 @@
+#version 450
+
+layout (location = 0) out vec3 outColor;
+
+// Pattern parameters, the defaults are overridden per pipeline variant
+layout (constant_id = 0) const float BAR_WIDTH = 0.1; // NDC, 2 is the screen width
+layout (constant_id = 1) const float BAR_RED = 0.9;
+layout (constant_id = 2) const float BAR_GREEN = 0.9;
+layout (constant_id = 3) const float BAR_BLUE = 0.9;
+
+// Rectangle at the left edge, x is scaled by the bar width
+const vec2 vertices[6] = vec2[6](
+    vec2(0.0,-1.0),
+    vec2(0.0, 1.0),
+    vec2(1.0, 1.0),
+    vec2(0.0,-1.0),
+    vec2(1.0,-1.0),
+    vec2(1.0, 1.0)
+);
+
+layout (set = 0, binding = 0) uniform FrameData
+{
+  float x;
+} currentStep;
+
+void main()
+{
+    vec2 vertex = vertices[gl_VertexIndex];
+    gl_Position = vec4(-1.0 + vertex.x * BAR_WIDTH + currentStep.x, vertex.y, 0.0, 1.0);
+    outColor = vec3(BAR_RED, BAR_GREEN, BAR_BLUE);
+}
@@ -0,0 +1,37 @@
+#ifndef RECTANGLE_UBO_VERT_SPV_H
+#define RECTANGLE_UBO_VERT_SPV_H
+
+static const unsigned int rectangle_ubo_vert_spv[] = {
+	0x07230203, 0x00010000, 0x000d000b, 0x00000034, 0x00000000, 0x00020011, 0x00000001, 0x0006000b, 0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e,
+	0x00000000, 0x0003000e, 0x00000000, 0x00000001, 0x0008000f, 0x00000000, 0x00000002, 0x6e69616d, 0x00000000, 0x00000003, 0x00000004, 0x00000005,
+	0x00030003, 0x00000002, 0x000001c2, 0x00040005, 0x00000002, 0x6e69616d, 0x00000000, 0x00050005, 0x00000006, 0x74726576, 0x73656369, 0x00000000,
+	0x00060005, 0x00000003, 0x565f6c67, 0x65747265, 0x646e4978, 0x00007865, 0x00050005, 0x00000004, 0x505f6c67, 0x7469736f, 0x006e6f69, 0x00050005,
+	0x00000007, 0x5f524142, 0x54444957, 0x00000048, 0x00050005, 0x00000008, 0x6d617246, 0x74614465, 0x00000061, 0x00040006, 0x00000008, 0x00000000,
+	0x00000078, 0x00050005, 0x00000009, 0x72727563, 0x53746e65, 0x00706574, 0x00050005, 0x00000005, 0x4374756f, 0x726f6c6f, 0x00000000, 0x00040005,
+	0x0000000a, 0x5f524142, 0x00444552, 0x00050005, 0x0000000b, 0x5f524142, 0x45455247, 0x0000004e, 0x00050005, 0x0000000c, 0x5f524142, 0x45554c42,
+	0x00000000, 0x00040047, 0x00000003, 0x0000000b, 0x0000002a, 0x00040047, 0x00000004, 0x0000000b, 0x00000000, 0x00040047, 0x00000007, 0x00000001,
+	0x00000000, 0x00050048, 0x00000008, 0x00000000, 0x00000023, 0x00000000, 0x00030047, 0x00000008, 0x00000002, 0x00040047, 0x00000009, 0x00000022,
+	0x00000000, 0x00040047, 0x00000009, 0x00000021, 0x00000000, 0x00040047, 0x00000005, 0x0000001e, 0x00000000, 0x00040047, 0x0000000a, 0x00000001,
+	0x00000001, 0x00040047, 0x0000000b, 0x00000001, 0x00000002, 0x00040047, 0x0000000c, 0x00000001, 0x00000003, 0x00020013, 0x0000000d, 0x00030021,
+	0x0000000e, 0x0000000d, 0x00030016, 0x0000000f, 0x00000020, 0x00040017, 0x00000010, 0x0000000f, 0x00000002, 0x00040017, 0x00000011, 0x0000000f,
+	0x00000003, 0x00040017, 0x00000012, 0x0000000f, 0x00000004, 0x00040015, 0x00000013, 0x00000020, 0x00000001, 0x00040015, 0x00000014, 0x00000020,
+	0x00000000, 0x0004002b, 0x00000014, 0x00000015, 0x00000006, 0x0004001c, 0x00000016, 0x00000010, 0x00000015, 0x00040020, 0x00000017, 0x00000007,
+	0x00000016, 0x0004002b, 0x0000000f, 0x00000018, 0x00000000, 0x0004002b, 0x0000000f, 0x00000019, 0xbf800000, 0x0004002b, 0x0000000f, 0x0000001a,
+	0x3f800000, 0x0005002c, 0x00000010, 0x0000001b, 0x00000018, 0x00000019, 0x0005002c, 0x00000010, 0x0000001c, 0x00000018, 0x0000001a, 0x0005002c,
+	0x00000010, 0x0000001d, 0x0000001a, 0x0000001a, 0x0005002c, 0x00000010, 0x0000001e, 0x0000001a, 0x00000019, 0x0009002c, 0x00000016, 0x0000001f,
+	0x0000001b, 0x0000001c, 0x0000001d, 0x0000001b, 0x0000001e, 0x0000001d, 0x00040020, 0x00000020, 0x00000001, 0x00000013, 0x0004003b, 0x00000020,
+	0x00000003, 0x00000001, 0x00040020, 0x00000021, 0x00000007, 0x00000010, 0x00040020, 0x00000022, 0x00000003, 0x00000012, 0x0004003b, 0x00000022,
+	0x00000004, 0x00000003, 0x00040032, 0x0000000f, 0x00000007, 0x3dcccccd, 0x0003001e, 0x00000008, 0x0000000f, 0x00040020, 0x00000023, 0x00000002,
+	0x00000008, 0x0004003b, 0x00000023, 0x00000009, 0x00000002, 0x0004002b, 0x00000013, 0x00000024, 0x00000000, 0x00040020, 0x00000025, 0x00000002,
+	0x0000000f, 0x00040020, 0x00000026, 0x00000003, 0x00000011, 0x0004003b, 0x00000026, 0x00000005, 0x00000003, 0x00040032, 0x0000000f, 0x0000000a,
+	0x3f666666, 0x00040032, 0x0000000f, 0x0000000b, 0x3f666666, 0x00040032, 0x0000000f, 0x0000000c, 0x3f666666, 0x00060033, 0x00000011, 0x00000027,
+	0x0000000a, 0x0000000b, 0x0000000c, 0x00050036, 0x0000000d, 0x00000002, 0x00000000, 0x0000000e, 0x000200f8, 0x00000028, 0x0004003b, 0x00000017,
+	0x00000006, 0x00000007, 0x0003003e, 0x00000006, 0x0000001f, 0x0004003d, 0x00000013, 0x00000029, 0x00000003, 0x00050041, 0x00000021, 0x0000002a,
+	0x00000006, 0x00000029, 0x0004003d, 0x00000010, 0x0000002b, 0x0000002a, 0x00050051, 0x0000000f, 0x0000002c, 0x0000002b, 0x00000000, 0x00050085,
+	0x0000000f, 0x0000002d, 0x0000002c, 0x00000007, 0x00050081, 0x0000000f, 0x0000002e, 0x00000019, 0x0000002d, 0x00050041, 0x00000025, 0x0000002f,
+	0x00000009, 0x00000024, 0x0004003d, 0x0000000f, 0x00000030, 0x0000002f, 0x00050081, 0x0000000f, 0x00000031, 0x0000002e, 0x00000030, 0x00050051,
+	0x0000000f, 0x00000032, 0x0000002b, 0x00000001, 0x00070050, 0x00000012, 0x00000033, 0x00000031, 0x00000032, 0x00000018, 0x0000001a, 0x0003003e,
+	0x00000004, 0x00000033, 0x0003003e, 0x00000005, 0x00000027, 0x000100fd, 0x00010038
+};
+
+#endif /* RECTANGLE_UBO_VERT_SPV_H */
@@ -2,14 +2,20 @@
 
 layout (location = 0) out vec3 outColor;
 
-// Draw rectangle with 10% screen width
-const vec3 vertices[6] = vec3[6](
-    vec3(-1.0,-1.0, 0.0),
-    vec3(-1.0, 1.0, 0.0),
-    vec3(-0.9, 1.0, 0.0),
-    vec3(-1.0,-1.0, 0.0),
-    vec3(-0.9,-1.0, 0.0),
-    vec3(-0.9, 1.0, 0.0)
+// Pattern parameters, the defaults are overridden per pipeline variant
+layout (constant_id = 0) const float BAR_WIDTH = 0.1; // NDC, 2 is the screen width
+layout (constant_id = 1) const float BAR_RED = 0.9;
+layout (constant_id = 2) const float BAR_GREEN = 0.9;
+layout (constant_id = 3) const float BAR_BLUE = 0.9;
+
+// Rectangle at the left edge, x is scaled by the bar width
+const vec2 vertices[6] = vec2[6](
+    vec2(0.0,-1.0),
+    vec2(0.0, 1.0),
+    vec2(1.0, 1.0),
+    vec2(0.0,-1.0),
+    vec2(1.0,-1.0),
+    vec2(1.0, 1.0)
 );
 
 layout (push_constant) uniform constants
@@ -19,6 +25,7 @@ layout (push_constant) uniform constants
 
 void main()
 {
-    gl_Position = vec4(vertices[gl_VertexIndex].x + currentStep.x, vertices[gl_VertexIndex].yz, 1.0);
-    outColor = vec3(0.9f, 0.9f, 0.9f);
+    vec2 vertex = vertices[gl_VertexIndex];
+    gl_Position = vec4(-1.0 + vertex.x * BAR_WIDTH + currentStep.x, vertex.y, 0.0, 1.0);
+    outColor = vec3(BAR_RED, BAR_GREEN, BAR_BLUE);
 }
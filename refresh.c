@@ -0,0 +1,200 @@
+#include <math.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+
+#include "log.h"
+#include "refresh.h"
+
+/* Presents further than this from a whole number of periods are not vblank aligned */
+#define REFRESH_ALIGNMENT_TOLERANCE 0.1
+/* Longer intervals are missed frames rather than a measure of the period */
+#define REFRESH_MAX_INTERVAL_VBLANKS 4
+#define REFRESH_MIN_VBLANKS          120
+/* Beyond this the nominal period is reported as wrong */
+#define REFRESH_MAX_DEVIATION_PPM    1000.0
+
+/* Indexed by RefreshSource */
+static const char *g_refreshSourceNames[] = { "XRandR", "display mode", "SDL" };
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+  while (b != 0) {
+    uint64_t r = a % b;
+    a = b;
+    b = r;
+  }
+
+  return a;
+}
+
+static void reduce(struct RefreshPeriod *period)
+{
+  uint64_t divisor = gcd(period->numerator, period->denominator);
+  if (divisor > 1) {
+    period->numerator /= divisor;
+    period->denominator /= divisor;
+  }
+}
+
+void refreshPeriodFromRate(struct RefreshPeriod *period, uint64_t rateNumerator, uint64_t rateDenominator,
+                           enum RefreshSource source)
+{
+  period->numerator = rateDenominator;
+  period->denominator = rateNumerator;
+  period->source = source;
+  reduce(period);
+}
+
+static const XRRModeInfo *findMode(const XRRScreenResources *resources, RRMode id)
+{
+  for (int i = 0; i < resources->nmode; i++) {
+    if (resources->modes[i].id == id) {
+      return &resources->modes[i];
+    }
+  }
+
+  return NULL;
+}
+
+bool refreshQueryXRandR(struct RefreshPeriod *period, int x, int y)
+{
+  Display *dpy = XOpenDisplay(NULL);
+  if (dpy == NULL) {
+    return false;
+  }
+
+  int eventBase, errorBase;
+  if (!XRRQueryExtension(dpy, &eventBase, &errorBase)) {
+    XCloseDisplay(dpy);
+    return false;
+  }
+
+  XRRScreenResources *resources = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
+  if (resources == NULL) {
+    XCloseDisplay(dpy);
+    return false;
+  }
+
+  bool found = false;
+  for (int i = 0; i < resources->ncrtc && !found; i++) {
+    XRRCrtcInfo *crtc = XRRGetCrtcInfo(dpy, resources, resources->crtcs[i]);
+    if (crtc == NULL) {
+      continue;
+    }
+
+    const XRRModeInfo *mode = crtc->mode != None && crtc->x == x && crtc->y == y
+                              ? findMode(resources, crtc->mode) : NULL;
+    if (mode != NULL && mode->dotClock != 0 && mode->hTotal != 0 && mode->vTotal != 0) {
+      period->numerator = (uint64_t)mode->hTotal * mode->vTotal;
+      period->denominator = mode->dotClock;
+      /* Fields are scanned out at twice the frame rate, double scan lines take twice as long */
+      if (mode->modeFlags & RR_Interlace) {
+        period->denominator *= 2;
+      }
+      if (mode->modeFlags & RR_DoubleScan) {
+        period->numerator *= 2;
+      }
+      period->source = REFRESH_SOURCE_XRANDR;
+      reduce(period);
+
+      logInfo("Mode %ux%u: dot clock %.3f MHz, %u x %u total, %.4f Hz",
+              mode->width, mode->height, mode->dotClock / 1e6, mode->hTotal, mode->vTotal, refreshRateHz(period));
+      found = true;
+    }
+
+    XRRFreeCrtcInfo(crtc);
+  }
+
+  XRRFreeScreenResources(resources);
+  XCloseDisplay(dpy);
+
+  return found;
+}
+
+double refreshPeriodSec(const struct RefreshPeriod *period)
+{
+  return (double)period->numerator / period->denominator;
+}
+
+double refreshRateHz(const struct RefreshPeriod *period)
+{
+  return (double)period->denominator / period->numerator;
+}
+
+const char *refreshSourceName(enum RefreshSource source)
+{
+  return g_refreshSourceNames[source];
+}
+
+void refreshEstimatorInitialize(struct RefreshEstimator *estimator, const struct RefreshPeriod *nominal)
+{
+  memset(estimator, 0, sizeof(*estimator));
+  estimator->nominal = *nominal;
+}
+
+void refreshEstimatorReset(struct RefreshEstimator *estimator)
+{
+  estimator->lastPresentSec = 0.0;
+  estimator->sumIntervalSec = 0.0;
+  estimator->vblanks = 0;
+  estimator->rejected = 0;
+}
+
+void refreshEstimatorPresented(struct RefreshEstimator *estimator, double presentSec)
+{
+  double lastPresentSec = estimator->lastPresentSec;
+  estimator->lastPresentSec = presentSec;
+
+  if (lastPresentSec == 0.0) {
+    return;
+  }
+
+  double nominalSec = refreshPeriodSec(&estimator->nominal);
+  double intervalSec = presentSec - lastPresentSec;
+  long vblanks = lround(intervalSec / nominalSec);
+
+  if (vblanks < 1 || vblanks > REFRESH_MAX_INTERVAL_VBLANKS
+      || fabs(intervalSec - vblanks * nominalSec) > REFRESH_ALIGNMENT_TOLERANCE * nominalSec) {
+    estimator->rejected++;
+    return;
+  }
+
+  estimator->sumIntervalSec += intervalSec;
+  estimator->vblanks += vblanks;
+}
+
+double refreshEstimatorPeriodSec(const struct RefreshEstimator *estimator)
+{
+  if (estimator->vblanks < REFRESH_MIN_VBLANKS) {
+    return 0.0;
+  }
+
+  return estimator->sumIntervalSec / estimator->vblanks;
+}
+
+void refreshEstimatorPrintReport(const struct RefreshEstimator *estimator)
+{
+  const struct RefreshPeriod *nominal = &estimator->nominal;
+  double measuredSec = refreshEstimatorPeriodSec(estimator);
+
+  if (measuredSec == 0.0) {
+    logInfo("Refresh: %.4f Hz (%s, %llu/%llu s), not measured",
+            refreshRateHz(nominal), refreshSourceName(nominal->source),
+            (unsigned long long)nominal->numerator, (unsigned long long)nominal->denominator);
+    return;
+  }
+
+  double deviationPpm = (measuredSec / refreshPeriodSec(nominal) - 1.0) * 1e6;
+
+  logInfo("Refresh: %.4f Hz (%s, %llu/%llu s), measured %.4f Hz over %llu vblanks (%+.0f ppm, %llu intervals rejected)",
+          refreshRateHz(nominal), refreshSourceName(nominal->source),
+          (unsigned long long)nominal->numerator, (unsigned long long)nominal->denominator,
+          1.0 / measuredSec, (unsigned long long)estimator->vblanks, deviationPpm,
+          (unsigned long long)estimator->rejected);
+
+  if (fabs(deviationPpm) > REFRESH_MAX_DEVIATION_PPM) {
+    logWarning("The measured refresh period differs from the %s one by %.0f ppm",
+               refreshSourceName(nominal->source), deviationPpm);
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef __REFRESH_H__
+#define __REFRESH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Where the nominal refresh period comes from, from the most to the least exact */
+enum RefreshSource
+{
+  REFRESH_SOURCE_XRANDR,       /* Mode timing: htotal * vtotal / dot clock */
+  REFRESH_SOURCE_DISPLAY_MODE, /* VK_KHR_display mode, in mHz */
+  REFRESH_SOURCE_SDL,          /* SDL_DisplayMode.refresh_rate, whole Hz */
+};
+
+/*
+ * Refresh period as the rational numerator / denominator seconds, e.g.
+ * 2080 * 1157 / 346200000 for a 143.856 Hz mode, so nothing downstream has to
+ * work with a rounded rate.
+ */
+struct RefreshPeriod
+{
+  uint64_t numerator;
+  uint64_t denominator;
+  enum RefreshSource source;
+};
+
+/*
+ * Cross-check of the nominal period against the presents. Under FIFO without
+ * VRR every displayed present lands on a vblank, so each present interval is
+ * a whole number of refresh periods: the measured period is the sum of the
+ * intervals over the sum of those numbers. Intervals that are not close to a
+ * multiple of the nominal period (dropped timestamps, VRR) are rejected.
+ */
+struct RefreshEstimator
+{
+  struct RefreshPeriod nominal;
+  double lastPresentSec;
+
+  double sumIntervalSec;
+  uint64_t vblanks;
+  uint64_t rejected;
+};
+
+/* Period of a rateNumerator / rateDenominator Hz refresh rate */
+void refreshPeriodFromRate(struct RefreshPeriod *period, uint64_t rateNumerator, uint64_t rateDenominator,
+                           enum RefreshSource source);
+/* Mode timing of the CRTC scanning out the desktop position x, y; false without XRandR */
+bool refreshQueryXRandR(struct RefreshPeriod *period, int x, int y);
+
+double refreshPeriodSec(const struct RefreshPeriod *period);
+double refreshRateHz(const struct RefreshPeriod *period);
+const char *refreshSourceName(enum RefreshSource source);
+
+void refreshEstimatorInitialize(struct RefreshEstimator *estimator, const struct RefreshPeriod *nominal);
+void refreshEstimatorReset(struct RefreshEstimator *estimator);
+/* Only displayed present times, from the FIFO present mode without VRR */
+void refreshEstimatorPresented(struct RefreshEstimator *estimator, double presentSec);
+/* 0 until enough vblanks were measured */
+double refreshEstimatorPeriodSec(const struct RefreshEstimator *estimator);
+void refreshEstimatorPrintReport(const struct RefreshEstimator *estimator);
+
+#endif /* __REFRESH_H__ */
@@ -0,0 +1,331 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "scenario.h"
+
+#define SCENARIO_LINE_SIZE 256
+
+static const char *profileNames[] = {
+  [FRAME_RATE_PROFILE_SINE]     = "sine",
+  [FRAME_RATE_PROFILE_RAMP]     = "ramp",
+  [FRAME_RATE_PROFILE_CONSTANT] = "constant",
+};
+
+static const char *gsyncNames[] = {
+  [SCENARIO_GSYNC_KEEP] = "keep",
+  [SCENARIO_GSYNC_ON]   = "on",
+  [SCENARIO_GSYNC_OFF]  = "off",
+};
+
+static char *trim(char *text)
+{
+  while (isspace((unsigned char)*text)) {
+    text++;
+  }
+
+  char *end = text + strlen(text);
+  while (end > text && isspace((unsigned char)end[-1])) {
+    end--;
+  }
+  *end = '\0';
+
+  return text;
+}
+
+static bool parseName(const char *value, const char **names, int count, int *index)
+{
+  for (int i = 0; i < count; i++) {
+    if (strcmp(value, names[i]) == 0) {
+      *index = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool scenarioParsePresentMode(const char *value, VulkanPresentMode *presentMode)
+{
+  for (int i = 0; i < VULKAN_PRESENT_MODE_COUNT; i++) {
+    if (strcmp(value, GetPresentModeName(i)) == 0) {
+      *presentMode = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool scenarioParsePattern(const char *value, VulkanPattern *pattern)
+{
+  for (int i = 0; i < VULKAN_PATTERN_COUNT; i++) {
+    if (strcmp(value, GetPatternName(i)) == 0) {
+      *pattern = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char *scenarioProfileName(enum FrameRateProfile profile)
+{
+  return profileNames[profile];
+}
+
+bool scenarioParseProfile(const char *value, enum FrameRateProfile *profile)
+{
+  int index;
+  if (!parseName(value, profileNames, sizeof(profileNames) / sizeof(*profileNames), &index)) {
+    return false;
+  }
+
+  *profile = index;
+  return true;
+}
+
+/* The whole value as a finite number, "60fps" is rejected */
+static bool parseNumber(const char *value, double *number)
+{
+  char *end;
+  errno = 0;
+  *number = strtod(value, &end);
+  return end != value && *end == '\0' && errno == 0 && isfinite(*number);
+}
+
+/* "MIN-MAX" with nothing after MAX */
+static bool parseFrameRateRange(const char *value, int *frameRateMin, int *frameRateMax)
+{
+  char *end;
+  errno = 0;
+  long min = strtol(value, &end, 10);
+  if (end == value || *end != '-') {
+    return false;
+  }
+
+  const char *maxText = end + 1;
+  long max = strtol(maxText, &end, 10);
+  if (end == maxText || *end != '\0' || errno != 0 || min <= 0 || max < min || max > INT_MAX) {
+    return false;
+  }
+
+  *frameRateMin = min;
+  *frameRateMax = max;
+  return true;
+}
+
+static bool parseSetting(struct ScenarioPhase *phase, const char *key, const char *value)
+{
+  int index;
+  double number;
+
+  if (strcmp(key, "duration") == 0) {
+    if (!parseNumber(value, &number) || number <= 0.0) {
+      return false;
+    }
+    phase->durationSec = number;
+    return true;
+  }
+  if (strcmp(key, "frame-rate") == 0) {
+    return parseFrameRateRange(value, &phase->frameRateMin, &phase->frameRateMax);
+  }
+  if (strcmp(key, "profile") == 0) {
+    return scenarioParseProfile(value, &phase->profile);
+  }
+  if (strcmp(key, "present-mode") == 0) {
+    return scenarioParsePresentMode(value, &phase->presentMode);
+  }
+  if (strcmp(key, "gsync") == 0) {
+    if (!parseName(value, gsyncNames, sizeof(gsyncNames) / sizeof(*gsyncNames), &index)) {
+      return false;
+    }
+    phase->gsync = index;
+    return true;
+  }
+  if (strcmp(key, "pattern") == 0) {
+    return scenarioParsePattern(value, &phase->pattern);
+  }
+  if (strcmp(key, "load") == 0) {
+    if (!parseNumber(value, &number) || number < 0.0) {
+      return false;
+    }
+    phase->loadSec = number / 1000.0;
+    return true;
+  }
+  if (strcmp(key, "load-jitter") == 0) {
+    if (!parseNumber(value, &number) || number < 0.0) {
+      return false;
+    }
+    phase->loadJitterSec = number / 1000.0;
+    return true;
+  }
+
+  return false;
+}
+
+bool scenarioLoad(struct Scenario *scenario, const char *path, const struct ScenarioPhase *defaults)
+{
+  memset(scenario, 0, sizeof(*scenario));
+  scenario->path = path;
+
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    logError("Cannot open scenario '%s'", path);
+    return false;
+  }
+
+  struct ScenarioPhase *phase = NULL;
+  char line[SCENARIO_LINE_SIZE];
+  int lineNumber = 0;
+  bool success = true;
+
+  while (success && fgets(line, sizeof(line), file) != NULL) {
+    lineNumber++;
+
+    /* The rest would be read as a line of its own */
+    if (strchr(line, '\n') == NULL && !feof(file)) {
+      logError("%s:%d: line longer than %d characters", path, lineNumber, SCENARIO_LINE_SIZE - 2);
+      success = false;
+      break;
+    }
+
+    char *comment = strchr(line, '#');
+    if (comment != NULL) {
+      *comment = '\0';
+    }
+
+    char *text = trim(line);
+    if (*text == '\0') {
+      continue;
+    }
+
+    if (*text == '[') {
+      char *end = strchr(text, ']');
+      if (end == NULL || scenario->phaseCount == SCENARIO_MAX_PHASES) {
+        logError("%s:%d: invalid phase or more than %d phases", path, lineNumber, SCENARIO_MAX_PHASES);
+        success = false;
+        break;
+      }
+      *end = '\0';
+
+      struct ScenarioPhase *next = &scenario->phases[scenario->phaseCount++];
+      *next = phase != NULL ? *phase : *defaults;
+      phase = next;
+      snprintf(phase->name, sizeof(phase->name), "%s", trim(text + 1));
+      continue;
+    }
+
+    char *separator = strchr(text, '=');
+    if (phase == NULL || separator == NULL) {
+      logError("%s:%d: expected [phase] or key = value", path, lineNumber);
+      success = false;
+      break;
+    }
+    *separator = '\0';
+
+    char *key = trim(text);
+    char *value = trim(separator + 1);
+    if (!parseSetting(phase, key, value)) {
+      logError("%s:%d: invalid setting '%s = %s'", path, lineNumber, key, value);
+      success = false;
+    }
+  }
+
+  fclose(file);
+
+  if (success && scenario->phaseCount == 0) {
+    logError("%s: no phase", path);
+    success = false;
+  }
+
+  for (int i = 0; success && i < scenario->phaseCount; i++) {
+    if (scenario->phases[i].durationSec <= 0.0) {
+      logError("%s: phase '%s' has no duration", path, scenario->phases[i].name);
+      success = false;
+    }
+  }
+
+  return success;
+}
+
+/* Quoted, with the characters JSON does not allow in a string escaped */
+static void writeJsonString(FILE *file, const char *value)
+{
+  fputc('"', file);
+
+  for (const unsigned char *c = (const unsigned char *)value; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fprintf(file, "\\%c", *c);
+    } else if (*c < 0x20) {
+      fprintf(file, "\\u%04x", *c);
+    } else {
+      fputc(*c, file);
+    }
+  }
+
+  fputc('"', file);
+}
+
+static void writeSummary(FILE *file, const char *name, const struct SeriesSummary *summary, bool last)
+{
+  fprintf(file, "      \"%s\": { \"count\": %llu, \"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+          name, (unsigned long long)summary->count, summary->mean * 1000.0, summary->p50 * 1000.0,
+          summary->p99 * 1000.0, summary->max * 1000.0, last ? "" : ",");
+}
+
+bool scenarioWriteResults(struct Scenario *scenario, const char *path)
+{
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    logError("Cannot open '%s'", path);
+    return false;
+  }
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"scenario\": ");
+  writeJsonString(file, scenario->path);
+  fprintf(file, ",\n");
+  fprintf(file, "  \"phases\": [\n");
+
+  for (int i = 0; i < scenario->completedPhases; i++) {
+    const struct ScenarioPhase *phase = &scenario->phases[i];
+    const struct ScenarioPhaseResult *result = &scenario->results[i];
+
+    fprintf(file, "    {\n");
+    fprintf(file, "      \"name\": ");
+    writeJsonString(file, phase->name);
+    fprintf(file, ",\n");
+    fprintf(file, "      \"duration_sec\": %.3f,\n", phase->durationSec);
+    fprintf(file, "      \"frame_rate_min\": %d,\n", result->frameRateMin);
+    fprintf(file, "      \"frame_rate_max\": %d,\n", result->frameRateMax);
+    fprintf(file, "      \"profile\": \"%s\",\n", scenarioProfileName(phase->profile));
+    fprintf(file, "      \"present_mode\": \"%s\",\n", GetPresentModeName(result->presentMode));
+    fprintf(file, "      \"gsync\": %s,\n", result->gsyncEnabled ? "true" : "false");
+    fprintf(file, "      \"pattern\": \"%s\",\n", GetPatternName(phase->pattern));
+    fprintf(file, "      \"load_ms\": %.3f,\n", phase->loadSec * 1000.0);
+    fprintf(file, "      \"load_jitter_ms\": %.3f,\n", phase->loadJitterSec * 1000.0);
+    fprintf(file, "      \"frames\": %llu,\n", (unsigned long long)result->frames);
+    writeSummary(file, "frame_interval_ms", &result->frameIntervalSec, false);
+    writeSummary(file, "gpu_frame_ms", &result->gpuFrameSec, false);
+    fprintf(file, "      \"judder_percent\": %.3f,\n", result->judderPercent);
+    fprintf(file, "      \"duplicated\": %llu,\n", (unsigned long long)result->duplicated);
+    fprintf(file, "      \"skipped\": %llu\n", (unsigned long long)result->skipped);
+    fprintf(file, "    }%s\n", i + 1 < scenario->completedPhases ? "," : "");
+  }
+
+  fprintf(file, "  ]\n");
+  fprintf(file, "}\n");
+
+  fclose(file);
+  return true;
+}
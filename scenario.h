@@ -0,0 +1,92 @@
+#ifndef __SCENARIO_H__
+#define __SCENARIO_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "framerate.h"
+#include "stats.h"
+#include "vulkan.h"
+
+#define SCENARIO_MAX_PHASES 64
+#define SCENARIO_NAME_SIZE  64
+
+enum ScenarioGSync
+{
+  SCENARIO_GSYNC_KEEP,
+  SCENARIO_GSYNC_ON,
+  SCENARIO_GSYNC_OFF,
+};
+
+/* Settings of a phase, every phase starts from the previous phase's ones
+   and the first one from the command line's */
+struct ScenarioPhase
+{
+  char name[SCENARIO_NAME_SIZE];
+  double durationSec;
+
+  /* 0 keeps the frame rate range the display started with */
+  int frameRateMin;
+  int frameRateMax;
+  enum FrameRateProfile profile;
+
+  VulkanPresentMode presentMode;
+  enum ScenarioGSync gsync;
+  VulkanPattern pattern;
+
+  /* CPU work per frame before rendering, plus up to loadJitterSec at random */
+  double loadSec;
+  double loadJitterSec;
+};
+
+/* Statistics of a completed phase and the state it actually ran with */
+struct ScenarioPhaseResult
+{
+  int frameRateMin;
+  int frameRateMax;
+  VulkanPresentMode presentMode;
+  bool gsyncEnabled;
+
+  uint64_t frames;
+  struct SeriesSummary frameIntervalSec;
+  struct SeriesSummary gpuFrameSec;
+  double judderPercent;
+  uint64_t duplicated;
+  uint64_t skipped;
+};
+
+/*
+ * Unattended sweep over display settings. The scenario file lists phases,
+ * each starting with a [name] line followed by "key = value" settings:
+ *
+ *   duration      seconds (required)
+ *   frame-rate    MIN-MAX
+ *   profile       sine, ramp or constant
+ *   present-mode  fifo, fifo-relaxed, mailbox or immediate
+ *   gsync         on, off or keep
+ *   pattern       default, thin, wide, red or gpu-load
+ *   load          CPU milliseconds per frame
+ *   load-jitter   random extra CPU milliseconds per frame
+ *
+ * '#' starts a comment, lines are at most 254 characters long.
+ */
+struct Scenario
+{
+  const char *path;
+
+  struct ScenarioPhase phases[SCENARIO_MAX_PHASES];
+  struct ScenarioPhaseResult results[SCENARIO_MAX_PHASES];
+  int phaseCount;
+  int completedPhases;
+};
+
+/* defaults are the settings the first phase starts from, its name and duration are ignored */
+bool scenarioLoad(struct Scenario *scenario, const char *path, const struct ScenarioPhase *defaults);
+bool scenarioWriteResults(struct Scenario *scenario, const char *path);
+
+bool scenarioParsePresentMode(const char *value, VulkanPresentMode *presentMode);
+bool scenarioParsePattern(const char *value, VulkanPattern *pattern);
+bool scenarioParseProfile(const char *value, enum FrameRateProfile *profile);
+const char *scenarioProfileName(enum FrameRateProfile profile);
+
+#endif /* __SCENARIO_H__ */
@@ -0,0 +1,116 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simclock.h"
+
+/* Indexed by SimDistributionType */
+static const char *g_distributionNames[] = { "constant", "uniform", "normal", "exp" };
+
+static double now(void *userData)
+{
+  struct SimulatedClock *clock = userData;
+
+  return clock->nowSec;
+}
+
+static void sleepUntil(void *userData, double deadlineSec)
+{
+  struct SimulatedClock *clock = userData;
+
+  /* Like clock_nanosleep(), a deadline in the past returns right away */
+  if (deadlineSec > clock->nowSec) {
+    clock->nowSec = deadlineSec + simDistributionSample(&clock->wakeupLatency, &clock->seed);
+  }
+}
+
+void simClockInitialize(struct SimulatedClock *clock, double startSec, const struct SimDistribution *wakeupLatency,
+                        unsigned int seed)
+{
+  memset(clock, 0, sizeof(*clock));
+
+  clock->nowSec = startSec;
+  clock->wakeupLatency = *wakeupLatency;
+  clock->seed = seed;
+
+  clock->source.now = now;
+  clock->source.sleepUntil = sleepUntil;
+  clock->source.userData = clock;
+}
+
+void simClockAdvance(struct SimulatedClock *clock, double durationSec)
+{
+  if (durationSec > 0.0) {
+    clock->nowSec += durationSec;
+  }
+}
+
+/* In ]0, 1], so the logarithms below stay finite */
+static double uniformSample(unsigned int *seed)
+{
+  return (rand_r(seed) + 1.0) / (RAND_MAX + 1.0);
+}
+
+double simDistributionSample(const struct SimDistribution *distribution, unsigned int *seed)
+{
+  double sampleSec = distribution->meanSec;
+
+  switch (distribution->type) {
+  case SIM_DISTRIBUTION_CONSTANT:
+    break;
+  case SIM_DISTRIBUTION_UNIFORM:
+    sampleSec += distribution->spreadSec * (2.0 * uniformSample(seed) - 1.0);
+    break;
+  case SIM_DISTRIBUTION_NORMAL: {
+    /* Box-Muller, drawn in sequence: the evaluation order within an expression is unspecified */
+    double u1 = uniformSample(seed);
+    double u2 = uniformSample(seed);
+    sampleSec += distribution->spreadSec * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+    break;
+  }
+  case SIM_DISTRIBUTION_EXPONENTIAL:
+    sampleSec += -distribution->spreadSec * log(uniformSample(seed));
+    break;
+  }
+
+  return sampleSec > 0.0 ? sampleSec : 0.0;
+}
+
+bool simDistributionParse(const char *value, struct SimDistribution *distribution)
+{
+  double meanMsec = 0.0, spreadMsec = 0.0;
+  char type[16] = "";
+
+  int matched = sscanf(value, "%lf:%lf:%15s", &meanMsec, &spreadMsec, type);
+  if (matched < 1 || meanMsec < 0.0 || spreadMsec < 0.0) {
+    return false;
+  }
+
+  distribution->meanSec = meanMsec / 1000.0;
+  distribution->spreadSec = spreadMsec / 1000.0;
+  distribution->type = matched == 1 ? SIM_DISTRIBUTION_CONSTANT : SIM_DISTRIBUTION_NORMAL;
+
+  if (matched == 3) {
+    int count = sizeof(g_distributionNames) / sizeof(g_distributionNames[0]);
+    int i = 0;
+    while (i < count && strcmp(type, g_distributionNames[i]) != 0) {
+      i++;
+    }
+    if (i == count) {
+      return false;
+    }
+    distribution->type = i;
+  }
+
+  return true;
+}
+
+const char *simDistributionName(enum SimDistributionType type)
+{
+  return g_distributionNames[type];
+}
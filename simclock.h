@@ -0,0 +1,50 @@
+#ifndef __SIMCLOCK_H__
+#define __SIMCLOCK_H__
+
+#include <stdbool.h>
+
+#include "clock.h"
+
+enum SimDistributionType
+{
+  SIM_DISTRIBUTION_CONSTANT,
+  SIM_DISTRIBUTION_UNIFORM,     /* mean +- spread */
+  SIM_DISTRIBUTION_NORMAL,      /* spread is the standard deviation */
+  SIM_DISTRIBUTION_EXPONENTIAL, /* mean plus an exponential tail whose mean is spread */
+};
+
+/* Random durations: render times, wake-up latency, present latency */
+struct SimDistribution
+{
+  enum SimDistributionType type;
+  double meanSec;
+  double spreadSec;
+};
+
+/*
+ * Virtual time for the pacing code. Sleeping jumps the clock to the deadline
+ * plus a wake-up latency drawn from a distribution, work "takes" time by
+ * advancing it explicitly. Nothing blocks, so hours of frames run in seconds,
+ * and the random numbers come from a seeded rand_r() so runs are repeatable.
+ */
+struct SimulatedClock
+{
+  double nowSec;
+  struct SimDistribution wakeupLatency;
+  unsigned int seed;
+
+  struct ClockSource source;
+};
+
+/* Starts at startSec, a source for clockSetSource() is in clock->source */
+void simClockInitialize(struct SimulatedClock *clock, double startSec, const struct SimDistribution *wakeupLatency,
+                        unsigned int seed);
+void simClockAdvance(struct SimulatedClock *clock, double durationSec);
+
+/* Never negative */
+double simDistributionSample(const struct SimDistribution *distribution, unsigned int *seed);
+/* "MEAN[:SPREAD[:constant|uniform|normal|exp]]" in milliseconds, normal when only a spread is given */
+bool simDistributionParse(const char *value, struct SimDistribution *distribution);
+const char *simDistributionName(enum SimDistributionType type);
+
+#endif /* __SIMCLOCK_H__ */
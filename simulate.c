@@ -0,0 +1,228 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pacesim.h"
+#include "simclock.h"
+
+/**
+ * Pacing simulator
+ *
+ * Runs the demo's frame pacing in virtual time against a simulated GPU and
+ * display, see pacesim.h: an hour of frames takes a few seconds and the same
+ * options and seed always give the same numbers, so pacing changes can be
+ * compared without watching the screen.
+ */
+
+static void printUsage(const char *programName)
+{
+  printf("Usage: %s [options]\n"
+         "  --duration=SEC          simulated time (default 3600)\n"
+         "  --seed=N                random seed (default 1)\n"
+         "  --low-latency           pace frames with the just in time pacer like the demo's --low-latency\n"
+         "  --frame-rate=MIN-MAX    simulated frame rate range (default 30 to the refresh rate)\n"
+         "  --profile=sine|ramp|constant\n"
+         "                          frame rate profile (default sine)\n"
+         "  --display=fixed|vrr|immediate\n"
+         "                          display model (default vrr)\n"
+         "  --refresh=HZ            refresh rate (default 144)\n"
+         "  --vrr-range=MIN-MAX     VRR range (default 48 to the refresh rate)\n"
+         "  --swapchain-images=N    swapchain images, bounding the queued presents (default 3)\n"
+         "  --cpu-time=DIST         frame start to submit (default 2:0.5:normal)\n"
+         "  --gpu-time=DIST         GPU time per frame (default 3:1:normal)\n"
+         "  --present-latency=DIST  GPU done to flip queued (default 0.2:0.3:exp)\n"
+         "  --wakeup=DIST           wake-up latency added to every sleep (default 0.05:0.05:exp)\n"
+         "  --help                  show this message\n"
+         "DIST is MEAN[:SPREAD[:constant|uniform|normal|exp]] in milliseconds\n",
+         programName);
+}
+
+static bool parseRange(const char *value, double *min, double *max)
+{
+  return sscanf(value, "%lf-%lf", min, max) == 2 && *min > 0.0 && *max >= *min;
+}
+
+static bool parseOptions(struct PaceSimConfig *config, int argc, char **argv)
+{
+  enum {
+    OPTION_DURATION = 256,
+    OPTION_SEED,
+    OPTION_LOW_LATENCY,
+    OPTION_FRAME_RATE,
+    OPTION_PROFILE,
+    OPTION_DISPLAY,
+    OPTION_REFRESH,
+    OPTION_VRR_RANGE,
+    OPTION_SWAPCHAIN_IMAGES,
+    OPTION_CPU_TIME,
+    OPTION_GPU_TIME,
+    OPTION_PRESENT_LATENCY,
+    OPTION_WAKEUP,
+    OPTION_HELP,
+  };
+
+  static const struct option longOptions[] = {
+    { "duration",         required_argument, NULL, OPTION_DURATION },
+    { "seed",             required_argument, NULL, OPTION_SEED },
+    { "low-latency",      no_argument,       NULL, OPTION_LOW_LATENCY },
+    { "frame-rate",       required_argument, NULL, OPTION_FRAME_RATE },
+    { "profile",          required_argument, NULL, OPTION_PROFILE },
+    { "display",          required_argument, NULL, OPTION_DISPLAY },
+    { "refresh",          required_argument, NULL, OPTION_REFRESH },
+    { "vrr-range",        required_argument, NULL, OPTION_VRR_RANGE },
+    { "swapchain-images", required_argument, NULL, OPTION_SWAPCHAIN_IMAGES },
+    { "cpu-time",         required_argument, NULL, OPTION_CPU_TIME },
+    { "gpu-time",         required_argument, NULL, OPTION_GPU_TIME },
+    { "present-latency",  required_argument, NULL, OPTION_PRESENT_LATENCY },
+    { "wakeup",           required_argument, NULL, OPTION_WAKEUP },
+    { "help",             no_argument,       NULL, OPTION_HELP },
+    { NULL, 0, NULL, 0 }
+  };
+
+  paceSimDefaults(config);
+
+  double min, max;
+  struct SimDistribution *distribution;
+
+  int option;
+  while ((option = getopt_long(argc, argv, "", longOptions, NULL)) != -1) {
+    switch (option) {
+    case OPTION_DURATION:         config->durationSec = atof(optarg); break;
+    case OPTION_SEED:             config->seed = strtoul(optarg, NULL, 0); break;
+    case OPTION_LOW_LATENCY:      config->lowLatency = true; break;
+    case OPTION_REFRESH:          config->refreshRateHz = atof(optarg); break;
+    case OPTION_SWAPCHAIN_IMAGES: config->swapchainImages = atoi(optarg); break;
+    case OPTION_FRAME_RATE:
+      if (!parseRange(optarg, &min, &max)) {
+        fprintf(stderr, "Invalid frame rate range '%s', expected MIN-MAX\n", optarg);
+        return false;
+      }
+      config->frameRateMin = (int)min;
+      config->frameRateMax = (int)max;
+      break;
+    case OPTION_PROFILE:
+      /* Not scenarioParseProfile(), scenario.o needs the Vulkan code */
+      if (strcmp(optarg, "sine") == 0) {
+        config->profile = FRAME_RATE_PROFILE_SINE;
+      } else if (strcmp(optarg, "ramp") == 0) {
+        config->profile = FRAME_RATE_PROFILE_RAMP;
+      } else if (strcmp(optarg, "constant") == 0) {
+        config->profile = FRAME_RATE_PROFILE_CONSTANT;
+      } else {
+        fprintf(stderr, "Unknown frame rate profile '%s'\n", optarg);
+        return false;
+      }
+      break;
+    case OPTION_DISPLAY:
+      if (strcmp(optarg, "fixed") == 0) {
+        config->display = PACE_SIM_DISPLAY_FIXED;
+      } else if (strcmp(optarg, "vrr") == 0) {
+        config->display = PACE_SIM_DISPLAY_VRR;
+      } else if (strcmp(optarg, "immediate") == 0) {
+        config->display = PACE_SIM_DISPLAY_IMMEDIATE;
+      } else {
+        fprintf(stderr, "Unknown display model '%s'\n", optarg);
+        return false;
+      }
+      break;
+    case OPTION_VRR_RANGE:
+      if (!parseRange(optarg, &config->vrrMinHz, &config->vrrMaxHz)) {
+        fprintf(stderr, "Invalid VRR range '%s', expected MIN-MAX\n", optarg);
+        return false;
+      }
+      break;
+    case OPTION_CPU_TIME:
+    case OPTION_GPU_TIME:
+    case OPTION_PRESENT_LATENCY:
+    case OPTION_WAKEUP:
+      distribution = option == OPTION_CPU_TIME ? &config->cpuTime
+        : option == OPTION_GPU_TIME ? &config->gpuTime
+        : option == OPTION_PRESENT_LATENCY ? &config->presentLatency
+        : &config->wakeupLatency;
+      if (!simDistributionParse(optarg, distribution)) {
+        fprintf(stderr, "Invalid distribution '%s', expected MEAN[:SPREAD[:TYPE]] in milliseconds\n", optarg);
+        return false;
+      }
+      break;
+    case OPTION_HELP:
+    default:
+      printUsage(argv[0]);
+      return false;
+    }
+  }
+
+  if (config->durationSec <= 0.0 || config->refreshRateHz <= 0.0) {
+    fprintf(stderr, "Duration and refresh rate must be positive\n");
+    return false;
+  }
+  if (config->swapchainImages < 2 || config->swapchainImages > 8) {
+    fprintf(stderr, "Swapchain image count must be 2 to 8\n");
+    return false;
+  }
+
+  return true;
+}
+
+static void printDistribution(const char *name, const struct SimDistribution *distribution)
+{
+  printf("  %-16s %.2f ms, spread %.2f ms, %s\n", name, distribution->meanSec * 1000.0,
+         distribution->spreadSec * 1000.0, simDistributionName(distribution->type));
+}
+
+static void printSummary(const char *name, const struct SeriesSummary *summary)
+{
+  if (summary->count == 0) {
+    return;
+  }
+
+  printf("  %-16s mean %.3f  p50 %.3f  p99 %.3f  max %.3f ms\n", name, summary->mean * 1000.0,
+         summary->p50 * 1000.0, summary->p99 * 1000.0, summary->max * 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+  struct PaceSimConfig config;
+
+  if (!parseOptions(&config, argc, argv)) {
+    return 1;
+  }
+
+  printf("Simulating %.0f s, seed %u, %s pacing, %s display at %.3f Hz",
+         config.durationSec, config.seed, config.lowLatency ? "low latency" : "sleep after frame",
+         paceSimDisplayName(config.display), config.refreshRateHz);
+  if (config.display == PACE_SIM_DISPLAY_VRR) {
+    printf(" (VRR %.0f-%.0f Hz)", config.vrrMinHz, config.vrrMaxHz > 0.0 ? config.vrrMaxHz : config.refreshRateHz);
+  }
+  printf("\n");
+  printDistribution("cpu time", &config.cpuTime);
+  printDistribution("gpu time", &config.gpuTime);
+  printDistribution("present latency", &config.presentLatency);
+  printDistribution("wake-up", &config.wakeupLatency);
+
+  struct PaceSimResult result;
+  if (!paceSimRun(&config, &result)) {
+    fprintf(stderr, "Simulation failed\n");
+    return 1;
+  }
+
+  printf("%llu frames in %.1f s simulated, %.2f s wall (%.0fx)\n",
+         (unsigned long long)result.frames, result.simulatedSec, result.wallSec,
+         result.wallSec > 0.0 ? result.simulatedSec / result.wallSec : 0.0);
+  printSummary("cadence error", &result.cadenceErrorSec);
+  printSummary("start to present", &result.latencySec);
+  printSummary("wake-up lateness", &result.wakeupLatenessSec);
+  if (config.lowLatency) {
+    printf("  pacer            %llu on time, %llu late\n",
+           (unsigned long long)result.pacerHits, (unsigned long long)result.pacerMisses);
+  }
+  printf("  smoothness       judder %.2f%%, %llu duplicated, %llu skipped\n", result.judderScore,
+         (unsigned long long)result.duplicated, (unsigned long long)result.skipped);
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include <math.h>
+#include <string.h>
+
+#include "log.h"
+#include "smoothness.h"
+
+int smoothnessInitialize(struct SmoothnessAnalyzer *analyzer, double speedPxPerSec, double wrapPx)
+{
+  memset(analyzer, 0, sizeof(*analyzer));
+
+  if (!statsSeriesInitialize(&analyzer->errorPx, 4096)) {
+    return 0;
+  }
+
+  analyzer->speedPxPerSec = speedPxPerSec;
+  analyzer->wrapPx = wrapPx;
+
+  return 1;
+}
+
+void smoothnessFinalize(struct SmoothnessAnalyzer *analyzer)
+{
+  statsSeriesFinalize(&analyzer->errorPx);
+}
+
+void smoothnessReset(struct SmoothnessAnalyzer *analyzer)
+{
+  statsSeriesReset(&analyzer->errorPx);
+  analyzer->sumSquaredErrorPx = 0.0;
+  analyzer->sumIdealDeltaPx = 0.0;
+  analyzer->duplicated = 0;
+  analyzer->skipped = 0;
+  analyzer->predictedIntervals = 0;
+}
+
+void smoothnessFrameSubmitted(struct SmoothnessAnalyzer *analyzer, uint64_t frameId, double positionPx)
+{
+  struct SmoothnessFrame *frame = &analyzer->frames[frameId % SMOOTHNESS_HISTORY_SIZE];
+
+  frame->frameId = frameId;
+  frame->positionPx = positionPx;
+}
+
+bool smoothnessFramePresented(struct SmoothnessAnalyzer *analyzer, const PresentTiming *timing,
+                              struct SmoothnessSample *sample)
+{
+  struct SmoothnessFrame *frame = &analyzer->frames[timing->frameId % SMOOTHNESS_HISTORY_SIZE];
+  if (frame->frameId != timing->frameId) {
+    return false;
+  }
+
+  /* Only consecutive frames: a gap in the timings would span several steps */
+  bool comparable = analyzer->lastFrameId != 0 && analyzer->lastFrameId + 1 == timing->frameId;
+
+  if (comparable) {
+    sample->displayIntervalSec = timing->presentTimeSec - analyzer->lastPresentTimeSec;
+    sample->idealDeltaPx = analyzer->speedPxPerSec * sample->displayIntervalSec;
+
+    sample->renderedDeltaPx = frame->positionPx - analyzer->lastPositionPx;
+    if (sample->renderedDeltaPx < 0.0) {
+      sample->renderedDeltaPx += analyzer->wrapPx;
+    }
+
+    sample->errorPx = sample->renderedDeltaPx - sample->idealDeltaPx;
+
+    sample->cadence = SMOOTHNESS_CADENCE_OK;
+    if (sample->renderedDeltaPx < 0.5 * sample->idealDeltaPx) {
+      sample->cadence = SMOOTHNESS_CADENCE_DUPLICATED;
+      analyzer->duplicated++;
+    } else if (sample->renderedDeltaPx > 1.5 * sample->idealDeltaPx) {
+      sample->cadence = SMOOTHNESS_CADENCE_SKIPPED;
+      analyzer->skipped++;
+    }
+
+    statsSeriesAdd(&analyzer->errorPx, fabs(sample->errorPx));
+    analyzer->sumSquaredErrorPx += sample->errorPx * sample->errorPx;
+    analyzer->sumIdealDeltaPx += sample->idealDeltaPx;
+
+    /* Queue present times only approximate the display interval */
+    if (!timing->presentTimeIsDisplayed) {
+      analyzer->predictedIntervals++;
+    }
+  }
+
+  analyzer->lastFrameId = timing->frameId;
+  analyzer->lastPresentTimeSec = timing->presentTimeSec;
+  analyzer->lastPositionPx = frame->positionPx;
+
+  return comparable;
+}
+
+double smoothnessJudderScore(struct SmoothnessAnalyzer *analyzer)
+{
+  uint64_t count = analyzer->errorPx.count;
+  if (count == 0 || analyzer->sumIdealDeltaPx <= 0.0) {
+    return 0.0;
+  }
+
+  double rmsErrorPx = sqrt(analyzer->sumSquaredErrorPx / count);
+  double meanIdealDeltaPx = analyzer->sumIdealDeltaPx / count;
+
+  return 100.0 * rmsErrorPx / meanIdealDeltaPx;
+}
+
+void smoothnessPrintReport(struct SmoothnessAnalyzer *analyzer)
+{
+  struct SeriesSummary summary;
+  statsSeriesSummarize(&analyzer->errorPx, &summary);
+
+  if (summary.count == 0) {
+    return;
+  }
+
+  logInfo("Smoothness: n=%llu position error mean %.2f  p99 %.2f  max %.2f px, duplicated %llu, skipped %llu, judder %.1f%%%s",
+          (unsigned long long)summary.count, summary.mean, summary.p99, summary.max,
+          (unsigned long long)analyzer->duplicated, (unsigned long long)analyzer->skipped,
+          smoothnessJudderScore(analyzer),
+          analyzer->predictedIntervals > 0 ? " (queue present times)" : "");
+}
@@ -0,0 +1,75 @@
+#ifndef __SMOOTHNESS_H__
+#define __SMOOTHNESS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stats.h"
+#include "vulkan.h"
+
+#define SMOOTHNESS_HISTORY_SIZE 64
+
+/* Cadence of a displayed frame compared with the ideal motion */
+enum SmoothnessCadence
+{
+  SMOOTHNESS_CADENCE_OK,
+  SMOOTHNESS_CADENCE_DUPLICATED, /* Bar moved less than half of the ideal step */
+  SMOOTHNESS_CADENCE_SKIPPED,    /* Bar moved more than one and a half ideal steps */
+};
+
+struct SmoothnessSample
+{
+  double displayIntervalSec;
+  double idealDeltaPx;
+  double renderedDeltaPx;
+  double errorPx;                /* renderedDeltaPx - idealDeltaPx */
+  enum SmoothnessCadence cadence;
+};
+
+struct SmoothnessFrame
+{
+  uint64_t frameId;
+  double positionPx;
+};
+
+/*
+ * Compares how far the bar moved between two displayed frames with how far
+ * it should have moved at constant speed during the time between their
+ * presents. The animation advances by the frame start to frame start time,
+ * so any difference between that and the display interval shows up as
+ * position error.
+ *
+ * The judder score is the RMS position error relative to the mean ideal
+ * step, in percent: 0 for perfectly smooth motion.
+ */
+struct SmoothnessAnalyzer
+{
+  double speedPxPerSec;
+  double wrapPx;                 /* Bar jumps back by this distance at the edge */
+
+  struct SmoothnessFrame frames[SMOOTHNESS_HISTORY_SIZE];
+  uint64_t lastFrameId;
+  double lastPresentTimeSec;
+  double lastPositionPx;
+
+  struct SampleSeries errorPx;   /* Absolute error */
+  double sumSquaredErrorPx;
+  double sumIdealDeltaPx;
+  uint64_t duplicated;
+  uint64_t skipped;
+  uint64_t predictedIntervals;
+};
+
+int smoothnessInitialize(struct SmoothnessAnalyzer *analyzer, double speedPxPerSec, double wrapPx);
+void smoothnessFinalize(struct SmoothnessAnalyzer *analyzer);
+void smoothnessReset(struct SmoothnessAnalyzer *analyzer);
+
+void smoothnessFrameSubmitted(struct SmoothnessAnalyzer *analyzer, uint64_t frameId, double positionPx);
+/* Returns false when the frame has no predecessor to compare with */
+bool smoothnessFramePresented(struct SmoothnessAnalyzer *analyzer, const PresentTiming *timing,
+                              struct SmoothnessSample *sample);
+
+double smoothnessJudderScore(struct SmoothnessAnalyzer *analyzer);
+void smoothnessPrintReport(struct SmoothnessAnalyzer *analyzer);
+
+#endif /* __SMOOTHNESS_H__ */
@@ -0,0 +1,95 @@
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+int statsSeriesInitialize(struct SampleSeries *series, size_t capacity)
+{
+  memset(series, 0, sizeof(*series));
+
+  /* Allocated once, adding a sample never allocates */
+  series->samples = calloc(capacity, sizeof(*series->samples));
+  series->scratch = calloc(capacity, sizeof(*series->scratch));
+  if (series->samples == NULL || series->scratch == NULL) {
+    statsSeriesFinalize(series);
+    return 0;
+  }
+
+  series->capacity = capacity;
+  statsSeriesReset(series);
+
+  return 1;
+}
+
+void statsSeriesFinalize(struct SampleSeries *series)
+{
+  free(series->samples);
+  free(series->scratch);
+  series->samples = NULL;
+  series->scratch = NULL;
+  series->capacity = 0;
+}
+
+void statsSeriesReset(struct SampleSeries *series)
+{
+  series->head = 0;
+  series->stored = 0;
+  series->count = 0;
+  series->sum = 0.0;
+  series->min = DBL_MAX;
+  series->max = -DBL_MAX;
+}
+
+void statsSeriesAdd(struct SampleSeries *series, double value)
+{
+  if (series->capacity == 0) {
+    return;
+  }
+
+  series->samples[series->head] = value;
+  series->head = (series->head + 1) % series->capacity;
+  if (series->stored < series->capacity) {
+    series->stored++;
+  }
+
+  series->count++;
+  series->sum += value;
+  if (value < series->min) series->min = value;
+  if (value > series->max) series->max = value;
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t count, double p)
+{
+  size_t index = (size_t)(p * (count - 1) + 0.5);
+  return sorted[index];
+}
+
+void statsSeriesSummarize(struct SampleSeries *series, struct SeriesSummary *summary)
+{
+  memset(summary, 0, sizeof(*summary));
+
+  if (series->count == 0) {
+    return;
+  }
+
+  summary->count = series->count;
+  summary->min = series->min;
+  summary->max = series->max;
+  summary->mean = series->sum / series->count;
+
+  memcpy(series->scratch, series->samples, series->stored * sizeof(*series->scratch));
+  qsort(series->scratch, series->stored, sizeof(*series->scratch), compareDouble);
+
+  summary->p50 = percentile(series->scratch, series->stored, 0.50);
+  summary->p90 = percentile(series->scratch, series->stored, 0.90);
+  summary->p99 = percentile(series->scratch, series->stored, 0.99);
+}
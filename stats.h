@@ -0,0 +1,43 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Series of samples. The last `capacity` samples are kept for percentiles,
+ * count/min/max/mean cover every sample since the last reset.
+ */
+struct SampleSeries
+{
+  double *samples;
+  double *scratch;
+  size_t capacity;
+  size_t head;
+  size_t stored;
+
+  uint64_t count;
+  double sum;
+  double min;
+  double max;
+};
+
+struct SeriesSummary
+{
+  uint64_t count;
+  double min;
+  double mean;
+  double p50;
+  double p90;
+  double p99;
+  double max;
+};
+
+int statsSeriesInitialize(struct SampleSeries *series, size_t capacity);
+void statsSeriesFinalize(struct SampleSeries *series);
+void statsSeriesReset(struct SampleSeries *series);
+
+void statsSeriesAdd(struct SampleSeries *series, double value);
+void statsSeriesSummarize(struct SampleSeries *series, struct SeriesSummary *summary);
+
+#endif /* __STATS_H__ */
@@ -0,0 +1,313 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <NVCtrl/NVCtrl.h>
+#include <NVCtrl/NVCtrlLib.h>
+
+#include "clock.h"
+#include "log.h"
+#include "telemetry.h"
+
+/**
+ * Sources
+ *
+ * Only telemetryInitialize() (before the thread starts) and the sampler
+ * thread itself talk to the source.
+ */
+
+struct TelemetrySource
+{
+  const char *name;
+
+  int  (*open)(struct TelemetrySampler *sampler);
+  void (*close)(struct TelemetrySampler *sampler);
+
+  void (*sample)(struct TelemetrySampler *sampler, struct TelemetrySample *sample);
+};
+
+/*
+ * NV-CONTROL source
+ */
+
+static int nvctrlOpen(struct TelemetrySampler *sampler)
+{
+  int eventBase, errorBase, value;
+
+  sampler->dpy = XOpenDisplay(NULL);
+  if (!sampler->dpy) {
+    logError("Cannot open display '%s'.", XDisplayName(NULL));
+    return 0;
+  }
+
+  if (!XNVCTRLQueryExtension(sampler->dpy, &eventBase, &errorBase)) {
+    logError("The NV-CONTROL X extension does not exist on '%s'.", XDisplayName(NULL));
+    return 0;
+  }
+
+  if (!XNVCTRLQueryTargetAttribute(sampler->dpy, NV_CTRL_TARGET_TYPE_GPU, sampler->gpu, 0,
+                                   NV_CTRL_GPU_CURRENT_CLOCK_FREQS, &value)) {
+    logError("The NV-CONTROL GPU clock attribute is not available on '%s'.", XDisplayName(NULL));
+    return 0;
+  }
+
+  return 1;
+}
+
+static void nvctrlClose(struct TelemetrySampler *sampler)
+{
+  if (sampler->dpy != NULL) {
+    XCloseDisplay(sampler->dpy);
+    sampler->dpy = NULL;
+  }
+}
+
+/* "graphics=45, memory=6, video=0, PCIe=0" */
+static int parseUtilization(const char *utilization, const char *key)
+{
+  const char *field = strstr(utilization, key);
+  int value;
+
+  if (field == NULL || sscanf(field + strlen(key), "%d", &value) != 1) {
+    return -1;
+  }
+
+  return value;
+}
+
+static void nvctrlSample(struct TelemetrySampler *sampler, struct TelemetrySample *sample)
+{
+  int value;
+  char *utilization = NULL;
+
+  /* Graphics clock in the high 16 bits, memory clock in the low ones */
+  if (XNVCTRLQueryTargetAttribute(sampler->dpy, NV_CTRL_TARGET_TYPE_GPU, sampler->gpu, 0,
+                                  NV_CTRL_GPU_CURRENT_CLOCK_FREQS, &value)) {
+    sample->graphicsClockMHz = (value >> 16) & 0xffff;
+    sample->memoryClockMHz = value & 0xffff;
+  }
+
+  if (XNVCTRLQueryTargetAttribute(sampler->dpy, NV_CTRL_TARGET_TYPE_GPU, sampler->gpu, 0,
+                                  NV_CTRL_GPU_CORE_TEMPERATURE, &value)) {
+    sample->temperatureC = value;
+  }
+
+  if (XNVCTRLQueryTargetStringAttribute(sampler->dpy, NV_CTRL_TARGET_TYPE_GPU, sampler->gpu, 0,
+                                        NV_CTRL_STRING_GPU_UTILIZATION, &utilization)) {
+    sample->graphicsUtilization = parseUtilization(utilization, "graphics=");
+    sample->memoryUtilization = parseUtilization(utilization, "memory=");
+    XFree(utilization);
+  }
+}
+
+static const struct TelemetrySource g_nvctrlSource = {
+  .name   = "NV-CONTROL",
+  .open   = nvctrlOpen,
+  .close  = nvctrlClose,
+  .sample = nvctrlSample,
+};
+
+/*
+ * Mock source
+ *
+ * The graphics clock switches between two performance levels every few
+ * seconds, the way a boosting GPU does, utilization is random and the
+ * temperature warms up towards a plateau.
+ */
+
+#define MOCK_PERFORMANCE_LEVEL_SEC 3.0
+
+static int mockOpen(struct TelemetrySampler *sampler)
+{
+  sampler->mockSeed = 1;
+  sampler->mockStartSec = clockNowSec();
+
+  return 1;
+}
+
+static void mockClose(struct TelemetrySampler *sampler)
+{
+}
+
+static void mockSample(struct TelemetrySampler *sampler, struct TelemetrySample *sample)
+{
+  double elapsedSec = sample->timeSec - sampler->mockStartSec;
+  bool boosted = (int)(elapsedSec / MOCK_PERFORMANCE_LEVEL_SEC) % 2 == 0;
+
+  sample->graphicsClockMHz = (boosted ? 1900 : 1400) + rand_r(&sampler->mockSeed) % 30;
+  sample->memoryClockMHz = boosted ? 7000 : 5000;
+  sample->graphicsUtilization = 30 + rand_r(&sampler->mockSeed) % 40;
+  sample->memoryUtilization = 5 + rand_r(&sampler->mockSeed) % 10;
+  sample->temperatureC = (int)(75.0 - 35.0 * exp(-elapsedSec / 60.0));
+}
+
+static const struct TelemetrySource g_mockSource = {
+  .name   = "mock",
+  .open   = mockOpen,
+  .close  = mockClose,
+  .sample = mockSample,
+};
+
+/**
+ * Sampler thread
+ */
+
+static void *telemetryThread(void *arg)
+{
+  struct TelemetrySampler *sampler = arg;
+  double deadlineSec = clockNowSec();
+
+  pthread_mutex_lock(&sampler->lock);
+
+  while (atomic_load(&sampler->running)) {
+    pthread_mutex_unlock(&sampler->lock);
+
+    struct TelemetrySample sample = { clockNowSec(), -1, -1, -1, -1, -1 };
+    sampler->source->sample(sampler, &sample);
+
+    pthread_mutex_lock(&sampler->lock);
+    sampler->samples[sampler->count % TELEMETRY_RING_SIZE] = sample;
+    sampler->count++;
+
+    /* Fixed rate: deadlines do not drift with the sampling time */
+    deadlineSec += sampler->intervalSec;
+    struct timespec deadline;
+    deadline.tv_sec = (time_t)deadlineSec;
+    deadline.tv_nsec = (long)((deadlineSec - deadline.tv_sec) * 1000000000.0);
+
+    while (atomic_load(&sampler->running) && clockNowSec() < deadlineSec) {
+      pthread_cond_timedwait(&sampler->wakeup, &sampler->lock, &deadline);
+    }
+  }
+
+  pthread_mutex_unlock(&sampler->lock);
+
+  return NULL;
+}
+
+/**
+ * Public API
+ */
+
+int telemetryInitialize(struct TelemetrySampler *sampler, enum TelemetrySourceType type, double rateHz)
+{
+  memset(sampler, 0, sizeof(*sampler));
+
+  sampler->source = type == TELEMETRY_SOURCE_MOCK ? &g_mockSource : &g_nvctrlSource;
+  sampler->intervalSec = 1.0 / rateHz;
+  sampler->gpu = 0;
+  atomic_init(&sampler->running, false);
+
+  sampler->samples = calloc(TELEMETRY_RING_SIZE, sizeof(*sampler->samples));
+  if (sampler->samples == NULL) {
+    logError("Cannot allocate the GPU telemetry ring.");
+    return 0;
+  }
+
+  if (!sampler->source->open(sampler)) {
+    sampler->source->close(sampler);
+    free(sampler->samples);
+    sampler->samples = NULL;
+    return 0;
+  }
+
+  /* Deadlines are on the monotonic clock, like clockNowSec() */
+  pthread_condattr_t condAttr;
+  pthread_condattr_init(&condAttr);
+  pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+  pthread_cond_init(&sampler->wakeup, &condAttr);
+  pthread_condattr_destroy(&condAttr);
+  pthread_mutex_init(&sampler->lock, NULL);
+
+  atomic_store(&sampler->running, true);
+  if (pthread_create(&sampler->thread, NULL, telemetryThread, sampler) != 0) {
+    logError("Cannot start the %s GPU telemetry sampler.", sampler->source->name);
+    atomic_store(&sampler->running, false);
+    pthread_cond_destroy(&sampler->wakeup);
+    pthread_mutex_destroy(&sampler->lock);
+    sampler->source->close(sampler);
+    free(sampler->samples);
+    sampler->samples = NULL;
+    return 0;
+  }
+
+  logInfo("GPU telemetry: %s, %.1f Hz", sampler->source->name, rateHz);
+
+  return 1;
+}
+
+void telemetryFinalize(struct TelemetrySampler *sampler)
+{
+  if (sampler->samples == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&sampler->lock);
+  bool running = atomic_exchange(&sampler->running, false);
+  pthread_cond_signal(&sampler->wakeup);
+  pthread_mutex_unlock(&sampler->lock);
+
+  if (running) {
+    pthread_join(sampler->thread, NULL);
+  }
+
+  pthread_cond_destroy(&sampler->wakeup);
+  pthread_mutex_destroy(&sampler->lock);
+  sampler->source->close(sampler);
+
+  free(sampler->samples);
+  sampler->samples = NULL;
+  sampler->count = 0;
+}
+
+bool telemetryIsRunning(struct TelemetrySampler *sampler)
+{
+  return atomic_load(&sampler->running);
+}
+
+const char *telemetrySourceName(struct TelemetrySampler *sampler)
+{
+  return sampler->source != NULL ? sampler->source->name : "none";
+}
+
+bool telemetryLatest(struct TelemetrySampler *sampler, struct TelemetrySample *sample)
+{
+  if (sampler->samples == NULL) {
+    return false;
+  }
+
+  pthread_mutex_lock(&sampler->lock);
+  bool available = sampler->count > 0;
+  if (available) {
+    *sample = sampler->samples[(sampler->count - 1) % TELEMETRY_RING_SIZE];
+  }
+  pthread_mutex_unlock(&sampler->lock);
+
+  return available;
+}
+
+uint64_t telemetryCopySamples(struct TelemetrySampler *sampler, struct TelemetrySample *samples, uint64_t capacity)
+{
+  if (sampler->samples == NULL) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&sampler->lock);
+
+  uint64_t stored = sampler->count < TELEMETRY_RING_SIZE ? sampler->count : TELEMETRY_RING_SIZE;
+  uint64_t copied = stored < capacity ? stored : capacity;
+  uint64_t first = sampler->count - copied;
+
+  for (uint64_t i = 0; i < copied; i++) {
+    samples[i] = sampler->samples[(first + i) % TELEMETRY_RING_SIZE];
+  }
+
+  pthread_mutex_unlock(&sampler->lock);
+
+  return copied;
+}
@@ -0,0 +1,72 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <X11/Xlib.h>
+
+/* About 1h50 at 10 Hz */
+#define TELEMETRY_RING_SIZE 65536
+
+enum TelemetrySourceType
+{
+  TELEMETRY_SOURCE_NVCTRL,
+  TELEMETRY_SOURCE_MOCK,
+};
+
+/* -1 when the source does not report the value */
+struct TelemetrySample
+{
+  double timeSec; /* clockNowSec() */
+  int graphicsClockMHz;
+  int memoryClockMHz;
+  int graphicsUtilization; /* Percent */
+  int memoryUtilization;
+  int temperatureC;
+};
+
+struct TelemetrySource;
+
+/*
+ * GPU state sampled at a fixed rate by a background thread into a
+ * timestamped ring, to correlate frame time spikes with clock changes.
+ * The NV-CONTROL source opens its own X connection: the one of the G-SYNC
+ * controller belongs to its worker thread. The mock source synthesizes
+ * clock steps, utilization and temperature without NVIDIA hardware.
+ */
+struct TelemetrySampler
+{
+  const struct TelemetrySource *source;
+  Display *dpy;
+  int gpu;
+  double intervalSec;
+
+  pthread_t thread;
+  atomic_bool running;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+
+  /* Guarded by lock, count is the number of samples ever taken */
+  struct TelemetrySample *samples;
+  uint64_t count;
+
+  /* Mock source state */
+  unsigned int mockSeed;
+  double mockStartSec;
+};
+
+/* Returns 0 and leaves the sampler disabled when the source is unavailable */
+int telemetryInitialize(struct TelemetrySampler *sampler, enum TelemetrySourceType type, double rateHz);
+void telemetryFinalize(struct TelemetrySampler *sampler);
+
+bool telemetryIsRunning(struct TelemetrySampler *sampler);
+const char *telemetrySourceName(struct TelemetrySampler *sampler);
+
+/* Last sample, false when none was taken yet */
+bool telemetryLatest(struct TelemetrySampler *sampler, struct TelemetrySample *sample);
+/* Samples still in the ring, oldest first, returns how many were copied */
+uint64_t telemetryCopySamples(struct TelemetrySampler *sampler, struct TelemetrySample *samples, uint64_t capacity);
+
+#endif /* __TELEMETRY_H__ */
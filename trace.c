@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "trace.h"
+
+int traceInitialize(struct Trace *trace, const char *path, uint64_t capacity, uint64_t firstFrameId)
+{
+  memset(trace, 0, sizeof(*trace));
+
+  if (path == NULL) {
+    return 1;
+  }
+
+  trace->records = calloc(capacity, sizeof(*trace->records));
+  if (trace->records == NULL) {
+    logError("Cannot allocate trace of %llu frames.", (unsigned long long)capacity);
+    return 0;
+  }
+
+  trace->capacity = capacity;
+  trace->firstFrameId = firstFrameId;
+  trace->path = path;
+
+  return 1;
+}
+
+void traceFinalize(struct Trace *trace)
+{
+  free(trace->records);
+  trace->records = NULL;
+  trace->capacity = 0;
+  trace->count = 0;
+  trace->path = NULL;
+  trace->telemetry = NULL;
+}
+
+bool traceIsEnabled(struct Trace *trace)
+{
+  return trace->path != NULL;
+}
+
+/* Frame ids are sequential */
+static struct TraceRecord *traceRecord(struct Trace *trace, uint64_t frameId)
+{
+  if (frameId < trace->firstFrameId || frameId - trace->firstFrameId >= trace->capacity) {
+    return NULL;
+  }
+
+  return &trace->records[frameId - trace->firstFrameId];
+}
+
+void traceFrameSubmitted(struct Trace *trace, uint64_t frameId, double frameStartSec, double frameIntervalSec,
+                         double submitSec, double positionPx)
+{
+  struct TraceRecord *record = traceRecord(trace, frameId);
+  if (record == NULL) {
+    return;
+  }
+
+  record->frameId = frameId;
+  record->frameStartSec = frameStartSec;
+  record->frameIntervalSec = frameIntervalSec;
+  record->submitSec = submitSec;
+  record->positionPx = positionPx;
+
+  if (frameId - trace->firstFrameId + 1 > trace->count) {
+    trace->count = frameId - trace->firstFrameId + 1;
+  }
+}
+
+void traceFrameGpu(struct Trace *trace, uint64_t frameId, double gpuSec)
+{
+  struct TraceRecord *record = traceRecord(trace, frameId);
+  if (record != NULL) {
+    record->gpuSec = gpuSec;
+  }
+}
+
+void traceFramePresented(struct Trace *trace, const PresentTiming *timing)
+{
+  struct TraceRecord *record = traceRecord(trace, timing->frameId);
+  if (record == NULL) {
+    return;
+  }
+
+  record->submitSec = timing->submitTimeSec;
+  record->presentSec = timing->presentTimeSec;
+  record->presentIsDisplayed = timing->presentTimeIsDisplayed;
+}
+
+void traceFrameSmoothness(struct Trace *trace, uint64_t frameId, const struct SmoothnessSample *sample)
+{
+  struct TraceRecord *record = traceRecord(trace, frameId);
+  if (record == NULL) {
+    return;
+  }
+
+  record->hasSmoothness = true;
+  record->smoothness = *sample;
+}
+
+void traceAttachTelemetry(struct Trace *trace, struct TelemetrySampler *telemetry)
+{
+  trace->telemetry = telemetry;
+}
+
+/* Empty fields for the values the source does not report */
+static void writeTelemetryValue(FILE *file, int value, char separator)
+{
+  if (value >= 0) {
+    fprintf(file, "%d%c", value, separator);
+  } else {
+    fprintf(file, "%c", separator);
+  }
+}
+
+static void writeTelemetry(FILE *file, const struct TelemetrySample *sample)
+{
+  if (sample == NULL) {
+    fprintf(file, ",,,,\n");
+    return;
+  }
+
+  writeTelemetryValue(file, sample->graphicsClockMHz, ',');
+  writeTelemetryValue(file, sample->memoryClockMHz, ',');
+  writeTelemetryValue(file, sample->graphicsUtilization, ',');
+  writeTelemetryValue(file, sample->memoryUtilization, ',');
+  writeTelemetryValue(file, sample->temperatureC, '\n');
+}
+
+bool traceWrite(struct Trace *trace)
+{
+  if (trace->path == NULL) {
+    return true;
+  }
+
+  FILE *file = fopen(trace->path, "w");
+  if (file == NULL) {
+    logError("Cannot open trace file '%s'.", trace->path);
+    return false;
+  }
+
+  struct TelemetrySample *samples = NULL;
+  uint64_t sampleCount = 0;
+
+  if (trace->telemetry != NULL) {
+    samples = malloc(TELEMETRY_RING_SIZE * sizeof(*samples));
+    if (samples != NULL) {
+      sampleCount = telemetryCopySamples(trace->telemetry, samples, TELEMETRY_RING_SIZE);
+    }
+  }
+
+  fprintf(file, "frame,start_sec,interval_ms,submit_sec,present_sec,present_displayed,gpu_ms,"
+                "position_px,display_interval_ms,ideal_delta_px,rendered_delta_px,error_px,cadence%s\n",
+          samples != NULL ? ",gpu_clock_mhz,mem_clock_mhz,gpu_util,mem_util,gpu_temp_c" : "");
+
+  static const char *cadenceNames[] = { "ok", "duplicated", "skipped" };
+
+  /* Frames and samples are both in time order, next is the first sample after the frame start */
+  uint64_t next = 0;
+
+  for (uint64_t i = 0; i < trace->count; i++) {
+    const struct TraceRecord *record = &trace->records[i];
+
+    fprintf(file, "%llu,%.6f,%.3f,%.6f,%.6f,%d,%.3f,%.2f,",
+            (unsigned long long)record->frameId, record->frameStartSec, record->frameIntervalSec * 1000.0,
+            record->submitSec, record->presentSec, record->presentIsDisplayed,
+            record->gpuSec * 1000.0, record->positionPx);
+
+    if (record->hasSmoothness) {
+      const struct SmoothnessSample *sample = &record->smoothness;
+      fprintf(file, "%.3f,%.2f,%.2f,%.2f,%s",
+              sample->displayIntervalSec * 1000.0, sample->idealDeltaPx, sample->renderedDeltaPx,
+              sample->errorPx, cadenceNames[sample->cadence]);
+    } else {
+      fprintf(file, ",,,,");
+    }
+
+    if (samples == NULL) {
+      fprintf(file, "\n");
+      continue;
+    }
+
+    fprintf(file, ",");
+    while (next < sampleCount && samples[next].timeSec <= record->frameStartSec) {
+      next++;
+    }
+    writeTelemetry(file, next > 0 ? &samples[next - 1] : NULL);
+  }
+
+  fclose(file);
+  free(samples);
+  logInfo("Trace of %llu frames written to %s", (unsigned long long)trace->count, trace->path);
+
+  return true;
+}
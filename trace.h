@@ -0,0 +1,61 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "smoothness.h"
+#include "telemetry.h"
+#include "vulkan.h"
+
+/* One row per frame, filled in as the frame goes through the pipeline */
+struct TraceRecord
+{
+  uint64_t frameId;
+  double frameStartSec;
+  double frameIntervalSec;   /* Requested by the FrameRateController */
+  double submitSec;
+  double presentSec;
+  bool presentIsDisplayed;
+  double gpuSec;
+  double positionPx;
+
+  bool hasSmoothness;
+  struct SmoothnessSample smoothness;
+};
+
+/*
+ * Per-frame trace kept in memory and written as CSV on exit. Records are
+ * preallocated so tracing does no I/O or allocation in the frame loop,
+ * frames beyond the capacity are not traced.
+ */
+struct Trace
+{
+  struct TraceRecord *records;
+  uint64_t capacity;
+  uint64_t count;
+  uint64_t firstFrameId;   /* Of records[0], traces can start mid-run */
+  const char *path;
+
+  /* Optional, its samples are merged into the frame rows on write */
+  struct TelemetrySampler *telemetry;
+};
+
+/* A NULL path disables tracing, every other call is then a no-op */
+int traceInitialize(struct Trace *trace, const char *path, uint64_t capacity, uint64_t firstFrameId);
+bool traceIsEnabled(struct Trace *trace);
+void traceFinalize(struct Trace *trace);
+
+void traceFrameSubmitted(struct Trace *trace, uint64_t frameId, double frameStartSec, double frameIntervalSec,
+                         double submitSec, double positionPx);
+void traceFrameGpu(struct Trace *trace, uint64_t frameId, double gpuSec);
+void traceFramePresented(struct Trace *trace, const PresentTiming *timing);
+void traceFrameSmoothness(struct Trace *trace, uint64_t frameId, const struct SmoothnessSample *sample);
+
+/* Adds the GPU telemetry columns, each frame gets the last sample taken before it started */
+void traceAttachTelemetry(struct Trace *trace, struct TelemetrySampler *telemetry);
+
+/* Writes the CSV file */
+bool traceWrite(struct Trace *trace);
+
+#endif /* __TRACE_H__ */
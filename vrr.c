@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+#include "vrr.h"
+
+/**
+ * Mock backend
+ *
+ * Capable 48-144 Hz panel with VRR enabled, fully controllable.
+ */
+
+static int mockOpen(struct VrrController *controller)
+{
+  controller->mock.capable = true;
+  controller->mock.enabled = true;
+  controller->mock.range.minHz = 48.0;
+  controller->mock.range.maxHz = 144.0;
+
+  return 1;
+}
+
+static void mockClose(struct VrrController *controller)
+{
+}
+
+static bool mockIsCapable(struct VrrController *controller)
+{
+  return controller->mock.capable;
+}
+
+static bool mockIsEnabled(struct VrrController *controller)
+{
+  return controller->mock.enabled;
+}
+
+static bool mockSetEnabled(struct VrrController *controller, bool enable)
+{
+  controller->mock.enabled = enable && controller->mock.capable;
+  return true;
+}
+
+static bool mockGetRange(struct VrrController *controller, struct VrrRange *range)
+{
+  *range = controller->mock.range;
+  return true;
+}
+
+const struct VrrBackend vrrMockBackend = {
+  .name       = "mock",
+  .open       = mockOpen,
+  .close      = mockClose,
+  .isCapable  = mockIsCapable,
+  .isEnabled  = mockIsEnabled,
+  .setEnabled = mockSetEnabled,
+  .getRange   = mockGetRange,
+};
+
+/**
+ * Controller
+ */
+
+static bool tryBackend(struct VrrController *controller, const struct VrrBackend *backend)
+{
+  controller->backend = backend;
+
+  if (!backend->open(controller)) {
+    backend->close(controller);
+    controller->backend = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+int vrrInitialize(struct VrrController *controller, enum VrrBackendType type, enum GSyncBackendType gsyncBackend)
+{
+  memset(controller, 0, sizeof(*controller));
+  controller->gsyncBackend = gsyncBackend;
+  controller->drm.fd = -1;
+
+  switch (type) {
+  case VRR_BACKEND_AUTO:
+    if (!tryBackend(controller, &vrrNvctrlBackend)) {
+      tryBackend(controller, &vrrDrmBackend);
+    }
+    break;
+  case VRR_BACKEND_NVCTRL: tryBackend(controller, &vrrNvctrlBackend); break;
+  case VRR_BACKEND_DRM:    tryBackend(controller, &vrrDrmBackend);    break;
+  case VRR_BACKEND_MOCK:   tryBackend(controller, &vrrMockBackend);   break;
+  }
+
+  if (controller->backend == NULL) {
+    logWarning("No VRR backend available.");
+    return 0;
+  }
+
+  controller->isAvailable = true;
+
+  struct VrrRange range = { 0.0, 0.0 };
+  vrrGetRange(controller, &range);
+  logInfo("VRR backend: %s, capable: %s, enabled: %s, range: %.0f-%.0f Hz",
+         controller->backend->name,
+         vrrIsCapable(controller) ? "yes" : "no",
+         vrrIsEnabled(controller) ? "yes" : "no",
+         range.minHz, range.maxHz);
+
+  return 1;
+}
+
+void vrrFinalize(struct VrrController *controller)
+{
+  if (controller->backend != NULL) {
+    controller->backend->close(controller);
+    controller->backend = NULL;
+  }
+
+  controller->isAvailable = false;
+}
+
+bool vrrIsAvailable(struct VrrController *controller)
+{
+  return controller->isAvailable;
+}
+
+const char *vrrBackendName(struct VrrController *controller)
+{
+  return controller->backend != NULL ? controller->backend->name : "none";
+}
+
+bool vrrIsCapable(struct VrrController *controller)
+{
+  return controller->isAvailable && controller->backend->isCapable(controller);
+}
+
+bool vrrIsEnabled(struct VrrController *controller)
+{
+  return controller->isAvailable && controller->backend->isEnabled(controller);
+}
+
+bool vrrSetEnabled(struct VrrController *controller, bool enable)
+{
+  return controller->isAvailable && controller->backend->setEnabled(controller, enable);
+}
+
+bool vrrGetRange(struct VrrController *controller, struct VrrRange *range)
+{
+  return controller->isAvailable && controller->backend->getRange(controller, range);
+}
+
+void vrrShowIndicator(struct VrrController *controller, bool enable)
+{
+  if (controller->isAvailable && controller->backend->showIndicator != NULL) {
+    controller->backend->showIndicator(controller, enable);
+  }
+}
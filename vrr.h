@@ -0,0 +1,89 @@
+#ifndef __VRR_H__
+#define __VRR_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gsync.h"
+
+enum VrrBackendType
+{
+  VRR_BACKEND_AUTO,
+  VRR_BACKEND_NVCTRL,
+  VRR_BACKEND_DRM,
+  VRR_BACKEND_MOCK,
+};
+
+/* Refresh rate window in which the display follows the frame rate, 0 when unknown */
+struct VrrRange
+{
+  double minHz;
+  double maxHz;
+};
+
+struct VrrController;
+
+struct VrrBackend
+{
+  const char *name;
+
+  int  (*open)(struct VrrController *controller);
+  void (*close)(struct VrrController *controller);
+
+  bool (*isCapable)(struct VrrController *controller);
+  bool (*isEnabled)(struct VrrController *controller);
+  /* Returns false when the backend is not permitted to change the state */
+  bool (*setEnabled)(struct VrrController *controller, bool enable);
+  bool (*getRange)(struct VrrController *controller, struct VrrRange *range);
+
+  /* Optional, NULL when the backend has no on-screen indicator */
+  void (*showIndicator)(struct VrrController *controller, bool enable);
+};
+
+struct VrrDrmState
+{
+  int fd;
+  uint32_t connectorId;
+  uint32_t crtcId;
+  uint32_t vrrEnabledPropertyId;
+  bool capable;
+  struct VrrRange range;
+};
+
+struct VrrMockState
+{
+  bool capable;
+  bool enabled;
+  struct VrrRange range;
+};
+
+struct VrrController
+{
+  bool isAvailable;
+  const struct VrrBackend *backend;
+
+  /* Backend specific state */
+  enum GSyncBackendType gsyncBackend;
+  struct GSyncController gsync;
+  struct VrrDrmState drm;
+  struct VrrMockState mock;
+};
+
+extern const struct VrrBackend vrrNvctrlBackend;
+extern const struct VrrBackend vrrDrmBackend;
+extern const struct VrrBackend vrrMockBackend;
+
+/* VRR_BACKEND_AUTO tries NV-CONTROL first, then DRM/KMS */
+int vrrInitialize(struct VrrController *controller, enum VrrBackendType type, enum GSyncBackendType gsyncBackend);
+void vrrFinalize(struct VrrController *controller);
+
+bool vrrIsAvailable(struct VrrController *controller);
+const char *vrrBackendName(struct VrrController *controller);
+
+bool vrrIsCapable(struct VrrController *controller);
+bool vrrIsEnabled(struct VrrController *controller);
+bool vrrSetEnabled(struct VrrController *controller, bool enable);
+bool vrrGetRange(struct VrrController *controller, struct VrrRange *range);
+void vrrShowIndicator(struct VrrController *controller, bool enable);
+
+#endif /* __VRR_H__ */
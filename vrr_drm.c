@@ -0,0 +1,248 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "log.h"
+#include "vrr.h"
+
+/**
+ * DRM/KMS backend
+ *
+ * Reads the connector "vrr_capable" and CRTC "VRR_ENABLED" properties of the
+ * first connected output (preferring a VRR capable one) and the range limits
+ * from its EDID. Changing VRR_ENABLED needs DRM master, which the X server
+ * normally holds; there the state follows the X driver's VariableRefresh option.
+ */
+
+#define DRM_MAX_CARDS 16
+
+static bool findProperty(int fd, uint32_t objectId, uint32_t objectType, const char *name,
+                         uint32_t *propertyId, uint64_t *value)
+{
+  bool found = false;
+
+  drmModeObjectPropertiesPtr properties = drmModeObjectGetProperties(fd, objectId, objectType);
+  if (properties == NULL) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < properties->count_props && !found; i++) {
+    drmModePropertyPtr property = drmModeGetProperty(fd, properties->props[i]);
+    if (property == NULL) {
+      continue;
+    }
+
+    if (strcmp(property->name, name) == 0) {
+      if (propertyId != NULL) {
+        *propertyId = property->prop_id;
+      }
+      if (value != NULL) {
+        *value = properties->prop_values[i];
+      }
+      found = true;
+    }
+
+    drmModeFreeProperty(property);
+  }
+
+  drmModeFreeObjectProperties(properties);
+  return found;
+}
+
+/* Display range limits descriptor (tag 0xFD) of the EDID base block */
+static bool parseEdidRange(const uint8_t *edid, uint32_t length, struct VrrRange *range)
+{
+  if (length < 128) {
+    return false;
+  }
+
+  for (int offset = 54; offset <= 108; offset += 18) {
+    const uint8_t *descriptor = &edid[offset];
+
+    if (descriptor[0] != 0 || descriptor[1] != 0 || descriptor[3] != 0xFD) {
+      continue;
+    }
+
+    /* EDID 1.4 rate offsets: bit 1 adds 255 Hz to the max, bits 1:0 == 11 to the min too */
+    int minHz = descriptor[5] + ((descriptor[4] & 0x03) == 0x03 ? 255 : 0);
+    int maxHz = descriptor[6] + ((descriptor[4] & 0x02) ? 255 : 0);
+
+    range->minHz = minHz;
+    range->maxHz = maxHz;
+    return true;
+  }
+
+  return false;
+}
+
+static void readEdidRange(int fd, uint32_t connectorId, struct VrrRange *range)
+{
+  uint64_t blobId = 0;
+
+  if (!findProperty(fd, connectorId, DRM_MODE_OBJECT_CONNECTOR, "EDID", NULL, &blobId) || blobId == 0) {
+    return;
+  }
+
+  drmModePropertyBlobPtr blob = drmModeGetPropertyBlob(fd, blobId);
+  if (blob != NULL) {
+    parseEdidRange(blob->data, blob->length, range);
+    drmModeFreePropertyBlob(blob);
+  }
+}
+
+static uint32_t connectorCrtc(int fd, drmModeConnectorPtr connector)
+{
+  uint32_t crtcId = 0;
+
+  drmModeEncoderPtr encoder = drmModeGetEncoder(fd, connector->encoder_id);
+  if (encoder != NULL) {
+    crtcId = encoder->crtc_id;
+    drmModeFreeEncoder(encoder);
+  }
+
+  return crtcId;
+}
+
+/* Pick the first active connector, preferring a VRR capable one */
+static bool selectConnector(int fd, struct VrrDrmState *drm)
+{
+  drmModeResPtr resources = drmModeGetResources(fd);
+  if (resources == NULL) {
+    return false;
+  }
+
+  bool found = false;
+
+  for (int i = 0; i < resources->count_connectors && !(found && drm->capable); i++) {
+    drmModeConnectorPtr connector = drmModeGetConnector(fd, resources->connectors[i]);
+    if (connector == NULL) {
+      continue;
+    }
+
+    uint32_t crtcId = 0;
+    if (connector->connection == DRM_MODE_CONNECTED) {
+      crtcId = connectorCrtc(fd, connector);
+    }
+
+    if (crtcId != 0) {
+      uint64_t capable = 0;
+      findProperty(fd, connector->connector_id, DRM_MODE_OBJECT_CONNECTOR, "vrr_capable", NULL, &capable);
+
+      if (!found || (capable && !drm->capable)) {
+        drm->connectorId = connector->connector_id;
+        drm->crtcId = crtcId;
+        drm->capable = capable != 0;
+        found = true;
+      }
+    }
+
+    drmModeFreeConnector(connector);
+  }
+
+  drmModeFreeResources(resources);
+  return found;
+}
+
+static int drmOpen(struct VrrController *controller)
+{
+  struct VrrDrmState *drm = &controller->drm;
+
+  for (int card = 0; card < DRM_MAX_CARDS; card++) {
+    char path[32];
+    snprintf(path, sizeof(path), "/dev/dri/card%d", card);
+
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+
+    memset(drm, 0, sizeof(*drm));
+    drm->fd = -1;
+
+    if (selectConnector(fd, drm)
+        && findProperty(fd, drm->crtcId, DRM_MODE_OBJECT_CRTC, "VRR_ENABLED", &drm->vrrEnabledPropertyId, NULL)) {
+      drm->fd = fd;
+      readEdidRange(fd, drm->connectorId, &drm->range);
+
+      /* Only needed for VRR_ENABLED writes, which may still be refused without master */
+      drmSetClientCap(fd, DRM_CLIENT_CAP_ATOMIC, 1);
+      return 1;
+    }
+
+    close(fd);
+  }
+
+  logWarning("No DRM/KMS connector exposing VRR properties found.");
+  return 0;
+}
+
+static void drmClose(struct VrrController *controller)
+{
+  if (controller->drm.fd >= 0) {
+    close(controller->drm.fd);
+    controller->drm.fd = -1;
+  }
+}
+
+static bool drmIsCapable(struct VrrController *controller)
+{
+  return controller->drm.capable;
+}
+
+static bool drmIsEnabled(struct VrrController *controller)
+{
+  uint64_t enabled = 0;
+
+  findProperty(controller->drm.fd, controller->drm.crtcId, DRM_MODE_OBJECT_CRTC, "VRR_ENABLED", NULL, &enabled);
+  return enabled != 0;
+}
+
+static bool drmSetEnabled(struct VrrController *controller, bool enable)
+{
+  struct VrrDrmState *drm = &controller->drm;
+
+  drmModeAtomicReqPtr request = drmModeAtomicAlloc();
+  if (request == NULL) {
+    return false;
+  }
+
+  drmModeAtomicAddProperty(request, drm->crtcId, drm->vrrEnabledPropertyId, enable ? 1 : 0);
+  int result = drmModeAtomicCommit(drm->fd, request, 0, NULL);
+  drmModeAtomicFree(request);
+
+  if (result != 0) {
+    logError("Cannot set VRR_ENABLED on CRTC %u: %s", drm->crtcId, strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+static bool drmGetRange(struct VrrController *controller, struct VrrRange *range)
+{
+  if (controller->drm.range.maxHz <= 0.0) {
+    return false;
+  }
+
+  *range = controller->drm.range;
+  return true;
+}
+
+const struct VrrBackend vrrDrmBackend = {
+  .name       = "DRM/KMS",
+  .open       = drmOpen,
+  .close      = drmClose,
+  .isCapable  = drmIsCapable,
+  .isEnabled  = drmIsEnabled,
+  .setEnabled = drmSetEnabled,
+  .getRange   = drmGetRange,
+};
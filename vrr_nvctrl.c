@@ -0,0 +1,56 @@
+#include "vrr.h"
+
+/**
+ * NV-CONTROL backend
+ *
+ * Thin wrapper around the cached GSyncController (screen 0).
+ */
+
+static int nvctrlOpen(struct VrrController *controller)
+{
+  return gsyncInitializeWithBackend(&controller->gsync, controller->gsyncBackend);
+}
+
+static void nvctrlClose(struct VrrController *controller)
+{
+  gsyncFinalize(&controller->gsync);
+}
+
+static bool nvctrlIsCapable(struct VrrController *controller)
+{
+  /* NV_CTRL_GSYNC_ALLOWED is only exposed by G-SYNC capable setups */
+  return gsyncIsAvailable(&controller->gsync);
+}
+
+static bool nvctrlIsEnabled(struct VrrController *controller)
+{
+  return gsyncIsAllowed(&controller->gsync);
+}
+
+static bool nvctrlSetEnabled(struct VrrController *controller, bool enable)
+{
+  gsyncSetAllowed(&controller->gsync, enable);
+  return true;
+}
+
+static bool nvctrlGetRange(struct VrrController *controller, struct VrrRange *range)
+{
+  /* NV-CONTROL does not report the panel range */
+  return false;
+}
+
+static void nvctrlShowIndicator(struct VrrController *controller, bool enable)
+{
+  gsyncShowVisualIndicator(&controller->gsync, enable);
+}
+
+const struct VrrBackend vrrNvctrlBackend = {
+  .name          = "NV-CONTROL",
+  .open          = nvctrlOpen,
+  .close         = nvctrlClose,
+  .isCapable     = nvctrlIsCapable,
+  .isEnabled     = nvctrlIsEnabled,
+  .setEnabled    = nvctrlSetEnabled,
+  .getRange      = nvctrlGetRange,
+  .showIndicator = nvctrlShowIndicator,
+};
@@ -0,0 +1,262 @@
+#include <math.h>
+#include <string.h>
+
+#include "log.h"
+#include "vrrprobe.h"
+
+/* Lowest frame rate of the sweep, the highest is this much above the refresh rate */
+#define VRR_PROBE_MIN_RATE         10
+#define VRR_PROBE_OVERSHOOT        1.15
+
+/* Per step: frames of the previous rate drain and the display adapts, then the measurement */
+#define VRR_PROBE_SETTLE_SEC       0.5
+#define VRR_PROBE_MEASURE_SEC      2.0
+#define VRR_PROBE_MIN_INTERVALS    8
+#define VRR_PROBE_SERIES_SIZE      1024
+
+/* Relative tolerance of "equal" intervals */
+#define VRR_PROBE_TOLERANCE        0.03
+/* Fraction of the intervals on the refresh grid for a fixed refresh cadence */
+#define VRR_PROBE_FIXED_FRACTION   0.8
+/* Spread, in refresh periods, of frames waiting for a repeated scanout to end */
+#define VRR_PROBE_LFC_SPREAD       0.2
+
+/* Indexed by VrrProbeCadence */
+static const char *g_cadenceNames[] = { "no data", "tracking", "LFC", "fixed refresh", "capped", "unstable", "on grid" };
+
+int vrrProbeInitialize(struct VrrProbe *probe, int stepHz, double refreshRateHz, const struct VrrRange *reported)
+{
+  memset(probe, 0, sizeof(*probe));
+
+  if (!statsSeriesInitialize(&probe->intervalSec, VRR_PROBE_SERIES_SIZE)
+      || !statsSeriesInitialize(&probe->deviationSec, VRR_PROBE_SERIES_SIZE)) {
+    vrrProbeFinalize(probe);
+    return 0;
+  }
+
+  probe->refreshPeriodSec = 1.0 / refreshRateHz;
+  probe->reported = *reported;
+  probe->presentTimesDisplayed = true;
+
+  /* From above the refresh rate down to the floor, on multiples of the step */
+  int firstRate = (int)ceil(refreshRateHz * VRR_PROBE_OVERSHOOT / stepHz) * stepHz;
+  int stepCount = (firstRate - VRR_PROBE_MIN_RATE) / stepHz + 1;
+  if (stepCount > VRR_PROBE_MAX_STEPS) {
+    stepHz = (firstRate - VRR_PROBE_MIN_RATE + VRR_PROBE_MAX_STEPS - 2) / (VRR_PROBE_MAX_STEPS - 1);
+    logWarning("VRR probe limited to %d steps, using %d fps steps", VRR_PROBE_MAX_STEPS, stepHz);
+  }
+
+  for (int rate = firstRate; rate >= VRR_PROBE_MIN_RATE && probe->stepCount < VRR_PROBE_MAX_STEPS; rate -= stepHz) {
+    probe->steps[probe->stepCount++].frameRate = rate;
+  }
+
+  logInfo("VRR probe: %d to %d fps in %d steps, about %.0f s",
+          firstRate, probe->steps[probe->stepCount - 1].frameRate, probe->stepCount,
+          probe->stepCount * (VRR_PROBE_SETTLE_SEC + VRR_PROBE_MEASURE_SEC));
+
+  return 1;
+}
+
+void vrrProbeFinalize(struct VrrProbe *probe)
+{
+  statsSeriesFinalize(&probe->intervalSec);
+  statsSeriesFinalize(&probe->deviationSec);
+}
+
+void vrrProbeStart(struct VrrProbe *probe, double nowSec)
+{
+  probe->stepIndex = 0;
+  probe->stepStartSec = nowSec;
+  probe->lastPresentSec = 0.0;
+}
+
+bool vrrProbeIsDone(struct VrrProbe *probe)
+{
+  return probe->stepIndex >= probe->stepCount;
+}
+
+int vrrProbeFrameRate(struct VrrProbe *probe)
+{
+  if (vrrProbeIsDone(probe)) {
+    return 0;
+  }
+
+  return probe->steps[probe->stepIndex].frameRate;
+}
+
+void vrrProbePresented(struct VrrProbe *probe, const PresentTiming *timing)
+{
+  if (vrrProbeIsDone(probe)) {
+    return;
+  }
+
+  double lastPresentSec = probe->lastPresentSec;
+  probe->lastPresentSec = timing->presentTimeSec;
+
+  /* Both presents must be from the settled part of the step */
+  double measureStartSec = probe->stepStartSec + VRR_PROBE_SETTLE_SEC;
+  if (lastPresentSec < measureStartSec) {
+    return;
+  }
+
+  if (!timing->presentTimeIsDisplayed) {
+    probe->presentTimesDisplayed = false;
+  }
+
+  double intervalSec = timing->presentTimeSec - lastPresentSec;
+  double frameIntervalSec = 1.0 / probe->steps[probe->stepIndex].frameRate;
+
+  statsSeriesAdd(&probe->intervalSec, intervalSec);
+  statsSeriesAdd(&probe->deviationSec, fabs(intervalSec - frameIntervalSec));
+
+  long periods = lround(intervalSec / probe->refreshPeriodSec);
+  if (periods >= 1
+      && fabs(intervalSec - periods * probe->refreshPeriodSec) < VRR_PROBE_TOLERANCE * probe->refreshPeriodSec) {
+    probe->quantized++;
+  }
+}
+
+static enum VrrProbeCadence classifyStep(struct VrrProbe *probe, const struct VrrProbeStep *step)
+{
+  if (step->intervals < VRR_PROBE_MIN_INTERVALS) {
+    return VRR_PROBE_NO_DATA;
+  }
+
+  double frameIntervalSec = 1.0 / step->frameRate;
+  double periodSec = probe->refreshPeriodSec;
+
+  if (step->medianIntervalSec > frameIntervalSec * (1.0 + VRR_PROBE_TOLERANCE)
+      && fabs(step->medianIntervalSec - periodSec) < VRR_PROBE_TOLERANCE * periodSec) {
+    return VRR_PROBE_CAPPED;
+  }
+
+  /* A frame interval on the refresh grid looks the same with and without VRR */
+  double periods = round(frameIntervalSec / periodSec);
+  bool onGrid = periods >= 1.0 && fabs(frameIntervalSec - periods * periodSec) < VRR_PROBE_TOLERANCE * periodSec;
+  if (!onGrid && step->quantizedFraction >= VRR_PROBE_FIXED_FRACTION) {
+    return VRR_PROBE_FIXED;
+  }
+
+  if (fabs(step->medianIntervalSec - frameIntervalSec) < VRR_PROBE_TOLERANCE * frameIntervalSec) {
+    /* Below the panel's minimum refresh rate every frame is necessarily scanned out more than once */
+    if (step->spreadSec > VRR_PROBE_LFC_SPREAD * periodSec) {
+      return VRR_PROBE_LFC;
+    }
+    if (onGrid) {
+      return VRR_PROBE_ON_GRID;
+    }
+    if (probe->reported.minHz > 0.0 && step->frameRate < probe->reported.minHz) {
+      return VRR_PROBE_LFC;
+    }
+    return VRR_PROBE_TRACKING;
+  }
+
+  return VRR_PROBE_UNSTABLE;
+}
+
+static void finishStep(struct VrrProbe *probe)
+{
+  struct VrrProbeStep *step = &probe->steps[probe->stepIndex];
+  struct SeriesSummary interval, deviation;
+
+  statsSeriesSummarize(&probe->intervalSec, &interval);
+  statsSeriesSummarize(&probe->deviationSec, &deviation);
+
+  step->intervals = interval.count;
+  step->medianIntervalSec = interval.p50;
+  step->spreadSec = deviation.p90;
+  step->quantizedFraction = interval.count > 0 ? (double)probe->quantized / interval.count : 0.0;
+  step->cadence = classifyStep(probe, step);
+
+  logInfo("VRR probe %3d fps: median %.2f ms, spread %.2f ms, %3.0f%% on the refresh grid, %s",
+          step->frameRate, step->medianIntervalSec * 1000.0, step->spreadSec * 1000.0,
+          step->quantizedFraction * 100.0, g_cadenceNames[step->cadence]);
+
+  statsSeriesReset(&probe->intervalSec);
+  statsSeriesReset(&probe->deviationSec);
+  probe->quantized = 0;
+}
+
+/* Steps go from the highest to the lowest frame rate */
+static void analyze(struct VrrProbe *probe)
+{
+  struct VrrProbeResult *result = &probe->result;
+  memset(result, 0, sizeof(*result));
+
+  int i = 0;
+  while (i < probe->stepCount && probe->steps[i].cadence != VRR_PROBE_TRACKING) {
+    if (probe->steps[i].cadence == VRR_PROBE_CAPPED) {
+      result->capped = probe->steps[i].frameRate;
+    }
+    i++;
+  }
+
+  if (i == probe->stepCount) {
+    return;
+  }
+
+  /* On-grid steps inside the run don't break it, the edges are tracking steps */
+  result->windowMax = probe->steps[i].frameRate;
+  while (i < probe->stepCount
+         && (probe->steps[i].cadence == VRR_PROBE_TRACKING || probe->steps[i].cadence == VRR_PROBE_ON_GRID)) {
+    if (probe->steps[i].cadence == VRR_PROBE_TRACKING) {
+      result->windowMin = probe->steps[i].frameRate;
+    }
+    i++;
+  }
+
+  for (; i < probe->stepCount; i++) {
+    enum VrrProbeCadence cadence = probe->steps[i].cadence;
+
+    if (cadence == VRR_PROBE_LFC && result->lfcOnset == 0) {
+      result->lfcOnset = probe->steps[i].frameRate;
+    } else if ((cadence == VRR_PROBE_FIXED || cadence == VRR_PROBE_UNSTABLE) && result->fixedOnset == 0) {
+      result->fixedOnset = probe->steps[i].frameRate;
+    }
+  }
+}
+
+bool vrrProbeUpdate(struct VrrProbe *probe, double nowSec)
+{
+  if (vrrProbeIsDone(probe) || nowSec - probe->stepStartSec < VRR_PROBE_SETTLE_SEC + VRR_PROBE_MEASURE_SEC) {
+    return false;
+  }
+
+  finishStep(probe);
+
+  probe->stepIndex++;
+  probe->stepStartSec = nowSec;
+
+  if (vrrProbeIsDone(probe)) {
+    analyze(probe);
+  }
+
+  return true;
+}
+
+void vrrProbePrintReport(struct VrrProbe *probe)
+{
+  const struct VrrProbeResult *result = &probe->result;
+
+  if (!probe->presentTimesDisplayed) {
+    logWarning("VRR probe measured vkQueuePresentKHR returns, not displayed present times");
+  }
+
+  if (result->windowMax == 0) {
+    logInfo("VRR probe: the display did not follow any frame rate, VRR is likely off");
+    return;
+  }
+
+  logInfo("VRR probe: effective window %d-%d fps (backend reports %.0f-%.0f Hz)",
+          result->windowMin, result->windowMax, probe->reported.minHz, probe->reported.maxHz);
+
+  if (result->capped != 0) {
+    logInfo("VRR probe: held at the max refresh rate from %d fps up", result->capped);
+  }
+  if (result->lfcOnset != 0) {
+    logInfo("VRR probe: frames repeated (LFC) from %d fps down", result->lfcOnset);
+  }
+  if (result->fixedOnset != 0) {
+    logInfo("VRR probe: cadence collapses to the fixed refresh grid at %d fps", result->fixedOnset);
+  }
+}
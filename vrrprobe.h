@@ -0,0 +1,92 @@
+#ifndef __VRRPROBE_H__
+#define __VRRPROBE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stats.h"
+#include "vrr.h"
+#include "vulkan.h"
+
+#define VRR_PROBE_MAX_STEPS 64
+
+/* How the display followed a constant frame rate */
+enum VrrProbeCadence
+{
+  VRR_PROBE_NO_DATA,
+  VRR_PROBE_TRACKING,  /* Present interval follows the frame interval */
+  VRR_PROBE_LFC,       /* Follows it on average, but frames wait for repeated scanouts */
+  VRR_PROBE_FIXED,     /* Intervals are whole numbers of refresh periods */
+  VRR_PROBE_CAPPED,    /* Faster than the panel, held at its max refresh rate */
+  VRR_PROBE_UNSTABLE,  /* None of the above */
+  VRR_PROBE_ON_GRID,   /* Tracked, but the frame interval is on the refresh grid: fixed refresh looks the same */
+};
+
+struct VrrProbeStep
+{
+  int frameRate;
+  uint64_t intervals;
+  double medianIntervalSec;
+  double spreadSec;          /* p90 of |present interval - frame interval| */
+  double quantizedFraction;  /* Intervals within a few percent of a multiple of the refresh period */
+  enum VrrProbeCadence cadence;
+};
+
+/* Frame rates, 0 when not found */
+struct VrrProbeResult
+{
+  int windowMin;
+  int windowMax;
+  int lfcOnset;              /* Highest rate below the window with repeated scanouts */
+  int fixedOnset;            /* Highest rate below the window collapsing to fixed refresh */
+  int capped;                /* Lowest rate above the window held at the max refresh rate */
+};
+
+/*
+ * VRR range probe. Sweeps constant frame rates from above the refresh rate
+ * down to a few Hz, one step at a time: each step lets the cadence settle,
+ * then measures the present intervals and classifies them. The effective
+ * VRR window is the run of steps the display tracks (on-grid steps neither
+ * extend nor break it, at least one off-grid step has to track), below it either
+ * low framerate compensation repeats frames (the intervals still track on
+ * average but spread by up to a scanout) or the cadence collapses onto the
+ * fixed refresh grid.
+ *
+ * Present wait (displayed) timestamps are needed for meaningful results,
+ * vkQueuePresentKHR return times only show the queueing.
+ */
+struct VrrProbe
+{
+  double refreshPeriodSec;   /* At the max refresh rate */
+  struct VrrRange reported;  /* From the VRR backend, 0 when unknown */
+
+  struct VrrProbeStep steps[VRR_PROBE_MAX_STEPS];
+  int stepCount;
+  int stepIndex;
+  double stepStartSec;
+
+  double lastPresentSec;
+  bool presentTimesDisplayed;
+  struct SampleSeries intervalSec;
+  struct SampleSeries deviationSec;
+  uint64_t quantized;
+
+  struct VrrProbeResult result;
+};
+
+int vrrProbeInitialize(struct VrrProbe *probe, int stepHz, double refreshRateHz, const struct VrrRange *reported);
+void vrrProbeFinalize(struct VrrProbe *probe);
+
+/* Starts measuring the first step at nowSec */
+void vrrProbeStart(struct VrrProbe *probe, double nowSec);
+bool vrrProbeIsDone(struct VrrProbe *probe);
+/* Frame rate of the current step */
+int vrrProbeFrameRate(struct VrrProbe *probe);
+
+void vrrProbePresented(struct VrrProbe *probe, const PresentTiming *timing);
+/* Returns true when the probe moved to the next step or finished */
+bool vrrProbeUpdate(struct VrrProbe *probe, double nowSec);
+
+void vrrProbePrintReport(struct VrrProbe *probe);
+
+#endif /* __VRRPROBE_H__ */
@@ -1,20 +1,35 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "vulkan.h"
 #include <X11/Xlib.h>
 
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+#include "clock.h"
+#include "hostalloc.h"
+#include "log.h"
 
 #include "rectangle_frag.spv.h"
+#include "rectangle_ubo_vert.spv.h"
 #include "rectangle_vert.spv.h"
 
-#define USE_DIRECT_DISPLAY 0
 #define VULKAN_DEBUG 0
 
 #define VK_KHR_XLIB_SURFACE_EXTENSION_NAME         "VK_KHR_xlib_surface"
 #define VK_EXT_ACQUIRE_XLIB_DISPLAY_EXTENSION_NAME "VK_EXT_acquire_xlib_display"
 
-#if USE_DIRECT_DISPLAY
 typedef VkResult (VKAPI_PTR *PFN_vkAcquireXlibDisplayEXT)(VkPhysicalDevice physicalDevice, Display* dpy, VkDisplayKHR display);
-#endif
 
 // Global variables declaration
 //
@@ -29,31 +44,232 @@ static VkPhysicalDeviceMemoryProperties  g_physicalDeviceMemoryProperties;
 static VkQueueFamilyProperties          *g_queueFamilyProperties;
 static VkDevice                          g_device;
 static VkQueue                           g_presentQueue;
-static VkCommandPool                     g_commandPool;
-static VkCommandBuffer                   g_cmdBufferDraw;
-
-static VkSurfaceKHR                      g_surface;
-static VkSwapchainKHR                    g_swapchain;
-static VkSurfaceCapabilitiesKHR          g_surfaceCapabilities;
-static VkSurfaceFormatKHR                g_surfaceFormat;
-static VkExtent2D                        g_swapchainExtent;
-static VkImage                          *g_swapchainImages;
-static VkImageView                      *g_colorImageViews;
-static uint32_t                          g_swapchainImageCount;
+// Outputs submit and present from their own threads, the queue is shared
+static pthread_mutex_t                   g_queueLock = PTHREAD_MUTEX_INITIALIZER;
 
+// Render pass path only, dynamic rendering doesn't need it
 static VkRenderPass                      g_renderPass;
-static VkFramebuffer                    *g_framebuffers;
-static VkFence                           g_renderFence;
-static VkSemaphore                       g_renderSemaphore, g_presentSemaphore;
+
+// With VK_KHR_timeline_semaphore every submission signals its frame id on
+// the timeline in place of the render fence
+static SDL_bool                          g_timelineSemaphoreEnabled;
 
 static VkPipelineLayout                  g_pipelineLayout;
-static VkPipeline                        g_pipeline;
+
+// Test patterns: one pipeline per VulkanPattern, compiled in parallel at
+// startup through a shared cache, so switching only changes the bound one
+static VkPipelineCache                   g_pipelineCache;
+static VkPipeline                        g_pipelines[VULKAN_PATTERN_COUNT];
+static VulkanPattern                     g_pattern;
+
+static VulkanConfig                      g_config;
+static SDL_bool                          g_dynamicRenderingEnabled;
+static SDL_bool                          g_directDisplayExtensionsEnabled;
+static Display                          *g_xlibDisplay;
+static VkDisplayKHR                      g_acquiredDisplay;
+
+// Present timing
+//
+#define PRESENT_TIMING_QUEUE_SIZE 64
+#define PRESENT_WAIT_TIMEOUT_NS   500000
+// Bounds the wait for the last presents at exit
+#define PRESENT_DRAIN_TIMEOUT_SEC 0.1
+
+typedef struct PresentTimingQueue_t {
+  PresentTiming entries[PRESENT_TIMING_QUEUE_SIZE];
+  uint32_t      head;
+  uint32_t      count;
+} PresentTimingQueue;
+
+static SDL_bool                          g_presentWaitEnabled;
+
+// Indexed by VulkanPresentMode
+static const VkPresentModeKHR g_vkPresentModes[] = {
+  VK_PRESENT_MODE_FIFO_KHR,
+  VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+  VK_PRESENT_MODE_MAILBOX_KHR,
+  VK_PRESENT_MODE_IMMEDIATE_KHR,
+};
+
+static const char *g_presentModeNames[] = {
+  "fifo",
+  "fifo-relaxed",
+  "mailbox",
+  "immediate",
+};
+
+// Specialization constants of a pattern, see the constant_id of the shaders
+typedef struct PatternConstants_t {
+  float   barWidth;       // NDC, 2 is the screen width
+  float   color[3];
+  int32_t loadIterations; // Fragment shader math, per fragment
+} PatternConstants;
+
+// Indexed by VulkanPattern
+static const PatternConstants g_patternConstants[] = {
+  { 0.1f,  { 0.9f, 0.9f, 0.9f }, 0 },
+  { 0.02f, { 0.9f, 0.9f, 0.9f }, 0 },
+  { 0.4f,  { 0.9f, 0.9f, 0.9f }, 0 },
+  { 0.1f,  { 0.9f, 0.1f, 0.1f }, 0 },
+  { 0.1f,  { 0.9f, 0.9f, 0.9f }, 2048 },
+};
+
+static const char *g_patternNames[] = {
+  "default",
+  "thin",
+  "wide",
+  "red",
+  "gpu-load",
+};
+
+static const VkSpecializationMapEntry g_patternMapEntries[] = {
+  { 0, offsetof(PatternConstants, barWidth), sizeof(float) },
+  { 1, offsetof(PatternConstants, color), sizeof(float) },
+  { 2, offsetof(PatternConstants, color) + sizeof(float), sizeof(float) },
+  { 3, offsetof(PatternConstants, color) + 2 * sizeof(float), sizeof(float) },
+  { 4, offsetof(PatternConstants, loadIterations), sizeof(int32_t) },
+};
+
+// Pre-recorded command buffers, one per swapchain image, with the per-frame
+// data in a persistently mapped uniform buffer (one slice per image)
+//
+static VkDescriptorSetLayout             g_descriptorSetLayout;
 
 typedef struct Position_t {
   float x;
 } Position;
 
-static Position delta = { 0.0f };
+// Damage tracking: only the band covering the bar's old and new position is
+// rendered, on top of the content the swapchain image kept from its last use
+//
+static SDL_bool                          g_damageTrackingEnabled;
+static SDL_bool                          g_incrementalPresentEnabled;
+static VkRenderPass                      g_damageRenderPass;
+
+// Host allocations: every object is created with the allocation callbacks of
+// its type, Draw() and the recording threads' work for it are the frame path
+// once the output rendered its warm-up frames
+//
+#define HOST_ALLOCATION_WARMUP_FRAMES 120
+
+static struct HostAllocator              g_hostAllocator;
+
+// Frame capture: the frame's submission also copies the swapchain image to a
+// host visible staging buffer of the output's ring, handed to the writer
+// thread once the frame completed. The ring is never waited for, a frame
+// finding its staging buffer still being written is dropped.
+//
+#define CAPTURE_RING_SIZE 4
+
+typedef struct CaptureBuffer_t {
+  VkBuffer                  buffer;
+  VkDeviceMemory            memory;
+  void                     *mapped;
+  VkCommandBuffer           commandBuffer;
+  uint64_t                  frameId;      // Copy in flight, 0 when none
+  atomic_bool               busy;         // Until the writer is done with it
+} CaptureBuffer;
+
+static struct CaptureWriter              g_captureWriter;
+
+// Outputs: a surface and swapchain per display with everything needed to
+// render and pace frames on it, all sharing the device and the pipeline
+//
+typedef struct VulkanOutput_t {
+  VkSurfaceKHR              surface;
+  VkSwapchainKHR            swapchain;
+  VkSurfaceCapabilitiesKHR  surfaceCapabilities;
+  VkSurfaceFormatKHR        surfaceFormat;
+  VkExtent2D                swapchainExtent;
+  VkImage                  *swapchainImages;
+  VkImageView              *colorImageViews;
+  uint32_t                  swapchainImageCount;
+  VulkanPresentMode         presentMode;
+  uint32_t                  displayRefreshRateMilliHz;
+
+  VkCommandPool             commandPool;
+  VkCommandBuffer           cmdBufferDraw;
+
+  // Render pass path only, dynamic rendering doesn't need them
+  VkFramebuffer            *framebuffers;
+
+  VkFence                   renderFence;
+  VkSemaphore               renderSemaphore, presentSemaphore;
+  VkSemaphore               timelineSemaphore;
+  uint64_t                  completedFrameId;
+
+  // Present timing
+  uint64_t                  frameId;
+  pthread_mutex_t           swapchainLock;
+  pthread_mutex_t           presentTimingLock;
+  pthread_cond_t            presentTimingCond;
+  PresentTimingQueue        pendingPresents;
+  PresentTimingQueue        completedPresents;
+  pthread_t                 presentWaiter;
+  SDL_bool                  presentWaiterRunning;
+
+  // GPU timing
+  VkQueryPool               timestampQueryPool;
+  SDL_bool                  timestampsPending;
+  double                    gpuFrameDurationSec;
+  double                    recordingDurationSec;
+
+  // Pre-recorded command buffers
+  VkCommandBuffer          *imageCmdBuffers;
+  VkDescriptorPool          descriptorPool;
+  VkDescriptorSet          *descriptorSets;
+  VkBuffer                  uniformBuffer;
+  VkDeviceMemory            uniformMemory;
+  void                     *uniformMapped;
+  VkDeviceSize              uniformStride;
+
+  Position                  delta;
+
+  // Damage tracking
+  VkRect2D                 *imageBarRects;
+  SDL_bool                 *imageContentValid;
+  VkRect2D                  presentedBarRect;
+  SDL_bool                  presentedBarRectValid;
+  VkRect2D                  damageRect;
+  SDL_bool                  damageLoadsContent;
+  double                    damageFraction;
+
+  // Frame capture, the swapchain images are transfer sources when supported
+  SDL_bool                  captureSupported;
+  CaptureBuffer             captureBuffers[CAPTURE_RING_SIZE];
+  uint32_t                  captureNext;
+} VulkanOutput;
+
+static VulkanOutput                      g_outputs[VULKAN_MAX_OUTPUTS];
+static uint32_t                          g_outputCount;
+// Output used by the calling thread, see BindOutput()
+static _Thread_local VulkanOutput       *g_output = &g_outputs[0];
+
+// Parallel recording into secondary command buffers. Draw() waits for the
+// previous frame before recording, so a single frame is in flight and each
+// thread's pool for the slot can be reset right away.
+//
+#define FRAMES_IN_FLIGHT 1
+
+typedef struct RecordThread_t {
+  pthread_t        thread;
+  sem_t            start;
+  uint32_t         index;
+  VkCommandPool    commandPools[FRAMES_IN_FLIGHT];
+  VkCommandBuffer  commandBuffers[FRAMES_IN_FLIGHT];
+
+  // Job of the current frame
+  uint32_t         imageIndex;
+  uint32_t         frameSlot;
+  SDL_bool         framePath;  // Past the host allocation warm-up
+  double           recordingDurationSec;
+} RecordThread;
+
+static RecordThread                     *g_recordThreads;
+static uint32_t                          g_recordThreadCount;
+static uint32_t                          g_recordThreadsStarted;
+static SDL_bool                          g_recordThreadsRunning;
+static sem_t                             g_recordDone;
 
 // Config
 //
@@ -65,13 +281,14 @@ static const char* g_enabledValidationLayers[] = {
 
 const char* g_requiredInstanceExtensions[] = {
   VK_KHR_SURFACE_EXTENSION_NAME,
-  VK_KHR_XLIB_SURFACE_EXTENSION_NAME,
-#if USE_DIRECT_DISPLAY
+  VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
+};
+
+// Enabled only when all of them are exposed by the loader
+const char* g_directDisplayInstanceExtensions[] = {
   VK_KHR_DISPLAY_EXTENSION_NAME,
   VK_EXT_DIRECT_MODE_DISPLAY_EXTENSION_NAME,
   VK_EXT_ACQUIRE_XLIB_DISPLAY_EXTENSION_NAME,
-#endif
-  VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
 };
 
 const char* g_requiredDeviceExtensions[] = {
@@ -84,13 +301,24 @@ const char* g_requiredDeviceExtensions[] = {
 static PFN_vkCreateDebugReportCallbackEXT SDL2_vkCreateDebugReportCallbackEXT;
 #endif
 
-#if USE_DIRECT_DISPLAY
 static PFN_vkAcquireXlibDisplayEXT pfn_vkAcquireXlibDisplayEXT = VK_NULL_HANDLE;
-#endif
+static PFN_vkReleaseDisplayEXT pfn_vkReleaseDisplayEXT = VK_NULL_HANDLE;
+static PFN_vkGetPhysicalDeviceFeatures2KHR pfn_vkGetPhysicalDeviceFeatures2KHR = VK_NULL_HANDLE;
+static PFN_vkWaitForPresentKHR pfn_vkWaitForPresentKHR = VK_NULL_HANDLE;
+static PFN_vkWaitSemaphoresKHR pfn_vkWaitSemaphoresKHR = VK_NULL_HANDLE;
+static PFN_vkGetSemaphoreCounterValueKHR pfn_vkGetSemaphoreCounterValueKHR = VK_NULL_HANDLE;
+static PFN_vkCmdBeginRenderingKHR pfn_vkCmdBeginRenderingKHR = VK_NULL_HANDLE;
+static PFN_vkCmdEndRenderingKHR pfn_vkCmdEndRenderingKHR = VK_NULL_HANDLE;
 
 
 // ------ Helper functions -----
 //
+// NULL unless host allocations are tracked
+static const VkAllocationCallbacks *allocationCallbacks(enum HostObjectType type)
+{
+  return hostAllocatorCallbacks(&g_hostAllocator, type);
+}
+
 static SDL_bool prepareShaderModule(uint32_t* shaderBinary, int shaderSize, VkShaderModule *pShaderModule)
 {
   VkShaderModuleCreateInfo shaderInfo = {};
@@ -98,15 +326,203 @@ static SDL_bool prepareShaderModule(uint32_t* shaderBinary, int shaderSize, VkSh
   shaderInfo.codeSize = shaderSize;
   shaderInfo.pCode = shaderBinary;
 
-  VkResult result = vkCreateShaderModule(g_device, &shaderInfo, VK_NULL_HANDLE, pShaderModule);
+  VkResult result = vkCreateShaderModule(g_device, &shaderInfo, allocationCallbacks(HOST_OBJECT_SHADER_MODULE), pShaderModule);
   if (result != VK_SUCCESS) {
-    printf("Failed to create shader module \n");
+    logError("Failed to create shader module");
+    return SDL_FALSE;
+  }
+
+  return SDL_TRUE;
+}
+
+static SDL_bool isInstanceExtensionSupported(const char *extensionName)
+{
+  uint32_t extensionCount = 0;
+  vkEnumerateInstanceExtensionProperties(VK_NULL_HANDLE, &extensionCount, VK_NULL_HANDLE);
+
+  VkExtensionProperties extensions[extensionCount + 1];
+  vkEnumerateInstanceExtensionProperties(VK_NULL_HANDLE, &extensionCount, extensions);
+
+  for (uint32_t i = 0; i < extensionCount; i++) {
+    if (strcmp(extensions[i].extensionName, extensionName) == 0) {
+      return SDL_TRUE;
+    }
+  }
+
+  return SDL_FALSE;
+}
+
+static SDL_bool isDeviceExtensionSupported(const char *extensionName)
+{
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(g_physicalDevice, VK_NULL_HANDLE, &extensionCount, VK_NULL_HANDLE);
+
+  VkExtensionProperties extensions[extensionCount + 1];
+  vkEnumerateDeviceExtensionProperties(g_physicalDevice, VK_NULL_HANDLE, &extensionCount, extensions);
+
+  for (uint32_t i = 0; i < extensionCount; i++) {
+    if (strcmp(extensions[i].extensionName, extensionName) == 0) {
+      return SDL_TRUE;
+    }
+  }
+
+  return SDL_FALSE;
+}
+
+static void pushPresentTiming(PresentTimingQueue *queue, const PresentTiming *timing)
+{
+  // Drop the oldest entry when nobody drains the queue
+  if (queue->count == PRESENT_TIMING_QUEUE_SIZE) {
+    queue->head = (queue->head + 1) % PRESENT_TIMING_QUEUE_SIZE;
+    queue->count--;
+  }
+
+  queue->entries[(queue->head + queue->count) % PRESENT_TIMING_QUEUE_SIZE] = *timing;
+  queue->count++;
+}
+
+static SDL_bool popPresentTiming(PresentTimingQueue *queue, PresentTiming *timing)
+{
+  if (queue->count == 0) {
     return SDL_FALSE;
   }
 
+  *timing = queue->entries[queue->head];
+  queue->head = (queue->head + 1) % PRESENT_TIMING_QUEUE_SIZE;
+  queue->count--;
+
   return SDL_TRUE;
 }
 
+// Waits for presented frames with VK_KHR_present_wait. The swapchain must be externally
+// synchronized, so vkWaitForPresentKHR blocks at most PRESENT_WAIT_TIMEOUT_NS while
+// holding the swapchain lock, then lets acquire/present in. It returns as soon as the
+// frame is presented: the present time is not quantized to a polling period.
+static void *presentWaiterThread(void *arg)
+{
+  g_output = arg;
+
+  pthread_mutex_lock(&g_output->presentTimingLock);
+
+  while (g_output->presentWaiterRunning) {
+    if (g_output->pendingPresents.count == 0) {
+      pthread_cond_wait(&g_output->presentTimingCond, &g_output->presentTimingLock);
+      continue;
+    }
+
+    PresentTiming timing = g_output->pendingPresents.entries[g_output->pendingPresents.head];
+    pthread_mutex_unlock(&g_output->presentTimingLock);
+
+    VkResult result = VK_TIMEOUT;
+    while (result == VK_TIMEOUT && g_output->presentWaiterRunning) {
+      pthread_mutex_lock(&g_output->swapchainLock);
+      result = pfn_vkWaitForPresentKHR(g_device, g_output->swapchain, timing.frameId, PRESENT_WAIT_TIMEOUT_NS);
+      if (result != VK_TIMEOUT) {
+        timing.presentTimeSec = clockNowSec();
+      }
+      pthread_mutex_unlock(&g_output->swapchainLock);
+
+      if (result == VK_TIMEOUT) {
+        sched_yield();
+      }
+    }
+
+    if (result == VK_TIMEOUT) {
+      timing.presentTimeSec = clockNowSec();
+    }
+    timing.presentTimeIsDisplayed = (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) ? SDL_TRUE : SDL_FALSE;
+
+    // Draw() may have pushed into a full queue meanwhile and dropped this
+    // frame's entry, only remove entries up to it
+    pthread_mutex_lock(&g_output->presentTimingLock);
+    while (g_output->pendingPresents.count > 0
+           && g_output->pendingPresents.entries[g_output->pendingPresents.head].frameId <= timing.frameId) {
+      popPresentTiming(&g_output->pendingPresents, &(PresentTiming){0});
+    }
+    pushPresentTiming(&g_output->completedPresents, &timing);
+  }
+
+  pthread_mutex_unlock(&g_output->presentTimingLock);
+  return NULL;
+}
+
+static void startPresentWaiter()
+{
+  if (!g_presentWaitEnabled) {
+    return;
+  }
+
+  g_output->presentWaiterRunning = SDL_TRUE;
+  if (pthread_create(&g_output->presentWaiter, NULL, presentWaiterThread, g_output) != 0) {
+    logWarning("Failed to start present waiter, falling back to queue present timestamps");
+    g_output->presentWaiterRunning = SDL_FALSE;
+    g_presentWaitEnabled = SDL_FALSE;
+  }
+}
+
+static void stopPresentWaiter()
+{
+  if (!g_output->presentWaiterRunning) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_output->presentTimingLock);
+  g_output->presentWaiterRunning = SDL_FALSE;
+  // Ids of a destroyed swapchain would never complete on the next one
+  g_output->pendingPresents.count = 0;
+  pthread_cond_signal(&g_output->presentTimingCond);
+  pthread_mutex_unlock(&g_output->presentTimingLock);
+
+  pthread_join(g_output->presentWaiter, NULL);
+}
+
+static double displayModeRefreshRateHz(const VkDisplayModePropertiesKHR *mode)
+{
+  // VkDisplayModeParametersKHR::refreshRate is expressed in millihertz
+  return mode->parameters.refreshRate / 1000.0;
+}
+
+// Pick the mode matching the requested resolution (if any) with the refresh rate
+// closest to the requested one, or the highest refresh rate when none was requested.
+// Ties are resolved in favour of the bigger resolution.
+static int selectDisplayMode(const VkDisplayModePropertiesKHR *modes, uint32_t modeCount,
+                             uint32_t width, uint32_t height, uint32_t refreshRateMilliHz)
+{
+  int selected = -1;
+
+  for (uint32_t i = 0; i < modeCount; i++) {
+    VkExtent2D ires = modes[i].parameters.visibleRegion;
+    uint32_t   ifreq = modes[i].parameters.refreshRate;
+
+    if ((width != 0 && ires.width != width) || (height != 0 && ires.height != height)) {
+      continue;
+    }
+
+    if (selected < 0) {
+      selected = i;
+      continue;
+    }
+
+    VkExtent2D cres = modes[selected].parameters.visibleRegion;
+    uint32_t   cfreq = modes[selected].parameters.refreshRate;
+
+    int64_t ifreqScore = ifreq;
+    int64_t cfreqScore = cfreq;
+    if (refreshRateMilliHz != 0) {
+      ifreqScore = -llabs((int64_t)ifreq - refreshRateMilliHz);
+      cfreqScore = -llabs((int64_t)cfreq - refreshRateMilliHz);
+    }
+
+    if (ifreqScore > cfreqScore
+        || (ifreqScore == cfreqScore
+            && (uint64_t)ires.width * ires.height > (uint64_t)cres.width * cres.height)) {
+      selected = i;
+    }
+  }
+
+  return selected;
+}
+
 static void beginFrame()
 {
 
@@ -130,18 +546,49 @@ static VkBool32 VKAPI_CALL vulkanDebugCallback(
   const char *pMessage,
   void *pUserData)
 {
-  printf("Debug cb called with msg:\n%s", pMessage);
+  logWarning("Debug cb called with msg:\n%s", pMessage);
   return VK_TRUE;
 }
 #endif
 
-static SDL_bool initVulkanCore(SDL_Window *appWindow)
+static SDL_bool initVulkanCore(SDL_bool wantDirectDisplay)
 {
-  printf("%s called\n", __func__);
+  logDebug("%s called", __func__);
 
-  if (appWindow == NULL) {
-    printf("App window not initialized.\n");
-    return SDL_FALSE;
+  const uint32_t requiredCount = sizeof(g_requiredInstanceExtensions) / sizeof(*g_requiredInstanceExtensions);
+  const uint32_t directCount = sizeof(g_directDisplayInstanceExtensions) / sizeof(*g_directDisplayInstanceExtensions);
+
+  const char *instanceExtensions[requiredCount + directCount + 1];
+  uint32_t instanceExtensionCount = 0;
+
+  for (uint32_t i = 0; i < requiredCount; i++) {
+    instanceExtensions[instanceExtensionCount++] = g_requiredInstanceExtensions[i];
+  }
+
+  // Window system: X11 or none at all
+  if (g_config.headless) {
+    instanceExtensions[instanceExtensionCount++] = VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME;
+    wantDirectDisplay = SDL_FALSE;
+  } else {
+    instanceExtensions[instanceExtensionCount++] = VK_KHR_XLIB_SURFACE_EXTENSION_NAME;
+  }
+
+  g_directDisplayExtensionsEnabled = SDL_FALSE;
+  if (wantDirectDisplay) {
+    g_directDisplayExtensionsEnabled = SDL_TRUE;
+    for (uint32_t i = 0; i < directCount; i++) {
+      if (!isInstanceExtensionSupported(g_directDisplayInstanceExtensions[i])) {
+        logWarning("%s not supported, direct display disabled", g_directDisplayInstanceExtensions[i]);
+        g_directDisplayExtensionsEnabled = SDL_FALSE;
+        break;
+      }
+    }
+
+    if (g_directDisplayExtensionsEnabled) {
+      for (uint32_t i = 0; i < directCount; i++) {
+        instanceExtensions[instanceExtensionCount++] = g_directDisplayInstanceExtensions[i];
+      }
+    }
   }
 
   VkApplicationInfo appInfo = {};
@@ -161,12 +608,12 @@ static SDL_bool initVulkanCore(SDL_Window *appWindow)
   instanceInfo.ppEnabledLayerNames = g_enabledValidationLayers;
 #endif
   instanceInfo.enabledLayerCount = 0;
-  instanceInfo.enabledExtensionCount = sizeof(g_requiredInstanceExtensions)/sizeof(g_requiredInstanceExtensions[0]);
-  instanceInfo.ppEnabledExtensionNames = g_requiredInstanceExtensions;
+  instanceInfo.enabledExtensionCount = instanceExtensionCount;
+  instanceInfo.ppEnabledExtensionNames = instanceExtensions;
 
-  VkResult result = vkCreateInstance(&instanceInfo, VK_NULL_HANDLE, &g_instance);
+  VkResult result = vkCreateInstance(&instanceInfo, allocationCallbacks(HOST_OBJECT_INSTANCE), &g_instance);
   if (result != VK_SUCCESS) {
-    printf("Failed to create Vulkan instance. Result = %d\n", result);
+    logError("Failed to create Vulkan instance. Result = %d", result);
     return SDL_FALSE;
   }
 
@@ -180,7 +627,7 @@ static SDL_bool initVulkanCore(SDL_Window *appWindow)
 
    result = SDL2_vkCreateDebugReportCallbackEXT(g_instance, &debugCallbackCreateInfo, VK_NULL_HANDLE, &g_debugCallbackEXT);
   if (result != VK_SUCCESS) {
-    printf("Failed to create debug callback.\n");
+    logError("Failed to create debug callback.");
     return SDL_FALSE;
   }
 #endif
@@ -210,23 +657,116 @@ static SDL_bool initVulkanCore(SDL_Window *appWindow)
     return SDL_FALSE;
   }
 
-#if USE_DIRECT_DISPLAY
-  pfn_vkAcquireXlibDisplayEXT =  (PFN_vkAcquireXlibDisplayEXT) vkGetInstanceProcAddr(g_instance, "vkAcquireXlibDisplayEXT");
-  if (pfn_vkAcquireXlibDisplayEXT == VK_NULL_HANDLE) {
-    printf("Failed to load vkAcquireXlibDisplayEXT\n");
-    return SDL_FALSE;
+  if (g_directDisplayExtensionsEnabled) {
+    pfn_vkAcquireXlibDisplayEXT =  (PFN_vkAcquireXlibDisplayEXT) vkGetInstanceProcAddr(g_instance, "vkAcquireXlibDisplayEXT");
+    pfn_vkReleaseDisplayEXT = (PFN_vkReleaseDisplayEXT) vkGetInstanceProcAddr(g_instance, "vkReleaseDisplayEXT");
+    if (pfn_vkAcquireXlibDisplayEXT == VK_NULL_HANDLE || pfn_vkReleaseDisplayEXT == VK_NULL_HANDLE) {
+      logError("Failed to load vkAcquireXlibDisplayEXT or vkReleaseDisplayEXT, direct display disabled");
+      g_directDisplayExtensionsEnabled = SDL_FALSE;
+    }
   }
-#endif
+
   return SDL_TRUE;
 }
 
 SDL_bool initLogicalDevice()
 {
-  printf("%s called\n", __func__);
+  logDebug("%s called", __func__);
+
+  const char *deviceExtensions[16];
+  uint32_t deviceExtensionCount = 0;
+  void *deviceFeaturesChain = VK_NULL_HANDLE;
+
+  deviceExtensions[deviceExtensionCount++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+
+  // Present timing feedback: VK_KHR_present_id + VK_KHR_present_wait
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+  presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+  presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  presentWaitFeatures.pNext = &presentIdFeatures;
+
+  // Frame synchronization: VK_KHR_timeline_semaphore
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+  timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  presentIdFeatures.pNext = &timelineFeatures;
+
+  // Rendering without render pass and framebuffer objects: VK_KHR_dynamic_rendering
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+  dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  timelineFeatures.pNext = &dynamicRenderingFeatures;
+
+  pfn_vkGetPhysicalDeviceFeatures2KHR = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(g_instance, "vkGetPhysicalDeviceFeatures2KHR");
+
+  if (pfn_vkGetPhysicalDeviceFeatures2KHR != VK_NULL_HANDLE) {
+    VkPhysicalDeviceFeatures2KHR features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    features2.pNext = &presentWaitFeatures;
+    pfn_vkGetPhysicalDeviceFeatures2KHR(g_physicalDevice, &features2);
+  }
+
+  // The queried structures are relinked into the chain of enabled features
+  presentIdFeatures.pNext = VK_NULL_HANDLE;
+  timelineFeatures.pNext = VK_NULL_HANDLE;
+
+  g_presentWaitEnabled = SDL_FALSE;
+  if (presentIdFeatures.presentId && presentWaitFeatures.presentWait
+      && isDeviceExtensionSupported(VK_KHR_PRESENT_ID_EXTENSION_NAME)
+      && isDeviceExtensionSupported(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+    deviceExtensions[deviceExtensionCount++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+    deviceExtensions[deviceExtensionCount++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+    presentIdFeatures.pNext = deviceFeaturesChain;
+    deviceFeaturesChain = &presentWaitFeatures;
+    g_presentWaitEnabled = SDL_TRUE;
+  }
+
+  g_timelineSemaphoreEnabled = SDL_FALSE;
+  if (timelineFeatures.timelineSemaphore && !g_config.disableTimelineSemaphore
+      && isDeviceExtensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+    deviceExtensions[deviceExtensionCount++] = VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME;
+    timelineFeatures.pNext = deviceFeaturesChain;
+    deviceFeaturesChain = &timelineFeatures;
+    g_timelineSemaphoreEnabled = SDL_TRUE;
+  }
 
-  const char *deviceExtensions[] = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+  // The extension's dependencies are core only from Vulkan 1.2 on
+  const char *dynamicRenderingExtensions[] = {
+    VK_KHR_MULTIVIEW_EXTENSION_NAME,
+    VK_KHR_MAINTENANCE_2_EXTENSION_NAME,
+    VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+    VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+    VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
   };
+  const uint32_t dynamicRenderingExtensionCount = sizeof(dynamicRenderingExtensions) / sizeof(*dynamicRenderingExtensions);
+
+  g_dynamicRenderingEnabled = SDL_FALSE;
+  if (g_config.dynamicRendering) {
+    SDL_bool supported = dynamicRenderingFeatures.dynamicRendering ? SDL_TRUE : SDL_FALSE;
+    for (uint32_t i = 0; i < dynamicRenderingExtensionCount && supported; i++) {
+      supported = isDeviceExtensionSupported(dynamicRenderingExtensions[i]);
+    }
+
+    if (supported) {
+      for (uint32_t i = 0; i < dynamicRenderingExtensionCount; i++) {
+        deviceExtensions[deviceExtensionCount++] = dynamicRenderingExtensions[i];
+      }
+      dynamicRenderingFeatures.pNext = deviceFeaturesChain;
+      deviceFeaturesChain = &dynamicRenderingFeatures;
+      g_dynamicRenderingEnabled = SDL_TRUE;
+    } else {
+      logWarning("VK_KHR_dynamic_rendering is not supported, using a render pass");
+    }
+  }
+
+  // Damage tracking works without it, the compositor just gets no hint
+  g_incrementalPresentEnabled = SDL_FALSE;
+  if (g_config.damageTracking && isDeviceExtensionSupported(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME)) {
+    deviceExtensions[deviceExtensionCount++] = VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME;
+    g_incrementalPresentEnabled = SDL_TRUE;
+  }
+
+  logInfo("Present timing: %s", g_presentWaitEnabled ? "VK_KHR_present_wait" : "queue present timestamps");
 
   VkDeviceQueueCreateInfo queueInfo = {};
   float priority = 0.0;
@@ -238,6 +778,7 @@ SDL_bool initLogicalDevice()
 
   VkDeviceCreateInfo deviceInfo = {};
   deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  deviceInfo.pNext = deviceFeaturesChain;
   deviceInfo.flags = 0;
   deviceInfo.queueCreateInfoCount = 1;
   deviceInfo.pQueueCreateInfos = &queueInfo;
@@ -245,233 +786,292 @@ SDL_bool initLogicalDevice()
   deviceInfo.enabledLayerCount = sizeof(g_enabledValidationLayers) / sizeof(*g_enabledValidationLayers);
   deviceInfo.ppEnabledLayerNames = g_enabledValidationLayers;
 #endif
-  deviceInfo.enabledExtensionCount = sizeof(deviceExtensions) / sizeof(*deviceExtensions);
+  deviceInfo.enabledExtensionCount = deviceExtensionCount;
   deviceInfo.ppEnabledExtensionNames = deviceExtensions;
 
-  VkResult result = vkCreateDevice(g_physicalDevice, &deviceInfo, VK_NULL_HANDLE, &g_device);
+  VkResult result = vkCreateDevice(g_physicalDevice, &deviceInfo, allocationCallbacks(HOST_OBJECT_DEVICE), &g_device);
   if (result != VK_SUCCESS) {
     return SDL_FALSE;
   }
 
   vkGetDeviceQueue(g_device, 0, 0, &g_presentQueue);
+
+  if (g_presentWaitEnabled) {
+    pfn_vkWaitForPresentKHR = (PFN_vkWaitForPresentKHR) vkGetDeviceProcAddr(g_device, "vkWaitForPresentKHR");
+    g_presentWaitEnabled = pfn_vkWaitForPresentKHR != VK_NULL_HANDLE;
+  }
+
+  if (g_timelineSemaphoreEnabled) {
+    pfn_vkWaitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(g_device, "vkWaitSemaphoresKHR");
+    pfn_vkGetSemaphoreCounterValueKHR = (PFN_vkGetSemaphoreCounterValueKHR) vkGetDeviceProcAddr(g_device, "vkGetSemaphoreCounterValueKHR");
+    g_timelineSemaphoreEnabled = pfn_vkWaitSemaphoresKHR != VK_NULL_HANDLE && pfn_vkGetSemaphoreCounterValueKHR != VK_NULL_HANDLE;
+  }
+
+  logInfo("Frame synchronization: %s", g_timelineSemaphoreEnabled ? "timeline semaphore" : "fence");
+
+  if (g_dynamicRenderingEnabled) {
+    pfn_vkCmdBeginRenderingKHR = (PFN_vkCmdBeginRenderingKHR) vkGetDeviceProcAddr(g_device, "vkCmdBeginRenderingKHR");
+    pfn_vkCmdEndRenderingKHR = (PFN_vkCmdEndRenderingKHR) vkGetDeviceProcAddr(g_device, "vkCmdEndRenderingKHR");
+    if (pfn_vkCmdBeginRenderingKHR == VK_NULL_HANDLE || pfn_vkCmdEndRenderingKHR == VK_NULL_HANDLE) {
+      logError("Failed to load VK_KHR_dynamic_rendering functions");
+      return SDL_FALSE;
+    }
+  }
+
   return SDL_TRUE;
 }
 
-SDL_bool initSwapchain(SDL_Window* pWindowHandle, int width, int height)
+// Direct display surface
+// Returns SDL_FALSE with *fallback set when the SDL surface should be used instead.
+static SDL_bool createDirectDisplaySurface(SDL_bool *fallback)
 {
-  printf("%s called\n", __func__);
+  *fallback = SDL_FALSE;
 
-  // Direct display surface
-#if USE_DIRECT_DISPLAY
-  {
-    Display* dpy = XOpenDisplay(0);
-    if (dpy == NULL) {
-      printf("Failed to open X display\n");
-      return 1;
-    } else {
-      printf("X display opened %p \n", dpy);
-    }
+  if (!g_directDisplayExtensionsEnabled) {
+    logWarning("Direct display extensions not available, falling back to SDL surface");
+    *fallback = SDL_TRUE;
+    return SDL_FALSE;
+  }
 
-    uint32_t displayCount;
-    vkGetPhysicalDeviceDisplayPropertiesKHR(g_physicalDevice, &displayCount, VK_NULL_HANDLE);
+  uint32_t displayCount = 0;
+  vkGetPhysicalDeviceDisplayPropertiesKHR(g_physicalDevice, &displayCount, VK_NULL_HANDLE);
+  if (displayCount == 0) {
+    logWarning("No displays enumerated, falling back to SDL surface");
+    *fallback = SDL_TRUE;
+    return SDL_FALSE;
+  }
 
-    VkDisplayPropertiesKHR displayProperties[displayCount];
-    vkGetPhysicalDeviceDisplayPropertiesKHR(g_physicalDevice, &displayCount, displayProperties);
+  VkDisplayPropertiesKHR displayProperties[displayCount];
+  vkGetPhysicalDeviceDisplayPropertiesKHR(g_physicalDevice, &displayCount, displayProperties);
 
-    printf( "Found displays = %d\n", displayCount);
-    for (int i=0; i < displayCount; i++) {
-      printf("\t[%d] %s \n", i, displayProperties[i].displayName);
-    }
+  logInfo("Found displays = %d", displayCount);
+  for (int i=0; i < displayCount; i++) {
+    logInfo("\t[%d] %s", i, displayProperties[i].displayName);
+  }
 
-    VkDisplayKHR selectedDisplay = displayProperties[0].display;
-    VkResult result = pfn_vkAcquireXlibDisplayEXT(g_physicalDevice, dpy, selectedDisplay);
-    if (result != VK_SUCCESS) {
-      printf("Failed to acquire display result = %d \n", result);
-      return SDL_FALSE;
-    }
+  if (g_config.displayIndex < 0 || g_config.displayIndex >= displayCount) {
+    logError("Display index %d out of range", g_config.displayIndex);
+    return SDL_FALSE;
+  }
 
-    uint32_t displayModesCount = 0;
-    vkGetDisplayModePropertiesKHR(g_physicalDevice, selectedDisplay, &displayModesCount, VK_NULL_HANDLE);
+  VkDisplayKHR selectedDisplay = displayProperties[g_config.displayIndex].display;
 
-    VkDisplayModePropertiesKHR displayModeProperites[displayModesCount];
-    vkGetDisplayModePropertiesKHR(g_physicalDevice, selectedDisplay, &displayModesCount, displayModeProperites);
+  g_xlibDisplay = XOpenDisplay(0);
+  if (g_xlibDisplay == NULL) {
+    logError("Failed to open X display");
+    return SDL_FALSE;
+  } else {
+    logInfo("X display opened %p", g_xlibDisplay);
+  }
 
-    // Select the highest refresh rate and resolution
-    VkDisplayModePropertiesKHR selectedMode = displayModeProperites[0];
-    for (int i=0; i < displayModesCount; i++) {
-      VkExtent2D ires = displayModeProperites[i].parameters.visibleRegion;
-      uint32_t   ifreq = displayModeProperites[i].parameters.refreshRate;
+  VkResult result = pfn_vkAcquireXlibDisplayEXT(g_physicalDevice, g_xlibDisplay, selectedDisplay);
+  if (result != VK_SUCCESS) {
+    logError("Failed to acquire display result = %d", result);
+    return SDL_FALSE;
+  }
+  // Released in CleanupVulkan(), after the swapchain on it is gone
+  g_acquiredDisplay = selectedDisplay;
 
-      VkExtent2D cres = selectedMode.parameters.visibleRegion;
-      uint32_t cfreq = selectedMode.parameters.refreshRate;
+  uint32_t displayModesCount = 0;
+  vkGetDisplayModePropertiesKHR(g_physicalDevice, selectedDisplay, &displayModesCount, VK_NULL_HANDLE);
 
-      if(ires.height * ires.width + ifreq > cres.height * cres.width + cfreq ) {
-        selectedMode = displayModeProperites[i];
-      }
-    }
+  VkDisplayModePropertiesKHR displayModeProperites[displayModesCount];
+  vkGetDisplayModePropertiesKHR(g_physicalDevice, selectedDisplay, &displayModesCount, displayModeProperites);
 
-    {
-      g_swapchainExtent.width = selectedMode.parameters.visibleRegion.width;
-      g_swapchainExtent.height = selectedMode.parameters.visibleRegion.height;
-      printf("g_swapchainExtent.width = %d, g_swapchainExtent.height = %d\n",
-        g_swapchainExtent.width, g_swapchainExtent.height);
-    }
+  int selectedModeIndex = selectDisplayMode(displayModeProperites, displayModesCount,
+                                            g_config.modeWidth, g_config.modeHeight,
+                                            g_config.modeRefreshRateMilliHz);
+  if (selectedModeIndex < 0) {
+    logError("No display mode matching %ux%u", g_config.modeWidth, g_config.modeHeight);
+    return SDL_FALSE;
+  }
 
-    uint32_t planePropertiesCount = 0;
-    vkGetPhysicalDeviceDisplayPlanePropertiesKHR(g_physicalDevice, &planePropertiesCount, VK_NULL_HANDLE);
+  VkDisplayModePropertiesKHR selectedMode = displayModeProperites[selectedModeIndex];
+  g_output->displayRefreshRateMilliHz = selectedMode.parameters.refreshRate;
 
-    VkDisplayPlanePropertiesKHR planeProperties[planePropertiesCount];
-    vkGetPhysicalDeviceDisplayPlanePropertiesKHR(g_physicalDevice, &planePropertiesCount, planeProperties);
+  {
+    g_output->swapchainExtent.width = selectedMode.parameters.visibleRegion.width;
+    g_output->swapchainExtent.height = selectedMode.parameters.visibleRegion.height;
+    logInfo("Selected mode %ux%u@%.3f", g_output->swapchainExtent.width, g_output->swapchainExtent.height,
+           displayModeRefreshRateHz(&selectedMode));
+  }
 
-    uint32_t planeIndex;
-    SDL_bool foundPlane = SDL_FALSE;
-    for(uint32_t i = 0; i < planePropertiesCount; ++i) {
-      VkDisplayPlanePropertiesKHR property = planeProperties[i];
+  uint32_t planePropertiesCount = 0;
+  vkGetPhysicalDeviceDisplayPlanePropertiesKHR(g_physicalDevice, &planePropertiesCount, VK_NULL_HANDLE);
 
-      // skip planes bound to different display
-      if(property.currentDisplay && (property.currentDisplay != selectedDisplay)) {
-        continue;
-      }
+  VkDisplayPlanePropertiesKHR planeProperties[planePropertiesCount];
+  vkGetPhysicalDeviceDisplayPlanePropertiesKHR(g_physicalDevice, &planePropertiesCount, planeProperties);
 
-      uint32_t supportedDisplayCount = 0;
-      vkGetDisplayPlaneSupportedDisplaysKHR(g_physicalDevice, i, &supportedDisplayCount, VK_NULL_HANDLE);
+  uint32_t planeIndex;
+  SDL_bool foundPlane = SDL_FALSE;
+  for(uint32_t i = 0; i < planePropertiesCount && !foundPlane; ++i) {
+    VkDisplayPlanePropertiesKHR property = planeProperties[i];
 
-      VkDisplayKHR supportedDisplays[supportedDisplayCount];
-      vkGetDisplayPlaneSupportedDisplaysKHR(g_physicalDevice, i, &supportedDisplayCount, supportedDisplays);
-      for(int i = 0; i < supportedDisplayCount; i++) {
-        if(supportedDisplays[i] == selectedDisplay) {
-          foundPlane = SDL_TRUE;
-          planeIndex = i;
-          break;
-        }
-      }
+    // skip planes bound to different display
+    if(property.currentDisplay && (property.currentDisplay != selectedDisplay)) {
+      continue;
+    }
+
+    uint32_t supportedDisplayCount = 0;
+    vkGetDisplayPlaneSupportedDisplaysKHR(g_physicalDevice, i, &supportedDisplayCount, VK_NULL_HANDLE);
 
-      if(foundPlane) {
+    VkDisplayKHR supportedDisplays[supportedDisplayCount + 1];
+    vkGetDisplayPlaneSupportedDisplaysKHR(g_physicalDevice, i, &supportedDisplayCount, supportedDisplays);
+    for(uint32_t j = 0; j < supportedDisplayCount; j++) {
+      if(supportedDisplays[j] == selectedDisplay) {
+        foundPlane = SDL_TRUE;
+        planeIndex = i;
         break;
       }
     }
+  }
 
-    if(!foundPlane) {
-      printf("Could not find a compatible display plane!\n");
-      return SDL_FALSE;
-    }
+  if(!foundPlane) {
+    logError("Could not find a compatible display plane!");
+    return SDL_FALSE;
+  }
 
-    // find alpha mode bit
-    VkDisplayPlaneCapabilitiesKHR planeCapabilites;
-    vkGetDisplayPlaneCapabilitiesKHR(g_physicalDevice, selectedMode.displayMode, planeIndex, &planeCapabilites);
+  // find alpha mode bit
+  VkDisplayPlaneCapabilitiesKHR planeCapabilites;
+  vkGetDisplayPlaneCapabilitiesKHR(g_physicalDevice, selectedMode.displayMode, planeIndex, &planeCapabilites);
 
-    VkDisplayPlaneAlphaFlagBitsKHR alphaMode = VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR;
-    VkDisplayPlaneAlphaFlagBitsKHR alphaModes[4] = {
-      VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR,
-      VK_DISPLAY_PLANE_ALPHA_GLOBAL_BIT_KHR,
-      VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR,
-      VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR
-    };
+  VkDisplayPlaneAlphaFlagBitsKHR alphaMode = VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR;
+  VkDisplayPlaneAlphaFlagBitsKHR alphaModes[4] = {
+    VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR,
+    VK_DISPLAY_PLANE_ALPHA_GLOBAL_BIT_KHR,
+    VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR,
+    VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR
+  };
 
-    for(uint32_t i = 0; i < 4; i++) {
-      if(planeCapabilites.supportedAlpha & alphaModes[i]) {
-        alphaMode = alphaModes[i];
-        break;
-      }
+  for(uint32_t i = 0; i < 4; i++) {
+    if(planeCapabilites.supportedAlpha & alphaModes[i]) {
+      alphaMode = alphaModes[i];
+      break;
     }
+  }
 
-    VkDisplaySurfaceCreateInfoKHR displaySurfaceInfo = {};
-    displaySurfaceInfo.sType = VK_STRUCTURE_TYPE_DISPLAY_SURFACE_CREATE_INFO_KHR;
-    displaySurfaceInfo.displayMode = selectedMode.displayMode;
-    displaySurfaceInfo.planeIndex = planeIndex;
-    displaySurfaceInfo.planeStackIndex = planeProperties[planeIndex].currentStackIndex;
-    displaySurfaceInfo.transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-    displaySurfaceInfo.globalAlpha = 1.0f;
-    displaySurfaceInfo.alphaMode = alphaMode;
-    displaySurfaceInfo.imageExtent = g_swapchainExtent;
-
-    result = vkCreateDisplayPlaneSurfaceKHR(g_instance, &displaySurfaceInfo, VK_NULL_HANDLE, &g_surface);
-    if (result != VK_SUCCESS) {
-      printf("Failed to create display plane surface result = %d \n", result);
-      return SDL_FALSE;
-    }
+  VkDisplaySurfaceCreateInfoKHR displaySurfaceInfo = {};
+  displaySurfaceInfo.sType = VK_STRUCTURE_TYPE_DISPLAY_SURFACE_CREATE_INFO_KHR;
+  displaySurfaceInfo.displayMode = selectedMode.displayMode;
+  displaySurfaceInfo.planeIndex = planeIndex;
+  displaySurfaceInfo.planeStackIndex = planeProperties[planeIndex].currentStackIndex;
+  displaySurfaceInfo.transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+  displaySurfaceInfo.globalAlpha = 1.0f;
+  displaySurfaceInfo.alphaMode = alphaMode;
+  displaySurfaceInfo.imageExtent = g_output->swapchainExtent;
+
+  // No allocation callbacks, like the SDL surfaces: they share the untracked vkDestroySurfaceKHR
+  result = vkCreateDisplayPlaneSurfaceKHR(g_instance, &displaySurfaceInfo, VK_NULL_HANDLE, &g_output->surface);
+  if (result != VK_SUCCESS) {
+    logError("Failed to create display plane surface result = %d", result);
+    return SDL_FALSE;
   }
-#else
-  // SDL surface
-  {
-    SDL_Vulkan_CreateSurface(pWindowHandle, g_instance, &g_surface);
 
-    g_swapchainExtent.width = width;
-    g_swapchainExtent.height = height;
+  return SDL_TRUE;
+}
+
+static SDL_bool createHeadlessSurface()
+{
+  PFN_vkCreateHeadlessSurfaceEXT pfn_vkCreateHeadlessSurfaceEXT =
+    (PFN_vkCreateHeadlessSurfaceEXT) vkGetInstanceProcAddr(g_instance, "vkCreateHeadlessSurfaceEXT");
+  if (pfn_vkCreateHeadlessSurfaceEXT == VK_NULL_HANDLE) {
+    logError("Failed to load vkCreateHeadlessSurfaceEXT");
+    return SDL_FALSE;
   }
-#endif
-   VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(g_physicalDevice, g_surface, &g_surfaceCapabilities);
+
+  VkHeadlessSurfaceCreateInfoEXT surfaceInfo = {};
+  surfaceInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+  // No allocation callbacks, like the SDL surfaces: they share the untracked vkDestroySurfaceKHR
+  VkResult result = pfn_vkCreateHeadlessSurfaceEXT(g_instance, &surfaceInfo, VK_NULL_HANDLE, &g_output->surface);
   if (result != VK_SUCCESS) {
-    printf("Failed to get surface capabilites = %d\n", result);
+    logError("Failed to create headless surface result = %d", result);
     return SDL_FALSE;
   }
 
-  uint32_t surfaceFormatsCount;
-  vkGetPhysicalDeviceSurfaceFormatsKHR(g_physicalDevice, g_surface, &surfaceFormatsCount, VK_NULL_HANDLE);
+  return SDL_TRUE;
+}
 
-  int surfaceFormatIndex = 0;
-  VkSurfaceFormatKHR surfaceFormats[surfaceFormatsCount];
-  vkGetPhysicalDeviceSurfaceFormatsKHR(g_physicalDevice, g_surface, &surfaceFormatsCount, surfaceFormats);
-  for (int i = 0; i < surfaceFormatsCount; i++) {
-    if (surfaceFormats[i].format == VK_FORMAT_B8G8R8A8_UNORM) {
-      surfaceFormatIndex = i;
+// Present mode when the surface supports it, FIFO (always supported) otherwise
+//
+static VulkanPresentMode selectPresentMode(VulkanPresentMode presentMode)
+{
+  uint32_t presentModeCount = 0;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(g_physicalDevice, g_output->surface, &presentModeCount, VK_NULL_HANDLE);
+
+  VkPresentModeKHR presentModes[presentModeCount];
+  vkGetPhysicalDeviceSurfacePresentModesKHR(g_physicalDevice, g_output->surface, &presentModeCount, presentModes);
+
+  for (uint32_t i = 0; i < presentModeCount; i++) {
+    if (presentModes[i] == g_vkPresentModes[presentMode]) {
+      return presentMode;
     }
   }
 
-  if (surfaceFormats[surfaceFormatIndex].format != VK_FORMAT_B8G8R8A8_UNORM) {
-    printf("VK_FORMAT_B8G8R8A8_UNORM not supported\n");
-    return SDL_FALSE;
-  }
+  logWarning("Present mode %s is not supported, using fifo", GetPresentModeName(presentMode));
+  return VULKAN_PRESENT_MODE_FIFO;
+}
+
+// Swapchain and its image views, replacing oldSwapchain when not null
+//
+static SDL_bool createSwapchain(VkSwapchainKHR oldSwapchain, VulkanPresentMode presentMode)
+{
+  logDebug("%s called", __func__);
 
-  g_surfaceFormat = surfaceFormats[surfaceFormatIndex];
+  g_output->presentMode = selectPresentMode(presentMode);
 
-  uint32_t imageCount = g_surfaceCapabilities.minImageCount + 1;
-  if (g_surfaceCapabilities.maxImageCount > 0 && imageCount > g_surfaceCapabilities.maxImageCount) {
-    imageCount = g_surfaceCapabilities.maxImageCount;
+  uint32_t imageCount = g_output->surfaceCapabilities.minImageCount + 1;
+  if (g_output->surfaceCapabilities.maxImageCount > 0 && imageCount > g_output->surfaceCapabilities.maxImageCount) {
+    imageCount = g_output->surfaceCapabilities.maxImageCount;
   }
 
   VkSwapchainCreateInfoKHR swapchainInfo = {};
   swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-  swapchainInfo.surface = g_surface;
+  swapchainInfo.surface = g_output->surface;
   swapchainInfo.minImageCount = imageCount;
-  swapchainInfo.imageFormat = g_surfaceFormat.format;
-  swapchainInfo.imageColorSpace = g_surfaceFormat.colorSpace;
-  swapchainInfo.imageExtent = g_swapchainExtent;
+  swapchainInfo.imageFormat = g_output->surfaceFormat.format;
+  swapchainInfo.imageColorSpace = g_output->surfaceFormat.colorSpace;
+  swapchainInfo.imageExtent = g_output->swapchainExtent;
   swapchainInfo.imageArrayLayers = 1;
   swapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  if (g_output->captureSupported) {
+    swapchainInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  }
   swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  swapchainInfo.preTransform = g_surfaceCapabilities.currentTransform;
+  swapchainInfo.preTransform = g_output->surfaceCapabilities.currentTransform;
   swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-  swapchainInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR; // V-SYNC -> expose to enable/disable
+  swapchainInfo.presentMode = g_vkPresentModes[g_output->presentMode];
   swapchainInfo.clipped = VK_TRUE;
+  swapchainInfo.oldSwapchain = oldSwapchain;
 
-  result = vkCreateSwapchainKHR(g_device, &swapchainInfo, VK_NULL_HANDLE, &g_swapchain);
+  VkResult result = vkCreateSwapchainKHR(g_device, &swapchainInfo, allocationCallbacks(HOST_OBJECT_SWAPCHAIN), &g_output->swapchain);
   if (result != VK_SUCCESS) {
-    printf("Failed to create swapchain result = %d\n", result);
+    logError("Failed to create swapchain result = %d", result);
+    g_output->swapchain = VK_NULL_HANDLE;
     return SDL_FALSE;
   }
 
-  vkGetSwapchainImagesKHR(g_device, g_swapchain, &g_swapchainImageCount, VK_NULL_HANDLE);
+  vkGetSwapchainImagesKHR(g_device, g_output->swapchain, &g_output->swapchainImageCount, VK_NULL_HANDLE);
 
-  g_swapchainImages = calloc(g_swapchainImageCount, sizeof(*g_swapchainImages));
-  if (g_swapchainImages == VK_NULL_HANDLE) {
-    printf("Failed to allocate swapchain images\n");
+  g_output->swapchainImages = calloc(g_output->swapchainImageCount, sizeof(*g_output->swapchainImages));
+  if (g_output->swapchainImages == VK_NULL_HANDLE) {
+    logError("Failed to allocate swapchain images");
     return SDL_FALSE;
   }
-  vkGetSwapchainImagesKHR(g_device, g_swapchain, &g_swapchainImageCount, g_swapchainImages);
+  vkGetSwapchainImagesKHR(g_device, g_output->swapchain, &g_output->swapchainImageCount, g_output->swapchainImages);
 
   // Create ImageViews
   {
-    g_colorImageViews = calloc(g_swapchainImageCount, sizeof(*g_colorImageViews));
-    if (g_colorImageViews == VK_NULL_HANDLE) {
-      printf("Failed to allocate color image views\n");
+    g_output->colorImageViews = calloc(g_output->swapchainImageCount, sizeof(*g_output->colorImageViews));
+    if (g_output->colorImageViews == VK_NULL_HANDLE) {
+      logError("Failed to allocate color image views");
       return SDL_FALSE;
     }
 
-    for (int i = 0; i < g_swapchainImageCount; i++) {
+    for (int i = 0; i < g_output->swapchainImageCount; i++) {
       VkImageViewCreateInfo colorInfo = {};
       colorInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-      colorInfo.format = g_surfaceFormat.format;
+      colorInfo.format = g_output->surfaceFormat.format;
       colorInfo.components.r = VK_COMPONENT_SWIZZLE_R;
       colorInfo.components.g = VK_COMPONENT_SWIZZLE_G;
       colorInfo.components.b = VK_COMPONENT_SWIZZLE_B;
@@ -483,11 +1083,11 @@ SDL_bool initSwapchain(SDL_Window* pWindowHandle, int width, int height)
       colorInfo.subresourceRange.layerCount = 1;
       colorInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
       colorInfo.flags = 0;
-      colorInfo.image = g_swapchainImages[i];
+      colorInfo.image = g_output->swapchainImages[i];
 
-      result = vkCreateImageView(g_device, &colorInfo, VK_NULL_HANDLE, &g_colorImageViews[i]);
+      result = vkCreateImageView(g_device, &colorInfo, allocationCallbacks(HOST_OBJECT_IMAGE_VIEW), &g_output->colorImageViews[i]);
       if (result != VK_SUCCESS) {
-        printf("Failed to create image view for image index: %d \n", i);
+        logError("Failed to create image view for image index: %d", i);
         return SDL_FALSE;
       }
     }
@@ -496,20 +1096,101 @@ SDL_bool initSwapchain(SDL_Window* pWindowHandle, int width, int height)
   return SDL_TRUE;
 }
 
-SDL_bool createRenderPass()
+SDL_bool initSwapchain(SDL_Window* pWindowHandle, int width, int height)
 {
-  printf("%s called\n", __func__);
+  logDebug("%s called", __func__);
 
-  // the renderpass will use this color attachment.
-  VkAttachmentDescription colorAttachment = {};
-  colorAttachment.format = g_surfaceFormat.format;
-  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  SDL_bool useSdlSurface = !g_config.directDisplay && !g_config.headless;
+
+  if (g_config.headless) {
+    if (!createHeadlessSurface()) {
+      return SDL_FALSE;
+    }
+
+    g_output->swapchainExtent.width = width;
+    g_output->swapchainExtent.height = height;
+  } else if (g_config.directDisplay) {
+    if (!createDirectDisplaySurface(&useSdlSurface) && !useSdlSurface) {
+      return SDL_FALSE;
+    }
+  }
+
+  // SDL surface
+  if (useSdlSurface) {
+    if (pWindowHandle == NULL) {
+      logError("App window not initialized.");
+      return SDL_FALSE;
+    }
+
+    // SDL_Vulkan_CreateSurface takes no allocation callbacks, the surface is deliberately untracked
+    SDL_Vulkan_CreateSurface(pWindowHandle, g_instance, &g_output->surface);
+
+    g_output->swapchainExtent.width = width;
+    g_output->swapchainExtent.height = height;
+  }
+
+   VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(g_physicalDevice, g_output->surface, &g_output->surfaceCapabilities);
+  if (result != VK_SUCCESS) {
+    logError("Failed to get surface capabilites = %d", result);
+    return SDL_FALSE;
+  }
+
+  uint32_t surfaceFormatsCount;
+  vkGetPhysicalDeviceSurfaceFormatsKHR(g_physicalDevice, g_output->surface, &surfaceFormatsCount, VK_NULL_HANDLE);
+
+  int surfaceFormatIndex = 0;
+  VkSurfaceFormatKHR surfaceFormats[surfaceFormatsCount];
+  vkGetPhysicalDeviceSurfaceFormatsKHR(g_physicalDevice, g_output->surface, &surfaceFormatsCount, surfaceFormats);
+  for (int i = 0; i < surfaceFormatsCount; i++) {
+    if (surfaceFormats[i].format == VK_FORMAT_B8G8R8A8_UNORM) {
+      surfaceFormatIndex = i;
+    }
+  }
+
+  if (surfaceFormats[surfaceFormatIndex].format != VK_FORMAT_B8G8R8A8_UNORM) {
+    logError("VK_FORMAT_B8G8R8A8_UNORM not supported");
+    return SDL_FALSE;
+  }
+
+  g_output->surfaceFormat = surfaceFormats[surfaceFormatIndex];
+
+  if (g_config.captureDirectory != NULL) {
+    g_output->captureSupported = (g_output->surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if (!g_output->captureSupported) {
+      logWarning("Swapchain images cannot be copied, frames of output %d are not captured", (int)(g_output - g_outputs));
+    }
+  }
+
+  return createSwapchain(VK_NULL_HANDLE, g_config.presentMode);
+}
+
+// Whether rendering has to make the swapchain image available to the capture
+// copy. The render pass is shared by the outputs, so both rendering paths
+// follow the outputs together: one capturing output is enough
+static SDL_bool captureFollowsRendering()
+{
+  for (uint32_t i = 0; i < g_outputCount; i++) {
+    if (g_outputs[i].captureSupported) {
+      return SDL_TRUE;
+    }
+  }
+  return SDL_FALSE;
+}
+
+SDL_bool createRenderPass()
+{
+  logDebug("%s called", __func__);
+
+  // the renderpass will use this color attachment.
+  VkAttachmentDescription colorAttachment = {};
+  colorAttachment.format = g_output->surfaceFormat.format;
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
   VkAttachmentReference colorAttachmentReference = {};
   colorAttachmentReference.attachment = 0;
@@ -520,25 +1201,52 @@ SDL_bool createRenderPass()
   subpassDescription.colorAttachmentCount = 1;
   subpassDescription.pColorAttachments = &colorAttachmentReference;
 
+  // Frame capture copies the image right after the pass, the final layout
+  // transition must happen before the copy rather than before the end of the
+  // submission only, as with the implicit dependency
+  VkSubpassDependency captureDependency = {};
+  captureDependency.srcSubpass = 0;
+  captureDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+  captureDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  captureDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  captureDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  captureDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
   VkRenderPassCreateInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
   renderPassInfo.attachmentCount = 1;
   renderPassInfo.pAttachments = &colorAttachment;
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpassDescription;
+  if (captureFollowsRendering()) {
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &captureDependency;
+  }
 
-  VkResult result = vkCreateRenderPass(g_device, &renderPassInfo, VK_NULL_HANDLE, &g_renderPass);
+  VkResult result = vkCreateRenderPass(g_device, &renderPassInfo, allocationCallbacks(HOST_OBJECT_RENDER_PASS), &g_renderPass);
   if ( result != VK_SUCCESS ) {
-    printf("Failed to create rectangle renderpass\n");
+    logError("Failed to create rectangle renderpass");
     return SDL_FALSE;
   }
 
+  // Compatible pass keeping the image's previous content, shares the framebuffers
+  if (g_damageTrackingEnabled) {
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    result = vkCreateRenderPass(g_device, &renderPassInfo, allocationCallbacks(HOST_OBJECT_RENDER_PASS), &g_damageRenderPass);
+    if (result != VK_SUCCESS) {
+      logError("Failed to create damage renderpass");
+      return SDL_FALSE;
+    }
+  }
+
   return SDL_TRUE;
 }
 
 SDL_bool createFramebuffers()
 {
-  printf("%s called\n", __func__);
+  logDebug("%s called", __func__);
 
   VkResult result;
 
@@ -546,16 +1254,16 @@ SDL_bool createFramebuffers()
   framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
   framebufferInfo.renderPass = g_renderPass;
   framebufferInfo.attachmentCount = 1;
-  framebufferInfo.width = g_swapchainExtent.width;
-  framebufferInfo.height = g_swapchainExtent.height;
+  framebufferInfo.width = g_output->swapchainExtent.width;
+  framebufferInfo.height = g_output->swapchainExtent.height;
   framebufferInfo.layers = 1;
 
-  g_framebuffers = calloc(g_swapchainImageCount, sizeof(*g_framebuffers));
-  for (int i = 0; i < g_swapchainImageCount; i++) {
-    framebufferInfo.pAttachments = &g_colorImageViews[i];
-    result = vkCreateFramebuffer(g_device, &framebufferInfo, VK_NULL_HANDLE, &g_framebuffers[i]);
+  g_output->framebuffers = calloc(g_output->swapchainImageCount, sizeof(*g_output->framebuffers));
+  for (int i = 0; i < g_output->swapchainImageCount; i++) {
+    framebufferInfo.pAttachments = &g_output->colorImageViews[i];
+    result = vkCreateFramebuffer(g_device, &framebufferInfo, allocationCallbacks(HOST_OBJECT_FRAMEBUFFER), &g_output->framebuffers[i]);
     if (result != VK_SUCCESS) {
-      printf("Failed to create framebuffer\n");
+      logError("Failed to create framebuffer");
       return SDL_FALSE;
     }
   }
@@ -565,28 +1273,28 @@ SDL_bool createFramebuffers()
 
 SDL_bool createCommandBuffers()
 {
-  printf("%s called\n", __func__);
+  logDebug("%s called", __func__);
 
   VkCommandPoolCreateInfo commandPoolInfo = {};
   commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   commandPoolInfo.queueFamilyIndex = 0;
   commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-  VkResult result = vkCreateCommandPool(g_device, &commandPoolInfo, VK_NULL_HANDLE, &g_commandPool);
+  VkResult result = vkCreateCommandPool(g_device, &commandPoolInfo, allocationCallbacks(HOST_OBJECT_COMMAND_POOL), &g_output->commandPool);
   if (result != VK_SUCCESS) {
-    printf("Failed to create command pool\n");
+    logError("Failed to create command pool");
     return SDL_FALSE;
   }
 
   VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
   commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  commandBufferAllocateInfo.commandPool = g_commandPool;
+  commandBufferAllocateInfo.commandPool = g_output->commandPool;
   commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
   commandBufferAllocateInfo.commandBufferCount = 1;
 
-  result = vkAllocateCommandBuffers(g_device, &commandBufferAllocateInfo, &g_cmdBufferDraw);
+  result = vkAllocateCommandBuffers(g_device, &commandBufferAllocateInfo, &g_output->cmdBufferDraw);
   if (result != VK_SUCCESS) {
-    printf("Failed to allocate command buffers\n");
+    logError("Failed to allocate command buffers");
     return SDL_FALSE;
   }
 
@@ -595,46 +1303,354 @@ SDL_bool createCommandBuffers()
 
 SDL_bool createSyncObjects()
 {
-  printf("%s called\n", __func__);
+  logDebug("%s called", __func__);
 
   VkResult result;
 
   VkSemaphoreCreateInfo semaphoreCreateInfo = {};
   semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  result = vkCreateSemaphore(g_device, &semaphoreCreateInfo, VK_NULL_HANDLE, &g_presentSemaphore);
+  result = vkCreateSemaphore(g_device, &semaphoreCreateInfo, allocationCallbacks(HOST_OBJECT_SEMAPHORE), &g_output->presentSemaphore);
   if (result != VK_SUCCESS) {
-    printf("Failed to create present semaphore.\n");
+    logError("Failed to create present semaphore.");
     return SDL_FALSE;
   }
 
-  result = vkCreateSemaphore(g_device, &semaphoreCreateInfo, VK_NULL_HANDLE, &g_renderSemaphore);
+  result = vkCreateSemaphore(g_device, &semaphoreCreateInfo, allocationCallbacks(HOST_OBJECT_SEMAPHORE), &g_output->renderSemaphore);
   if (result != VK_SUCCESS) {
-    printf("Failed to create render semaphore.\n");
+    logError("Failed to create render semaphore.");
     return SDL_FALSE;
   }
 
+  // Nothing is in flight yet, frame ids keep counting across reinitializations
+  g_output->completedFrameId = g_output->frameId;
+
+  // Swapchain acquire and present only take binary semaphores, the timeline
+  // replaces the fence
+  if (g_timelineSemaphoreEnabled) {
+    VkSemaphoreTypeCreateInfoKHR semaphoreTypeInfo = {};
+    semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    semaphoreTypeInfo.initialValue = g_output->frameId;
+
+    VkSemaphoreCreateInfo timelineCreateInfo = {};
+    timelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timelineCreateInfo.pNext = &semaphoreTypeInfo;
+
+    result = vkCreateSemaphore(g_device, &timelineCreateInfo, allocationCallbacks(HOST_OBJECT_SEMAPHORE), &g_output->timelineSemaphore);
+    if (result != VK_SUCCESS) {
+      logError("Failed to create timeline semaphore.");
+      return SDL_FALSE;
+    }
+
+    return SDL_TRUE;
+  }
+
   VkFenceCreateInfo fenceCreateInfo = {};
   fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-  result = vkCreateFence(g_device, &fenceCreateInfo, VK_NULL_HANDLE, &g_renderFence);
+  result = vkCreateFence(g_device, &fenceCreateInfo, allocationCallbacks(HOST_OBJECT_FENCE), &g_output->renderFence);
+  if (result != VK_SUCCESS) {
+    logError("Failed to create render fence.");
+    return SDL_FALSE;
+  }
+
+  return SDL_TRUE;
+}
+
+// Two timestamps bracketing the frame's command buffer. Optional: queues
+// without timestampValidBits simply report no GPU time.
+SDL_bool createTimestampQueryPool()
+{
+  logDebug("%s called", __func__);
+
+  if (g_queueFamilyProperties[0].timestampValidBits == 0) {
+    logWarning("Timestamps not supported by the queue, GPU frame time unavailable");
+    return SDL_TRUE;
+  }
+
+  VkQueryPoolCreateInfo queryPoolInfo = {};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolInfo.queryCount = 2;
+
+  VkResult result = vkCreateQueryPool(g_device, &queryPoolInfo, allocationCallbacks(HOST_OBJECT_QUERY_POOL), &g_output->timestampQueryPool);
+  if (result != VK_SUCCESS) {
+    logWarning("Failed to create timestamp query pool, GPU frame time unavailable");
+    g_output->timestampQueryPool = VK_NULL_HANDLE;
+  }
+
+  return SDL_TRUE;
+}
+
+// Called once the previous frame's fence is signaled
+static void readGpuFrameDuration()
+{
+  if (g_output->timestampQueryPool == VK_NULL_HANDLE || !g_output->timestampsPending) {
+    return;
+  }
+
+  uint64_t timestamps[2];
+  VkResult result = vkGetQueryPoolResults(g_device, g_output->timestampQueryPool, 0, 2, sizeof(timestamps), timestamps,
+                                          sizeof(*timestamps), VK_QUERY_RESULT_64_BIT);
+  g_output->timestampsPending = SDL_FALSE;
+
+  if (result != VK_SUCCESS) {
+    return;
+  }
+
+  uint32_t validBits = g_queueFamilyProperties[0].timestampValidBits;
+  uint64_t mask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+  uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+
+  g_output->gpuFrameDurationSec = ticks * (double)g_physicalDeviceProperties.limits.timestampPeriod / 1000000000.0;
+}
+
+static int findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties)
+{
+  for (uint32_t i = 0; i < g_physicalDeviceMemoryProperties.memoryTypeCount; i++) {
+    if ((typeBits & (1u << i))
+        && (g_physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+SDL_bool createDescriptorSetLayout()
+{
+  logDebug("%s called", __func__);
+
+  VkDescriptorSetLayoutBinding binding = {};
+  binding.binding = 0;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  binding.descriptorCount = 1;
+  binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = 1;
+  layoutInfo.pBindings = &binding;
+
+  VkResult result = vkCreateDescriptorSetLayout(g_device, &layoutInfo, allocationCallbacks(HOST_OBJECT_DESCRIPTOR_SET_LAYOUT), &g_descriptorSetLayout);
+  if (result != VK_SUCCESS) {
+    logError("Failed to create descriptor set layout result = %d", result);
+    return SDL_FALSE;
+  }
+
+  return SDL_TRUE;
+}
+
+// The uniform slice of an image is only written after the frame fence
+// showed that the image's previous frame has completed
+//
+SDL_bool createUniformBuffer()
+{
+  logDebug("%s called", __func__);
+
+  VkDeviceSize alignment = g_physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+  if (alignment == 0) {
+    alignment = 1;
+  }
+  g_output->uniformStride = (sizeof(Position) + alignment - 1) / alignment * alignment;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = g_output->uniformStride * g_output->swapchainImageCount;
+  bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkResult result = vkCreateBuffer(g_device, &bufferInfo, allocationCallbacks(HOST_OBJECT_BUFFER), &g_output->uniformBuffer);
+  if (result != VK_SUCCESS) {
+    logError("Failed to create uniform buffer result = %d", result);
+    return SDL_FALSE;
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(g_device, g_output->uniformBuffer, &requirements);
+
+  int memoryType = findMemoryType(requirements.memoryTypeBits,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  if (memoryType < 0) {
+    logError("No host visible coherent memory for the uniform buffer");
+    return SDL_FALSE;
+  }
+
+  VkMemoryAllocateInfo allocateInfo = {};
+  allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocateInfo.allocationSize = requirements.size;
+  allocateInfo.memoryTypeIndex = memoryType;
+
+  result = vkAllocateMemory(g_device, &allocateInfo, allocationCallbacks(HOST_OBJECT_DEVICE_MEMORY), &g_output->uniformMemory);
+  if (result != VK_SUCCESS) {
+    logError("Failed to allocate uniform buffer memory result = %d", result);
+    return SDL_FALSE;
+  }
+
+  vkBindBufferMemory(g_device, g_output->uniformBuffer, g_output->uniformMemory, 0);
+
+  // Mapped for the lifetime of the buffer
+  result = vkMapMemory(g_device, g_output->uniformMemory, 0, VK_WHOLE_SIZE, 0, &g_output->uniformMapped);
+  if (result != VK_SUCCESS) {
+    logError("Failed to map uniform buffer memory result = %d", result);
+    return SDL_FALSE;
+  }
+  memset(g_output->uniformMapped, 0, bufferInfo.size);
+
+  VkDescriptorPoolSize poolSize = {};
+  poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  poolSize.descriptorCount = g_output->swapchainImageCount;
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = g_output->swapchainImageCount;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+
+  result = vkCreateDescriptorPool(g_device, &poolInfo, allocationCallbacks(HOST_OBJECT_DESCRIPTOR_POOL), &g_output->descriptorPool);
   if (result != VK_SUCCESS) {
-    printf("Failed to create render fence.\n");
+    logError("Failed to create descriptor pool result = %d", result);
     return SDL_FALSE;
   }
 
+  g_output->descriptorSets = calloc(g_output->swapchainImageCount, sizeof(*g_output->descriptorSets));
+  if (g_output->descriptorSets == VK_NULL_HANDLE) {
+    logError("Failed to allocate descriptor sets");
+    return SDL_FALSE;
+  }
+
+  VkDescriptorSetLayout setLayouts[g_output->swapchainImageCount];
+  for (uint32_t i = 0; i < g_output->swapchainImageCount; i++) {
+    setLayouts[i] = g_descriptorSetLayout;
+  }
+
+  VkDescriptorSetAllocateInfo setInfo = {};
+  setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  setInfo.descriptorPool = g_output->descriptorPool;
+  setInfo.descriptorSetCount = g_output->swapchainImageCount;
+  setInfo.pSetLayouts = setLayouts;
+
+  result = vkAllocateDescriptorSets(g_device, &setInfo, g_output->descriptorSets);
+  if (result != VK_SUCCESS) {
+    logError("Failed to allocate descriptor sets result = %d", result);
+    return SDL_FALSE;
+  }
+
+  for (uint32_t i = 0; i < g_output->swapchainImageCount; i++) {
+    VkDescriptorBufferInfo descriptorBufferInfo = {};
+    descriptorBufferInfo.buffer = g_output->uniformBuffer;
+    descriptorBufferInfo.offset = g_output->uniformStride * i;
+    descriptorBufferInfo.range = sizeof(Position);
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = g_output->descriptorSets[i];
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    write.pBufferInfo = &descriptorBufferInfo;
+
+    vkUpdateDescriptorSets(g_device, 1, &write, 0, VK_NULL_HANDLE);
+  }
+
   return SDL_TRUE;
 }
 
+static SDL_bool hasDynamicScissor()
+{
+  return g_recordThreadCount > 0 || g_damageTrackingEnabled || g_outputCount > 1;
+}
+
+typedef struct PipelineVariant_t {
+  const VkGraphicsPipelineCreateInfo *pipelineInfo;
+  VulkanPattern                       pattern;
+  VkResult                            result;
+  pthread_t                           thread;
+} PipelineVariant;
+
+// Compiles the pipeline of a pattern: the shared create info with the
+// pattern's specialization constants
+static void *compilePipelineVariant(void *arg)
+{
+  PipelineVariant *variant = arg;
+
+  VkSpecializationInfo specializationInfo = {};
+  specializationInfo.mapEntryCount = sizeof(g_patternMapEntries) / sizeof(*g_patternMapEntries);
+  specializationInfo.pMapEntries = g_patternMapEntries;
+  specializationInfo.dataSize = sizeof(PatternConstants);
+  specializationInfo.pData = &g_patternConstants[variant->pattern];
+
+  VkPipelineShaderStageCreateInfo shaderStages[2];
+  for (uint32_t i = 0; i < 2; i++) {
+    shaderStages[i] = variant->pipelineInfo->pStages[i];
+    shaderStages[i].pSpecializationInfo = &specializationInfo;
+  }
+
+  VkGraphicsPipelineCreateInfo pipelineInfo = *variant->pipelineInfo;
+  pipelineInfo.pStages = shaderStages;
+
+  // The pipeline cache is internally synchronized
+  variant->result = vkCreateGraphicsPipelines(g_device, g_pipelineCache, 1, &pipelineInfo,
+                                              allocationCallbacks(HOST_OBJECT_PIPELINE), &g_pipelines[variant->pattern]);
+  return NULL;
+}
+
+static SDL_bool compilePipelineVariants(const VkGraphicsPipelineCreateInfo *pipelineInfo)
+{
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+  VkResult result = vkCreatePipelineCache(g_device, &cacheInfo, allocationCallbacks(HOST_OBJECT_PIPELINE_CACHE), &g_pipelineCache);
+  if (result != VK_SUCCESS) {
+    logError("Failed to create pipeline cache result = %d", result);
+    return SDL_FALSE;
+  }
+
+  double startTimeSec = clockNowSec();
+  PipelineVariant variants[VULKAN_PATTERN_COUNT] = {};
+  SDL_bool threaded[VULKAN_PATTERN_COUNT] = {};
+
+  for (uint32_t i = 0; i < VULKAN_PATTERN_COUNT; i++) {
+    variants[i].pipelineInfo = pipelineInfo;
+    variants[i].pattern = i;
+    threaded[i] = pthread_create(&variants[i].thread, NULL, compilePipelineVariant, &variants[i]) == 0;
+    if (!threaded[i]) {
+      compilePipelineVariant(&variants[i]);
+    }
+  }
+
+  SDL_bool success = SDL_TRUE;
+  for (uint32_t i = 0; i < VULKAN_PATTERN_COUNT; i++) {
+    if (threaded[i]) {
+      pthread_join(variants[i].thread, NULL);
+    }
+    if (variants[i].result != VK_SUCCESS) {
+      logError("Failed to create the %s graphics pipeline! result = %d", g_patternNames[i], variants[i].result);
+      success = SDL_FALSE;
+    }
+  }
+
+  if (success) {
+    logInfo("%d pipeline variants compiled in %.1f ms", VULKAN_PATTERN_COUNT,
+            (clockNowSec() - startTimeSec) * 1000.0);
+  }
+  return success;
+}
+
 SDL_bool createPipeline()
 {
-  printf("%s called\n", __func__);
+  logDebug("%s called", __func__);
 
   VkResult result;
 
   VkShaderModule vertShaderModule;
-  prepareShaderModule(rectangle_vert_spv, sizeof(rectangle_vert_spv), &vertShaderModule);
+  if (g_config.prerecordedCommands) {
+    prepareShaderModule(rectangle_ubo_vert_spv, sizeof(rectangle_ubo_vert_spv), &vertShaderModule);
+  } else {
+    prepareShaderModule(rectangle_vert_spv, sizeof(rectangle_vert_spv), &vertShaderModule);
+  }
 
   VkShaderModule fragShaderModule;
   prepareShaderModule(rectangle_frag_spv, sizeof(rectangle_frag_spv), &fragShaderModule);
@@ -670,13 +1686,13 @@ SDL_bool createPipeline()
   VkViewport viewport = {};
   viewport.x = 0.0f;
   viewport.y = 0.0f;
-  viewport.width = (float) g_swapchainExtent.width;
-  viewport.height = (float) g_swapchainExtent.height;
+  viewport.width = (float) g_output->swapchainExtent.width;
+  viewport.height = (float) g_output->swapchainExtent.height;
   viewport.minDepth = 0.0f;
   viewport.maxDepth = 1.0f;
 
   VkRect2D scissor = {};
-  scissor.extent = g_swapchainExtent;
+  scissor.extent = g_output->swapchainExtent;
 
   VkPipelineViewportStateCreateInfo viewportInfo = {};
   viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
@@ -717,15 +1733,20 @@ SDL_bool createPipeline()
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 0;
-  pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  if (g_config.prerecordedCommands) {
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &g_descriptorSetLayout;
+  } else {
+    pipelineLayoutInfo.setLayoutCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+  }
 
-  result = vkCreatePipelineLayout(g_device, &pipelineLayoutInfo, VK_NULL_HANDLE, &g_pipelineLayout);
+  result = vkCreatePipelineLayout(g_device, &pipelineLayoutInfo, allocationCallbacks(HOST_OBJECT_PIPELINE_LAYOUT), &g_pipelineLayout);
   if (result != VK_SUCCESS) {
-    printf("Failed to create pipeline layout!\n");
-    vkDestroyShaderModule(g_device, fragShaderModule, VK_NULL_HANDLE);
-    vkDestroyShaderModule(g_device, vertShaderModule, VK_NULL_HANDLE);
+    logError("Failed to create pipeline layout!");
+    vkDestroyShaderModule(g_device, fragShaderModule, allocationCallbacks(HOST_OBJECT_SHADER_MODULE));
+    vkDestroyShaderModule(g_device, vertShaderModule, allocationCallbacks(HOST_OBJECT_SHADER_MODULE));
     return SDL_FALSE;
   }
 
@@ -739,186 +1760,1571 @@ SDL_bool createPipeline()
   pipelineInfo.pRasterizationState = &rasterizerInfo;
   pipelineInfo.pMultisampleState = &multisamplingInfo;
   pipelineInfo.pColorBlendState = &colorBlendingInfo;
-  pipelineInfo.pDynamicState = VK_NULL_HANDLE;
+  // Recording threads and damage tracking limit drawing through the scissor,
+  // outputs of different sizes share the pipeline with a dynamic viewport
+  VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_VIEWPORT };
+
+  VkPipelineDynamicStateCreateInfo dynamicStateInfo = {};
+  dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicStateInfo.dynamicStateCount = g_outputCount > 1 ? 2 : 1;
+  dynamicStateInfo.pDynamicStates = dynamicStates;
+
+  pipelineInfo.pDynamicState = hasDynamicScissor() ? &dynamicStateInfo : VK_NULL_HANDLE;
   pipelineInfo.layout = g_pipelineLayout;
   pipelineInfo.renderPass = g_renderPass;
   pipelineInfo.subpass = 0;
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-  result = vkCreateGraphicsPipelines(g_device, VK_NULL_HANDLE, 1, &pipelineInfo, VK_NULL_HANDLE, &g_pipeline);
-  if (result != VK_SUCCESS) {
-    printf("Failed to create graphics pipeline! result = %d\n", result);
-    vkDestroyShaderModule(g_device, fragShaderModule, VK_NULL_HANDLE);
-    vkDestroyShaderModule(g_device, vertShaderModule, VK_NULL_HANDLE);
-    return SDL_FALSE;
+  VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachmentFormats = &g_output->surfaceFormat.format;
+
+  if (g_dynamicRenderingEnabled) {
+    pipelineInfo.pNext = &renderingInfo;
+    pipelineInfo.renderPass = VK_NULL_HANDLE;
   }
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  SDL_bool success = compilePipelineVariants(&pipelineInfo);
 
-  vkDestroyShaderModule(g_device, fragShaderModule, VK_NULL_HANDLE);
-  vkDestroyShaderModule(g_device, vertShaderModule, VK_NULL_HANDLE);
+  vkDestroyShaderModule(g_device, fragShaderModule, allocationCallbacks(HOST_OBJECT_SHADER_MODULE));
+  vkDestroyShaderModule(g_device, vertShaderModule, allocationCallbacks(HOST_OBJECT_SHADER_MODULE));
 
-  return result == VK_SUCCESS ? SDL_TRUE : SDL_FALSE;
+  return success;
 }
 
-SDL_bool drawRectangle()
+SDL_bool drawRectangle(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
-  vkCmdBindPipeline(g_cmdBufferDraw, VK_PIPELINE_BIND_POINT_GRAPHICS, g_pipeline);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, g_pipelines[g_pattern]);
 
-  vkCmdPushConstants(g_cmdBufferDraw, g_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Position), &delta);
-  vkCmdDraw(g_cmdBufferDraw, 6, 1, 0, 0);
+  if (g_config.prerecordedCommands) {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, g_pipelineLayout, 0, 1,
+                            &g_output->descriptorSets[imageIndex], 0, VK_NULL_HANDLE);
+  } else {
+    vkCmdPushConstants(commandBuffer, g_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Position), &g_output->delta);
+  }
+  vkCmdDraw(commandBuffer, 6, 1, 0, 0);
 
   return SDL_TRUE;
 }
 
-// ------ Public API ----------
-//
-
+static VkRect2D fullFrameRect()
+{
+  VkRect2D rect = {};
+  rect.extent = g_output->swapchainExtent;
+  return rect;
+}
 
-// Main starting point for Vulkan
-//
-SDL_bool InitializeVulkan(SDL_Window* pWindowHandle, int width, int height)
+static VkRect2D unionRect(VkRect2D a, VkRect2D b)
 {
-  if (!initVulkanCore(pWindowHandle)) {
-    return SDL_FALSE;
+  if (a.extent.width == 0 || a.extent.height == 0) {
+    return b;
   }
-
-  if (!initLogicalDevice()) {
-    return SDL_FALSE;
+  if (b.extent.width == 0 || b.extent.height == 0) {
+    return a;
   }
 
-  if (!initSwapchain(pWindowHandle, width, height)) {
-    return SDL_FALSE;
-  }
+  int32_t left = a.offset.x < b.offset.x ? a.offset.x : b.offset.x;
+  int32_t top = a.offset.y < b.offset.y ? a.offset.y : b.offset.y;
+  int32_t right = a.offset.x + a.extent.width > b.offset.x + b.extent.width
+                ? a.offset.x + a.extent.width : b.offset.x + b.extent.width;
+  int32_t bottom = a.offset.y + a.extent.height > b.offset.y + b.extent.height
+                 ? a.offset.y + a.extent.height : b.offset.y + b.extent.height;
 
-  if (!createRenderPass()) {
-    return SDL_FALSE;
-  }
+  VkRect2D rect = { { left, top }, { right - left, bottom - top } };
+  return rect;
+}
 
-  if (!createPipeline()) {
-    return SDL_FALSE;
+// Empty (zero extent) when the rectangles do not overlap
+static VkRect2D intersectRect(VkRect2D a, VkRect2D b)
+{
+  int32_t left = a.offset.x > b.offset.x ? a.offset.x : b.offset.x;
+  int32_t top = a.offset.y > b.offset.y ? a.offset.y : b.offset.y;
+  int32_t right = a.offset.x + a.extent.width < b.offset.x + b.extent.width
+                ? a.offset.x + a.extent.width : b.offset.x + b.extent.width;
+  int32_t bottom = a.offset.y + a.extent.height < b.offset.y + b.extent.height
+                 ? a.offset.y + a.extent.height : b.offset.y + b.extent.height;
+
+  VkRect2D rect = {};
+  if (right > left && bottom > top) {
+    rect.offset.x = left;
+    rect.offset.y = top;
+    rect.extent.width = right - left;
+    rect.extent.height = bottom - top;
   }
+  return rect;
+}
 
-  if (!createFramebuffers()) {
-    return SDL_FALSE;
-  }
+// Pixels covered by the bar at the current position (see rectangle_vert.glsl),
+// widened by a pixel for rasterization rounding
+static VkRect2D barRect()
+{
+  double width = g_output->swapchainExtent.width;
+  int32_t left = (int32_t)(g_output->delta.x / 2.0 * width) - 1;
+  int32_t right = (int32_t)((g_output->delta.x + g_patternConstants[g_pattern].barWidth) / 2.0 * width) + 2;
 
-  if (!createCommandBuffers()) {
-    return SDL_FALSE;
+  VkRect2D rect = { { left, 0 }, { right - left, g_output->swapchainExtent.height } };
+  return intersectRect(rect, fullFrameRect());
+}
+
+// Region of the acquired image to render: the bar's old position in this
+// image and its new one, or the whole frame on the image's first use
+static void updateDamage(uint32_t imageIndex)
+{
+  VkRect2D bar = barRect();
+
+  if (g_output->imageContentValid[imageIndex]) {
+    g_output->damageRect = unionRect(g_output->imageBarRects[imageIndex], bar);
+    g_output->damageLoadsContent = SDL_TRUE;
+  } else {
+    g_output->damageRect = fullFrameRect();
+    g_output->damageLoadsContent = SDL_FALSE;
+    g_output->imageContentValid[imageIndex] = SDL_TRUE;
   }
 
-  if (!createSyncObjects()) {
+  g_output->imageBarRects[imageIndex] = bar;
+  g_output->damageFraction = (double)g_output->damageRect.extent.width * g_output->damageRect.extent.height
+                   / ((double)g_output->swapchainExtent.width * g_output->swapchainExtent.height);
+}
+
+SDL_bool createDamageTracking()
+{
+  logDebug("%s called", __func__);
+
+  g_output->imageBarRects = calloc(g_output->swapchainImageCount, sizeof(*g_output->imageBarRects));
+  g_output->imageContentValid = calloc(g_output->swapchainImageCount, sizeof(*g_output->imageContentValid));
+  if (g_output->imageBarRects == VK_NULL_HANDLE || g_output->imageContentValid == VK_NULL_HANDLE) {
+    logError("Failed to allocate damage tracking state");
     return SDL_FALSE;
   }
 
+  g_output->presentedBarRectValid = SDL_FALSE;
+
+  logInfo("Damage tracking enabled, present regions: %s",
+          g_incrementalPresentEnabled ? "VK_KHR_incremental_present" : "not supported");
   return SDL_TRUE;
 }
 
-void Update(float position)
+// Scene limited to the area; with damage tracking the area is cleared first
+// as it still holds the image's previous content
+static void drawScene(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkRect2D area)
 {
-  delta.x = position;
-}
+  if (g_damageTrackingEnabled && g_output->damageLoadsContent && area.extent.width > 0 && area.extent.height > 0) {
+    VkClearAttachment clearAttachment = {};
+    clearAttachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    clearAttachment.colorAttachment = 0;
+    clearAttachment.clearValue.color.float32[0] = 0.2f;
+    clearAttachment.clearValue.color.float32[1] = 0.2f;
+    clearAttachment.clearValue.color.float32[2] = 0.2f;
+    clearAttachment.clearValue.color.float32[3] = 1.0f;
+
+    VkClearRect clearRect = {};
+    clearRect.rect = area;
+    clearRect.layerCount = 1;
+
+    vkCmdClearAttachments(commandBuffer, 1, &clearAttachment, 1, &clearRect);
+  }
 
-void Draw()
-{
-  VkClearValue clearValue = { 0.2f, 0.2f, 0.2f, 1.0f };
+  if (g_outputCount > 1) {
+    VkViewport viewport = {};
+    viewport.width = (float) g_output->swapchainExtent.width;
+    viewport.height = (float) g_output->swapchainExtent.height;
+    viewport.maxDepth = 1.0f;
 
-  vkWaitForFences(g_device, 1, &g_renderFence, VK_TRUE, UINT64_MAX);
-  vkResetFences(g_device, 1, &g_renderFence);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  }
 
-  uint32_t swapchainImageIndex = 0;
-  vkAcquireNextImageKHR(g_device, g_swapchain, UINT64_MAX, g_presentSemaphore, VK_NULL_HANDLE, &swapchainImageIndex);
+  if (hasDynamicScissor()) {
+    vkCmdSetScissor(commandBuffer, 0, 1, &area);
+  }
 
-  vkResetCommandBuffer(g_cmdBufferDraw, 0);
+  drawRectangle(commandBuffer, imageIndex);
+}
+
+// Records the thread's horizontal band of the scene
+//
+static void recordSceneBand(RecordThread *recordThread)
+{
+  VkCommandPool commandPool = recordThread->commandPools[recordThread->frameSlot];
+  VkCommandBuffer commandBuffer = recordThread->commandBuffers[recordThread->frameSlot];
+
+  // Resetting the pool recycles the buffer's memory without freeing it
+  vkResetCommandPool(g_device, commandPool, 0);
+
+  VkCommandBufferInheritanceRenderingInfoKHR inheritanceRenderingInfo = {};
+  inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+  inheritanceRenderingInfo.colorAttachmentCount = 1;
+  inheritanceRenderingInfo.pColorAttachmentFormats = &g_output->surfaceFormat.format;
+  inheritanceRenderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkCommandBufferInheritanceInfo inheritanceInfo = {};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  if (g_dynamicRenderingEnabled) {
+    inheritanceInfo.pNext = &inheritanceRenderingInfo;
+  } else {
+    inheritanceInfo.renderPass = g_renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = g_output->framebuffers[recordThread->imageIndex];
+  }
 
   VkCommandBufferBeginInfo beginInfo = {};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-  vkBeginCommandBuffer(g_cmdBufferDraw, &beginInfo);
-  {
-    VkRenderPassBeginInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-    renderPassInfo.renderPass = g_renderPass;
-    renderPassInfo.renderArea.offset.x = 0;
-    renderPassInfo.renderArea.offset.y = 0;
-    renderPassInfo.renderArea.extent = g_swapchainExtent;
-    renderPassInfo.framebuffer = g_framebuffers[swapchainImageIndex];
+  uint32_t bandHeight = g_output->swapchainExtent.height / g_recordThreadCount;
 
-    //connect clear values
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearValue;
+  VkRect2D band = {};
+  band.offset.y = bandHeight * recordThread->index;
+  band.extent.width = g_output->swapchainExtent.width;
+  band.extent.height = recordThread->index + 1 < g_recordThreadCount
+                     ? bandHeight : g_output->swapchainExtent.height - band.offset.y;
 
-    vkCmdBeginRenderPass(g_cmdBufferDraw, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  if (g_damageTrackingEnabled) {
+    band = intersectRect(band, g_output->damageRect);
+  }
 
-    drawRectangle();
+  drawScene(commandBuffer, recordThread->imageIndex, band);
 
-    vkCmdEndRenderPass(g_cmdBufferDraw);
-  }
-  vkEndCommandBuffer(g_cmdBufferDraw);
+  vkEndCommandBuffer(commandBuffer);
+}
 
-  // Submit
-  {
-    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+static void *recordThreadMain(void *arg)
+{
+  RecordThread *recordThread = arg;
 
-    VkSubmitInfo submit = {};
+  for (;;) {
+    while (sem_wait(&recordThread->start) != 0 && errno == EINTR);
+
+    if (!g_recordThreadsRunning) {
+      break;
+    }
+
+    double startSec = clockNowSec();
+    if (recordThread->framePath) {
+      hostAllocatorEnterFrame(&g_hostAllocator);
+    }
+    recordSceneBand(recordThread);
+    if (recordThread->framePath) {
+      hostAllocatorLeaveFrame(&g_hostAllocator);
+    }
+    recordThread->recordingDurationSec = clockNowSec() - startSec;
+
+    sem_post(&g_recordDone);
+  }
+
+  return NULL;
+}
+
+static void stopRecordThreads()
+{
+  if (g_recordThreads == NULL) {
+    return;
+  }
+
+  g_recordThreadsRunning = SDL_FALSE;
+  for (uint32_t i = 0; i < g_recordThreadsStarted; i++) {
+    sem_post(&g_recordThreads[i].start);
+    pthread_join(g_recordThreads[i].thread, NULL);
+  }
+
+  for (uint32_t i = 0; i < g_recordThreadCount; i++) {
+    RecordThread *recordThread = &g_recordThreads[i];
+
+    for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+      if (recordThread->commandPools[slot] != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(g_device, recordThread->commandPools[slot], allocationCallbacks(HOST_OBJECT_COMMAND_POOL));
+      }
+    }
+    sem_destroy(&recordThread->start);
+  }
+  sem_destroy(&g_recordDone);
+
+  free(g_recordThreads);
+  g_recordThreads = NULL;
+  g_recordThreadsStarted = 0;
+}
+
+// One command pool per thread and frame slot, each with a single secondary
+// command buffer that is re-recorded after the pool is reset
+//
+SDL_bool startRecordThreads()
+{
+  logDebug("%s called", __func__);
+
+  g_recordThreads = calloc(g_recordThreadCount, sizeof(*g_recordThreads));
+  if (g_recordThreads == NULL) {
+    logError("Failed to allocate recording threads");
+    return SDL_FALSE;
+  }
+
+  sem_init(&g_recordDone, 0, 0);
+  for (uint32_t i = 0; i < g_recordThreadCount; i++) {
+    g_recordThreads[i].index = i;
+    sem_init(&g_recordThreads[i].start, 0, 0);
+  }
+
+  for (uint32_t i = 0; i < g_recordThreadCount; i++) {
+    RecordThread *recordThread = &g_recordThreads[i];
+
+    for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+      VkCommandPoolCreateInfo commandPoolInfo = {};
+      commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      commandPoolInfo.queueFamilyIndex = 0;
+      commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+      VkResult result = vkCreateCommandPool(g_device, &commandPoolInfo, allocationCallbacks(HOST_OBJECT_COMMAND_POOL), &recordThread->commandPools[slot]);
+      if (result != VK_SUCCESS) {
+        logError("Failed to create recording thread command pool result = %d", result);
+        return SDL_FALSE;
+      }
+
+      VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+      commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      commandBufferAllocateInfo.commandPool = recordThread->commandPools[slot];
+      commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      commandBufferAllocateInfo.commandBufferCount = 1;
+
+      result = vkAllocateCommandBuffers(g_device, &commandBufferAllocateInfo, &recordThread->commandBuffers[slot]);
+      if (result != VK_SUCCESS) {
+        logError("Failed to allocate secondary command buffer result = %d", result);
+        return SDL_FALSE;
+      }
+    }
+  }
+
+  g_recordThreadsRunning = SDL_TRUE;
+
+  for (uint32_t i = 0; i < g_recordThreadCount; i++) {
+    if (pthread_create(&g_recordThreads[i].thread, NULL, recordThreadMain, &g_recordThreads[i]) != 0) {
+      logError("Failed to start recording thread %u", i);
+      return SDL_FALSE;
+    }
+    g_recordThreadsStarted++;
+  }
+
+  logInfo("Recording the scene on %u threads", g_recordThreadCount);
+  return SDL_TRUE;
+}
+
+// Hands the frame to the recording threads and executes their secondary
+// command buffers once all of them finished
+//
+static void recordParallel(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+  uint32_t frameSlot = g_output->frameId % FRAMES_IN_FLIGHT;
+
+  for (uint32_t i = 0; i < g_recordThreadCount; i++) {
+    g_recordThreads[i].imageIndex = imageIndex;
+    g_recordThreads[i].frameSlot = frameSlot;
+    g_recordThreads[i].framePath = g_output->frameId >= HOST_ALLOCATION_WARMUP_FRAMES;
+    sem_post(&g_recordThreads[i].start);
+  }
+
+  for (uint32_t i = 0; i < g_recordThreadCount; i++) {
+    while (sem_wait(&g_recordDone) != 0 && errno == EINTR);
+  }
+
+  VkCommandBuffer secondaryCommandBuffers[g_recordThreadCount];
+  for (uint32_t i = 0; i < g_recordThreadCount; i++) {
+    secondaryCommandBuffers[i] = g_recordThreads[i].commandBuffers[frameSlot];
+  }
+
+  vkCmdExecuteCommands(commandBuffer, g_recordThreadCount, secondaryCommandBuffers);
+}
+
+static void transitionSwapchainImage(VkCommandBuffer commandBuffer, uint32_t imageIndex,
+                                     VkImageLayout oldLayout, VkImageLayout newLayout,
+                                     VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+                                     VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+{
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccessMask;
+  barrier.dstAccessMask = dstAccessMask;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = g_output->swapchainImages[imageIndex];
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+
+  vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+}
+
+// Starts rendering to the swapchain image, through the render pass or with
+// dynamic rendering. The latter does the layout transitions the render pass
+// otherwise does implicitly.
+//
+static void beginFrameRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkRect2D area,
+                                SDL_bool secondaryContents)
+{
+  VkClearValue clearValue = { 0.2f, 0.2f, 0.2f, 1.0f };
+  SDL_bool loadContent = g_damageTrackingEnabled && g_output->damageLoadsContent;
+
+  if (g_dynamicRenderingEnabled) {
+    // Waits on the acquire semaphore's stage, the previous content is discarded
+    // unless damage tracking renders on top of it, loading it is a read
+    transitionSwapchainImage(commandBuffer, imageIndex,
+                             loadContent ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED,
+                             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                             0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                             | (loadContent ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0),
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    VkRenderingAttachmentInfoKHR colorAttachment = {};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.imageView = g_output->colorImageViews[imageIndex];
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = loadContent ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearValue;
+
+    VkRenderingInfoKHR renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.flags = secondaryContents ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+    renderingInfo.renderArea = area;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+
+    pfn_vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+    return;
+  }
+
+  VkRenderPassBeginInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+
+  renderPassInfo.renderPass = loadContent ? g_damageRenderPass : g_renderPass;
+  renderPassInfo.renderArea = area;
+  renderPassInfo.framebuffer = g_output->framebuffers[imageIndex];
+
+  //connect clear values
+  renderPassInfo.clearValueCount = 1;
+  renderPassInfo.pClearValues = &clearValue;
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                       secondaryContents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+}
+
+static void endFrameRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+  if (g_dynamicRenderingEnabled) {
+    pfn_vkCmdEndRenderingKHR(commandBuffer);
+
+    // Presentation is synchronized by the render semaphore, no destination stage
+    // needed, but frame capture copies the image afterwards
+    SDL_bool capture = captureFollowsRendering();
+    transitionSwapchainImage(commandBuffer, imageIndex,
+                             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, capture ? VK_ACCESS_TRANSFER_READ_BIT : 0,
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             capture ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    return;
+  }
+
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+// Commands of a whole frame rendered to the given swapchain image
+//
+static void recordFrameCommands(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkCommandBufferUsageFlags flags)
+{
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = flags;
+
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+  if (g_output->timestampQueryPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, g_output->timestampQueryPool, 0, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, g_output->timestampQueryPool, 0);
+  }
+
+  VkRect2D area = g_damageTrackingEnabled ? g_output->damageRect : fullFrameRect();
+
+  beginFrameRendering(commandBuffer, imageIndex, area, g_recordThreadCount > 0);
+
+  if (g_recordThreadCount > 0) {
+    recordParallel(commandBuffer, imageIndex);
+  } else {
+    drawScene(commandBuffer, imageIndex, area);
+  }
+
+  endFrameRendering(commandBuffer, imageIndex);
+
+  if (g_output->timestampQueryPool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, g_output->timestampQueryPool, 1);
+  }
+
+  vkEndCommandBuffer(commandBuffer);
+}
+
+// Records the per-image command buffers. Has to be called again whenever
+// the swapchain images, framebuffers or the scene change.
+//
+SDL_bool recordImageCommandBuffers()
+{
+  logDebug("%s called", __func__);
+
+  if (g_output->imageCmdBuffers == VK_NULL_HANDLE) {
+    g_output->imageCmdBuffers = calloc(g_output->swapchainImageCount, sizeof(*g_output->imageCmdBuffers));
+    if (g_output->imageCmdBuffers == VK_NULL_HANDLE) {
+      logError("Failed to allocate image command buffers");
+      return SDL_FALSE;
+    }
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.commandPool = g_output->commandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = g_output->swapchainImageCount;
+
+    VkResult result = vkAllocateCommandBuffers(g_device, &commandBufferAllocateInfo, g_output->imageCmdBuffers);
+    if (result != VK_SUCCESS) {
+      logError("Failed to allocate image command buffers result = %d", result);
+      return SDL_FALSE;
+    }
+  }
+
+  for (uint32_t i = 0; i < g_output->swapchainImageCount; i++) {
+    recordFrameCommands(g_output->imageCmdBuffers[i], i, 0);
+  }
+
+  return SDL_TRUE;
+}
+
+// Staging buffers of the bound output's capture ring, each with the command
+// buffer copying a swapchain image into it. Cached memory when available,
+// the writer thread reads every byte.
+//
+SDL_bool createCaptureBuffers()
+{
+  logDebug("%s called", __func__);
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = (VkDeviceSize)g_output->swapchainExtent.width * g_output->swapchainExtent.height * 4;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  for (uint32_t i = 0; i < CAPTURE_RING_SIZE; i++) {
+    CaptureBuffer *capture = &g_output->captureBuffers[i];
+
+    VkResult result = vkCreateBuffer(g_device, &bufferInfo, allocationCallbacks(HOST_OBJECT_BUFFER), &capture->buffer);
+    if (result != VK_SUCCESS) {
+      logError("Failed to create capture buffer result = %d", result);
+      return SDL_FALSE;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(g_device, capture->buffer, &requirements);
+
+    int memoryType = findMemoryType(requirements.memoryTypeBits,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                    | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    if (memoryType < 0) {
+      memoryType = findMemoryType(requirements.memoryTypeBits,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    if (memoryType < 0) {
+      logError("No host visible coherent memory for the capture buffers");
+      return SDL_FALSE;
+    }
+
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex = memoryType;
+
+    result = vkAllocateMemory(g_device, &allocateInfo, allocationCallbacks(HOST_OBJECT_DEVICE_MEMORY), &capture->memory);
+    if (result != VK_SUCCESS) {
+      logError("Failed to allocate capture buffer memory result = %d", result);
+      return SDL_FALSE;
+    }
+
+    vkBindBufferMemory(g_device, capture->buffer, capture->memory, 0);
+
+    result = vkMapMemory(g_device, capture->memory, 0, VK_WHOLE_SIZE, 0, &capture->mapped);
+    if (result != VK_SUCCESS) {
+      logError("Failed to map capture buffer memory result = %d", result);
+      return SDL_FALSE;
+    }
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.commandPool = g_output->commandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = 1;
+
+    result = vkAllocateCommandBuffers(g_device, &commandBufferAllocateInfo, &capture->commandBuffer);
+    if (result != VK_SUCCESS) {
+      logError("Failed to allocate capture command buffer result = %d", result);
+      return SDL_FALSE;
+    }
+
+    capture->frameId = 0;
+    atomic_init(&capture->busy, false);
+  }
+
+  return SDL_TRUE;
+}
+
+static void destroyCaptureBuffers()
+{
+  for (uint32_t i = 0; i < CAPTURE_RING_SIZE; i++) {
+    CaptureBuffer *capture = &g_output->captureBuffers[i];
+
+    if (capture->commandBuffer != VK_NULL_HANDLE) {
+      vkFreeCommandBuffers(g_device, g_output->commandPool, 1, &capture->commandBuffer);
+      capture->commandBuffer = VK_NULL_HANDLE;
+    }
+    if (capture->buffer != VK_NULL_HANDLE) {
+      vkDestroyBuffer(g_device, capture->buffer, allocationCallbacks(HOST_OBJECT_BUFFER));
+      capture->buffer = VK_NULL_HANDLE;
+    }
+    if (capture->memory != VK_NULL_HANDLE) {
+      // Freeing the memory unmaps it
+      vkFreeMemory(g_device, capture->memory, allocationCallbacks(HOST_OBJECT_DEVICE_MEMORY));
+      capture->memory = VK_NULL_HANDLE;
+      capture->mapped = NULL;
+    }
+  }
+}
+
+// Records the copy of the swapchain image into the next staging buffer of the
+// ring, submitted after the frame's commands. SDL_FALSE when the frame is not
+// captured, counted as dropped when the staging buffer is still busy.
+//
+static SDL_bool recordCapture(uint32_t imageIndex, uint64_t frameId, VkCommandBuffer *commandBuffer)
+{
+  if (!g_output->captureSupported || frameId % g_config.captureInterval != 0) {
+    return SDL_FALSE;
+  }
+
+  CaptureBuffer *capture = &g_output->captureBuffers[g_output->captureNext];
+  if (atomic_load(&capture->busy)) {
+    captureWriterDropped(&g_captureWriter);
+    return SDL_FALSE;
+  }
+
+  g_output->captureNext = (g_output->captureNext + 1) % CAPTURE_RING_SIZE;
+  atomic_store(&capture->busy, true);
+  capture->frameId = frameId;
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkResetCommandBuffer(capture->commandBuffer, 0);
+  vkBeginCommandBuffer(capture->commandBuffer, &beginInfo);
+
+  // The frame's commands left the image ready to present, their last layout
+  // transition has the transfer stage as destination: waiting on it chains
+  VkImageMemoryBarrier imageBarrier = {};
+  imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  imageBarrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.image = g_output->swapchainImages[imageIndex];
+  imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  imageBarrier.subresourceRange.levelCount = 1;
+  imageBarrier.subresourceRange.layerCount = 1;
+
+  vkCmdPipelineBarrier(capture->commandBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &imageBarrier);
+
+  // Tightly packed rows
+  VkBufferImageCopy region = {};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent.width = g_output->swapchainExtent.width;
+  region.imageExtent.height = g_output->swapchainExtent.height;
+  region.imageExtent.depth = 1;
+
+  vkCmdCopyImageToBuffer(capture->commandBuffer, g_output->swapchainImages[imageIndex],
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, capture->buffer, 1, &region);
+
+  // Back to presentable, the present waits for the whole submission
+  imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  imageBarrier.dstAccessMask = 0;
+  imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  imageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  VkBufferMemoryBarrier bufferBarrier = {};
+  bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferBarrier.buffer = capture->buffer;
+  bufferBarrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(capture->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+                       0, NULL, 1, &bufferBarrier, 1, &imageBarrier);
+
+  vkEndCommandBuffer(capture->commandBuffer);
+
+  *commandBuffer = capture->commandBuffer;
+  return SDL_TRUE;
+}
+
+// Hands the bound output's staging buffers whose copy completed to the writer
+//
+static void queueCompletedCaptures(uint64_t completedFrameId)
+{
+  for (uint32_t i = 0; i < CAPTURE_RING_SIZE; i++) {
+    CaptureBuffer *capture = &g_output->captureBuffers[i];
+    if (capture->frameId == 0 || capture->frameId > completedFrameId) {
+      continue;
+    }
+
+    struct CaptureJob job = {};
+    job.pixels = capture->mapped;
+    job.width = g_output->swapchainExtent.width;
+    job.height = g_output->swapchainExtent.height;
+    job.rowPitch = g_output->swapchainExtent.width * 4;
+    job.output = g_output - g_outputs;
+    job.frameId = capture->frameId;
+    job.busy = &capture->busy;
+
+    // The writer's queue is longer than all rings together, but never wait
+    if (!captureWriterQueue(&g_captureWriter, &job)) {
+      captureWriterDropped(&g_captureWriter);
+      atomic_store(&capture->busy, false);
+    }
+    capture->frameId = 0;
+  }
+}
+
+// Everything depending on the swapchain images of the bound output, but the
+// swapchain itself
+//
+static void destroySwapchainResources()
+{
+  for (int i = 0; i < g_output->swapchainImageCount; i++) {
+    if (g_output->framebuffers != VK_NULL_HANDLE) {
+      vkDestroyFramebuffer(g_device, g_output->framebuffers[i], allocationCallbacks(HOST_OBJECT_FRAMEBUFFER));
+    }
+    if (g_output->colorImageViews != VK_NULL_HANDLE) {
+      vkDestroyImageView(g_device, g_output->colorImageViews[i], allocationCallbacks(HOST_OBJECT_IMAGE_VIEW));
+    }
+  }
+
+  if (g_output->imageCmdBuffers != VK_NULL_HANDLE) {
+    vkFreeCommandBuffers(g_device, g_output->commandPool, g_output->swapchainImageCount, g_output->imageCmdBuffers);
+  }
+  if (g_output->descriptorPool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(g_device, g_output->descriptorPool, allocationCallbacks(HOST_OBJECT_DESCRIPTOR_POOL));
+    g_output->descriptorPool = VK_NULL_HANDLE;
+  }
+  if (g_output->uniformBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(g_device, g_output->uniformBuffer, allocationCallbacks(HOST_OBJECT_BUFFER));
+    g_output->uniformBuffer = VK_NULL_HANDLE;
+  }
+  if (g_output->uniformMemory != VK_NULL_HANDLE) {
+    // Freeing the memory unmaps it
+    vkFreeMemory(g_device, g_output->uniformMemory, allocationCallbacks(HOST_OBJECT_DEVICE_MEMORY));
+    g_output->uniformMemory = VK_NULL_HANDLE;
+    g_output->uniformMapped = NULL;
+  }
+
+  free(g_output->swapchainImages);
+  free(g_output->colorImageViews);
+  free(g_output->framebuffers);
+  free(g_output->imageCmdBuffers);
+  free(g_output->descriptorSets);
+  free(g_output->imageBarRects);
+  free(g_output->imageContentValid);
+  g_output->swapchainImages = VK_NULL_HANDLE;
+  g_output->colorImageViews = VK_NULL_HANDLE;
+  g_output->framebuffers = VK_NULL_HANDLE;
+  g_output->imageCmdBuffers = VK_NULL_HANDLE;
+  g_output->descriptorSets = VK_NULL_HANDLE;
+  g_output->imageBarRects = VK_NULL_HANDLE;
+  g_output->imageContentValid = VK_NULL_HANDLE;
+  g_output->swapchainImageCount = 0;
+}
+
+// Device objects of the bound output, its surface goes with the instance
+//
+static void cleanupOutput()
+{
+  vkDestroySemaphore(g_device, g_output->presentSemaphore, allocationCallbacks(HOST_OBJECT_SEMAPHORE));
+  vkDestroySemaphore(g_device, g_output->renderSemaphore, allocationCallbacks(HOST_OBJECT_SEMAPHORE));
+  if (g_output->renderFence != VK_NULL_HANDLE) {
+    vkDestroyFence(g_device, g_output->renderFence, allocationCallbacks(HOST_OBJECT_FENCE));
+    g_output->renderFence = VK_NULL_HANDLE;
+  }
+  if (g_output->timelineSemaphore != VK_NULL_HANDLE) {
+    vkDestroySemaphore(g_device, g_output->timelineSemaphore, allocationCallbacks(HOST_OBJECT_SEMAPHORE));
+    g_output->timelineSemaphore = VK_NULL_HANDLE;
+  }
+  if (g_output->timestampQueryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(g_device, g_output->timestampQueryPool, allocationCallbacks(HOST_OBJECT_QUERY_POOL));
+    g_output->timestampQueryPool = VK_NULL_HANDLE;
+  }
+
+  destroySwapchainResources();
+  destroyCaptureBuffers();
+  vkDestroyCommandPool(g_device, g_output->commandPool, allocationCallbacks(HOST_OBJECT_COMMAND_POOL));
+  vkDestroySwapchainKHR(g_device, g_output->swapchain, allocationCallbacks(HOST_OBJECT_SWAPCHAIN));
+}
+
+// ------ Public API ----------
+//
+
+
+// Main starting point for Vulkan
+//
+SDL_bool InitializeVulkan(SDL_Window* pWindowHandle, int width, int height, const VulkanConfig *config)
+{
+  return InitializeVulkanOutputs(&pWindowHandle, &width, &height, 1, config);
+}
+
+SDL_bool InitializeVulkanOutputs(SDL_Window **windows, const int *widths, const int *heights,
+                                 uint32_t count, const VulkanConfig *config)
+{
+  if (config != NULL) {
+    g_config = *config;
+  }
+
+  if (count == 0) {
+    logError("No output to initialize");
+    return SDL_FALSE;
+  }
+
+  g_pattern = g_config.pattern < VULKAN_PATTERN_COUNT ? g_config.pattern : VULKAN_PATTERN_DEFAULT;
+
+  g_outputCount = count;
+  if (g_outputCount > VULKAN_MAX_OUTPUTS) {
+    logWarning("Only %d outputs are supported", VULKAN_MAX_OUTPUTS);
+    g_outputCount = VULKAN_MAX_OUTPUTS;
+  }
+
+  for (uint32_t i = 0; i < g_outputCount; i++) {
+    memset(&g_outputs[i], 0, sizeof(g_outputs[i]));
+    pthread_mutex_init(&g_outputs[i].swapchainLock, NULL);
+    pthread_mutex_init(&g_outputs[i].presentTimingLock, NULL);
+    pthread_cond_init(&g_outputs[i].presentTimingCond, NULL);
+    g_outputs[i].damageFraction = 1.0;
+  }
+  g_output = &g_outputs[0];
+
+  if (g_outputCount > 1 && g_config.directDisplay) {
+    logWarning("Direct display drives a single output, using the windows");
+    g_config.directDisplay = SDL_FALSE;
+  }
+
+  g_recordThreadCount = g_config.recordThreads;
+  if (g_recordThreadCount > VULKAN_MAX_RECORD_THREADS) {
+    g_recordThreadCount = VULKAN_MAX_RECORD_THREADS;
+  }
+  if (g_recordThreadCount > 0 && g_config.prerecordedCommands) {
+    logWarning("Pre-recorded command buffers are used, ignoring the recording threads");
+    g_recordThreadCount = 0;
+  }
+  if (g_recordThreadCount > 0 && g_outputCount > 1) {
+    logWarning("Recording threads are shared by a single output, ignoring them");
+    g_recordThreadCount = 0;
+  }
+
+  g_damageTrackingEnabled = g_config.damageTracking;
+  if (g_damageTrackingEnabled && g_config.prerecordedCommands) {
+    logWarning("Pre-recorded command buffers always render the whole frame, ignoring damage tracking");
+    g_damageTrackingEnabled = SDL_FALSE;
+  }
+
+  if (g_config.captureDirectory != NULL && g_config.captureInterval == 0) {
+    g_config.captureInterval = 1;
+  }
+  if (!captureWriterInitialize(&g_captureWriter, g_config.captureDirectory,
+                               g_config.captureCompressed ? CAPTURE_FORMAT_PNG : CAPTURE_FORMAT_PPM)) {
+    return SDL_FALSE;
+  }
+
+  // Before the instance, objects are destroyed with the callbacks they were created with
+  if (!hostAllocatorInitialize(&g_hostAllocator, g_config.trackHostAllocations || g_config.hostAllocationArena,
+                               g_config.hostAllocationArena)) {
+    return SDL_FALSE;
+  }
+
+  if (!initVulkanCore(g_config.directDisplay)) {
+    return SDL_FALSE;
+  }
+
+  if (!initLogicalDevice()) {
+    return SDL_FALSE;
+  }
+
+  // Surfaces first, the render pass and pipeline are created for their format
+  for (uint32_t i = 0; i < g_outputCount; i++) {
+    g_output = &g_outputs[i];
+    if (!initSwapchain(windows[i], widths[i], heights[i])) {
+      return SDL_FALSE;
+    }
+
+    // Built once from output 0, every output has to render in the same format
+    if (g_outputs[i].surfaceFormat.format != g_outputs[0].surfaceFormat.format
+        || g_outputs[i].surfaceFormat.colorSpace != g_outputs[0].surfaceFormat.colorSpace) {
+      logError("Output %u surface format %d (color space %d) differs from output 0: %d (color space %d)",
+               i, g_outputs[i].surfaceFormat.format, g_outputs[i].surfaceFormat.colorSpace,
+               g_outputs[0].surfaceFormat.format, g_outputs[0].surfaceFormat.colorSpace);
+      return SDL_FALSE;
+    }
+  }
+  g_output = &g_outputs[0];
+
+  if (!g_dynamicRenderingEnabled && !createRenderPass()) {
+    return SDL_FALSE;
+  }
+
+  if (g_config.prerecordedCommands && !createDescriptorSetLayout()) {
+    return SDL_FALSE;
+  }
+
+  if (!createPipeline()) {
+    return SDL_FALSE;
+  }
+
+  for (uint32_t i = 0; i < g_outputCount; i++) {
+    g_output = &g_outputs[i];
+
+    if (!g_dynamicRenderingEnabled && !createFramebuffers()) {
+      return SDL_FALSE;
+    }
+
+    if (!createCommandBuffers()) {
+      return SDL_FALSE;
+    }
+
+    if (!createSyncObjects()) {
+      return SDL_FALSE;
+    }
+
+    if (!createTimestampQueryPool()) {
+      return SDL_FALSE;
+    }
+
+    if (g_config.prerecordedCommands) {
+      if (!createUniformBuffer() || !recordImageCommandBuffers()) {
+        return SDL_FALSE;
+      }
+    }
+
+    if (g_damageTrackingEnabled && !createDamageTracking()) {
+      return SDL_FALSE;
+    }
+
+    if (g_output->captureSupported && !createCaptureBuffers()) {
+      return SDL_FALSE;
+    }
+
+    startPresentWaiter();
+  }
+  g_output = &g_outputs[0];
+
+  if (g_recordThreadCount > 0 && !startRecordThreads()) {
+    return SDL_FALSE;
+  }
+
+  return SDL_TRUE;
+}
+
+uint32_t GetOutputCount()
+{
+  return g_outputCount;
+}
+
+void BindOutput(uint32_t output)
+{
+  if (output < g_outputCount) {
+    g_output = &g_outputs[output];
+  }
+}
+
+uint32_t GetDisplayRefreshRateMilliHz()
+{
+  return g_output->displayRefreshRateMilliHz;
+}
+
+double GetGpuFrameDurationSec()
+{
+  return g_output->gpuFrameDurationSec;
+}
+
+double GetRecordingDurationSec()
+{
+  return g_output->recordingDurationSec;
+}
+
+double GetDamageFraction()
+{
+  return g_output->damageFraction;
+}
+
+uint32_t GetRecordThreadCount()
+{
+  return g_recordThreadCount;
+}
+
+double GetThreadRecordingDurationSec(uint32_t thread)
+{
+  if (g_recordThreads == NULL || thread >= g_recordThreadCount) {
+    return 0.0;
+  }
+
+  return g_recordThreads[thread].recordingDurationSec;
+}
+
+// Dump displays, their modes and the display planes exposed through VK_KHR_display
+//
+SDL_bool ListDisplays()
+{
+  if (!initVulkanCore(SDL_TRUE)) {
+    return SDL_FALSE;
+  }
+
+  if (!g_directDisplayExtensionsEnabled) {
+    printf("VK_KHR_display is not available on this system\n");
+    CleanupVulkan();
+    return SDL_FALSE;
+  }
+
+  printf("Physical device: %s\n", g_physicalDeviceProperties.deviceName);
+
+  uint32_t displayCount = 0;
+  vkGetPhysicalDeviceDisplayPropertiesKHR(g_physicalDevice, &displayCount, VK_NULL_HANDLE);
+
+  VkDisplayPropertiesKHR displayProperties[displayCount + 1];
+  vkGetPhysicalDeviceDisplayPropertiesKHR(g_physicalDevice, &displayCount, displayProperties);
+
+  printf("Displays: %u\n", displayCount);
+  for (uint32_t i = 0; i < displayCount; i++) {
+    VkDisplayPropertiesKHR *display = &displayProperties[i];
+    printf("  [%u] %s\n", i, display->displayName ? display->displayName : "(unnamed)");
+    printf("      physical resolution %ux%u, physical size %ux%u mm\n",
+           display->physicalResolution.width, display->physicalResolution.height,
+           display->physicalDimensions.width, display->physicalDimensions.height);
+
+    uint32_t modeCount = 0;
+    vkGetDisplayModePropertiesKHR(g_physicalDevice, display->display, &modeCount, VK_NULL_HANDLE);
+
+    VkDisplayModePropertiesKHR modes[modeCount + 1];
+    vkGetDisplayModePropertiesKHR(g_physicalDevice, display->display, &modeCount, modes);
+
+    int bestMode = selectDisplayMode(modes, modeCount, 0, 0, 0);
+    for (uint32_t m = 0; m < modeCount; m++) {
+      printf("      mode %2u: %ux%u@%.3f%s\n", m,
+             modes[m].parameters.visibleRegion.width, modes[m].parameters.visibleRegion.height,
+             displayModeRefreshRateHz(&modes[m]), (int)m == bestMode ? " (default)" : "");
+    }
+  }
+
+  uint32_t planeCount = 0;
+  vkGetPhysicalDeviceDisplayPlanePropertiesKHR(g_physicalDevice, &planeCount, VK_NULL_HANDLE);
+
+  VkDisplayPlanePropertiesKHR planeProperties[planeCount + 1];
+  vkGetPhysicalDeviceDisplayPlanePropertiesKHR(g_physicalDevice, &planeCount, planeProperties);
+
+  printf("Planes: %u\n", planeCount);
+  for (uint32_t i = 0; i < planeCount; i++) {
+    uint32_t supportedDisplayCount = 0;
+    vkGetDisplayPlaneSupportedDisplaysKHR(g_physicalDevice, i, &supportedDisplayCount, VK_NULL_HANDLE);
+
+    VkDisplayKHR supportedDisplays[supportedDisplayCount + 1];
+    vkGetDisplayPlaneSupportedDisplaysKHR(g_physicalDevice, i, &supportedDisplayCount, supportedDisplays);
+
+    printf("  [%u] stack index %u, current display %s, supported displays:",
+           i, planeProperties[i].currentStackIndex,
+           planeProperties[i].currentDisplay != VK_NULL_HANDLE ? "bound" : "none");
+    for (uint32_t j = 0; j < supportedDisplayCount; j++) {
+      for (uint32_t d = 0; d < displayCount; d++) {
+        if (supportedDisplays[j] == displayProperties[d].display) {
+          printf(" %u", d);
+        }
+      }
+    }
+    printf("\n");
+  }
+
+  CleanupVulkan();
+  return SDL_TRUE;
+}
+
+SDL_bool SetPresentMode(VulkanPresentMode presentMode)
+{
+  if (g_output->swapchain == VK_NULL_HANDLE || presentMode >= VULKAN_PRESENT_MODE_COUNT) {
+    return SDL_FALSE;
+  }
+
+  if (selectPresentMode(presentMode) == g_output->presentMode) {
+    return SDL_TRUE;
+  }
+
+  // Ids pending on the old swapchain would never complete on the new one
+  stopPresentWaiter();
+
+  pthread_mutex_lock(&g_queueLock);
+  vkQueueWaitIdle(g_presentQueue);
+  pthread_mutex_unlock(&g_queueLock);
+
+  destroySwapchainResources();
+
+  VkSwapchainKHR oldSwapchain = g_output->swapchain;
+  SDL_bool success = createSwapchain(oldSwapchain, presentMode);
+  vkDestroySwapchainKHR(g_device, oldSwapchain, allocationCallbacks(HOST_OBJECT_SWAPCHAIN));
+
+  if (success && !g_dynamicRenderingEnabled) {
+    success = createFramebuffers();
+  }
+  if (success && g_config.prerecordedCommands) {
+    success = createUniformBuffer() && recordImageCommandBuffers();
+  }
+  if (success && g_damageTrackingEnabled) {
+    success = createDamageTracking();
+  }
+
+  startPresentWaiter();
+
+  if (success) {
+    logInfo("Swapchain recreated, present mode: %s", GetPresentModeName(g_output->presentMode));
+  }
+  return success;
+}
+
+VulkanPresentMode GetPresentMode()
+{
+  return g_output->presentMode;
+}
+
+const char *GetPresentModeName(VulkanPresentMode presentMode)
+{
+  return presentMode < VULKAN_PRESENT_MODE_COUNT ? g_presentModeNames[presentMode] : "unknown";
+}
+
+SDL_bool SetPattern(VulkanPattern pattern)
+{
+  if (pattern >= VULKAN_PATTERN_COUNT) {
+    return SDL_FALSE;
+  }
+
+  if (pattern == g_pattern) {
+    return SDL_TRUE;
+  }
+  g_pattern = pattern;
+
+  // Per-frame recording picks the pipeline up with the next frame, the
+  // pre-recorded command buffers bind it once
+  SDL_bool success = SDL_TRUE;
+  if (g_config.prerecordedCommands) {
+    VulkanOutput *boundOutput = g_output;
+
+    pthread_mutex_lock(&g_queueLock);
+    vkQueueWaitIdle(g_presentQueue);
+    pthread_mutex_unlock(&g_queueLock);
+
+    for (uint32_t i = 0; i < g_outputCount && success; i++) {
+      g_output = &g_outputs[i];
+      success = recordImageCommandBuffers();
+    }
+    g_output = boundOutput;
+  }
+
+  logInfo("Pattern: %s", g_patternNames[pattern]);
+  return success;
+}
+
+VulkanPattern GetPattern()
+{
+  return g_pattern;
+}
+
+const char *GetPatternName(VulkanPattern pattern)
+{
+  return pattern < VULKAN_PATTERN_COUNT ? g_patternNames[pattern] : "unknown";
+}
+
+SDL_bool PollPresentTiming(PresentTiming *timing)
+{
+  pthread_mutex_lock(&g_output->presentTimingLock);
+  SDL_bool available = popPresentTiming(&g_output->completedPresents, timing);
+  pthread_mutex_unlock(&g_output->presentTimingLock);
+
+  return available;
+}
+
+void Update(float position)
+{
+  g_output->delta.x = position;
+}
+
+uint64_t GetCompletedFrameId()
+{
+  if (g_timelineSemaphoreEnabled) {
+    uint64_t value = 0;
+    if (pfn_vkGetSemaphoreCounterValueKHR(g_device, g_output->timelineSemaphore, &value) == VK_SUCCESS) {
+      return value;
+    }
+    return g_output->completedFrameId;
+  }
+
+  if (g_output->completedFrameId < g_output->frameId && vkGetFenceStatus(g_device, g_output->renderFence) == VK_SUCCESS) {
+    g_output->completedFrameId = g_output->frameId;
+  }
+
+  return g_output->completedFrameId;
+}
+
+SDL_bool WaitForFrameCompletion(uint64_t frameId, uint64_t timeoutNs)
+{
+  if (frameId <= g_output->completedFrameId) {
+    return SDL_TRUE;
+  }
+
+  // Never submitted, waiting would not end
+  if (frameId > g_output->frameId) {
+    return SDL_FALSE;
+  }
+
+  if (g_timelineSemaphoreEnabled) {
+    VkSemaphoreWaitInfoKHR waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &g_output->timelineSemaphore;
+    waitInfo.pValues = &frameId;
+
+    if (pfn_vkWaitSemaphoresKHR(g_device, &waitInfo, timeoutNs) != VK_SUCCESS) {
+      return SDL_FALSE;
+    }
+
+    g_output->completedFrameId = frameId;
+    return SDL_TRUE;
+  }
+
+  if (vkWaitForFences(g_device, 1, &g_output->renderFence, VK_TRUE, timeoutNs) != VK_SUCCESS) {
+    return SDL_FALSE;
+  }
+
+  g_output->completedFrameId = g_output->frameId;
+  return SDL_TRUE;
+}
+
+uint64_t Draw()
+{
+  SDL_bool framePath = g_output->frameId >= HOST_ALLOCATION_WARMUP_FRAMES;
+  if (framePath) {
+    hostAllocatorEnterFrame(&g_hostAllocator);
+  }
+
+  // Resources of the frame slot are reused once its previous frame completed
+  WaitForFrameCompletion(g_output->frameId + 1 - FRAMES_IN_FLIGHT, UINT64_MAX);
+  if (!g_timelineSemaphoreEnabled) {
+    vkResetFences(g_device, 1, &g_output->renderFence);
+  }
+
+  readGpuFrameDuration();
+
+  if (g_output->captureSupported) {
+    queueCompletedCaptures(GetCompletedFrameId());
+  }
+
+  uint32_t swapchainImageIndex = 0;
+  pthread_mutex_lock(&g_output->swapchainLock);
+  vkAcquireNextImageKHR(g_device, g_output->swapchain, UINT64_MAX, g_output->presentSemaphore, VK_NULL_HANDLE, &swapchainImageIndex);
+  pthread_mutex_unlock(&g_output->swapchainLock);
+
+  if (g_damageTrackingEnabled) {
+    updateDamage(swapchainImageIndex);
+  }
+
+  // Frame commands: record them, or with pre-recorded command buffers only
+  // update the image's uniform slice
+  double recordingStartSec = clockNowSec();
+  VkCommandBuffer commandBuffer;
+
+  if (g_config.prerecordedCommands) {
+    Position *frameData = (Position *)((char *)g_output->uniformMapped + g_output->uniformStride * swapchainImageIndex);
+    *frameData = g_output->delta;
+    commandBuffer = g_output->imageCmdBuffers[swapchainImageIndex];
+  } else {
+    vkResetCommandBuffer(g_output->cmdBufferDraw, 0);
+    recordFrameCommands(g_output->cmdBufferDraw, swapchainImageIndex, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    commandBuffer = g_output->cmdBufferDraw;
+  }
+
+  g_output->recordingDurationSec = clockNowSec() - recordingStartSec;
+  g_output->timestampsPending = g_output->timestampQueryPool != VK_NULL_HANDLE;
+
+  PresentTiming timing = {};
+  timing.frameId = g_output->frameId + 1;
+
+  // Frame capture, copied in the same submission
+  VkCommandBuffer commandBuffers[] = { commandBuffer, VK_NULL_HANDLE };
+  uint32_t commandBufferCount = 1;
+  if (g_output->captureSupported && recordCapture(swapchainImageIndex, timing.frameId, &commandBuffers[1])) {
+    commandBufferCount = 2;
+  }
+
+  // Submit
+  {
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkSemaphore signalSemaphores[] = { g_output->renderSemaphore, g_output->timelineSemaphore };
+
+    VkSubmitInfo submit = {};
     submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submit.pWaitDstStageMask = &waitStage;
     submit.waitSemaphoreCount = 1;
-    submit.pWaitSemaphores = &g_presentSemaphore;
+    submit.pWaitSemaphores = &g_output->presentSemaphore;
     submit.signalSemaphoreCount = 1;
-    submit.pSignalSemaphores = &g_renderSemaphore;
-
-    submit.commandBufferCount = 1;
-    submit.pCommandBuffers = &g_cmdBufferDraw;
-
-    vkQueueSubmit(g_presentQueue, 1, &submit, g_renderFence);
+    submit.pSignalSemaphores = signalSemaphores;
+
+    submit.commandBufferCount = commandBufferCount;
+    submit.pCommandBuffers = commandBuffers;
+
+    // Values of binary semaphores are ignored
+    uint64_t waitValues[] = { 0 };
+    uint64_t signalValues[] = { 0, timing.frameId };
+
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = 2;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+
+    pthread_mutex_lock(&g_queueLock);
+    if (g_timelineSemaphoreEnabled) {
+      submit.pNext = &timelineInfo;
+      submit.signalSemaphoreCount = 2;
+      vkQueueSubmit(g_presentQueue, 1, &submit, VK_NULL_HANDLE);
+    } else {
+      vkQueueSubmit(g_presentQueue, 1, &submit, g_output->renderFence);
+    }
+    pthread_mutex_unlock(&g_queueLock);
   }
 
+  g_output->frameId = timing.frameId;
+  timing.submitTimeSec = clockNowSec();
+
   // Present
   {
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.pSwapchains = &g_swapchain;
+    presentInfo.pSwapchains = &g_output->swapchain;
     presentInfo.swapchainCount = 1;
 
-    presentInfo.pWaitSemaphores = &g_renderSemaphore;
+    presentInfo.pWaitSemaphores = &g_output->renderSemaphore;
     presentInfo.waitSemaphoreCount = 1;
 
     presentInfo.pImageIndices = &swapchainImageIndex;
 
+    // Changed since the last present: the bar's previous and new position
+    VkRect2D bar = g_output->imageBarRects != VK_NULL_HANDLE ? g_output->imageBarRects[swapchainImageIndex] : fullFrameRect();
+    VkRect2D changed = g_output->presentedBarRectValid ? unionRect(g_output->presentedBarRect, bar) : fullFrameRect();
+
+    VkRectLayerKHR presentRect = {};
+    presentRect.offset = changed.offset;
+    presentRect.extent = changed.extent;
+    presentRect.layer = 0;
+
+    VkPresentRegionKHR presentRegion = {};
+    presentRegion.rectangleCount = 1;
+    presentRegion.pRectangles = &presentRect;
+
+    VkPresentRegionsKHR presentRegions = {};
+    presentRegions.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR;
+    presentRegions.swapchainCount = 1;
+    presentRegions.pRegions = &presentRegion;
+    if (g_damageTrackingEnabled && g_incrementalPresentEnabled) {
+      presentRegions.pNext = presentInfo.pNext;
+      presentInfo.pNext = &presentRegions;
+    }
+
+    if (g_damageTrackingEnabled) {
+      g_output->presentedBarRect = bar;
+      g_output->presentedBarRectValid = SDL_TRUE;
+    }
+
+    // The frame id doubles as present id
+    VkPresentIdKHR presentId = {};
+    presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentId.swapchainCount = 1;
+    presentId.pPresentIds = &timing.frameId;
+    if (g_presentWaitEnabled) {
+      presentId.pNext = presentInfo.pNext;
+      presentInfo.pNext = &presentId;
+    }
+
+    pthread_mutex_lock(&g_output->swapchainLock);
+    pthread_mutex_lock(&g_queueLock);
     vkQueuePresentKHR(g_presentQueue, &presentInfo);
+    pthread_mutex_unlock(&g_queueLock);
+    pthread_mutex_unlock(&g_output->swapchainLock);
+  }
+
+  pthread_mutex_lock(&g_output->presentTimingLock);
+  if (g_output->presentWaiterRunning) {
+    pushPresentTiming(&g_output->pendingPresents, &timing);
+    pthread_cond_signal(&g_output->presentTimingCond);
+  } else {
+    timing.presentTimeSec = clockNowSec();
+    timing.presentTimeIsDisplayed = SDL_FALSE;
+    pushPresentTiming(&g_output->completedPresents, &timing);
+  }
+  pthread_mutex_unlock(&g_output->presentTimingLock);
+
+  if (framePath) {
+    hostAllocatorLeaveFrame(&g_hostAllocator);
   }
+
+  return timing.frameId;
+}
+
+uint64_t GetFramePathHostAllocations()
+{
+  return hostAllocatorFramePathAllocations(&g_hostAllocator);
+}
+
+void GetCaptureCounts(uint64_t *written, uint64_t *dropped)
+{
+  *written = atomic_load(&g_captureWriter.written);
+  *dropped = atomic_load(&g_captureWriter.dropped);
+}
+
+void FinishPresentTimings()
+{
+  if (g_device == VK_NULL_HANDLE) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_queueLock);
+  vkQueueWaitIdle(g_presentQueue);
+  pthread_mutex_unlock(&g_queueLock);
+
+  VulkanOutput *boundOutput = g_output;
+  for (uint32_t i = 0; i < g_outputCount; i++) {
+    g_output = &g_outputs[i];
+
+    // The waiter moves every pending present to the completed queue
+    double deadlineSec = clockNowSec() + PRESENT_DRAIN_TIMEOUT_SEC;
+    pthread_mutex_lock(&g_output->presentTimingLock);
+    while (g_output->presentWaiterRunning && g_output->pendingPresents.count > 0 && clockNowSec() < deadlineSec) {
+      pthread_mutex_unlock(&g_output->presentTimingLock);
+      clockSleepSec(0.001);
+      pthread_mutex_lock(&g_output->presentTimingLock);
+    }
+    pthread_mutex_unlock(&g_output->presentTimingLock);
+
+    stopPresentWaiter();
+  }
+  g_output = boundOutput;
 }
 
 // Release Vulkan resources
 //
 void CleanupVulkan()
 {
-  if (g_instance != VK_NULL_HANDLE) {
-    vkDestroySemaphore(g_device, g_presentSemaphore, NULL);
-    vkDestroySemaphore(g_device, g_renderSemaphore, NULL);
-    vkDestroyFence(g_device, g_renderFence, VK_NULL_HANDLE);
-    vkDestroyPipelineLayout(g_device, g_pipelineLayout, VK_NULL_HANDLE);
-    vkDestroyPipeline(g_device, g_pipeline, VK_NULL_HANDLE);
-    vkDestroyCommandPool(g_device, g_commandPool, VK_NULL_HANDLE);
-    vkDestroyRenderPass(g_device, g_renderPass, VK_NULL_HANDLE);
-    vkDestroySwapchainKHR(g_device, g_swapchain, VK_NULL_HANDLE);
+  for (uint32_t i = 0; i < g_outputCount; i++) {
+    g_output = &g_outputs[i];
+    stopPresentWaiter();
+  }
+
+  if (g_device != VK_NULL_HANDLE) {
+    vkDeviceWaitIdle(g_device);
 
-    for (int i = 0; i < g_swapchainImageCount; i++) {
-      vkDestroyFramebuffer(g_device, g_framebuffers[i], VK_NULL_HANDLE);
+    stopRecordThreads();
+
+    // Every copy completed, write them before the staging buffers go
+    for (uint32_t i = 0; i < g_outputCount; i++) {
+      g_output = &g_outputs[i];
+      queueCompletedCaptures(UINT64_MAX);
     }
+    captureWriterFinalize(&g_captureWriter);
 
-    vkDestroyDevice(g_device, VK_NULL_HANDLE);
-    vkDestroyInstance(g_instance, VK_NULL_HANDLE);
+    for (uint32_t i = 0; i < g_outputCount; i++) {
+      g_output = &g_outputs[i];
+      cleanupOutput();
+    }
 
+    vkDestroyPipelineLayout(g_device, g_pipelineLayout, allocationCallbacks(HOST_OBJECT_PIPELINE_LAYOUT));
+    if (g_descriptorSetLayout != VK_NULL_HANDLE) {
+      vkDestroyDescriptorSetLayout(g_device, g_descriptorSetLayout, allocationCallbacks(HOST_OBJECT_DESCRIPTOR_SET_LAYOUT));
+      g_descriptorSetLayout = VK_NULL_HANDLE;
+    }
+    for (uint32_t i = 0; i < VULKAN_PATTERN_COUNT; i++) {
+      if (g_pipelines[i] != VK_NULL_HANDLE) {
+        vkDestroyPipeline(g_device, g_pipelines[i], allocationCallbacks(HOST_OBJECT_PIPELINE));
+        g_pipelines[i] = VK_NULL_HANDLE;
+      }
+    }
+    if (g_pipelineCache != VK_NULL_HANDLE) {
+      vkDestroyPipelineCache(g_device, g_pipelineCache, allocationCallbacks(HOST_OBJECT_PIPELINE_CACHE));
+      g_pipelineCache = VK_NULL_HANDLE;
+    }
+    if (g_renderPass != VK_NULL_HANDLE) {
+      vkDestroyRenderPass(g_device, g_renderPass, allocationCallbacks(HOST_OBJECT_RENDER_PASS));
+      g_renderPass = VK_NULL_HANDLE;
+    }
+    if (g_damageRenderPass != VK_NULL_HANDLE) {
+      vkDestroyRenderPass(g_device, g_damageRenderPass, allocationCallbacks(HOST_OBJECT_RENDER_PASS));
+      g_damageRenderPass = VK_NULL_HANDLE;
+    }
+
+    vkDestroyDevice(g_device, allocationCallbacks(HOST_OBJECT_DEVICE));
+    g_device = VK_NULL_HANDLE;
+  }
+
+  for (uint32_t i = 0; i < g_outputCount; i++) {
+    VulkanOutput *output = &g_outputs[i];
+
+    if (g_instance != VK_NULL_HANDLE && output->surface != VK_NULL_HANDLE) {
+      // Created without allocation callbacks (SDL_Vulkan_CreateSurface cannot take any), destroyed to match
+      vkDestroySurfaceKHR(g_instance, output->surface, VK_NULL_HANDLE);
+    }
+
+    pthread_mutex_destroy(&output->swapchainLock);
+    pthread_mutex_destroy(&output->presentTimingLock);
+    pthread_cond_destroy(&output->presentTimingCond);
+    memset(output, 0, sizeof(*output));
+  }
+  g_outputCount = 0;
+  g_output = &g_outputs[0];
+
+  // Already done unless initialization failed before the device was created
+  captureWriterFinalize(&g_captureWriter);
+
+  // Hands the display back to the X server
+  if (g_acquiredDisplay != VK_NULL_HANDLE) {
+    pfn_vkReleaseDisplayEXT(g_physicalDevice, g_acquiredDisplay);
+    g_acquiredDisplay = VK_NULL_HANDLE;
+  }
+
+  if (g_instance != VK_NULL_HANDLE) {
+    vkDestroyInstance(g_instance, allocationCallbacks(HOST_OBJECT_INSTANCE));
     g_instance = VK_NULL_HANDLE;
   }
 
-  if (g_swapchainImages != VK_NULL_HANDLE) {
-    free(g_swapchainImages);
+  // After everything was destroyed, what is still live leaked
+  hostAllocatorPrintReport(&g_hostAllocator);
+  hostAllocatorFinalize(&g_hostAllocator);
+
+  if (g_xlibDisplay != NULL) {
+    XCloseDisplay(g_xlibDisplay);
+    g_xlibDisplay = NULL;
   }
 
   if (g_queueFamilyProperties != VK_NULL_HANDLE) {
     free(g_queueFamilyProperties);
+    g_queueFamilyProperties = VK_NULL_HANDLE;
   }
 }
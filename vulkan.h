@@ -3,12 +3,143 @@
 
 #define APP_NAME "vk-gsync-demo"
 
+#define VULKAN_MAX_RECORD_THREADS 16
+#define VULKAN_MAX_OUTPUTS        8
+
 #include <SDL2/SDL_vulkan.h>
 #include <vulkan/vulkan.h>
 
-SDL_bool InitializeVulkan(SDL_Window* pWindowHandle, int width, int height);
+// Swapchain present mode, unsupported ones fall back to FIFO
+typedef enum VulkanPresentMode_t {
+  VULKAN_PRESENT_MODE_FIFO,
+  VULKAN_PRESENT_MODE_FIFO_RELAXED,
+  VULKAN_PRESENT_MODE_MAILBOX,
+  VULKAN_PRESENT_MODE_IMMEDIATE,
+  VULKAN_PRESENT_MODE_COUNT,
+} VulkanPresentMode;
+
+// Test patterns, each a pipeline variant with its own bar width, color and
+// fragment shader load (specialization constants)
+typedef enum VulkanPattern_t {
+  VULKAN_PATTERN_DEFAULT,
+  VULKAN_PATTERN_THIN,
+  VULKAN_PATTERN_WIDE,
+  VULKAN_PATTERN_RED,
+  VULKAN_PATTERN_GPU_LOAD,
+  VULKAN_PATTERN_COUNT,
+} VulkanPattern;
+
+typedef struct VulkanConfig_t {
+  // Render straight to a display through VK_KHR_display instead of the SDL window
+  SDL_bool directDisplay;
+  int      displayIndex;
+
+  // Requested direct display mode, 0 means "any"
+  uint32_t modeWidth;
+  uint32_t modeHeight;
+  uint32_t modeRefreshRateMilliHz;
+
+  // Offscreen presentation through VK_EXT_headless_surface, no window needed
+  SDL_bool headless;
+
+  VulkanPresentMode presentMode;
+  VulkanPattern     pattern;
+
+  // Record one command buffer per swapchain image up front, the per-frame
+  // data then goes through a persistently mapped uniform buffer
+  SDL_bool prerecordedCommands;
+
+  // Threads recording the scene into secondary command buffers, 0 records
+  // it inline in Draw(). Capped at VULKAN_MAX_RECORD_THREADS.
+  uint32_t recordThreads;
+
+  // Keep the fence based frame synchronization even when
+  // VK_KHR_timeline_semaphore is available
+  SDL_bool disableTimelineSemaphore;
+
+  // Render through VK_KHR_dynamic_rendering instead of a render pass and
+  // framebuffers, falls back to the render pass when unsupported
+  SDL_bool dynamicRendering;
+
+  // Render only the region the bar moved through, on top of the swapchain
+  // image's previous content, and pass it as present region
+  // (VK_KHR_incremental_present) when supported
+  SDL_bool damageTracking;
+
+  // Pass allocation callbacks counting the driver's host allocations by scope
+  // and object type, reported at cleanup. Allocations in Draw() after the
+  // warm-up frames are logged. With the arena, object scope allocations come
+  // from one preallocated block.
+  SDL_bool trackHostAllocations;
+  SDL_bool hostAllocationArena;
+
+  // Copy every captureInterval-th frame to a staging buffer in the frame's own
+  // submission and write it to captureDirectory from a separate thread, as
+  // PNG when compressed, else PPM. Frames are dropped, never waited for,
+  // when the writer falls behind. NULL disables the capture.
+  const char *captureDirectory;
+  uint32_t    captureInterval;
+  SDL_bool    captureCompressed;
+} VulkanConfig;
+
+typedef struct PresentTiming_t {
+  uint64_t frameId;
+  double   submitTimeSec;   // clockNowSec() right after vkQueueSubmit
+  double   presentTimeSec;  // clockNowSec() when the frame was reported on screen
+  // SDL_FALSE when VK_KHR_present_wait is unavailable: presentTimeSec is then
+  // the time vkQueuePresentKHR returned
+  SDL_bool presentTimeIsDisplayed;
+} PresentTiming;
+
+SDL_bool InitializeVulkan(SDL_Window* pWindowHandle, int width, int height, const VulkanConfig *config);
+// One output (surface and swapchain) per window, all sharing the device and the
+// pipeline. Direct display and recording threads are single output only.
+// Capped at VULKAN_MAX_OUTPUTS.
+SDL_bool InitializeVulkanOutputs(SDL_Window **windows, const int *widths, const int *heights,
+                                 uint32_t count, const VulkanConfig *config);
+uint32_t GetOutputCount();
+// Selects the output the calling thread's Draw(), Update(), PollPresentTiming()
+// and the per-frame getters below refer to, output 0 until called
+void BindOutput(uint32_t output);
+SDL_bool ListDisplays();
+uint32_t GetDisplayRefreshRateMilliHz();
+// GPU execution time of the last completed frame, 0 when timestamps are unsupported
+double GetGpuFrameDurationSec();
+// CPU time Draw() spent preparing the frame's commands (recording or uniform update)
+double GetRecordingDurationSec();
+// Share of the frame's pixels rendered by the last Draw(), 1 without damage tracking
+double GetDamageFraction();
+uint32_t GetRecordThreadCount();
+// Time the recording thread spent on the last frame's secondary command buffer
+double GetThreadRecordingDurationSec(uint32_t thread);
+// Recreates the bound output's swapchain when the present mode changes
+SDL_bool SetPresentMode(VulkanPresentMode presentMode);
+VulkanPresentMode GetPresentMode();
+const char *GetPresentModeName(VulkanPresentMode presentMode);
+// Switches pipeline variant, the next frame renders the pattern. Pre-recorded
+// command buffers are recorded again after the queue drained.
+SDL_bool SetPattern(VulkanPattern pattern);
+VulkanPattern GetPattern();
+const char *GetPatternName(VulkanPattern pattern);
 void Update(float position);
-void Draw();
+// Returns the id of the submitted frame, matching PresentTiming::frameId
+uint64_t Draw();
+// Present timings of past frames in submission order, SDL_FALSE when none is ready
+SDL_bool PollPresentTiming(PresentTiming *timing);
+// Id of the last frame the GPU finished rendering. Without timeline semaphores
+// the fence only tracks the last submitted frame and these must be called
+// from the thread calling Draw().
+uint64_t GetCompletedFrameId();
+// Blocks until the GPU finished rendering the frame, SDL_FALSE on timeout or
+// when the frame was not submitted yet
+SDL_bool WaitForFrameCompletion(uint64_t frameId, uint64_t timeoutNs);
+// Host allocations made in Draw() after the warm-up frames, 0 when not tracked
+uint64_t GetFramePathHostAllocations();
+// Frames written and dropped by the frame capture, 0 when disabled
+void GetCaptureCounts(uint64_t *written, uint64_t *dropped);
+// Waits for the submitted frames to be presented and stops the present waiters,
+// PollPresentTiming() then returns the last timings until CleanupVulkan()
+void FinishPresentTimings();
 void CleanupVulkan();
 
 #endif //VULKAN_H